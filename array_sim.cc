@@ -0,0 +1,98 @@
+#include "assistant/array_sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Half-length of the fractional-delay filter, in samples.
+static const int kSincTaps = 16;
+// Room for the delays ahead of the first sample.
+static const int kMarginSamples = kSincTaps + 8;
+
+// Adds |source| delayed by |delay| samples and scaled by |gain| to |out|.
+static void AddDelayed(const std::vector<float>& source, double delay,
+                       float gain, std::vector<float>* out) {
+  int whole = static_cast<int>(std::floor(delay));
+  double fraction = delay - whole;
+  float taps[2 * kSincTaps];
+  for (int k = 0; k < 2 * kSincTaps; k++) {
+    double t = k - kSincTaps + 1 - fraction;
+    double sinc = t == 0 ? 1 : std::sin(M_PI * t) / (M_PI * t);
+    double window = 0.5 + 0.5 * std::cos(M_PI * t / kSincTaps);
+    taps[k] = gain * sinc * window;
+  }
+  int size = out->size();
+  for (int n = 0; n < size; n++) {
+    float sum = 0;
+    for (int k = 0; k < 2 * kSincTaps; k++) {
+      int i = n - whole - (k - kSincTaps + 1);
+      if (i >= 0 && i < static_cast<int>(source.size())) {
+        sum += taps[k] * source[i];
+      }
+    }
+    (*out)[n] += sum;
+  }
+}
+
+// Samples by which sound from |bearing_deg| reaches |mic| after the center
+// of the array.
+static double ArrivalDelay(const MicPosition& mic, float bearing_deg,
+                           const ArraySimConfig& config) {
+  double b = bearing_deg * M_PI / 180;
+  double lead_mm = mic.x_mm * std::cos(b) + mic.y_mm * std::sin(b);
+  return -lead_mm / 1000 / config.speed_of_sound_m_s * config.sample_rate;
+}
+
+WavData SimulateTalker(const std::vector<MicPosition>& mics,
+                       float bearing_deg, const ArraySimConfig& config) {
+  std::mt19937 random(config.seed);
+  std::normal_distribution<float> gaussian(0, 1);
+  const int samples = static_cast<int>(config.seconds * config.sample_rate);
+
+  // Noise with a speech-like tilt, in bursts.
+  std::vector<float> talker(samples);
+  float low = 0;
+  double sum_sq = 0;
+  int voiced = 0;
+  for (int n = 0; n < samples; n++) {
+    low = 0.6f * low + 0.4f * gaussian(random);
+    double phase = 2 * M_PI * config.syllable_hz * n / config.sample_rate;
+    float envelope = std::max(0.0, std::sin(phase));
+    talker[n] = low * envelope;
+    if (envelope > 0) {
+      sum_sq += talker[n] * talker[n];
+      voiced++;
+    }
+  }
+  float scale = config.talker_rms / std::sqrt(sum_sq / std::max(voiced, 1));
+  for (float& sample : talker) {
+    sample *= scale;
+  }
+
+  float noise_rms = config.talker_rms * std::pow(10, -config.snr_db / 20);
+  double echo_delay = config.echo_delay_ms / 1000 * config.sample_rate;
+  WavData wav;
+  wav.channels = mics.size();
+  wav.sample_rate = config.sample_rate;
+  wav.samples.resize(static_cast<size_t>(samples) * wav.channels);
+  for (int c = 0; c < wav.channels; c++) {
+    std::vector<float> mic(samples);
+    AddDelayed(talker, kMarginSamples +
+                           ArrivalDelay(mics[c], bearing_deg, config),
+               1, &mic);
+    if (config.echo_gain > 0) {
+      AddDelayed(talker,
+                 kMarginSamples + echo_delay +
+                     ArrivalDelay(mics[c],
+                                  bearing_deg + config.echo_offset_deg,
+                                  config),
+                 config.echo_gain, &mic);
+    }
+    for (int n = 0; n < samples; n++) {
+      float value = mic[n] + noise_rms * gaussian(random);
+      wav.samples[static_cast<size_t>(n) * wav.channels + c] =
+          static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, value)));
+    }
+  }
+  return wav;
+}
@@ -0,0 +1,36 @@
+#ifndef SRC_ASSISTANT_ARRAY_SIM_H_
+#define SRC_ASSISTANT_ARRAY_SIM_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "assistant/doa_service.h"
+#include "assistant/wav_file.h"
+
+struct ArraySimConfig {
+  int sample_rate = 16000;
+  float seconds = 1.5;
+  // RMS of the talker while voiced, on a full scale of 32768.
+  float talker_rms = 3000;
+  // Syllables per second; the talker is voiced for about half the time.
+  float syllable_hz = 4;
+  // Independent noise at every microphone, below the voiced talker.
+  float snr_db = 15;
+  // A reflection off a wall behind the talker: its level relative to the
+  // direct sound, and how much later and further round it arrives.
+  float echo_gain = 0.4;
+  float echo_delay_ms = 6;
+  float echo_offset_deg = 60;
+  float speed_of_sound_m_s = 343;
+  uint32_t seed = 1;
+};
+
+// A recording of |mics| hearing one far-field talker at |bearing_deg|,
+// clockwise from the robot's front: speech-shaped noise in syllable bursts,
+// delayed to every microphone by a windowed-sinc fractional delay, with its
+// echo and with uncorrelated noise at each microphone.
+WavData SimulateTalker(const std::vector<MicPosition>& mics,
+                       float bearing_deg, const ArraySimConfig& config);
+
+#endif  // SRC_ASSISTANT_ARRAY_SIM_H_
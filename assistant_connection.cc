@@ -0,0 +1,149 @@
+#include "assistant/assistant_connection.h"
+
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "assistant/time_util.h"
+
+using google::assistant::embedded::v1alpha2::AssistRequest;
+using google::assistant::embedded::v1alpha2::EmbeddedAssistant;
+
+static bool ReadFile(const std::string& path, std::string* contents) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *contents = buffer.str();
+  return true;
+}
+
+// Gives up on a stream opened ahead: the server is still waiting for its
+// config.
+static void Discard(std::unique_ptr<AssistantCall> call) {
+  if (call != nullptr) {
+    call->context.TryCancel();
+    call->stream->Finish();
+  }
+}
+
+AssistantConnection::AssistantConnection(
+    const AssistantConnectionConfig& config)
+    : config_(config) {}
+
+AssistantConnection::~AssistantConnection() {
+  if (next_call_.valid()) {
+    Discard(next_call_.get());
+  }
+}
+
+bool AssistantConnection::Init() {
+  std::shared_ptr<grpc::ChannelCredentials> channel_credentials;
+  if (config_.insecure) {
+    channel_credentials = grpc::InsecureChannelCredentials();
+  } else {
+    grpc::SslCredentialsOptions ssl_opts;
+    // Empty roots mean gRPC's own, as before.
+    ReadFile(config_.roots_pem_path, &ssl_opts.pem_root_certs);
+    if (config_.verbose) {
+      std::clog << "assistant_sdk robots_pem: " << ssl_opts.pem_root_certs
+                << std::endl;
+    }
+    channel_credentials = grpc::SslCredentials(ssl_opts);
+  }
+  if (!config_.credentials_path.empty()) {
+    std::string credentials;
+    if (!ReadFile(config_.credentials_path, &credentials)) {
+      std::cerr << "Credentials file \"" << config_.credentials_path
+                << "\" does not exist." << std::endl;
+      return false;
+    }
+    call_credentials_ = grpc::GoogleRefreshTokenCredentials(credentials);
+    if (call_credentials_ == nullptr) {
+      std::cerr << "Credentials file \"" << config_.credentials_path
+                << "\" is invalid. Check step 5 in README for how to get valid "
+                << "credentials." << std::endl;
+      return false;
+    }
+  }
+
+  std::string server = config_.endpoint;
+  if (server.find(':') == std::string::npos) {
+    server += ":443";
+  }
+  grpc::ChannelArguments channel_args;
+  channel_args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, config_.keepalive_ms);
+  channel_args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS,
+                      config_.keepalive_timeout_ms);
+  channel_args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+  channel_args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+  channel_args.SetInt(GRPC_ARG_INITIAL_RECONNECT_BACKOFF_MS,
+                      config_.min_reconnect_backoff_ms);
+  channel_args.SetInt(GRPC_ARG_MIN_RECONNECT_BACKOFF_MS,
+                      config_.min_reconnect_backoff_ms);
+  channel_args.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS,
+                      config_.max_reconnect_backoff_ms);
+  if (!config_.ssl_target_name.empty()) {
+    channel_args.SetSslTargetNameOverride(config_.ssl_target_name);
+  }
+  if (config_.verbose) {
+    std::clog << "assistant_sdk CreateCustomChannel(" << server
+              << ", creds, arg)" << std::endl;
+  }
+  channel_ = grpc::CreateCustomChannel(server, channel_credentials,
+                                       channel_args);
+  stub_ = EmbeddedAssistant::NewStub(channel_);
+  // Channels connect lazily; start now rather than at the first turn.
+  channel_->GetState(true);
+  return true;
+}
+
+bool AssistantConnection::WaitForConnected(int64_t timeout_ns) {
+  return channel_->WaitForConnected(std::chrono::system_clock::now() +
+                                    std::chrono::nanoseconds(timeout_ns));
+}
+
+std::unique_ptr<AssistantCall> AssistantConnection::OpenCall() {
+  std::unique_ptr<AssistantCall> call(new AssistantCall());
+  call->context.set_fail_fast(false);
+  if (call_credentials_ != nullptr) {
+    call->context.set_credentials(call_credentials_);
+  }
+  // Returns once the call is on a connected transport, the access token
+  // fetched if it had expired.
+  call->stream = stub_->Assist(&call->context);
+  call->opened_ns = MonotonicNowNs();
+  return call;
+}
+
+void AssistantConnection::PrepareNextCall() {
+  if (next_call_.valid()) {
+    return;
+  }
+  next_call_ = std::async(std::launch::async, [this] { return OpenCall(); });
+}
+
+std::unique_ptr<AssistantCall> AssistantConnection::StartCall(
+    const AssistRequest& config, grpc::Status* status) {
+  if (next_call_.valid()) {
+    std::unique_ptr<AssistantCall> call = next_call_.get();
+    if (MonotonicNowNs() - call->opened_ns <= config_.max_prepared_age_ns &&
+        call->stream->Write(config)) {
+      stats_.prepared_calls++;
+      return call;
+    }
+    // The server or the connection dropped it while it waited.
+    stats_.stale_calls++;
+    Discard(std::move(call));
+  }
+  std::unique_ptr<AssistantCall> call = OpenCall();
+  if (!call->stream->Write(config)) {
+    *status = call->stream->Finish();
+    return nullptr;
+  }
+  stats_.fresh_calls++;
+  return call;
+}
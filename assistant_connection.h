@@ -0,0 +1,110 @@
+#ifndef SRC_ASSISTANT_ASSISTANT_CONNECTION_H_
+#define SRC_ASSISTANT_ASSISTANT_CONNECTION_H_
+
+#include <grpc++/grpc++.h>
+#include <stdint.h>
+
+#include <future>  // NOLINT
+#include <memory>
+#include <string>
+
+#include "assistant/assistant_config.h"
+#include "google/assistant/embedded/v1alpha2/embedded_assistant.grpc.pb.h"
+#include "google/assistant/embedded/v1alpha2/embedded_assistant.pb.h"
+
+struct AssistantConnectionConfig {
+  // host or host:port; port 443 when none is given.
+  std::string endpoint = ASSISTANT_ENDPOINT;
+  // OAuth refresh-token JSON for the call credentials; none when empty,
+  // for a stand-in server.
+  std::string credentials_path;
+  std::string roots_pem_path = "robots.pem";
+  // Name the server certificate is checked against instead of the host,
+  // for a stand-in server with a test certificate.
+  std::string ssl_target_name;
+  // Plaintext, for a stand-in server only. gRPC sends no call credentials
+  // over it.
+  bool insecure = false;
+  // HTTP/2 pings keep NATs from dropping the idle channel between turns
+  // and notice a dead one before the next turn does. Much more often and
+  // servers answer with GOAWAY "too_many_pings".
+  int keepalive_ms = 60000;
+  int keepalive_timeout_ms = 10000;
+  // Reconnect backoff once the channel is lost.
+  int min_reconnect_backoff_ms = 500;
+  int max_reconnect_backoff_ms = 10000;
+  // A stream opened ahead that sat unused longer than this is dropped
+  // rather than risk the server having timed it out.
+  int64_t max_prepared_age_ns = 60000000000LL;
+  bool verbose = false;
+};
+
+// One Assist stream. The context must outlive the stream, hence both here.
+struct AssistantCall {
+  grpc::ClientContext context;
+  std::shared_ptr<grpc::ClientReaderWriter<
+      google::assistant::embedded::v1alpha2::AssistRequest,
+      google::assistant::embedded::v1alpha2::AssistResponse>>
+      stream;
+  // When the stream was opened, on MonotonicNowNs().
+  int64_t opened_ns = 0;
+};
+
+struct AssistantConnectionStats {
+  // Turns started on a stream opened ahead by PrepareNextCall().
+  int prepared_calls = 0;
+  // Turns that had to open their stream when they started.
+  int fresh_calls = 0;
+  // Streams opened ahead but dropped: too old, or the first write failed.
+  int stale_calls = 0;
+};
+
+// The Assistant's channel, credentials and stub, created once and kept
+// for every turn, instead of re-reading the credentials and root
+// certificates and dialing a new TLS connection each time. The call
+// credentials cache their OAuth access token, so it is refreshed when it
+// expires rather than on every turn. The next turn's stream can be opened
+// while the current response still plays, so a turn starts by writing its
+// config.
+//
+// Not thread safe: one thread runs the turns.
+class AssistantConnection {
+ public:
+  explicit AssistantConnection(const AssistantConnectionConfig& config);
+  ~AssistantConnection();
+
+  // Reads the credentials and root certificates and creates the channel,
+  // which starts connecting in the background. False, with the reason on
+  // std::cerr, if the credentials cannot be read.
+  bool Init();
+
+  // Waits up to |timeout_ns| for the channel to be ready. The channel
+  // keeps trying after a false return.
+  bool WaitForConnected(int64_t timeout_ns);
+
+  // Opens the next turn's stream in the background, unless one already is.
+  void PrepareNextCall();
+
+  // Returns the stream for a turn with |config| written to it: the one
+  // opened ahead if it is still good, otherwise a new one. Null if the
+  // write fails on a new stream too; its Finish() status says why.
+  std::unique_ptr<AssistantCall> StartCall(
+      const google::assistant::embedded::v1alpha2::AssistRequest& config,
+      grpc::Status* status);
+
+  const AssistantConnectionStats& stats() const { return stats_; }
+
+ private:
+  std::unique_ptr<AssistantCall> OpenCall();
+
+  AssistantConnectionConfig config_;
+  std::shared_ptr<grpc::Channel> channel_;
+  std::shared_ptr<grpc::CallCredentials> call_credentials_;
+  std::unique_ptr<
+      google::assistant::embedded::v1alpha2::EmbeddedAssistant::Stub>
+      stub_;
+  std::future<std::unique_ptr<AssistantCall>> next_call_;
+  AssistantConnectionStats stats_;
+};
+
+#endif  // SRC_ASSISTANT_ASSISTANT_CONNECTION_H_
@@ -0,0 +1,270 @@
+// Per-turn setup time of the Assistant loop against a local stand-in
+// server (assistant_stub_server.h): from the start of a turn to its config
+// written on an open Assist stream, after which audio can flow.
+//
+//   per_turn    what run_assistant_audio used to do every turn: read the
+//               root certificates, create a channel and stub, open the
+//               stream
+//   persistent  AssistantConnection: one channel for all turns, and the
+//               next turn's stream opened while the reply plays
+//
+// Each turn then streams a short utterance, reads the whole reply and
+// "plays" it for --playback-ms. With --cert and --key the stand-in serves
+// TLS with that certificate, which the client trusts for "localhost", so
+// per_turn pays for a handshake as it does against the real endpoint.
+// --endpoint talks to a stand-in already running elsewhere, in plaintext.
+//
+// Usage: ./assistant_connection_bench [--turns N] [--playback-ms MS]
+//                                     [--cert <pem> --key <pem>]
+//                                     [--endpoint <host:port>]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/assistant_connection.h"
+#include "assistant/assistant_stub_server.h"
+#include "assistant/time_util.h"
+
+namespace assistant = google::assistant::embedded::v1alpha2;
+
+using assistant::AssistRequest;
+using assistant::AssistResponse;
+
+typedef grpc::ClientReaderWriter<AssistRequest, AssistResponse> AssistStream;
+
+// 100 ms of 16 kHz LINEAR16 per request, half a second per utterance.
+static const int kAudioInBytes = 3200;
+static const int kAudioInChunks = 5;
+
+struct Options {
+  std::string endpoint;
+  std::string cert_path;
+  int playback_ms = 300;
+};
+
+static bool ReadFile(const std::string& path, std::string* contents) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "assistant_connection_bench: cannot read " << path
+              << std::endl;
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *contents = buffer.str();
+  return true;
+}
+
+static AssistRequest ConfigRequest() {
+  AssistRequest request;
+  auto config = request.mutable_config();
+  config->mutable_audio_in_config()->set_encoding(
+      assistant::AudioInConfig::LINEAR16);
+  config->mutable_audio_in_config()->set_sample_rate_hertz(16000);
+  config->mutable_audio_out_config()->set_encoding(
+      assistant::AudioOutConfig::LINEAR16);
+  config->mutable_audio_out_config()->set_sample_rate_hertz(16000);
+  config->mutable_dialog_state_in()->set_language_code("en-US");
+  config->mutable_device_config()->set_device_id("default");
+  config->mutable_device_config()->set_device_model_id("default");
+  return request;
+}
+
+// The rest of a turn once its config is written: the utterance, the reply
+// and its playback. |on_reply| runs at the first response.
+static bool Converse(AssistStream* stream, std::function<void()> on_reply,
+                     int playback_ms) {
+  AssistRequest request;
+  std::string silence(kAudioInBytes, '\0');
+  for (int i = 0; i < kAudioInChunks; i++) {
+    request.set_audio_in(silence);
+    stream->Write(request);
+  }
+  stream->WritesDone();
+  AssistResponse response;
+  bool replied = false;
+  while (stream->Read(&response)) {
+    if (!replied) {
+      replied = true;
+      on_reply();
+    }
+  }
+  grpc::Status status = stream->Finish();
+  if (!status.ok()) {
+    std::cerr << "assistant_connection_bench: turn failed: "
+              << status.error_message() << std::endl;
+    return false;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(playback_ms));
+  return true;
+}
+
+// The loop as it was: everything from scratch every turn.
+static bool PerTurn(const Options& options, const AssistRequest& config,
+                    int turns, std::vector<int64_t>* setup_ns) {
+  for (int turn = 0; turn < turns; turn++) {
+    int64_t start_ns = MonotonicNowNs();
+    std::shared_ptr<grpc::ChannelCredentials> credentials;
+    grpc::ChannelArguments channel_args;
+    if (options.cert_path.empty()) {
+      credentials = grpc::InsecureChannelCredentials();
+    } else {
+      grpc::SslCredentialsOptions ssl_opts;
+      if (!ReadFile(options.cert_path, &ssl_opts.pem_root_certs)) {
+        return false;
+      }
+      credentials = grpc::SslCredentials(ssl_opts);
+      channel_args.SetSslTargetNameOverride("localhost");
+    }
+    auto channel =
+        grpc::CreateCustomChannel(options.endpoint, credentials, channel_args);
+    auto stub = assistant::EmbeddedAssistant::NewStub(channel);
+    grpc::ClientContext context;
+    context.set_fail_fast(false);
+    std::shared_ptr<AssistStream> stream(stub->Assist(&context));
+    if (!stream->Write(config)) {
+      std::cerr << "assistant_connection_bench: cannot open a stream"
+                << std::endl;
+      return false;
+    }
+    setup_ns->push_back(MonotonicNowNs() - start_ns);
+    if (!Converse(stream.get(), [] {}, options.playback_ms)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool Persistent(const Options& options, const AssistRequest& config,
+                       int turns, std::vector<int64_t>* setup_ns) {
+  AssistantConnectionConfig connection_config;
+  connection_config.endpoint = options.endpoint;
+  connection_config.insecure = options.cert_path.empty();
+  connection_config.roots_pem_path = options.cert_path;
+  connection_config.ssl_target_name = "localhost";
+  AssistantConnection connection(connection_config);
+  if (!connection.Init() || !connection.WaitForConnected(5000000000LL)) {
+    std::cerr << "assistant_connection_bench: cannot connect" << std::endl;
+    return false;
+  }
+  for (int turn = 0; turn < turns; turn++) {
+    int64_t start_ns = MonotonicNowNs();
+    grpc::Status status;
+    std::unique_ptr<AssistantCall> call =
+        connection.StartCall(config, &status);
+    if (call == nullptr) {
+      std::cerr << "assistant_connection_bench: cannot open a stream: "
+                << status.error_message() << std::endl;
+      return false;
+    }
+    setup_ns->push_back(MonotonicNowNs() - start_ns);
+    if (!Converse(call->stream.get(),
+                  [&connection] { connection.PrepareNextCall(); },
+                  options.playback_ms)) {
+      return false;
+    }
+  }
+  const AssistantConnectionStats& stats = connection.stats();
+  printf("persistent: %d turns on a stream opened ahead, %d opened at the "
+         "turn, %d dropped as stale\n",
+         stats.prepared_calls, stats.fresh_calls, stats.stale_calls);
+  return true;
+}
+
+static void PrintStats(const char* name, std::vector<int64_t> samples) {
+  // The first turn connects either way; shown apart.
+  int64_t first = samples[0];
+  std::sort(samples.begin(), samples.end());
+  int64_t sum = 0;
+  for (int64_t s : samples) {
+    sum += s;
+  }
+  printf("%-11s first=%.2fms mean=%.2fms p50=%.2fms max=%.2fms\n", name,
+         first / 1e6, static_cast<double>(sum) / samples.size() / 1e6,
+         samples[samples.size() / 2] / 1e6, samples.back() / 1e6);
+}
+
+int main(int argc, char** argv) {
+  int turns = 20;
+  Options options;
+  std::string key_path;
+
+  const struct option long_options[] = {
+      {"turns", required_argument, nullptr, 'n'},
+      {"playback-ms", required_argument, nullptr, 'p'},
+      {"cert", required_argument, nullptr, 'c'},
+      {"key", required_argument, nullptr, 'k'},
+      {"endpoint", required_argument, nullptr, 'e'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:p:c:k:e:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        turns = std::atoi(optarg);
+        break;
+      case 'p':
+        options.playback_ms = std::atoi(optarg);
+        break;
+      case 'c':
+        options.cert_path = optarg;
+        break;
+      case 'k':
+        key_path = optarg;
+        break;
+      case 'e':
+        options.endpoint = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+  if (turns < 1 || options.cert_path.empty() != key_path.empty()) {
+    std::cerr << "assistant_connection_bench: --cert and --key go together"
+              << std::endl;
+    return -1;
+  }
+
+  StubAssistantConfig stub_config;
+  if (!options.cert_path.empty() &&
+      (!ReadFile(options.cert_path, &stub_config.cert_pem) ||
+       !ReadFile(key_path, &stub_config.key_pem))) {
+    return -1;
+  }
+  StubAssistantServer server(stub_config);
+  if (options.endpoint.empty()) {
+    if (!server.Start("localhost:0")) {
+      return -1;
+    }
+    options.endpoint = "localhost:" + std::to_string(server.port());
+  }
+  printf("%d turns against %s (%s), %d ms playback\n", turns,
+         options.endpoint.c_str(),
+         options.cert_path.empty() ? "plaintext" : "TLS",
+         options.playback_ms);
+
+  AssistRequest config = ConfigRequest();
+  std::vector<int64_t> per_turn_ns, persistent_ns;
+  if (!PerTurn(options, config, turns, &per_turn_ns) ||
+      !Persistent(options, config, turns, &persistent_ns)) {
+    return -1;
+  }
+  PrintStats("per_turn", per_turn_ns);
+  PrintStats("persistent", persistent_ns);
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "assistant/assistant_stub_server.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/time_util.h"
+
+using google::assistant::embedded::v1alpha2::AssistRequest;
+using google::assistant::embedded::v1alpha2::AssistResponse;
+using google::assistant::embedded::v1alpha2::EmbeddedAssistant;
+
+class StubAssistantServer::Service : public EmbeddedAssistant::Service {
+ public:
+  Service(const StubAssistantConfig& config, std::atomic<int>* turns)
+      : config_(config), turns_(turns) {}
+
+  grpc::Status Assist(
+      grpc::ServerContext* context,
+      grpc::ServerReaderWriter<AssistResponse, AssistRequest>* stream)
+      override {
+    AssistRequest request;
+    if (!stream->Read(&request)) {
+      // Opened ahead and then dropped by the client.
+      return grpc::Status::CANCELLED;
+    }
+    if (!request.has_config()) {
+      return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "the first request must carry the config");
+    }
+    AssistResponse response;
+    if (config_.speech.empty()) {
+      while (stream->Read(&request)) {
+      }
+      if (config_.partials) {
+        StreamPartials(stream);
+      }
+      response.set_event_type(
+          google::assistant::embedded::v1alpha2::
+              AssistResponse_EventType_END_OF_UTTERANCE);
+      auto result = response.add_speech_results();
+      result->set_transcript(Transcript());
+      result->set_stability(1);
+      stream->Write(response);
+    } else {
+      StreamSpeech(stream);
+    }
+
+    response.Clear();
+    response.mutable_dialog_state_out()->set_supplemental_display_text(
+        config_.reply_text);
+    stream->Write(response);
+
+    std::vector<char> silence(config_.audio_out_bytes);
+    for (int i = 0; i < config_.audio_out_chunks; i++) {
+      response.Clear();
+      response.mutable_audio_out()->set_audio_data(silence.data(),
+                                                   silence.size());
+      if (!stream->Write(response)) {
+        break;
+      }
+    }
+    (*turns_)++;
+    return grpc::Status::OK;
+  }
+
+ private:
+  const std::string& Transcript() const {
+    if (config_.transcripts.empty()) {
+      return config_.transcript;
+    }
+    size_t turn = turns_->load();
+    return config_.transcripts[std::min(turn, config_.transcripts.size() - 1)];
+  }
+
+  void StreamPartials(
+      grpc::ServerReaderWriter<AssistResponse, AssistRequest>* stream) {
+    const std::string& transcript = Transcript();
+    size_t end = transcript.find(' ');
+    while (true) {
+      AssistResponse response;
+      auto result = response.add_speech_results();
+      result->set_transcript(transcript.substr(0, end));
+      result->set_stability(0.9);
+      stream->Write(response);
+      if (end == std::string::npos) {
+        return;
+      }
+      end = transcript.find(' ', end + 1);
+    }
+  }
+
+  // Recognition goes out while the audio still comes in, as it does from
+  // the Assistant; the client stops sending at END_OF_UTTERANCE.
+  void StreamSpeech(
+      grpc::ServerReaderWriter<AssistResponse, AssistRequest>* stream) {
+    std::thread reader([stream] {
+      AssistRequest audio;
+      while (stream->Read(&audio)) {
+      }
+    });
+    int64_t start_ns = MonotonicNowNs();
+    AssistResponse response;
+    for (size_t i = 0; i < config_.speech.size(); i++) {
+      const StubSpeechResponse& speech = config_.speech[i];
+      std::this_thread::sleep_for(std::chrono::nanoseconds(
+          start_ns + speech.offset_ms * 1000000 - MonotonicNowNs()));
+      response.Clear();
+      if (i + 1 == config_.speech.size()) {
+        response.set_event_type(
+            google::assistant::embedded::v1alpha2::
+                AssistResponse_EventType_END_OF_UTTERANCE);
+      }
+      for (const auto& result : speech.results) {
+        auto speech_result = response.add_speech_results();
+        speech_result->set_transcript(result.first);
+        speech_result->set_stability(result.second);
+      }
+      if (!stream->Write(response)) {
+        break;
+      }
+    }
+    reader.join();
+  }
+
+  const StubAssistantConfig& config_;
+  std::atomic<int>* turns_;
+};
+
+StubAssistantServer::StubAssistantServer(const StubAssistantConfig& config)
+    : config_(config), port_(0), turns_(0) {}
+
+StubAssistantServer::~StubAssistantServer() { Shutdown(); }
+
+bool StubAssistantServer::Start(const std::string& address) {
+  std::shared_ptr<grpc::ServerCredentials> credentials;
+  if (config_.cert_pem.empty()) {
+    credentials = grpc::InsecureServerCredentials();
+  } else {
+    grpc::SslServerCredentialsOptions options;
+    options.pem_key_cert_pairs.push_back({config_.key_pem, config_.cert_pem});
+    credentials = grpc::SslServerCredentials(options);
+  }
+  service_.reset(new Service(config_, &turns_));
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(address, credentials, &port_);
+  builder.RegisterService(service_.get());
+  server_ = builder.BuildAndStart();
+  if (server_ == nullptr || port_ == 0) {
+    std::cerr << "assistant_stub_server: cannot listen on " << address
+              << std::endl;
+    server_.reset();
+    return false;
+  }
+  return true;
+}
+
+void StubAssistantServer::Shutdown() {
+  if (server_ != nullptr) {
+    // Calls still open, e.g. a stream a client opened ahead, are cancelled.
+    server_->Shutdown(std::chrono::system_clock::now() +
+                      std::chrono::seconds(1));
+    server_.reset();
+  }
+}
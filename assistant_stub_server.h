@@ -0,0 +1,75 @@
+#ifndef SRC_ASSISTANT_ASSISTANT_STUB_SERVER_H_
+#define SRC_ASSISTANT_ASSISTANT_STUB_SERVER_H_
+
+#include <grpc++/grpc++.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/assistant/embedded/v1alpha2/embedded_assistant.grpc.pb.h"
+
+// One response of streamed recognition.
+struct StubSpeechResponse {
+  // From the config request.
+  int64_t offset_ms = 0;
+  // Transcript and stability of each result.
+  std::vector<std::pair<std::string, float>> results;
+};
+
+struct StubAssistantConfig {
+  std::string transcript = "what time is it";
+  // If set, the transcripts of successive turns, in place of |transcript|;
+  // the last one repeats.
+  std::vector<std::string> transcripts;
+  // If set, the transcript is led by partial results growing a word at a
+  // time, as "come", "come on" ahead of the final "come on".
+  bool partials = false;
+  // Recognition as the Assistant streams it while the user speaks, sent at
+  // its offsets as the client's audio keeps coming; the last response,
+  // with the final result, carries END_OF_UTTERANCE. When empty,
+  // |transcript| is sent, final, once the client is done writing.
+  std::vector<StubSpeechResponse> speech;
+  std::string reply_text = "It is noon.";
+  // The spoken reply: chunks of silent LINEAR16 audio.
+  int audio_out_chunks = 8;
+  int audio_out_bytes = 3200;
+  // PEM server certificate and key for TLS; plaintext when empty.
+  std::string cert_pem;
+  std::string key_pem;
+};
+
+// A local stand-in for the EmbeddedAssistant service, to measure the
+// client's turn setup and command handling without the network or an
+// account. Each Assist call expects the config first, takes audio until the
+// client is done writing, then answers like the Assistant does: the
+// recognized transcript with END_OF_UTTERANCE, the display text and the
+// spoken reply.
+class StubAssistantServer {
+ public:
+  explicit StubAssistantServer(const StubAssistantConfig& config);
+  ~StubAssistantServer();
+
+  // Listens on |address|, e.g. "localhost:0" for any free port. False,
+  // with the reason on std::cerr, if it cannot.
+  bool Start(const std::string& address);
+  void Shutdown();
+
+  int port() const { return port_; }
+  // Assist calls answered so far.
+  int turns() const { return turns_; }
+
+ private:
+  class Service;
+
+  StubAssistantConfig config_;
+  std::unique_ptr<Service> service_;
+  std::unique_ptr<grpc::Server> server_;
+  int port_;
+  std::atomic<int> turns_;
+};
+
+#endif  // SRC_ASSISTANT_ASSISTANT_STUB_SERVER_H_
@@ -0,0 +1,35 @@
+#include "assistant/audio_buffer_pool.h"
+
+AudioBufferPool::AudioBufferPool(int buffers, size_t buffer_bytes)
+    : count_(buffers), slots_(new Slot[buffers]), next_(0), misses_(0) {
+  for (size_t i = 0; i < count_; i++) {
+    slots_[i].claimed.store(false, std::memory_order_relaxed);
+    slots_[i].buffer = std::make_shared<std::vector<unsigned char>>();
+    slots_[i].buffer->reserve(buffer_bytes);
+  }
+}
+
+std::shared_ptr<std::vector<unsigned char>> AudioBufferPool::Acquire(
+    size_t bytes) {
+  size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < count_; i++) {
+    Slot& slot = slots_[(start + i) % count_];
+    if (slot.claimed.exchange(true, std::memory_order_acquire)) {
+      continue;
+    }
+    // Only the pool hands out references, and only under |claimed|, so a
+    // count of one cannot go back up behind our back. The last user
+    // dropped its reference with a release decrement; the fence orders
+    // its reads of the buffer before our writes.
+    if (slot.buffer.use_count() == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      slot.buffer->resize(bytes);
+      std::shared_ptr<std::vector<unsigned char>> buffer = slot.buffer;
+      slot.claimed.store(false, std::memory_order_release);
+      return buffer;
+    }
+    slot.claimed.store(false, std::memory_order_release);
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
@@ -0,0 +1,45 @@
+#ifndef SRC_ASSISTANT_AUDIO_BUFFER_POOL_H_
+#define SRC_ASSISTANT_AUDIO_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// A fixed set of audio buffers, handed out as the
+// std::shared_ptr<std::vector<unsigned char>> that AudioInput listeners
+// and AudioOutput::Send pass around. A buffer is free again once the pool
+// holds its only reference, so it comes back with its capacity and its
+// shared_ptr control block: once warm, a chunk costs no heap allocation.
+//
+// Acquire() never blocks and takes no lock; any thread may call it, and
+// buffers may be dropped on any thread.
+class AudioBufferPool {
+ public:
+  // |buffers| buffers with |buffer_bytes| reserved in each.
+  AudioBufferPool(int buffers, size_t buffer_bytes);
+
+  // A free buffer resized to |bytes|, or null when all are in use. Growing
+  // a buffer past its capacity allocates, once.
+  std::shared_ptr<std::vector<unsigned char>> Acquire(size_t bytes);
+
+  // Acquire() calls that found no free buffer.
+  uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Slot {
+    // Held while a thread checks and hands out the buffer.
+    std::atomic<bool> claimed;
+    std::shared_ptr<std::vector<unsigned char>> buffer;
+  };
+
+  const size_t count_;
+  std::unique_ptr<Slot[]> slots_;
+  // Where the next search starts, so buffers are used round robin.
+  std::atomic<size_t> next_;
+  std::atomic<uint64_t> misses_;
+};
+
+#endif  // SRC_ASSISTANT_AUDIO_BUFFER_POOL_H_
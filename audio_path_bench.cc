@@ -0,0 +1,271 @@
+// Heap allocations and per-chunk latency of the Assist audio path, the way
+// run_assistant_audio handles each chunk, without ALSA or the network:
+//
+//   upload    an audio chunk handed to the data listener, copied into the
+//             AssistRequest and serialized as stream->Write() does
+//   download  an AssistResponse parsed as stream->Read() does, its
+//             audio_out copied into a buffer and queued for a playback
+//             thread that drops it
+//
+// Each path runs as run_assistant_audio used to, with a fresh heap buffer
+// per chunk, and as it does now: audio_in assigned into the request's
+// string, audio_out copied into AudioBufferPool buffers. Two rows are not
+// what it does: "upload pool" is the capture side taking its chunks from a
+// pool, which AudioInputALSA does not, and "download pool+arena" parses
+// the responses on a protobuf Arena reset every turn, which saves
+// allocations but costs more at p99 than it saves. Allocations are
+// counted by replacing the global operator new, and reported per chunk and
+// per second of audio (16 kHz LINEAR16). Latency is the time to handle one
+// chunk.
+//
+// Usage: ./audio_path_bench [--chunks N] [--chunk-bytes N]
+
+#include <getopt.h>
+#include <google/protobuf/arena.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/audio_buffer_pool.h"
+#include "assistant/lock_free_queue.h"
+#include "assistant/time_util.h"
+#include "google/assistant/embedded/v1alpha2/embedded_assistant.pb.h"
+
+using google::assistant::embedded::v1alpha2::AssistRequest;
+using google::assistant::embedded::v1alpha2::AssistResponse;
+
+typedef std::shared_ptr<std::vector<unsigned char>> AudioChunk;
+
+static const int kBytesPerSecond = 16000 * 2;
+// Responses per turn, for resetting the arena.
+static const int kChunksPerTurn = 50;
+// Chunks the playback side may hold at once, as ALSA's queue would.
+static const int kPoolBuffers = 256;
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Drains queued chunks on its own thread, like the playback thread does.
+class Playback {
+ public:
+  Playback()
+      : queue_(1024), sent_(0), played_(0), running_(true),
+        thread_([this] { Run(); }) {}
+  ~Playback() {
+    running_ = false;
+    thread_.join();
+  }
+  void Send(AudioChunk chunk) {
+    sent_++;
+    while (!queue_.TryPush(&chunk)) {
+      std::this_thread::yield();
+    }
+  }
+  // Waits for the reply queued so far to have played.
+  void Drain() {
+    while (played_ != sent_) {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  void Run() {
+    AudioChunk chunk;
+    while (running_) {
+      if (!queue_.TryPop(&chunk)) {
+        std::this_thread::yield();
+        continue;
+      }
+      chunk.reset();
+      played_++;
+    }
+    while (queue_.TryPop(&chunk)) {
+    }
+  }
+
+  LockFreeQueue<AudioChunk> queue_;
+  std::atomic<uint64_t> sent_;
+  std::atomic<uint64_t> played_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+struct Result {
+  double allocations_per_chunk;
+  int64_t p50_ns, p99_ns, max_ns;
+};
+
+static void Print(const char* name, const Result& result, int chunk_bytes) {
+  printf("%-32s %6.2f allocs/chunk %8.1f allocs/s  p50=%5.1fus "
+         "p99=%5.1fus max=%6.1fus\n",
+         name, result.allocations_per_chunk,
+         result.allocations_per_chunk * kBytesPerSecond / chunk_bytes,
+         result.p50_ns / 1e3, result.p99_ns / 1e3, result.max_ns / 1e3);
+}
+
+// Runs |handle| once per chunk, after a warm-up of one turn. With a
+// |playback|, each turn's reply plays out before the next turn starts.
+template <typename Handle>
+static Result Measure(int chunks, Playback* playback, Handle handle) {
+  for (int i = 0; i < kChunksPerTurn; i++) {
+    handle(i);
+  }
+  std::vector<int64_t> samples;
+  samples.reserve(chunks);
+  uint64_t start_allocations = allocations.load();
+  for (int i = 0; i < chunks; i++) {
+    if (playback != nullptr && i % kChunksPerTurn == 0) {
+      playback->Drain();
+    }
+    int64_t start_ns = MonotonicNowNs();
+    handle(i);
+    samples.push_back(MonotonicNowNs() - start_ns);
+  }
+  Result result;
+  result.allocations_per_chunk =
+      static_cast<double>(allocations.load() - start_allocations) / chunks;
+  std::sort(samples.begin(), samples.end());
+  result.p50_ns = samples[samples.size() / 2];
+  result.p99_ns = samples[samples.size() * 99 / 100];
+  result.max_ns = samples.back();
+  return result;
+}
+
+int main(int argc, char** argv) {
+  int chunks = 20000;
+  int chunk_bytes = 3200;
+
+  const struct option long_options[] = {
+      {"chunks", required_argument, nullptr, 'n'},
+      {"chunk-bytes", required_argument, nullptr, 'b'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:b:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        chunks = std::atoi(optarg);
+        break;
+      case 'b':
+        chunk_bytes = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+  printf("%d chunks of %d bytes (%.0f ms of audio each)\n", chunks,
+         chunk_bytes, 1000.0 * chunk_bytes / kBytesPerSecond);
+
+  // Upload. The capture side hands the listener a chunk; the request and
+  // the buffer it is serialized to are reused, as the listener reuses its
+  // request and gRPC its send buffer. set_audio_in(pointer, size) builds a
+  // temporary string; assigning into mutable_audio_in() does not.
+  {
+    std::vector<unsigned char> captured(chunk_bytes, 1);
+    AssistRequest request;
+    std::string wire;
+    Print("upload heap", Measure(chunks, nullptr, [&](int) {
+            AudioChunk data(new std::vector<unsigned char>(chunk_bytes));
+            memcpy(data->data(), captured.data(), chunk_bytes);
+            request.set_audio_in(data->data(), data->size());
+            request.SerializeToString(&wire);
+          }), chunk_bytes);
+    Print("upload assign", Measure(chunks, nullptr, [&](int) {
+            AudioChunk data(new std::vector<unsigned char>(chunk_bytes));
+            memcpy(data->data(), captured.data(), chunk_bytes);
+            request.mutable_audio_in()->assign(
+                reinterpret_cast<const char*>(data->data()), data->size());
+            request.SerializeToString(&wire);
+          }), chunk_bytes);
+    AudioBufferPool pool(kPoolBuffers, chunk_bytes);
+    Print("upload pool (hypothetical)", Measure(chunks, nullptr, [&](int) {
+            AudioChunk data = pool.Acquire(chunk_bytes);
+            memcpy(data->data(), captured.data(), chunk_bytes);
+            request.mutable_audio_in()->assign(
+                reinterpret_cast<const char*>(data->data()), data->size());
+            request.SerializeToString(&wire);
+          }), chunk_bytes);
+  }
+
+  // Download.
+  {
+    AssistResponse reply;
+    reply.mutable_audio_out()->set_audio_data(std::string(chunk_bytes, 1));
+    std::string wire = reply.SerializeAsString();
+    Playback playback;
+    AssistResponse response;
+
+    Print("download heap", Measure(chunks, &playback, [&](int) {
+            response.ParseFromString(wire);
+            const std::string& audio = response.audio_out().audio_data();
+            AudioChunk data(new std::vector<unsigned char>);
+            data->resize(audio.size());
+            memcpy(data->data(), audio.data(), audio.size());
+            playback.Send(data);
+          }), chunk_bytes);
+
+    AudioBufferPool pool(kPoolBuffers, chunk_bytes);
+    auto send_pooled = [&pool, &playback](const std::string& audio) {
+      AudioChunk data = pool.Acquire(audio.size());
+      if (data == nullptr) {
+        data = std::make_shared<std::vector<unsigned char>>(audio.size());
+      }
+      memcpy(data->data(), audio.data(), audio.size());
+      playback.Send(data);
+    };
+    Print("download pool", Measure(chunks, &playback, [&](int) {
+            response.ParseFromString(wire);
+            send_pooled(response.audio_out().audio_data());
+          }), chunk_bytes);
+
+    // Parsing frees and reallocates audio_out, its string and the string's
+    // buffer every Read. On an arena the first two come from the arena,
+    // freed all at once when the next turn resets it; the buffer is still
+    // allocated on the heap.
+    std::vector<char> block(64 << 10);
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block.data();
+    options.initial_block_size = block.size();
+    google::protobuf::Arena arena(options);
+    AssistResponse* arena_response = nullptr;
+    Print("download pool+arena (not used)",
+          Measure(chunks, &playback, [&](int i) {
+            if (i % kChunksPerTurn == 0) {
+              arena.Reset();
+              arena_response =
+                  google::protobuf::Arena::CreateMessage<AssistResponse>(
+                      &arena);
+            }
+            arena_response->ParseFromString(wire);
+            send_pooled(arena_response->audio_out().audio_data());
+          }), chunk_bytes);
+    if (pool.misses() > 0) {
+      printf("pool ran dry %llu times\n",
+             static_cast<unsigned long long>(pool.misses()));  // NOLINT
+    }
+  }
+  return 0;
+}
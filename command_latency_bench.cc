@@ -0,0 +1,423 @@
+// Robot command latency with and without speculation: recorded transcript
+// streams played by the stand-in server (assistant_stub_server.h), which
+// streams recognition as the Assistant does while the user speaks, through
+// the response handling of run_assistant_audio:
+//
+//   final        acting on the final result only, as before
+//   speculative  CommandSpeculator on the partial results as well
+//
+// For each stream it reports, from the start of the turn:
+//
+//   final_ms   arrival of the final result
+//   effect_ms  the command's first effect: a motor write or the detector
+//              switched on
+//   done_ms    for turns, the robot facing the commanded way
+//
+// The motion controller, IMU service and speculation run for real, on the
+// simulated robot (robot_sim.h) in real time.
+//
+// Transcript streams are one response per line, "<offset ms> <stability>
+// <transcript>", lines with the same offset being the results of one
+// response; stability 1 is the final result, and a blank line ends the
+// stream. Without --transcripts a built-in set is used.
+//
+// Usage: ./command_latency_bench [--transcripts <file>] [--stability S]
+//                                [--settle-ms MS]
+
+#include <getopt.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/assistant_stub_server.h"
+#include "assistant/command_recognizer.h"
+#include "assistant/heading_controller.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_commands.h"
+#include "assistant/robot_sim.h"
+#include "assistant/time_util.h"
+
+namespace assistant = google::assistant::embedded::v1alpha2;
+
+using assistant::AssistRequest;
+using assistant::AssistResponse;
+
+typedef grpc::ClientReaderWriter<AssistRequest, AssistResponse> AssistStream;
+
+static const int kAudioInBytes = 3200;
+static const int64_t kAudioInPeriodNs = 100000000;
+// A turn is done once the robot is this close to the commanded heading.
+static const float kTurnToleranceDeg = 5;
+
+static const char kBuiltinTranscripts[] =
+    "300 0.01 turn\n"
+    "500 0.9 turn\n500 0.01 left\n"
+    "700 0.9 turn left\n"
+    "1400 1 turn left\n"
+    "\n"
+    "300 0.01 stop\n"
+    "500 0.9 stop\n"
+    "1200 1 stop\n"
+    "\n"
+    "300 0.01 fall\n"
+    "500 0.9 follow\n"
+    "800 0.9 follow me\n"
+    "1500 1 follow me\n"
+    "\n"
+    "300 0.9 come\n"
+    "500 0.9 come to\n"
+    "700 0.9 come to me\n"
+    "1400 1 come to me\n"
+    "\n"
+    "300 0.9 turn\n"
+    "600 0.9 turn\n600 0.1 around\n"
+    "800 0.9 turn around\n"
+    "1500 1 turn around\n"
+    "\n"
+    "300 0.9 turn\n"
+    "600 0.9 turn right\n"
+    "1300 1 turn right\n"
+    "\n"
+    "300 0.9 go\n"
+    "500 0.9 go forward\n"
+    "1200 1 go forward\n"
+    "\n"
+    "400 0.9 stop\n"
+    "700 0.9 stop the\n"
+    "900 0.9 stop the music\n"
+    "1600 1 stop the music\n"
+    "\n"
+    "300 0.9 come\n"
+    "600 0.9 come on\n"
+    "1300 1 come on\n"
+    "\n"
+    "300 0.9 what\n"
+    "600 0.9 what time\n"
+    "800 0.9 what time is it\n"
+    "1500 1 what time is it\n";
+
+// The simulated robot's motors and detector, recording the first effect of
+// a command: a motor write or the detector being switched on.
+class BenchPorts : public MotorPort, public DetectionSource {
+ public:
+  explicit BenchPorts(SimRobot* robot) : robot_(robot), effect_ns_(0) {}
+
+  void Set(float duty_a, float duty_b) override {
+    robot_->motors()->Set(duty_a, duty_b);
+    Effect();
+  }
+  void SetActive(bool active) override {
+    robot_->detections()->SetActive(active);
+    if (active) {
+      Effect();
+    }
+  }
+  bool ReadLatest(DetectionRecord* record) override {
+    return robot_->detections()->ReadLatest(record);
+  }
+
+  // Forgets the effects so far.
+  void Arm() { effect_ns_ = 0; }
+  int64_t effect_ns() const { return effect_ns_; }
+
+ private:
+  void Effect() {
+    int64_t expected = 0;
+    effect_ns_.compare_exchange_strong(expected, MonotonicNowNs());
+  }
+
+  SimRobot* robot_;
+  std::atomic<int64_t> effect_ns_;
+};
+
+struct Stream {
+  std::vector<StubSpeechResponse> speech;
+  std::string final_transcript;
+};
+
+struct TurnResult {
+  int64_t final_ns = -1;
+  int64_t effect_ns = -1;
+  int64_t done_ns = -1;
+};
+
+static bool ParseStreams(std::istream& in, std::vector<Stream>* streams) {
+  Stream stream;
+  std::string line;
+  while (true) {
+    bool more = static_cast<bool>(std::getline(in, line));
+    if (!more || line.empty()) {
+      if (!stream.speech.empty()) {
+        if (stream.final_transcript.empty()) {
+          std::cerr << "command_latency_bench: a stream has no final result"
+                    << std::endl;
+          return false;
+        }
+        streams->push_back(stream);
+      }
+      stream = Stream();
+      if (!more) {
+        return true;
+      }
+      continue;
+    }
+    std::istringstream fields(line);
+    int64_t offset_ms;
+    float stability;
+    std::string transcript;
+    if (!(fields >> offset_ms >> stability) ||
+        !std::getline(fields >> std::ws, transcript)) {
+      std::cerr << "command_latency_bench: bad line \"" << line << "\""
+                << std::endl;
+      return false;
+    }
+    if (stream.speech.empty() ||
+        stream.speech.back().offset_ms != offset_ms) {
+      stream.speech.push_back(StubSpeechResponse());
+      stream.speech.back().offset_ms = offset_ms;
+    }
+    stream.speech.back().results.push_back({transcript, stability});
+    if (stability >= 1) {
+      stream.final_transcript = transcript;
+    }
+  }
+}
+
+static float TurnDegrees(const std::string& transcript) {
+  if (transcript == "turn right") {
+    return 90;
+  } else if (transcript == "turn left") {
+    return -90;
+  } else if (transcript == "turn around") {
+    return -180;
+  }
+  return 0;
+}
+
+// One turn of the response loop against |endpoint|.
+static bool RunTurn(const std::string& endpoint, const Stream& stream,
+                    bool speculate, const RecognizerConfig& recognizer_config,
+                    int settle_ms, Clock* clock, SimRobot* robot,
+                    BenchPorts* ports, MotionController* motion,
+                    TurnResult* result) {
+  auto channel =
+      grpc::CreateChannel(endpoint, grpc::InsecureChannelCredentials());
+  auto stub = assistant::EmbeddedAssistant::NewStub(channel);
+  if (!channel->WaitForConnected(std::chrono::system_clock::now() +
+                                 std::chrono::seconds(5))) {
+    std::cerr << "command_latency_bench: cannot connect" << std::endl;
+    return false;
+  }
+  FollowBehavior follow(motion, ports, clock, FollowConfig());
+  CommandSpeculator speculator(motion, ports, nullptr, recognizer_config);
+  double start_yaw = robot->Pose().heading_deg;
+  ports->Arm();
+
+  grpc::ClientContext context;
+  std::shared_ptr<AssistStream> assist(stub->Assist(&context));
+  AssistRequest request;
+  request.mutable_config()->mutable_audio_in_config()->set_sample_rate_hertz(
+      16000);
+  int64_t start_ns = MonotonicNowNs();
+  if (!assist->Write(request)) {
+    std::cerr << "command_latency_bench: cannot open a stream" << std::endl;
+    return false;
+  }
+  // The microphone, until the end of the utterance.
+  std::atomic<bool> listening(true);
+  std::thread microphone([&assist, &listening] {
+    AssistRequest audio;
+    audio.set_audio_in(std::string(kAudioInBytes, '\0'));
+    int64_t next_ns = MonotonicNowNs();
+    while (listening) {
+      assist->Write(audio);
+      next_ns += kAudioInPeriodNs;
+      std::this_thread::sleep_for(
+          std::chrono::nanoseconds(next_ns - MonotonicNowNs()));
+    }
+    assist->WritesDone();
+  });
+
+  AssistResponse response;
+  while (assist->Read(&response)) {
+    if (response.event_type() ==
+        assistant::AssistResponse_EventType_END_OF_UTTERANCE) {
+      listening = false;
+    }
+    bool final_result = response.speech_results_size() == 1 &&
+                        response.speech_results(0).stability() == 1;
+    if (speculate && !final_result && response.speech_results_size() > 0) {
+      std::vector<SpeechResult> results;
+      for (int i = 0; i < response.speech_results_size(); i++) {
+        results.push_back({response.speech_results(i).transcript(),
+                           response.speech_results(i).stability()});
+      }
+      speculator.OnPartial(results);
+    }
+    if (final_result) {
+      const std::string& transcript = response.speech_results(0).transcript();
+      result->final_ns = MonotonicNowNs() - start_ns;
+      speculator.OnFinal(transcript);
+      if (IsRobotCommand(transcript)) {
+        RunRobotCommand(transcript, motion, &follow, [] { return false; });
+      }
+    }
+  }
+  listening = false;
+  microphone.join();
+  speculator.Cancel();
+  grpc::Status status = assist->Finish();
+  if (!status.ok()) {
+    std::cerr << "command_latency_bench: turn failed: "
+              << status.error_message() << std::endl;
+    return false;
+  }
+
+  // Let a turn finish.
+  float degrees = TurnDegrees(stream.final_transcript);
+  int64_t settle_end_ns =
+      MonotonicNowNs() + static_cast<int64_t>(settle_ms) * 1000000;
+  while (MonotonicNowNs() < settle_end_ns) {
+    // Right turns lower the counter-clockwise heading.
+    float turned = AngleDifferenceDeg(start_yaw, robot->Pose().heading_deg);
+    if (degrees != 0 && result->done_ns < 0 &&
+        std::fabs(AngleDifferenceDeg(turned, degrees)) <=
+            kTurnToleranceDeg) {
+      result->done_ns = MonotonicNowNs() - start_ns;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  motion->Halt();
+  if (ports->effect_ns() > 0) {
+    result->effect_ns = ports->effect_ns() - start_ns;
+  }
+  // The halt, and the coast after it, are not part of the next turn.
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  return true;
+}
+
+static std::string Ms(int64_t ns) {
+  if (ns < 0) {
+    return "-";
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.0f", ns / 1e6);
+  return buffer;
+}
+
+int main(int argc, char** argv) {
+  std::string transcripts_path;
+  RecognizerConfig recognizer_config;
+  int settle_ms = 2500;
+
+  const struct option long_options[] = {
+      {"transcripts", required_argument, nullptr, 't'},
+      {"stability", required_argument, nullptr, 's'},
+      {"settle-ms", required_argument, nullptr, 'm'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "t:s:m:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 't':
+        transcripts_path = optarg;
+        break;
+      case 's':
+        recognizer_config.min_stability = std::atof(optarg);
+        break;
+      case 'm':
+        settle_ms = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  std::vector<Stream> streams;
+  if (transcripts_path.empty()) {
+    std::istringstream in(kBuiltinTranscripts);
+    ParseStreams(in, &streams);
+  } else {
+    std::ifstream in(transcripts_path);
+    if (!in) {
+      std::cerr << "command_latency_bench: cannot read " << transcripts_path
+                << std::endl;
+      return -1;
+    }
+    if (!ParseStreams(in, &streams)) {
+      return -1;
+    }
+  }
+
+  MonotonicClock clock;
+  SimRobot robot(&clock, SimConfig());
+  BenchPorts ports(&robot);
+  ImuConfig imu_config;
+  imu_config.calibration_s = 0.2;
+  ImuService imu(robot.imu(), &clock, imu_config);
+  MotionController motion(&ports, &imu, &clock, MotionConfig());
+  if (!imu.Start() || !motion.Start()) {
+    return -1;
+  }
+
+  printf("%-16s %8s %21s %21s\n", "", "", "effect_ms", "done_ms");
+  printf("%-16s %8s %10s %10s %10s %10s  %s\n", "transcript", "final_ms",
+         "final", "spec", "final", "spec", "speculation");
+  int64_t saved_ns = 0;
+  int commands = 0;
+  for (const Stream& stream : streams) {
+    StubAssistantConfig stub_config;
+    stub_config.speech = stream.speech;
+    stub_config.audio_out_chunks = 0;
+    StubAssistantServer server(stub_config);
+    if (!server.Start("localhost:0")) {
+      return -1;
+    }
+    std::string endpoint = "localhost:" + std::to_string(server.port());
+    TurnResult final_only, speculative;
+    if (!RunTurn(endpoint, stream, false, recognizer_config, settle_ms,
+                 &clock, &robot, &ports, &motion, &final_only) ||
+        !RunTurn(endpoint, stream, true, recognizer_config, settle_ms,
+                 &clock, &robot, &ports, &motion, &speculative)) {
+      return -1;
+    }
+    const char* outcome = "none";
+    bool command = IsRobotCommand(stream.final_transcript);
+    if (speculative.effect_ns >= 0 && final_only.effect_ns < 0) {
+      outcome = "false start";
+    } else if (command && speculative.effect_ns >= 0 &&
+               speculative.effect_ns < final_only.final_ns) {
+      outcome = "early";
+    }
+    printf("%-16s %8s %10s %10s %10s %10s  %s\n",
+           stream.final_transcript.c_str(), Ms(final_only.final_ns).c_str(),
+           Ms(final_only.effect_ns).c_str(), Ms(speculative.effect_ns).c_str(),
+           Ms(final_only.done_ns).c_str(), Ms(speculative.done_ns).c_str(),
+           outcome);
+    if (command && final_only.effect_ns >= 0 && speculative.effect_ns >= 0) {
+      saved_ns += final_only.effect_ns - speculative.effect_ns;
+      commands++;
+    }
+  }
+  if (commands > 0) {
+    printf("first effect %.0f ms sooner on average over %d commands\n",
+           saved_ns / 1e6 / commands, commands);
+  }
+  motion.Stop();
+  imu.Stop();
+  return 0;
+}
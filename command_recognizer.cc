@@ -0,0 +1,55 @@
+#include "assistant/command_recognizer.h"
+
+#include <cctype>
+
+CommandRecognizer::CommandRecognizer(const std::vector<std::string>& commands,
+                                     const RecognizerConfig& config)
+    : commands_(commands), config_(config) {}
+
+std::string CommandRecognizer::Hypothesis(
+    const std::vector<SpeechResult>& results) const {
+  std::string hypothesis;
+  bool space = false;
+  for (const SpeechResult& result : results) {
+    if (result.stability < config_.min_stability) {
+      break;
+    }
+    // Results may or may not carry the space between them.
+    space = !hypothesis.empty();
+    for (char c : result.transcript) {
+      if (std::isspace(static_cast<unsigned char>(c))) {
+        space = !hypothesis.empty();
+        continue;
+      }
+      if (space) {
+        hypothesis += ' ';
+        space = false;
+      }
+      hypothesis += std::tolower(static_cast<unsigned char>(c));
+    }
+  }
+  return hypothesis;
+}
+
+int CommandRecognizer::Match(const std::vector<SpeechResult>& results) const {
+  std::string hypothesis = Hypothesis(results);
+  if (hypothesis.empty()) {
+    return -1;
+  }
+  int match = -1;
+  for (size_t i = 0; i < commands_.size(); i++) {
+    const std::string& command = commands_[i];
+    if (command == hypothesis) {
+      return i;
+    }
+    if (config_.prefix_match && hypothesis.size() >= config_.min_prefix_chars &&
+        command.compare(0, hypothesis.size(), hypothesis) == 0) {
+      if (match >= 0) {
+        // "turn" could still be any of the turns.
+        return -1;
+      }
+      match = i;
+    }
+  }
+  return match;
+}
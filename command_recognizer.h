@@ -0,0 +1,51 @@
+#ifndef SRC_ASSISTANT_COMMAND_RECOGNIZER_H_
+#define SRC_ASSISTANT_COMMAND_RECOGNIZER_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// One of the speech results an AssistResponse streams while the user
+// speaks. The Assistant splits its hypothesis into results of falling
+// stability: ~0.9 for words unlikely to change, ~0.01 for a guess, and a
+// single result at 1.0 once the utterance is final.
+struct SpeechResult {
+  std::string transcript;
+  float stability;
+};
+
+struct RecognizerConfig {
+  // Results less stable than this, and any after them, are not trusted.
+  float min_stability = 0.5;
+  // Match a partial hypothesis that is the start of exactly one command,
+  // e.g. "turn l" for "turn left", once it is this long. Otherwise only a
+  // whole command matches.
+  bool prefix_match = true;
+  size_t min_prefix_chars = 4;
+};
+
+// Matches the partial transcripts of an utterance still being spoken
+// against a fixed set of command phrases, so a command can be acted on
+// before the final result arrives.
+class CommandRecognizer {
+ public:
+  CommandRecognizer(const std::vector<std::string>& commands,
+                    const RecognizerConfig& config);
+
+  // The trusted part of a hypothesis: its leading results at or above
+  // min_stability, joined, lower-cased, with single spaces.
+  std::string Hypothesis(const std::vector<SpeechResult>& results) const;
+
+  // Index of the command |results| point at, or -1 if none or more than
+  // one do.
+  int Match(const std::vector<SpeechResult>& results) const;
+
+  const std::string& command(int index) const { return commands_[index]; }
+
+ private:
+  std::vector<std::string> commands_;
+  RecognizerConfig config_;
+};
+
+#endif  // SRC_ASSISTANT_COMMAND_RECOGNIZER_H_
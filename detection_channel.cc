@@ -0,0 +1,178 @@
+#include "assistant/detection_channel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static_assert(sizeof(DetectionRecord) % sizeof(uint32_t) == 0,
+              "DetectionRecord must be a whole number of words");
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "shared-memory seqlock needs lock-free 32-bit atomics");
+
+static const uint32_t kDetectionChannelMagic = 0x44455443;  // "DETC"
+
+DetectionChannel::DetectionChannel() : shared_(nullptr), mapped_(false) {}
+
+DetectionChannel::~DetectionChannel() { Unmap(); }
+
+bool DetectionChannel::Create(const std::string& name) {
+  Unmap();
+  if (name.empty()) {
+    shared_ = new Shared();
+  } else if (!Map(name, true)) {
+    return false;
+  }
+  shared_->magic = kDetectionChannelMagic;
+  shared_->version = kDetectionChannelVersion;
+  shared_->sequence.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < kRecordWords; i++) {
+    shared_->words[i].store(0, std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  return true;
+}
+
+bool DetectionChannel::Open(const std::string& name) {
+  Unmap();
+  if (!Map(name, false)) {
+    return false;
+  }
+  if (shared_->magic != kDetectionChannelMagic ||
+      shared_->version != kDetectionChannelVersion) {
+    std::cerr << "detection_channel: " << name
+              << " has an unexpected layout" << std::endl;
+    Unmap();
+    return false;
+  }
+  return true;
+}
+
+void DetectionChannel::Publish(const DetectionRecord& record) {
+  uint32_t words[kRecordWords];
+  memcpy(words, &record, sizeof(words));
+
+  uint32_t sequence = shared_->sequence.load(std::memory_order_relaxed);
+  shared_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int i = 0; i < kRecordWords; i++) {
+    shared_->words[i].store(words[i], std::memory_order_relaxed);
+  }
+  shared_->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool DetectionChannel::ReadLatest(DetectionRecord* record) const {
+  uint32_t words[kRecordWords];
+  uint32_t before, after;
+  do {
+    before = shared_->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;  // Publish in progress.
+    }
+    for (int i = 0; i < kRecordWords; i++) {
+      words[i] = shared_->words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = shared_->sequence.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+
+  if (before == 0) {
+    return false;
+  }
+  memcpy(record, words, sizeof(words));
+  return true;
+}
+
+uint64_t DetectionChannel::LatestFrameId() const {
+  DetectionRecord record;
+  return ReadLatest(&record) ? record.frame_id : 0;
+}
+
+bool DetectionChannel::Map(const std::string& name, bool create) {
+  int flags = create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR;
+  int fd = shm_open(name.c_str(), flags, 0660);
+  if (fd < 0) {
+    std::cerr << "detection_channel: shm_open(" << name
+              << ") failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  if (create && ftruncate(fd, sizeof(Shared)) != 0) {
+    std::cerr << "detection_channel: ftruncate(" << name
+              << ") failed: " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+  void* addr =
+      mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "detection_channel: mmap(" << name
+              << ") failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  shared_ = static_cast<Shared*>(addr);
+  mapped_ = true;
+  if (create) {
+    name_ = name;
+  }
+  return true;
+}
+
+void DetectionChannel::Unmap() {
+  if (shared_ == nullptr) {
+    return;
+  }
+  if (mapped_) {
+    munmap(shared_, sizeof(Shared));
+    if (!name_.empty()) {
+      shm_unlink(name_.c_str());
+    }
+  } else {
+    delete shared_;
+  }
+  shared_ = nullptr;
+  mapped_ = false;
+  name_.clear();
+}
+
+void WriteDetectionLogLine(const DetectionRecord& record, std::ostream* out) {
+  *out << record.frame_id << ' ' << record.capture_time_ns << ' '
+       << record.found << ' ' << record.x << ' ' << record.y << ' '
+       << record.width << ' ' << record.height << ' ' << record.distance
+       << ' ' << record.confidence << '\n';
+}
+
+bool ReadDetectionLog(const std::string& path,
+                      std::vector<DetectionRecord>* records,
+                      std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  records->clear();
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    DetectionRecord record = DetectionRecord();
+    if (!(fields >> record.frame_id >> record.capture_time_ns >>
+          record.found >> record.x >> record.y >> record.width >>
+          record.height >> record.distance >> record.confidence)) {
+      *error = path + ":" + std::to_string(line_number) + ": bad record";
+      return false;
+    }
+    records->push_back(record);
+  }
+  return true;
+}
@@ -0,0 +1,96 @@
+#ifndef SRC_ASSISTANT_DETECTION_CHANNEL_H_
+#define SRC_ASSISTANT_DETECTION_CHANNEL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Fixed-layout binary detection record shared between the vision side and
+// the follow loop. Field order and sizes are part of the shared-memory
+// format; bump kDetectionChannelVersion when changing them.
+struct DetectionRecord {
+  // Monotonically increasing per published frame, starting at 1.
+  uint64_t frame_id;
+  // CLOCK_MONOTONIC time the frame was captured.
+  int64_t capture_time_ns;
+  // CLOCK_MONOTONIC time the record was published.
+  int64_t publish_time_ns;
+  // Horizontal center of the person box in frame pixels.
+  float x;
+  // Estimated range in meters.
+  float distance;
+  float confidence;
+  // Nonzero when a person was detected in this frame.
+  uint32_t found;
+  // Vertical center and size of the person box in frame pixels.
+  float y;
+  float width;
+  float height;
+};
+
+static const uint32_t kDetectionChannelVersion = 2;
+
+// Text log of records for offline replay, one record per line:
+// "<frame_id> <capture_time_ns> <found> <x> <y> <width> <height>
+//  <distance> <confidence>".
+void WriteDetectionLogLine(const DetectionRecord& record, std::ostream* out);
+bool ReadDetectionLog(const std::string& path,
+                      std::vector<DetectionRecord>* records,
+                      std::string* error);
+
+// Single-writer, multi-reader "latest value" channel built on a seqlock.
+// Readers never block the writer and never make system calls; they retry
+// the copy if it overlapped a publish. The state lives either on the heap
+// (in-process use) or in a POSIX shared-memory object so a detector
+// running in another process can publish into it.
+class DetectionChannel {
+ public:
+  DetectionChannel();
+  ~DetectionChannel();
+
+  // Creates (or truncates) the shared-memory object |name|, e.g.
+  // "/follow_me_detections", and maps it. Pass an empty name for a private
+  // in-process channel.
+  bool Create(const std::string& name);
+
+  // Maps an existing shared-memory object created by another process.
+  bool Open(const std::string& name);
+
+  // Publishes |record|. Only one thread may publish at a time.
+  void Publish(const DetectionRecord& record);
+
+  // Copies the newest record into |record|. Returns false if nothing has
+  // been published yet.
+  bool ReadLatest(DetectionRecord* record) const;
+
+  // Frame id of the newest record, or 0 if nothing has been published.
+  uint64_t LatestFrameId() const;
+
+ private:
+  static const int kRecordWords = sizeof(DetectionRecord) / sizeof(uint32_t);
+
+  struct Shared {
+    uint32_t magic;
+    uint32_t version;
+    // Even when stable, odd while a publish is in progress.
+    std::atomic<uint32_t> sequence;
+    // The record, stored as relaxed atomic words so that a torn read is
+    // detected by the sequence check rather than being a data race.
+    std::atomic<uint32_t> words[kRecordWords];
+  };
+
+  bool Map(const std::string& name, bool create);
+  void Unmap();
+
+  Shared* shared_;
+  bool mapped_;
+  std::string name_;
+
+  DetectionChannel(const DetectionChannel&) = delete;
+  DetectionChannel& operator=(const DetectionChannel&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_DETECTION_CHANNEL_H_
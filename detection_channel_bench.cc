@@ -0,0 +1,150 @@
+// Measures how long the follow loop takes to obtain the newest detection
+// through the shared-memory DetectionChannel versus the old text file that
+// was written by the detection script and parsed with std::stof.
+//
+// Usage: ./detection_channel_bench [--iterations N] [--file <path>]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/detection_channel.h"
+#include "assistant/time_util.h"
+
+static void PrintStats(const std::string& name, std::vector<int64_t> samples) {
+  std::sort(samples.begin(), samples.end());
+  int64_t sum = 0;
+  for (int64_t s : samples) {
+    sum += s;
+  }
+  std::cout << name << ": mean=" << sum / static_cast<int64_t>(samples.size())
+            << "ns p50=" << samples[samples.size() / 2]
+            << "ns p99=" << samples[samples.size() * 99 / 100]
+            << "ns max=" << samples.back() << "ns" << std::endl;
+}
+
+// Write-then-read of the coordinates file, as the script and the follow
+// loop did it.
+static std::vector<int64_t> BenchFile(const std::string& path,
+                                      int iterations) {
+  std::vector<int64_t> samples;
+  for (int i = 0; i < iterations; i++) {
+    int64_t start = MonotonicNowNs();
+    {
+      std::ofstream out(path.c_str(), std::ios::trunc);
+      out << 180.5f + i % 40 << " " << 2.5f << std::endl;
+    }
+    std::ifstream coordFile;
+    std::string coordBuffer;
+    std::string::size_type sz;
+    coordFile.open(path.c_str());
+    std::getline(coordFile, coordBuffer);
+    coordFile.close();
+    volatile float x = 0;
+    volatile float dist = 0;
+    if (coordBuffer != "no person") {
+      x = std::stof(coordBuffer, &sz);
+      dist = std::stof(coordBuffer.substr(sz));
+    }
+    (void)x;
+    (void)dist;
+    samples.push_back(MonotonicNowNs() - start);
+  }
+  return samples;
+}
+
+// Publish-then-read on one thread: the raw cost of the seqlock.
+static std::vector<int64_t> BenchChannel(DetectionChannel* channel,
+                                         int iterations) {
+  std::vector<int64_t> samples;
+  DetectionRecord record = DetectionRecord();
+  DetectionRecord latest;
+  for (int i = 0; i < iterations; i++) {
+    int64_t start = MonotonicNowNs();
+    record.frame_id = i + 1;
+    record.x = 180.5f + i % 40;
+    record.distance = 2.5f;
+    record.found = 1;
+    channel->Publish(record);
+    channel->ReadLatest(&latest);
+    samples.push_back(MonotonicNowNs() - start);
+  }
+  return samples;
+}
+
+// Publisher and reader on separate threads: time from Publish() until a
+// spinning reader observes the new frame id.
+static std::vector<int64_t> BenchChannelCrossThread(DetectionChannel* channel,
+                                                    int iterations) {
+  std::vector<int64_t> samples;
+  std::atomic<uint64_t> acked(0);
+  std::thread reader([channel, iterations, &samples, &acked]() {
+    DetectionRecord latest;
+    uint64_t seen = 0;
+    while (seen < static_cast<uint64_t>(iterations)) {
+      if (channel->ReadLatest(&latest) && latest.frame_id > seen) {
+        seen = latest.frame_id;
+        samples.push_back(MonotonicNowNs() - latest.publish_time_ns);
+        acked.store(seen, std::memory_order_release);
+      }
+    }
+  });
+  DetectionRecord record = DetectionRecord();
+  for (int i = 1; i <= iterations; i++) {
+    record.frame_id = i;
+    record.found = 1;
+    record.publish_time_ns = MonotonicNowNs();
+    channel->Publish(record);
+    while (acked.load(std::memory_order_acquire) < static_cast<uint64_t>(i)) {
+      std::this_thread::yield();
+    }
+  }
+  reader.join();
+  return samples;
+}
+
+int main(int argc, char** argv) {
+  int iterations = 10000;
+  std::string path = "coordinates_bench.txt";
+  const struct option long_options[] = {
+      {"iterations", required_argument, nullptr, 'n'},
+      {"file", required_argument, nullptr, 'f'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:f:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        iterations = std::atoi(optarg);
+        break;
+      case 'f':
+        path = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  DetectionChannel channel;
+  if (!channel.Create("/follow_me_detections_bench")) {
+    return -1;
+  }
+  PrintStats("coordinates file write+parse", BenchFile(path, iterations));
+  PrintStats("channel publish+read", BenchChannel(&channel, iterations));
+  PrintStats("channel publish->reader (threads)",
+             BenchChannelCrossThread(&channel, iterations));
+  std::remove(path.c_str());
+  return 0;
+}
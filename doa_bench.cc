@@ -0,0 +1,214 @@
+// Cost and payoff of the microphone-array bearing (doa_service.h).
+//
+// Per frame: the time GccPhatDoa takes for one 32 ms frame of the 8-channel
+// array, over synthetic recordings of talkers all round the robot
+// (array_sim.h), with the FFTW planning it does once at startup. Most of it
+// is the transforms, so it is printed with the FFTW build it ran on.
+//
+// Search: on the simulated robot (robot_sim.h), a person stands 3 m away at
+// each bearing and FollowBehavior::Approach() looks for them, once blindly
+// and once starting from the bearing the estimator found in a recording of
+// them speaking from there. Reports the simulated time until the robot has
+// found and faced the person and until it has driven up to them.
+//
+// Usage: ./doa_bench [--frames N] [--seed N]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "assistant/array_sim.h"
+#include "assistant/doa_service.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_sim.h"
+#include "assistant/time_util.h"
+
+static const double kPersonRangeM = 3;
+static const int64_t kSearchTimeoutNs = 60000000000LL;
+
+struct SearchResult {
+  bool approached = false;
+  // Until the robot had found and faced the person, and until the approach
+  // ended.
+  double found_s = 0;
+  double approach_s = 0;
+};
+
+// Bearing |doa| finds in a recording of a talker at |bearing_deg|.
+static bool SpeakerBearing(GccPhatDoa* doa, const DoaConfig& config,
+                           float bearing_deg, uint32_t seed, float* found) {
+  ArraySimConfig sim;
+  sim.seed = seed;
+  WavData wav = SimulateTalker(config.mics, bearing_deg, sim);
+  doa->Reset();
+  size_t frame = static_cast<size_t>(config.frame_samples) * wav.channels;
+  for (size_t i = 0; i + frame <= wav.samples.size(); i += frame) {
+    doa->AddFrame(&wav.samples[i]);
+  }
+  DoaEstimate estimate;
+  if (!doa->Estimate(&estimate)) {
+    return false;
+  }
+  *found = estimate.bearing_deg;
+  return true;
+}
+
+// Approach() on a fresh world with the person at |person_deg|, starting
+// from |speaker_deg| if it is given.
+static SearchResult Search(float person_deg, const float* speaker_deg,
+                           uint32_t seed) {
+  SimConfig config;
+  config.seed = seed;
+  config.person_speed_m_s = 0;
+  SimClock clock;
+  SimRobot robot(&clock, config);
+  clock.AddThread();
+  ImuService imu(robot.imu(), &clock, ImuConfig());
+  MotionController motion(robot.motors(), &imu, &clock, MotionConfig());
+  SearchResult result;
+  if (!imu.Start() || !motion.Start()) {
+    clock.RemoveThread();
+    return result;
+  }
+  FollowConfig follow_config;
+  follow_config.tracker.frame_width = config.frame_width;
+  follow_config.tracker.horizontal_fov_deg = config.horizontal_fov_deg;
+  FollowBehavior follow(&motion, robot.detections(), &clock, follow_config);
+
+  robot.PlacePerson(person_deg, kPersonRangeM);
+  const int64_t start_ns = clock.NowNs();
+  int64_t found_ns = start_ns;
+  follow.set_on_search([&clock, &found_ns](bool searching) {
+    if (!searching) {
+      found_ns = clock.NowNs();
+    }
+  });
+  if (speaker_deg != nullptr) {
+    float bearing = *speaker_deg;
+    follow.set_speaker_bearing([bearing](float* bearing_deg) {
+      *bearing_deg = bearing;
+      return true;
+    });
+  }
+  result.approached = follow.Approach([&clock, start_ns] {
+    return clock.NowNs() - start_ns < kSearchTimeoutNs;
+  });
+  result.found_s = (found_ns - start_ns) / 1e9;
+  result.approach_s = (clock.NowNs() - start_ns) / 1e9;
+  motion.Stop();
+  imu.Stop();
+  clock.RemoveThread();
+  return result;
+}
+
+int main(int argc, char** argv) {
+  int frames = 2000;
+  uint32_t seed = 1;
+
+  const struct option long_options[] = {
+      {"frames", required_argument, nullptr, 'n'},
+      {"seed", required_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:s:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        frames = std::atoi(optarg);
+        break;
+      case 's':
+        seed = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  DoaConfig config;
+  int64_t plan_start_ns = MonotonicNowNs();
+  GccPhatDoa doa(config);
+  double plan_ms = (MonotonicNowNs() - plan_start_ns) / 1e6;
+
+  // Frames of talkers every 30 degrees, round and round.
+  std::vector<WavData> recordings;
+  for (int b = -150; b <= 180; b += 30) {
+    ArraySimConfig sim;
+    sim.seed = seed + b + 1000;
+    recordings.push_back(SimulateTalker(config.mics, b, sim));
+  }
+  const size_t frame =
+      static_cast<size_t>(config.frame_samples) * config.mics.size();
+  std::vector<int64_t> costs;
+  costs.reserve(frames);
+  size_t recording = 0, offset = 0;
+  while (static_cast<int>(costs.size()) < frames) {
+    const WavData& wav = recordings[recording];
+    if (offset + frame > wav.samples.size()) {
+      recording = (recording + 1) % recordings.size();
+      offset = 0;
+      doa.Reset();
+      continue;
+    }
+    int64_t start_ns = MonotonicNowNs();
+    bool voiced = doa.AddFrame(&wav.samples[offset]);
+    int64_t cost_ns = MonotonicNowNs() - start_ns;
+    if (voiced) {
+      costs.push_back(cost_ns);
+    }
+    offset += frame;
+  }
+  std::sort(costs.begin(), costs.end());
+  double frame_ms = 1e3 * config.frame_samples / config.sample_rate;
+  printf("GCC-PHAT over %zu mics (%zu pairs), %d-sample frames (%.0f ms), "
+         "%dx interpolation, %.0f deg steps\n",
+         config.mics.size(), config.mics.size() * (config.mics.size() - 1) / 2,
+         config.frame_samples, frame_ms, config.interpolation,
+         config.resolution_deg);
+  printf("  planning %.1f ms once, %s\n", plan_ms, fftwf_version);
+  printf("  per frame p50 %.3f ms p99 %.3f ms max %.3f ms over %zu frames "
+         "(%.1f%% of real time at p50)\n",
+         costs[costs.size() / 2] / 1e6, costs[costs.size() * 99 / 100] / 1e6,
+         costs.back() / 1e6, costs.size(),
+         100 * costs[costs.size() / 2] / 1e6 / frame_ms);
+
+  printf("\nsearch for a person %.0f m away, simulated seconds\n",
+         kPersonRangeM);
+  printf("  %8s %8s | %8s %8s | %8s %8s | %7s\n", "person", "heard",
+         "found", "reached", "found", "reached", "saved");
+  printf("  %8s %8s | %17s | %17s |\n", "deg", "deg", "blind", "from bearing");
+  double blind_sum = 0, steered_sum = 0;
+  int searches = 0;
+  for (int b = -135; b <= 180; b += 45) {
+    float heard;
+    if (!SpeakerBearing(&doa, config, b, seed + b + 2000, &heard)) {
+      printf("  %8d no bearing\n", b);
+      continue;
+    }
+    SearchResult blind = Search(b, nullptr, seed);
+    SearchResult steered = Search(b, &heard, seed);
+    printf("  %8d %8.0f | %8.2f %8.2f | %8.2f %8.2f | %7.2f%s\n", b, heard,
+           blind.found_s, blind.approach_s, steered.found_s,
+           steered.approach_s, blind.found_s - steered.found_s,
+           blind.approached && steered.approached ? "" : "  (timed out)");
+    blind_sum += blind.found_s;
+    steered_sum += steered.found_s;
+    searches++;
+  }
+  if (searches > 0) {
+    printf("  mean time to find: %.2f s blind, %.2f s from the bearing, "
+           "%.2f s saved\n",
+           blind_sum / searches, steered_sum / searches,
+           (blind_sum - steered_sum) / searches);
+  }
+  return 0;
+}
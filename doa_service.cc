@@ -0,0 +1,237 @@
+#include "assistant/doa_service.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "assistant/trace.h"
+
+std::vector<MicPosition> MatrixCreatorMics() {
+  // M1-M8 as in the HAL's microphone_array_location.h, on a 52.5 mm
+  // radius, turned so the board's +y points to the robot's front.
+  return {{-48.5036755f, 20.0908795f},  {-48.5036755f, -20.0908795f},
+          {-20.0908795f, -48.5036755f}, {20.0908795f, -48.5036755f},
+          {48.5036755f, -20.0908795f},  {48.5036755f, 20.0908795f},
+          {20.0908795f, 48.5036755f},   {-20.0908795f, 48.5036755f}};
+}
+
+GccPhatDoa::GccPhatDoa(const DoaConfig& config)
+    : config_(config),
+      channels_(config.mics.size()),
+      bins_(config.frame_samples / 2 + 1),
+      // Whole 64-byte lines per channel, so every channel's spectrum has
+      // the alignment the forward plan was made for.
+      stride_((bins_ + 7) / 8 * 8),
+      lags_(config.frame_samples * config.interpolation),
+      frames_(0) {
+  const int n = config_.frame_samples;
+  min_bin_ = std::max(1, static_cast<int>(std::ceil(
+                             config_.min_hz * n / config_.sample_rate)));
+  max_bin_ = std::min(bins_ - 1, static_cast<int>(config_.max_hz * n /
+                                                  config_.sample_rate));
+
+  window_.resize(n);
+  for (int i = 0; i < n; i++) {
+    window_[i] = 0.5f - 0.5f * std::cos(2 * M_PI * i / n);
+  }
+  frame_ = fftwf_alloc_real(n);
+  spectra_ = fftwf_alloc_complex(static_cast<size_t>(stride_) * channels_);
+  cross_ = fftwf_alloc_complex(lags_ / 2 + 1);
+  correlation_ = fftwf_alloc_real(lags_);
+  // Planned on the first channel's spectrum; AddFrame() runs the same plan
+  // on each channel's.
+  forward_ = fftwf_plan_dft_r2c_1d(n, frame_, spectra_, FFTW_MEASURE);
+  inverse_ = fftwf_plan_dft_c2r_1d(lags_, cross_, correlation_, FFTW_MEASURE);
+
+  for (int i = 0; i < channels_; i++) {
+    for (int j = i + 1; j < channels_; j++) {
+      pairs_.push_back(std::make_pair(i, j));
+    }
+  }
+  // Arrival at microphone m from bearing b leads the array's center by
+  // (p_m . u(b)) / c, so the correlation of the pair (i, j) peaks at the
+  // lag (p_j - p_i) . u(b) / c.
+  std::vector<MicPosition> mics(config_.mics);
+  float mount = config_.mount_deg * M_PI / 180;
+  for (MicPosition& mic : mics) {
+    MicPosition turned;
+    turned.x_mm = mic.x_mm * std::cos(mount) - mic.y_mm * std::sin(mount);
+    turned.y_mm = mic.x_mm * std::sin(mount) + mic.y_mm * std::cos(mount);
+    mic = turned;
+  }
+  float lags_per_mm = config_.sample_rate * config_.interpolation /
+                      (config_.speed_of_sound_m_s * 1000);
+  for (float b = 0; b < 360; b += config_.resolution_deg) {
+    bearings_deg_.push_back(b > 180 ? b - 360 : b);
+    float ux = std::cos(b * M_PI / 180), uy = std::sin(b * M_PI / 180);
+    for (const auto& pair : pairs_) {
+      const MicPosition& a = mics[pair.first];
+      const MicPosition& c = mics[pair.second];
+      float lag = ((c.x_mm - a.x_mm) * ux + (c.y_mm - a.y_mm) * uy) *
+                  lags_per_mm;
+      int index = static_cast<int>(std::lround(lag));
+      lag_index_.push_back(index < 0 ? index + lags_ : index);
+    }
+  }
+  power_.assign(bearings_deg_.size(), 0);
+}
+
+GccPhatDoa::~GccPhatDoa() {
+  fftwf_destroy_plan(forward_);
+  fftwf_destroy_plan(inverse_);
+  fftwf_free(frame_);
+  fftwf_free(spectra_);
+  fftwf_free(cross_);
+  fftwf_free(correlation_);
+}
+
+bool GccPhatDoa::AddFrame(const int16_t* samples) {
+  const int n = config_.frame_samples;
+  double energy = 0;
+  for (int i = 0; i < n; i++) {
+    float sample = samples[i * channels_];
+    energy += sample * sample;
+  }
+  if (std::sqrt(energy / n) < config_.min_rms) {
+    return false;
+  }
+
+  for (int c = 0; c < channels_; c++) {
+    for (int i = 0; i < n; i++) {
+      frame_[i] = samples[i * channels_ + c] * window_[i];
+    }
+    fftwf_execute_dft_r2c(forward_, frame_, spectra_ + c * stride_);
+  }
+
+  // With every bin of the band at unit magnitude, the correlation is 1 at
+  // the lag of a single source.
+  const float scale = 1.0f / (2 * (max_bin_ - min_bin_ + 1));
+  const size_t candidates = bearings_deg_.size();
+  for (size_t p = 0; p < pairs_.size(); p++) {
+    // The inverse transform overwrites its input, so the bins outside the
+    // band are cleared for every pair.
+    std::memset(cross_, 0, sizeof(fftwf_complex) * (lags_ / 2 + 1));
+    const fftwf_complex* a = spectra_ + pairs_[p].first * stride_;
+    const fftwf_complex* b = spectra_ + pairs_[p].second * stride_;
+    for (int k = min_bin_; k <= max_bin_; k++) {
+      float re = a[k][0] * b[k][0] + a[k][1] * b[k][1];
+      float im = a[k][1] * b[k][0] - a[k][0] * b[k][1];
+      float magnitude = std::sqrt(re * re + im * im);
+      float weight = magnitude > 0 ? scale / magnitude : 0;
+      cross_[k][0] = re * weight;
+      cross_[k][1] = im * weight;
+    }
+    fftwf_execute(inverse_);
+    const int* index = &lag_index_[p];
+    for (size_t c = 0; c < candidates; c++) {
+      power_[c] += correlation_[index[c * pairs_.size()]];
+    }
+  }
+  frames_++;
+  return true;
+}
+
+void GccPhatDoa::Reset() {
+  std::fill(power_.begin(), power_.end(), 0);
+  frames_ = 0;
+}
+
+bool GccPhatDoa::Estimate(DoaEstimate* estimate) const {
+  if (frames_ < config_.min_frames || power_.empty()) {
+    return false;
+  }
+  size_t best = std::max_element(power_.begin(), power_.end()) -
+                power_.begin();
+  estimate->bearing_deg = bearings_deg_[best];
+  estimate->frames = frames_;
+  estimate->strength = power_[best] / (frames_ * pairs_.size());
+  return true;
+}
+
+DoaService::DoaService(MicArrayPort* mics, const DoaConfig& config)
+    : mics_(mics),
+      config_(config),
+      doa_(config),
+      collecting_(false),
+      utterance_(0),
+      has_estimate_(false),
+      frames_read_(0),
+      frames_processed_(0),
+      running_(false) {}
+
+DoaService::~DoaService() { Stop(); }
+
+bool DoaService::Start() {
+  if (mics_->Channels() != doa_.channels() ||
+      mics_->SampleRate() != config_.sample_rate) {
+    std::cerr << "doa_service: the array has " << mics_->Channels()
+              << " channels at " << mics_->SampleRate() << " Hz, configured "
+              << doa_.channels() << " at " << config_.sample_rate << " Hz"
+              << std::endl;
+    return false;
+  }
+  running_ = true;
+  thread_ = std::thread(&DoaService::ReadLoop, this);
+  return true;
+}
+
+void DoaService::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  thread_.join();
+}
+
+void DoaService::Begin() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    has_estimate_ = false;
+  }
+  utterance_++;
+  collecting_ = true;
+}
+
+bool DoaService::Bearing(DoaEstimate* estimate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!has_estimate_) {
+    return false;
+  }
+  *estimate = estimate_;
+  return true;
+}
+
+void DoaService::ReadLoop() {
+  TRACE_THREAD_NAME("doa");
+  const size_t frame = static_cast<size_t>(doa_.frame_samples()) *
+                       doa_.channels();
+  uint32_t utterance = utterance_;
+  // The array has to be drained whether or not anyone listens, so the
+  // frames of an utterance are fresh when it begins.
+  while (running_ && mics_->Read(&block_)) {
+    pending_.insert(pending_.end(), block_.begin(), block_.end());
+    size_t used = 0;
+    for (; pending_.size() - used >= frame; used += frame) {
+      frames_read_++;
+      if (utterance != utterance_) {
+        utterance = utterance_;
+        doa_.Reset();
+      }
+      if (!collecting_) {
+        continue;
+      }
+      TRACE_SCOPE("doa.frame");
+      frames_processed_++;
+      DoaEstimate estimate;
+      if (doa_.AddFrame(&pending_[used]) && doa_.Estimate(&estimate)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A Begin() since the frame was read wins.
+        if (utterance == utterance_) {
+          estimate_ = estimate;
+          has_estimate_ = true;
+        }
+      }
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + used);
+  }
+}
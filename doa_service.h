@@ -0,0 +1,171 @@
+#ifndef SRC_ASSISTANT_DOA_SERVICE_H_
+#define SRC_ASSISTANT_DOA_SERVICE_H_
+
+#include <fftw3.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "assistant/robot_hal.h"
+
+// A microphone's place on the robot, in millimeters from the array's
+// center: x to the robot's front, y to its right.
+struct MicPosition {
+  float x_mm;
+  float y_mm;
+};
+
+// The MATRIX Creator's eight microphones, with the board's M1-M2 edge to
+// the robot's back.
+std::vector<MicPosition> MatrixCreatorMics();
+
+struct DoaConfig {
+  int sample_rate = 16000;
+  // Samples per channel in one GCC-PHAT frame; a power of two. 512 is
+  // 32 ms at 16 kHz.
+  int frame_samples = 512;
+  // The cross-correlations are computed this many times finer than the
+  // sample period, by zero-padding the inverse transform: the whole array
+  // spans under 5 samples at 16 kHz.
+  int interpolation = 4;
+  // Band kept by the phase transform, where speech carries its energy.
+  float min_hz = 300;
+  float max_hz = 4000;
+  // Bearings tried, every this many degrees.
+  float resolution_deg = 2;
+  // Frames whose RMS, on a full scale of 32768, is below this are taken
+  // for silence and skipped.
+  float min_rms = 100;
+  // Voiced frames needed before there is a bearing.
+  int min_frames = 4;
+  float speed_of_sound_m_s = 343;
+  // Rotation of the array on the robot, clockwise.
+  float mount_deg = 0;
+  std::vector<MicPosition> mics = MatrixCreatorMics();
+};
+
+// Where a sound came from.
+struct DoaEstimate {
+  // Clockwise from the robot's front, in (-180, 180]; right is positive,
+  // as for MotionController::Turn().
+  float bearing_deg = 0;
+  // Voiced frames it is based on.
+  int frames = 0;
+  // Mean phase-transform correlation at the bearing, 1 for one source in
+  // free field, near 0 for diffuse noise.
+  float strength = 0;
+};
+
+// Steered-response power with the phase transform (SRP-PHAT) over every
+// pair of microphones: each frame's GCC-PHAT correlations are summed at the
+// delays every candidate bearing would cause, and the sums accumulate
+// over the frames of an utterance. The FFTW plans and buffers are made
+// once, so a frame allocates nothing.
+//
+// Plans are made with FFTW_MEASURE, which takes a while; make the estimator
+// once, on one thread, as FFTW planning is not thread-safe.
+class GccPhatDoa {
+ public:
+  explicit GccPhatDoa(const DoaConfig& config);
+  ~GccPhatDoa();
+
+  // Adds one frame: config.frame_samples samples of each of the
+  // config.mics.size() channels, interleaved by channel. False if it was
+  // too quiet to count.
+  bool AddFrame(const int16_t* samples);
+  // Forgets the frames added so far.
+  void Reset();
+  // The strongest bearing over the frames added since Reset(); false
+  // until config.min_frames of them were voiced.
+  bool Estimate(DoaEstimate* estimate) const;
+
+  int channels() const { return channels_; }
+  int frame_samples() const { return config_.frame_samples; }
+
+ private:
+  DoaConfig config_;
+  int channels_;
+  // Spectrum bins of a frame and their stride between channels, and the
+  // length of the interpolated correlation.
+  int bins_;
+  int stride_;
+  int lags_;
+  int min_bin_;
+  int max_bin_;
+  std::vector<float> window_;
+  float* frame_;
+  fftwf_complex* spectra_;
+  fftwf_complex* cross_;
+  float* correlation_;
+  fftwf_plan forward_;
+  fftwf_plan inverse_;
+  std::vector<std::pair<int, int>> pairs_;
+  std::vector<float> bearings_deg_;
+  // Correlation index each candidate bearing reads, pair by pair.
+  std::vector<int> lag_index_;
+  // Summed correlation per candidate bearing.
+  std::vector<float> power_;
+  int frames_;
+
+  GccPhatDoa(const GccPhatDoa&) = delete;
+  GccPhatDoa& operator=(const GccPhatDoa&) = delete;
+};
+
+// Reads the microphone array on its own thread and, between Begin() and
+// End(), feeds it to a GccPhatDoa, so the bearing of whoever gave a command
+// is ready when the command is. The voice loop calls Begin() as the user
+// starts speaking and End() with the final transcript; both only set a
+// flag. Behaviors read the bearing with Bearing().
+//
+// The service is the only user of |mics| once started.
+class DoaService {
+ public:
+  DoaService(MicArrayPort* mics, const DoaConfig& config);
+  ~DoaService();
+
+  // False, with the reason on std::cerr, if the array does not match the
+  // configuration.
+  bool Start();
+  void Stop();
+
+  // Starts a new utterance: forgets the last one's bearing.
+  void Begin();
+  // Stops feeding the estimator; the bearing stays until the next Begin().
+  void End() { collecting_ = false; }
+
+  // The bearing over the utterance so far; false until it has enough
+  // voiced frames.
+  bool Bearing(DoaEstimate* estimate);
+
+  // Frames read and frames the estimator ran on.
+  uint64_t frames_read() const { return frames_read_; }
+  uint64_t frames_processed() const { return frames_processed_; }
+
+ private:
+  void ReadLoop();
+
+  MicArrayPort* mics_;
+  DoaConfig config_;
+  GccPhatDoa doa_;
+  std::vector<int16_t> block_;
+  std::vector<int16_t> pending_;
+  std::atomic<bool> collecting_;
+  // Bumped by Begin(); the thread resets the estimator when it changes.
+  std::atomic<uint32_t> utterance_;
+  std::mutex mutex_;
+  DoaEstimate estimate_;
+  bool has_estimate_;
+  std::atomic<uint64_t> frames_read_;
+  std::atomic<uint64_t> frames_processed_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+
+  DoaService(const DoaService&) = delete;
+  DoaService& operator=(const DoaService&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_DOA_SERVICE_H_
@@ -0,0 +1,143 @@
+// Checks the microphone-array bearing (doa_service.h) on synthetic
+// recordings: for talkers all round the robot, an 8-channel WAV file is
+// written as the MATRIX Creator's array would hear it (array_sim.h), read
+// back and played through DoaService, and the bearing it finds is compared
+// with the true one. A near-silent recording must give no bearing.
+//
+// With --wav, runs on a recording instead, e.g. one made on the robot, and
+// prints its bearing; with --bearing as well, checks it.
+//
+// Usage: ./doa_test [--dir DIR] [--snr-db DB] [--tolerance DEG]
+//        ./doa_test --wav FILE [--bearing DEG]
+
+#include <getopt.h>
+
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "assistant/array_sim.h"
+#include "assistant/doa_service.h"
+#include "assistant/heading_controller.h"
+#include "assistant/wav_file.h"
+
+// Plays |wav| through a DoaService as one utterance; false if it found no
+// bearing.
+static bool Locate(const WavData& wav, const DoaConfig& config,
+                   DoaEstimate* estimate) {
+  WavMicArray mics(&wav);
+  DoaService doa(&mics, config);
+  doa.Begin();
+  if (!doa.Start()) {
+    return false;
+  }
+  uint64_t frames =
+      wav.samples.size() / wav.channels / config.frame_samples;
+  while (doa.frames_read() < frames) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  doa.End();
+  doa.Stop();
+  return doa.Bearing(estimate);
+}
+
+static bool CheckRecording(const std::string& path, const DoaConfig& config,
+                           float bearing, float tolerance) {
+  WavData wav;
+  if (!ReadWav(path, &wav)) {
+    return false;
+  }
+  DoaEstimate estimate;
+  if (!Locate(wav, config, &estimate)) {
+    printf("  %-28s no bearing%s\n", path.c_str(),
+           std::isnan(bearing) ? "" : "  FAIL");
+    return std::isnan(bearing);
+  }
+  float error = std::isnan(bearing)
+                    ? 0
+                    : AngleDifferenceDeg(estimate.bearing_deg, bearing);
+  bool ok = std::fabs(error) <= tolerance;
+  printf("  %-28s %7.1f deg (error %5.1f, strength %.2f, %d frames)%s\n",
+         path.c_str(), estimate.bearing_deg, error, estimate.strength,
+         estimate.frames, ok ? "" : "  FAIL");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  std::string dir = "/tmp";
+  std::string wav_path;
+  float bearing = NAN;
+  float tolerance = 8;
+  ArraySimConfig sim;
+
+  const struct option long_options[] = {
+      {"dir", required_argument, nullptr, 'd'},
+      {"snr-db", required_argument, nullptr, 'n'},
+      {"tolerance", required_argument, nullptr, 't'},
+      {"wav", required_argument, nullptr, 'w'},
+      {"bearing", required_argument, nullptr, 'b'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "d:n:t:w:b:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'd':
+        dir = optarg;
+        break;
+      case 'n':
+        sim.snr_db = std::atof(optarg);
+        break;
+      case 't':
+        tolerance = std::atof(optarg);
+        break;
+      case 'w':
+        wav_path = optarg;
+        break;
+      case 'b':
+        bearing = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  DoaConfig config;
+  bool ok = true;
+  if (!wav_path.empty()) {
+    ok = CheckRecording(wav_path, config, bearing, tolerance);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+  }
+
+  printf("talkers at %.0f dB SNR, echo %.1f at +%.0f deg\n", sim.snr_db,
+         sim.echo_gain, sim.echo_offset_deg);
+  for (int b = -165; b <= 180; b += 15) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/doa_talker_%d.wav", dir.c_str(), b);
+    sim.seed = b + 1000;
+    if (!WriteWav(path, SimulateTalker(config.mics, b, sim))) {
+      return -1;
+    }
+    ok &= CheckRecording(path, config, b, tolerance);
+  }
+
+  // A talker too faint to pass the voice gate, so no bearing.
+  ArraySimConfig silence = sim;
+  silence.talker_rms = 30;
+  silence.snr_db = 0;
+  std::string path = dir + "/doa_silence.wav";
+  if (!WriteWav(path, SimulateTalker(config.mics, 0, silence))) {
+    return -1;
+  }
+  ok &= CheckRecording(path, config, NAN, tolerance);
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
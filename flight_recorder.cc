@@ -0,0 +1,259 @@
+#include "assistant/flight_recorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+static const uint32_t kFlightLogMagic = 0x464c5452;  // "FLTR"
+
+struct FlightLogHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_bytes;
+  uint32_t reserved;
+  int64_t start_ns;
+  uint8_t padding[40];
+};
+
+// A record as laid out in the file. The type is stored last, with release
+// order, and a reader that sees it also sees the rest.
+struct FlightRecorder::Slot {
+  int64_t time_ns;
+  std::atomic<uint32_t> type;
+  uint32_t reserved;
+  uint8_t payload[sizeof(FlightRecord) - 16];
+};
+
+static_assert(sizeof(FlightLogHeader) == 64, "header must stay 64 bytes");
+static_assert(sizeof(FlightRecord) == 80, "record layout changed");
+static_assert(offsetof(FlightRecord, imu) == 16, "payload must follow type");
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "flight log commits need lock-free 32-bit atomics");
+
+FlightRecorder::FlightRecorder(Clock* clock)
+    : clock_(clock),
+      mapping_(nullptr),
+      mapping_bytes_(0),
+      records_(nullptr),
+      capacity_(0),
+      next_(0),
+      dropped_(0) {}
+
+FlightRecorder::~FlightRecorder() { Close(); }
+
+bool FlightRecorder::Open(const std::string& path, size_t capacity_bytes) {
+  static_assert(sizeof(Slot) == sizeof(FlightRecord), "slot layout changed");
+  Close();
+  uint64_t capacity = capacity_bytes / sizeof(Slot);
+  if (capacity == 0) {
+    std::cerr << "flight_recorder: capacity too small" << std::endl;
+    return false;
+  }
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "flight_recorder: open(" << path
+              << ") failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  // Allocate the blocks up front, so a page fault on a recording thread
+  // never waits for the file system to find room.
+  size_t bytes = sizeof(FlightLogHeader) + capacity * sizeof(Slot);
+  int error = posix_fallocate(fd, 0, bytes);
+  if (error != 0) {
+    std::cerr << "flight_recorder: posix_fallocate(" << path
+              << ") failed: " << strerror(error) << std::endl;
+    close(fd);
+    return false;
+  }
+  void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "flight_recorder: mmap(" << path
+              << ") failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  FlightLogHeader header = FlightLogHeader();
+  header.magic = kFlightLogMagic;
+  header.version = kFlightLogVersion;
+  header.record_bytes = sizeof(Slot);
+  header.start_ns = clock_->NowNs();
+  memcpy(addr, &header, sizeof(header));
+
+  path_ = path;
+  mapping_ = addr;
+  mapping_bytes_ = bytes;
+  capacity_ = capacity;
+  next_ = 0;
+  dropped_ = 0;
+  records_ = reinterpret_cast<Slot*>(static_cast<uint8_t*>(addr) +
+                                     sizeof(FlightLogHeader));
+  return true;
+}
+
+void FlightRecorder::Close() {
+  if (mapping_ == nullptr) {
+    return;
+  }
+  uint64_t used = recorded();
+  records_ = nullptr;
+  munmap(mapping_, mapping_bytes_);
+  mapping_ = nullptr;
+  if (truncate(path_.c_str(), sizeof(FlightLogHeader) + used * sizeof(Slot)) !=
+      0) {
+    std::cerr << "flight_recorder: truncate(" << path_
+              << ") failed: " << strerror(errno) << std::endl;
+  }
+  if (dropped_ > 0) {
+    std::cerr << "flight_recorder: log full, dropped " << dropped_
+              << " records" << std::endl;
+  }
+}
+
+uint64_t FlightRecorder::recorded() const {
+  return std::min<uint64_t>(next_.load(), capacity_);
+}
+
+FlightRecorder::Slot* FlightRecorder::Reserve() {
+  if (records_ == nullptr) {
+    return nullptr;
+  }
+  uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+  if (index >= capacity_) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Slot* slot = &records_[index];
+  slot->time_ns = clock_->NowNs();
+  return slot;
+}
+
+void FlightRecorder::Commit(Slot* slot, FlightRecordType type) {
+  slot->type.store(static_cast<uint32_t>(type), std::memory_order_release);
+}
+
+void FlightRecorder::RecordImu(const ImuReading& reading) {
+  Slot* slot = Reserve();
+  if (slot != nullptr) {
+    memcpy(slot->payload, &reading, sizeof(reading));
+    Commit(slot, FlightRecordType::kImu);
+  }
+}
+
+void FlightRecorder::RecordDetection(const DetectionRecord& record) {
+  Slot* slot = Reserve();
+  if (slot != nullptr) {
+    memcpy(slot->payload, &record, sizeof(record));
+    Commit(slot, FlightRecordType::kDetection);
+  }
+}
+
+void FlightRecorder::RecordCommand(const std::string& transcript) {
+  Slot* slot = Reserve();
+  if (slot != nullptr) {
+    memset(slot->payload, 0, kFlightCommandBytes);
+    memcpy(slot->payload, transcript.data(),
+           std::min(transcript.size(), kFlightCommandBytes - 1));
+    Commit(slot, FlightRecordType::kCommand);
+  }
+}
+
+void FlightRecorder::RecordMotor(float duty_a, float duty_b) {
+  Slot* slot = Reserve();
+  if (slot != nullptr) {
+    FlightMotor motor = {duty_a, duty_b};
+    memcpy(slot->payload, &motor, sizeof(motor));
+    Commit(slot, FlightRecordType::kMotor);
+  }
+}
+
+void FlightRecorder::RecordStop() {
+  Slot* slot = Reserve();
+  if (slot != nullptr) {
+    memset(slot->payload, 0, sizeof(slot->payload));
+    Commit(slot, FlightRecordType::kStop);
+  }
+}
+
+bool ReadFlightLog(const std::string& path, int64_t* start_ns,
+                   std::vector<FlightRecord>* records, std::string* error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(FlightLogHeader)) {
+    close(fd);
+    *error = path + " is not a flight log";
+    return false;
+  }
+  size_t bytes = st.st_size;
+  void* addr = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    *error = "cannot map " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  FlightLogHeader header;
+  memcpy(&header, addr, sizeof(header));
+  if (header.magic != kFlightLogMagic || header.version != kFlightLogVersion ||
+      header.record_bytes != sizeof(FlightRecord)) {
+    munmap(addr, bytes);
+    *error = path + " has an unexpected layout";
+    return false;
+  }
+  *start_ns = header.start_ns;
+
+  // Slots are skipped rather than ending the log at the first empty one:
+  // after a crash, a slot reserved but never committed can sit between
+  // committed ones.
+  const uint8_t* slots = static_cast<const uint8_t*>(addr) + sizeof(header);
+  size_t count = (bytes - sizeof(header)) / sizeof(FlightRecord);
+  records->clear();
+  for (size_t i = 0; i < count; i++) {
+    FlightRecord record;
+    memcpy(&record, slots + i * sizeof(FlightRecord), sizeof(record));
+    if (record.type != FlightRecordType::kNone) {
+      records->push_back(record);
+    }
+  }
+  munmap(addr, bytes);
+  return true;
+}
+
+void RecordingMotors::Set(float duty_a, float duty_b) {
+  motors_->Set(duty_a, duty_b);
+  recorder_->RecordMotor(duty_a, duty_b);
+}
+
+bool RecordingImu::Read(ImuReading* reading) {
+  if (!imu_->Read(reading)) {
+    return false;
+  }
+  recorder_->RecordImu(*reading);
+  return true;
+}
+
+void RecordingDetections::SetActive(bool active) {
+  detections_->SetActive(active);
+}
+
+bool RecordingDetections::ReadLatest(DetectionRecord* record) {
+  if (!detections_->ReadLatest(record)) {
+    return false;
+  }
+  if (record->frame_id != last_frame_) {
+    last_frame_ = record->frame_id;
+    recorder_->RecordDetection(*record);
+  }
+  return true;
+}
@@ -0,0 +1,147 @@
+#ifndef SRC_ASSISTANT_FLIGHT_RECORDER_H_
+#define SRC_ASSISTANT_FLIGHT_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "assistant/detection_channel.h"
+#include "assistant/robot_hal.h"
+
+// What the robot saw and did, for looking into a misbehavior afterwards and
+// for replaying it through the control code (flight_replay).
+enum class FlightRecordType : uint32_t {
+  kNone = 0,
+  // Reading returned by the IMU port.
+  kImu = 1,
+  // A detection record the follow behavior saw for the first time.
+  kDetection = 2,
+  // A robot command transcript.
+  kCommand = 3,
+  // Duty cycles written to the motor port.
+  kMotor = 4,
+  // The running behavior was told to stop; the motor outputs after it are
+  // the behavior and the controller stopping.
+  kStop = 5,
+};
+
+static const size_t kFlightCommandBytes = 64;
+
+struct FlightMotor {
+  float duty_a;
+  float duty_b;
+};
+
+// One entry of the log. Every entry has the same size, so the file is an
+// array of them after the header.
+struct FlightRecord {
+  // Time on the recorder's clock.
+  int64_t time_ns;
+  FlightRecordType type;
+  uint32_t reserved;
+  union {
+    ImuReading imu;
+    DetectionRecord detection;
+    FlightMotor motor;
+    // NUL-padded; longer commands are cut short.
+    char command[kFlightCommandBytes];
+  };
+};
+
+static const uint32_t kFlightLogVersion = 1;
+
+// Appends records to a memory-mapped file of fixed capacity. Recording is a
+// slot reservation with one atomic add and a copy into the mapping, so any
+// thread may record, none blocks and no system call is made; the kernel
+// writes the pages back. Each record is committed by storing its type last,
+// so a log cut short by a crash reads back up to the last whole record.
+// Once the file is full further records are dropped and counted.
+class FlightRecorder {
+ public:
+  explicit FlightRecorder(Clock* clock);
+  ~FlightRecorder();
+
+  // Creates (or truncates) |path| with room for |capacity_bytes| of
+  // records. Until then, and after Close(), recording does nothing.
+  bool Open(const std::string& path, size_t capacity_bytes);
+  // Unmaps the log and trims the file to the records written.
+  void Close();
+  bool is_open() const { return records_ != nullptr; }
+
+  void RecordImu(const ImuReading& reading);
+  void RecordDetection(const DetectionRecord& record);
+  void RecordCommand(const std::string& transcript);
+  void RecordMotor(float duty_a, float duty_b);
+  void RecordStop();
+
+  uint64_t recorded() const;
+  uint64_t dropped() const { return dropped_.load(); }
+
+ private:
+  struct Slot;
+
+  // Returns a slot to fill and commit, or nullptr.
+  Slot* Reserve();
+  void Commit(Slot* slot, FlightRecordType type);
+
+  Clock* clock_;
+  std::string path_;
+  void* mapping_;
+  size_t mapping_bytes_;
+  Slot* records_;
+  uint64_t capacity_;
+  std::atomic<uint64_t> next_;
+  std::atomic<uint64_t> dropped_;
+
+  FlightRecorder(const FlightRecorder&) = delete;
+  FlightRecorder& operator=(const FlightRecorder&) = delete;
+};
+
+// Reads the committed records of a log, in the order their slots were
+// reserved. |start_ns| is the recorder's clock when the log was opened.
+bool ReadFlightLog(const std::string& path, int64_t* start_ns,
+                   std::vector<FlightRecord>* records, std::string* error);
+
+// Ports that record what passes through them and otherwise forward to the
+// wrapped port. With the recorder closed they only forward.
+class RecordingMotors : public MotorPort {
+ public:
+  RecordingMotors(MotorPort* motors, FlightRecorder* recorder)
+      : motors_(motors), recorder_(recorder) {}
+  void Set(float duty_a, float duty_b) override;
+
+ private:
+  MotorPort* motors_;
+  FlightRecorder* recorder_;
+};
+
+class RecordingImu : public ImuPort {
+ public:
+  RecordingImu(ImuPort* imu, FlightRecorder* recorder)
+      : imu_(imu), recorder_(recorder) {}
+  bool Read(ImuReading* reading) override;
+
+ private:
+  ImuPort* imu_;
+  FlightRecorder* recorder_;
+};
+
+// Records each detection record the first time it is read, stamped with
+// when it was read, which is what decided what the robot did with it.
+class RecordingDetections : public DetectionSource {
+ public:
+  RecordingDetections(DetectionSource* detections, FlightRecorder* recorder)
+      : detections_(detections), recorder_(recorder), last_frame_(0) {}
+  void SetActive(bool active) override;
+  bool ReadLatest(DetectionRecord* record) override;
+
+ private:
+  DetectionSource* detections_;
+  FlightRecorder* recorder_;
+  uint64_t last_frame_;
+};
+
+#endif  // SRC_ASSISTANT_FLIGHT_RECORDER_H_
@@ -0,0 +1,116 @@
+// Measures what the flight recorder costs the threads that record: the
+// time per record into a fresh log, page faults included, and from it the
+// CPU share at the robot's record rates (IMU at ImuConfig::rate_hz, motor
+// writes at MotionConfig::rate_hz, detections at camera rate). For
+// comparison it times one std::clog line per record, the only trace the
+// robot used to leave.
+//
+// Usage: ./flight_recorder_bench [--records N] [--file <path>]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "assistant/flight_recorder.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/time_util.h"
+
+static const float kDetectionsPerS = 10;
+
+static double PrintStats(const char* name, std::vector<int64_t> samples) {
+  std::sort(samples.begin(), samples.end());
+  int64_t sum = 0;
+  for (int64_t s : samples) {
+    sum += s;
+  }
+  double mean = static_cast<double>(sum) / samples.size();
+  printf("%-16s mean=%.0fns p50=%lldns p99=%lldns max=%lldns\n", name, mean,
+         static_cast<long long>(samples[samples.size() / 2]),  // NOLINT
+         static_cast<long long>(samples[samples.size() * 99 / 100]),  // NOLINT
+         static_cast<long long>(samples.back()));  // NOLINT
+  return mean;
+}
+
+int main(int argc, char** argv) {
+  int records = 1000000;
+  std::string path = "/tmp/flight_recorder_bench.log";
+
+  const struct option long_options[] = {
+      {"records", required_argument, nullptr, 'n'},
+      {"file", required_argument, nullptr, 'f'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:f:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        records = std::atoi(optarg);
+        break;
+      case 'f':
+        path = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  // The mix the robot records: mostly IMU readings, a motor write every
+  // four, a detection now and then.
+  MonotonicClock clock;
+  FlightRecorder recorder(&clock);
+  if (!recorder.Open(path, static_cast<size_t>(records) *
+                               sizeof(FlightRecord))) {
+    return -1;
+  }
+  ImuReading reading = {1.5f, 42.0f};
+  DetectionRecord detection = DetectionRecord();
+  std::vector<int64_t> samples;
+  samples.reserve(records);
+  for (int i = 0; i < records; i++) {
+    int64_t start = MonotonicNowNs();
+    if (i % 20 == 19) {
+      detection.frame_id = i;
+      recorder.RecordDetection(detection);
+    } else if (i % 4 == 3) {
+      recorder.RecordMotor(30, -30);
+    } else {
+      reading.gyro_z_deg_s = i % 100;
+      recorder.RecordImu(reading);
+    }
+    samples.push_back(MonotonicNowNs() - start);
+  }
+  recorder.Close();
+  double record_ns = PrintStats("flight recorder", samples);
+
+  samples.clear();
+  {
+    std::ofstream log((path + ".txt").c_str(), std::ios::trunc);
+    for (int i = 0; i < std::min(records, 100000); i++) {
+      int64_t start = MonotonicNowNs();
+      log << "imu " << MonotonicNowNs() << " " << reading.gyro_z_deg_s << " "
+          << reading.yaw_deg << std::endl;
+      samples.push_back(MonotonicNowNs() - start);
+    }
+  }
+  PrintStats("text line", samples);
+  remove((path + ".txt").c_str());
+
+  float per_s = ImuConfig().rate_hz + MotionConfig().rate_hz + kDetectionsPerS;
+  printf("at %.0f records/s (IMU %d Hz, control %d Hz, camera %.0f fps): "
+         "%.4f%% of one core, %.1f MB/hour\n",
+         per_s, ImuConfig().rate_hz, MotionConfig().rate_hz, kDetectionsPerS,
+         per_s * record_ns / 1e9 * 100, per_s * sizeof(FlightRecord) * 3600 /
+         1e6);
+  remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,259 @@
+// Replays a flight log (flight_recorder.h) through the control code and
+// diffs the motor outputs it commands against the recorded ones. The
+// recorded IMU readings, detections and robot commands are fed back at
+// their recorded times on a simulated clock (robot_sim.h), which jumps
+// ahead whenever the controller threads are idle, so an hour of driving
+// replays in well under a minute.
+//
+// Outputs are matched in order. A recorded and a replayed write differ when
+// either duty cycle is further apart than --tolerance percent; the time
+// between them is reported as skew. On a log recorded on the robot, the
+// live threads' scheduling jitter shows up as skew and as the odd output
+// landing one control tick apart. A log recorded in the simulator (see
+// robot_sim_test --record) replays to the same outputs at the same times
+// and exits 0. A command runs until the next command, as a newer command
+// cancels a running behavior, or until the next stop record (the behavior
+// being told to stop) if that comes first; the last one runs until the
+// log runs out. The controller is shut down at the last record.
+//
+// Usage: ./flight_replay --log <file> [--tolerance PERCENT] [--verbose]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "assistant/flight_recorder.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_commands.h"
+#include "assistant/robot_sim.h"
+#include "assistant/time_util.h"
+
+// Hands out the recorded IMU readings one per read, each once the clock
+// has reached the time it was recorded at, as the live read returned then.
+class ReplayImu : public ImuPort {
+ public:
+  ReplayImu(Clock* clock, const std::vector<FlightRecord>& records)
+      : clock_(clock), records_(records), next_(0) {}
+
+  bool Read(ImuReading* reading) override {
+    if (next_ == records_.size()) {
+      // Out of samples; block like a read would rather than spin.
+      clock_->SleepForNs(5000000);
+      return false;
+    }
+    const FlightRecord& record = records_[next_++];
+    clock_->SleepUntilNs(record.time_ns);
+    *reading = record.imu;
+    return true;
+  }
+
+ private:
+  Clock* clock_;
+  std::vector<FlightRecord> records_;
+  size_t next_;
+};
+
+// The newest recorded detection the clock has reached.
+class ReplayDetections : public DetectionSource {
+ public:
+  ReplayDetections(Clock* clock, const std::vector<FlightRecord>& records)
+      : clock_(clock), records_(records), next_(0) {}
+
+  void SetActive(bool active) override {}
+
+  bool ReadLatest(DetectionRecord* record) override {
+    int64_t now_ns = clock_->NowNs();
+    while (next_ < records_.size() && records_[next_].time_ns <= now_ns) {
+      next_++;
+    }
+    if (next_ == 0) {
+      return false;
+    }
+    *record = records_[next_ - 1].detection;
+    return true;
+  }
+
+ private:
+  Clock* clock_;
+  std::vector<FlightRecord> records_;
+  size_t next_;
+};
+
+class CapturingMotors : public MotorPort {
+ public:
+  explicit CapturingMotors(Clock* clock) : clock_(clock) {}
+
+  void Set(float duty_a, float duty_b) override {
+    FlightRecord record = FlightRecord();
+    record.time_ns = clock_->NowNs();
+    record.type = FlightRecordType::kMotor;
+    record.motor.duty_a = duty_a;
+    record.motor.duty_b = duty_b;
+    outputs_.push_back(record);
+  }
+
+  // Only read once the controller has stopped.
+  const std::vector<FlightRecord>& outputs() const { return outputs_; }
+
+ private:
+  Clock* clock_;
+  std::vector<FlightRecord> outputs_;
+};
+
+int main(int argc, char** argv) {
+  std::string log_path;
+  float tolerance = 0.5;
+  bool verbose = false;
+
+  const struct option long_options[] = {
+      {"log", required_argument, nullptr, 'l'},
+      {"tolerance", required_argument, nullptr, 't'},
+      {"verbose", no_argument, nullptr, 'v'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "l:t:v", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'l':
+        log_path = optarg;
+        break;
+      case 't':
+        tolerance = std::atof(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        return -1;
+    }
+  }
+  if (log_path.empty()) {
+    std::cerr << "Usage: ./flight_replay --log <file> [--tolerance PERCENT] "
+              << "[--verbose]" << std::endl;
+    return -1;
+  }
+
+  int64_t start_ns;
+  std::vector<FlightRecord> records;
+  std::string error;
+  if (!ReadFlightLog(log_path, &start_ns, &records, &error)) {
+    std::cerr << "flight_replay: " << error << std::endl;
+    return -1;
+  }
+  std::vector<FlightRecord> imu_records, detection_records, command_records,
+      motor_records;
+  std::vector<int64_t> stop_times_ns;
+  int64_t end_ns = start_ns;
+  for (const FlightRecord& record : records) {
+    end_ns = std::max(end_ns, record.time_ns);
+    switch (record.type) {
+      case FlightRecordType::kImu:
+        imu_records.push_back(record);
+        break;
+      case FlightRecordType::kDetection:
+        detection_records.push_back(record);
+        break;
+      case FlightRecordType::kCommand:
+        command_records.push_back(record);
+        break;
+      case FlightRecordType::kMotor:
+        motor_records.push_back(record);
+        break;
+      case FlightRecordType::kStop:
+        stop_times_ns.push_back(record.time_ns);
+        break;
+      default:
+        break;
+    }
+  }
+  printf("%s: %.1f s, %zu IMU readings, %zu detections, %zu commands, "
+         "%zu motor outputs\n",
+         log_path.c_str(), (end_ns - start_ns) / 1e9, imu_records.size(),
+         detection_records.size(), command_records.size(),
+         motor_records.size());
+
+  // The same setup as run_assistant_audio, on recorded inputs.
+  int64_t wall_start_ns = MonotonicNowNs();
+  SimClock clock(start_ns);
+  ReplayImu imu_port(&clock, imu_records);
+  ReplayDetections detection_source(&clock, detection_records);
+  CapturingMotors motors(&clock);
+  clock.AddThread();
+  {
+    ImuService imu(&imu_port, &clock, ImuConfig());
+    MotionController motion(&motors, &imu, &clock, MotionConfig());
+    if (!imu.Start() || !motion.Start()) {
+      return -1;
+    }
+    FollowBehavior follow(&motion, &detection_source, &clock, FollowConfig());
+    for (size_t i = 0; i < command_records.size(); i++) {
+      const FlightRecord& record = command_records[i];
+      clock.SleepUntilNs(record.time_ns);
+      int64_t stop_ns = i + 1 < command_records.size()
+                            ? command_records[i + 1].time_ns
+                            : end_ns;
+      for (int64_t time_ns : stop_times_ns) {
+        if (time_ns >= record.time_ns) {
+          stop_ns = std::min(stop_ns, time_ns);
+          break;
+        }
+      }
+      auto keep_going = [&clock, stop_ns] { return clock.NowNs() < stop_ns; };
+      std::string transcript(record.command,
+                             strnlen(record.command, kFlightCommandBytes));
+      if (verbose) {
+        printf("  t=%8.3f command \"%s\"\n", (record.time_ns - start_ns) / 1e9,
+               transcript.c_str());
+      }
+      RunRobotCommand(transcript, &motion, &follow, keep_going);
+    }
+    clock.SleepUntilNs(end_ns);
+    motion.Stop();
+    imu.Stop();
+  }
+  clock.RemoveThread();
+  double wall_s = (MonotonicNowNs() - wall_start_ns) / 1e9;
+
+  const std::vector<FlightRecord>& outputs = motors.outputs();
+  size_t compared = std::min(outputs.size(), motor_records.size());
+  size_t differing = 0;
+  double max_skew_ms = 0, skew_sum_ms = 0;
+  for (size_t i = 0; i < compared; i++) {
+    const FlightMotor& live = motor_records[i].motor;
+    const FlightMotor& replayed = outputs[i].motor;
+    double skew_ms = (outputs[i].time_ns - motor_records[i].time_ns) / 1e6;
+    max_skew_ms = std::max(max_skew_ms, std::fabs(skew_ms));
+    skew_sum_ms += std::fabs(skew_ms);
+    if (std::fabs(live.duty_a - replayed.duty_a) > tolerance ||
+        std::fabs(live.duty_b - replayed.duty_b) > tolerance) {
+      if (differing < 10 || verbose) {
+        printf("  output %zu at t=%.3f: recorded (%.1f, %.1f), replayed "
+               "(%.1f, %.1f), skew %.1f ms\n",
+               i, (motor_records[i].time_ns - start_ns) / 1e9, live.duty_a,
+               live.duty_b, replayed.duty_a, replayed.duty_b, skew_ms);
+      }
+      differing++;
+    }
+  }
+  printf("%zu recorded and %zu replayed outputs; %zu of %zu compared differ "
+         "by more than %.1f%%\n",
+         motor_records.size(), outputs.size(), differing, compared, tolerance);
+  printf("time skew: mean %.2f ms, max %.2f ms\n",
+         compared > 0 ? skew_sum_ms / compared : 0.0, max_skew_ms);
+  printf("replayed %.1f s in %.2f s (%.0fx real time)\n",
+         (end_ns - start_ns) / 1e9, wall_s, (end_ns - start_ns) / 1e9 / wall_s);
+  return differing == 0 && outputs.size() == motor_records.size() ? 0 : 1;
+}
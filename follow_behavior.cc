@@ -0,0 +1,396 @@
+#include "assistant/follow_behavior.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+
+#include "assistant/heading_controller.h"
+#include "assistant/trace.h"
+
+// IMU history kept to find the heading a frame was captured at; frames
+// arrive well within it.
+static const int64_t kYawHistoryNs = 2000000000;
+
+FollowBehavior::FollowBehavior(MotionController* motion,
+                               DetectionSource* detections, Clock* clock,
+                               const FollowConfig& config)
+    : motion_(motion),
+      detections_(detections),
+      clock_(clock),
+      config_(config),
+      distance_(0),
+      searching_(false),
+      seen_person_(false),
+      last_seen_yaw_deg_(0),
+      last_seen_ns_(0) {}
+
+void FollowBehavior::SetSearching(bool searching) {
+  if (searching != searching_) {
+    searching_ = searching;
+    if (on_search_) {
+      on_search_(searching);
+    }
+  }
+}
+
+bool FollowBehavior::NextDetection(int64_t since_ns,
+                                   const std::function<bool()>& keep_going,
+                                   DetectionRecord* record) {
+  while (!detections_->ReadLatest(record) ||
+         record->capture_time_ns <= since_ns) {
+    if (!keep_going()) {
+      return false;
+    }
+    clock_->SleepForNs(config_.poll_ns);
+  }
+  return true;
+}
+
+void FollowBehavior::SawPerson(float bearing_deg) {
+  seen_person_ = true;
+  last_seen_yaw_deg_ = motion_->Imu().yaw_deg - bearing_deg;
+  last_seen_ns_ = clock_->NowNs();
+}
+
+bool FollowBehavior::LastSeen(float* bearing_deg) {
+  if (!seen_person_ || clock_->NowNs() - last_seen_ns_ > config_.last_seen_ns) {
+    return false;
+  }
+  // Yaw is counter-clockwise positive; turns are right positive.
+  *bearing_deg = AngleDifferenceDeg(motion_->Imu().yaw_deg, last_seen_yaw_deg_);
+  return true;
+}
+
+float FollowBehavior::YawAt(const std::deque<std::pair<int64_t, float>>& yaws,
+                            int64_t time_ns) {
+  if (time_ns <= yaws.front().first) {
+    return yaws.front().second;
+  }
+  for (size_t i = 1; i < yaws.size(); i++) {
+    if (time_ns <= yaws[i].first) {
+      const std::pair<int64_t, float>& before = yaws[i - 1];
+      float fraction = static_cast<float>(time_ns - before.first) /
+                       (yaws[i].first - before.first);
+      return before.second + fraction * (yaws[i].second - before.second);
+    }
+  }
+  return yaws.back().second;
+}
+
+bool FollowBehavior::Search(float direction,
+                            const std::function<bool()>& keep_going,
+                            DetectionRecord* person, float* bearing_deg) {
+  TargetTracker camera(config_.tracker);
+  if (config_.search_rate_deg_s <= 0) {
+    do {
+      Await(motion_->Turn(direction * config_.search_turn_deg,
+                          TurnType::kPivot),
+            keep_going);
+      if (!NextDetection(clock_->NowNs(), keep_going, person)) {
+        return false;
+      }
+    } while (!person->found);
+    *bearing_deg = camera.BearingDeg(person->x);
+    return true;
+  }
+
+  // Keep the yaw over the last frames' latency, to know where the robot
+  // was pointing when the one that shows the person was captured.
+  std::deque<std::pair<int64_t, float>> yaws;
+  AddYaw(motion_->Imu(), &yaws);
+  const int64_t start_ns = clock_->NowNs();
+  motion_->SetVelocity(0, direction * config_.search_rate_deg_s);
+  uint64_t last_frame = 0;
+  bool found = false;
+  while (!found && keep_going()) {
+    clock_->SleepForNs(config_.poll_ns);
+    AddYaw(motion_->Imu(), &yaws);
+    DetectionRecord record;
+    if (detections_->ReadLatest(&record) && record.frame_id != last_frame &&
+        record.capture_time_ns > start_ns) {
+      last_frame = record.frame_id;
+      if (record.found) {
+        *person = record;
+        found = true;
+      }
+    }
+  }
+  if (!found) {
+    Await(motion_->Halt(), keep_going);
+    return false;
+  }
+  // Turn on until facing them, from the heading the frame was captured at;
+  // the turn allows for the speed the robot carries into the stop.
+  const float capture_yaw = YawAt(yaws, person->capture_time_ns);
+  const float seen_deg = camera.BearingDeg(person->x);
+  Await(motion_->Turn(seen_deg - (capture_yaw - motion_->Imu().yaw_deg),
+                      TurnType::kPivot),
+        keep_going);
+  // Let the robot coast to a stop before reading where it ended up.
+  const int64_t halt_ns = clock_->NowNs();
+  while (std::fabs(motion_->Imu().yaw_rate_deg_s) >
+             config_.stopped_rate_deg_s &&
+         clock_->NowNs() - halt_ns < config_.settle_ns) {
+    clock_->SleepForNs(config_.poll_ns);
+  }
+  *bearing_deg = seen_deg - (capture_yaw - motion_->Imu().yaw_deg);
+  return keep_going();
+}
+
+void FollowBehavior::AddYaw(const ImuSnapshot& imu,
+                            std::deque<std::pair<int64_t, float>>* yaws) {
+  if (!yaws->empty() && imu.time_ns <= yaws->back().first) {
+    return;
+  }
+  yaws->emplace_back(imu.time_ns, imu.yaw_deg);
+  while (yaws->size() > 2 &&
+         yaws->front().first < imu.time_ns - kYawHistoryNs) {
+    yaws->pop_front();
+  }
+}
+
+MotionResult FollowBehavior::Await(std::future<MotionResult> result,
+                                   const std::function<bool()>& keep_going) {
+  bool halted = false;
+  while (result.wait_for(std::chrono::seconds(0)) !=
+         std::future_status::ready) {
+    if (!halted && !keep_going()) {
+      // The halt preempts the move within a control period.
+      motion_->Halt();
+      halted = true;
+    }
+    clock_->SleepForNs(config_.poll_ns);
+  }
+  return result.get();
+}
+
+bool FollowBehavior::Approach(const std::function<bool()>& keep_going) {
+  searching_ = false;
+  detections_->SetActive(true);
+  bool found = FindAndApproach(keep_going);
+  detections_->SetActive(false);
+  return found;
+}
+
+bool FollowBehavior::Find(const std::function<bool()>& keep_going,
+                          float* distance) {
+  // Face whoever spoke first, if the microphones heard where they are, or
+  // else where the person was last seen; search on round the same way.
+  float toward_deg;
+  float direction = 1;
+  if ((speaker_bearing_ && speaker_bearing_(&toward_deg)) ||
+      LastSeen(&toward_deg)) {
+    direction = toward_deg < 0 ? -1 : 1;
+    if (std::fabs(toward_deg) > config_.speaker_deadband_deg) {
+      SetSearching(true);
+      Await(motion_->Turn(toward_deg, TurnType::kPivot), keep_going);
+    }
+  }
+  DetectionRecord person;
+  if (!NextDetection(clock_->NowNs(), keep_going, &person)) {
+    return false;
+  }
+  float bearing_deg = TargetTracker(config_.tracker).BearingDeg(person.x);
+  if (!person.found) {
+    SetSearching(true);
+    if (!Search(direction, keep_going, &person, &bearing_deg)) {
+      return false;
+    }
+  }
+
+  // Face the subject.
+  SawPerson(bearing_deg);
+  if (std::fabs(bearing_deg) > config_.turn_deadband_deg) {
+    Await(motion_->Turn(bearing_deg, TurnType::kSwing), keep_going);
+  }
+  SetSearching(false);
+  *distance = person.distance;
+  return keep_going();
+}
+
+bool FollowBehavior::FindAndApproach(const std::function<bool()>& keep_going) {
+  float distance;
+  if (!Find(keep_going, &distance)) {
+    return false;
+  }
+  Await(motion_->Drive(distance), keep_going);
+  distance_ = distance;
+  return true;
+}
+
+bool FollowBehavior::SearchLost(const std::function<bool()>& keep_going) {
+  SetSearching(true);
+  float last_deg = 0, bearing_deg;
+  LastSeen(&last_deg);
+  DetectionRecord person;
+  if (!Search(last_deg < 0 ? -1 : 1, keep_going, &person, &bearing_deg)) {
+    return false;
+  }
+  SawPerson(bearing_deg);
+  if (std::fabs(bearing_deg) > config_.turn_deadband_deg) {
+    Await(motion_->Turn(bearing_deg, TurnType::kSwing), keep_going);
+  }
+  return keep_going();
+}
+
+void FollowBehavior::Follow(const std::function<bool()>& keep_going) {
+  searching_ = false;
+  detections_->SetActive(true);
+  if (config_.max_speed > 0) {
+    FollowSmoothly(keep_going);
+  } else {
+    FollowInSteps(keep_going);
+  }
+  detections_->SetActive(false);
+}
+
+void FollowBehavior::FollowInSteps(const std::function<bool()>& keep_going) {
+  if (!FindAndApproach(keep_going)) {
+    return;
+  }
+
+  // Track subject. Every new frame feeds the tracker; the controller acts
+  // on its prediction at the control rate, so a single jittery or mistaken
+  // detection no longer turns the robot.
+  TargetTracker tracker(config_.tracker);
+  uint64_t last_frame = 0;
+  int64_t since_ns = clock_->NowNs();
+  while (keep_going()) {
+    clock_->SleepForNs(config_.control_period_ns);
+    TRACE_SCOPE("follow.step");
+    DetectionRecord record;
+    if (detections_->ReadLatest(&record) && record.frame_id != last_frame &&
+        record.capture_time_ns > since_ns) {  // skip frames taken while moving
+      last_frame = record.frame_id;
+      tracker.Update(record);
+    }
+    int64_t now_ns = clock_->NowNs();
+    TrackEstimate target = tracker.Predict(now_ns);
+
+    if (!target.valid) {
+      if (now_ns - since_ns > config_.tracker.max_coast_ns) {
+        if (!SearchLost(keep_going)) {
+          break;
+        }
+        tracker.Reset();
+        since_ns = clock_->NowNs();
+      }
+      continue;
+    }
+    SetSearching(false);
+    SawPerson(target.bearing_deg);
+    // Track lateral movement.
+    if (std::fabs(target.bearing_deg) > config_.turn_deadband_deg) {
+      Await(motion_->Turn(target.bearing_deg, TurnType::kSwing), keep_going);
+      tracker.Rotate(target.bearing_deg);
+      since_ns = clock_->NowNs();
+      if (!keep_going()) {
+        break;
+      }
+    }
+    // Track longitudinal movement.
+    if (std::fabs(target.distance - distance_) > config_.range_deadband) {
+      if (target.distance > distance_) {
+        Await(motion_->Drive(target.distance), keep_going);  // go to subject
+      } else {
+        // Back away from subject.
+        Await(motion_->Drive(-target.distance), keep_going);
+      }
+      distance_ = target.distance;
+      // Boxes change size with the move; start the tracks over.
+      tracker.Reset();
+      since_ns = clock_->NowNs();
+    }
+  }
+}
+
+// Moves |from| toward |to| by at most |max_step|.
+static float Slew(float from, float to, float max_step) {
+  return from + std::min(std::max(to - from, -max_step), max_step);
+}
+
+void FollowBehavior::FollowSmoothly(const std::function<bool()>& keep_going) {
+  float distance;
+  if (!Find(keep_going, &distance)) {
+    return;
+  }
+
+  // The tracks are kept in the frame of the current heading: turned with
+  // the robot every period, and fed frames moved from the heading they
+  // were captured at, so frames taken on the move count too.
+  TargetTracker tracker(config_.tracker);
+  std::deque<std::pair<int64_t, float>> yaws;
+  AddYaw(motion_->Imu(), &yaws);
+  const float dt = config_.control_period_ns / 1e9f;
+  float speed = 0, turn_rate = 0;
+  uint64_t last_frame = 0;
+  int64_t since_ns = clock_->NowNs();
+  while (keep_going()) {
+    clock_->SleepForNs(config_.control_period_ns);
+    TRACE_SCOPE("follow.step");
+    ImuSnapshot imu = motion_->Imu();
+    // Yaw is counter-clockwise positive; turns are right positive.
+    tracker.Rotate(yaws.back().second - imu.yaw_deg);
+    AddYaw(imu, &yaws);
+    DetectionRecord record;
+    if (detections_->ReadLatest(&record) && record.frame_id != last_frame &&
+        record.capture_time_ns > since_ns) {
+      last_frame = record.frame_id;
+      if (record.found) {
+        float turned_deg =
+            YawAt(yaws, record.capture_time_ns) - yaws.back().second;
+        record.x = tracker.PixelAtBearing(tracker.BearingDeg(record.x) -
+                                          turned_deg);
+      }
+      tracker.Update(record);
+    }
+    int64_t now_ns = clock_->NowNs();
+    TrackEstimate target = tracker.Predict(now_ns);
+
+    float want_speed = 0, want_turn_rate = 0;
+    if (target.valid) {
+      SetSearching(false);
+      SawPerson(target.bearing_deg);
+      // Close the range, slowing for a person off to the side, and back
+      // away from one too close.
+      float bearing = target.bearing_deg * static_cast<float>(M_PI) / 180;
+      want_speed = config_.range_gain *
+                   (target.distance - config_.follow_distance);
+      if (want_speed > 0) {
+        want_speed *= std::max(std::cos(bearing), 0.0f);
+      }
+      want_speed = std::min(std::max(want_speed, -config_.max_reverse_speed),
+                            config_.max_speed);
+      // Pure pursuit: the arc through the person at the speed driven, plus
+      // a turn in place that holds the bearing when standing still, plus the
+      // bearing's own rate as the person walks across.
+      float pursuit_deg_s = 0;
+      if (want_speed > 0 && target.distance > 0) {
+        pursuit_deg_s = 2 * want_speed * std::sin(bearing) /
+                        target.distance * 180 / static_cast<float>(M_PI);
+      }
+      want_turn_rate = pursuit_deg_s +
+                       config_.bearing_gain * target.bearing_deg +
+                       target.bearing_rate_deg_s;
+      want_turn_rate =
+          std::min(std::max(want_turn_rate, -config_.max_turn_rate_deg_s),
+                   config_.max_turn_rate_deg_s);
+    } else if (now_ns - since_ns > config_.tracker.max_coast_ns) {
+      if (!SearchLost(keep_going)) {
+        break;
+      }
+      tracker.Reset();
+      yaws.clear();
+      AddYaw(motion_->Imu(), &yaws);
+      speed = turn_rate = 0;
+      since_ns = clock_->NowNs();
+      continue;
+    }
+    // Until the person is confirmed again the robot comes to a smooth stop.
+    speed = Slew(speed, want_speed, config_.max_accel * dt);
+    turn_rate =
+        Slew(turn_rate, want_turn_rate, config_.max_turn_accel_deg_s * dt);
+    motion_->SetVelocity(speed, turn_rate);
+  }
+  Await(motion_->Halt(), [] { return true; });
+}
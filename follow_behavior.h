@@ -0,0 +1,158 @@
+#ifndef SRC_ASSISTANT_FOLLOW_BEHAVIOR_H_
+#define SRC_ASSISTANT_FOLLOW_BEHAVIOR_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <future>  // NOLINT
+#include <utility>
+
+#include "assistant/detection_channel.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_hal.h"
+#include "assistant/target_tracker.h"
+
+struct FollowConfig {
+  // The follow controller runs at 20 Hz on the tracker's prediction.
+  int64_t control_period_ns = 50000000;
+  // How often to look for a new detection or a finished move.
+  int64_t poll_ns = 5000000;
+  // Bearing error, in degrees, and range change that trigger a correction.
+  float turn_deadband_deg = 5;
+  float range_deadband = 2;
+  // Follow() keeps the person this many meters ahead. Every control period
+  // a unicycle controller sets the forward speed from the range error and
+  // the turn rate from the bearing, pure pursuit toward the person plus a
+  // turn in place, and MotionController::SetVelocity() maps both to wheel
+  // duty; the robot turns while it drives and never stops between moves.
+  // max_speed 0 follows the old way instead: a turn, then a drive.
+  float follow_distance = 2;
+  float max_speed = 0.8;
+  float max_reverse_speed = 0.3;
+  float max_turn_rate_deg_s = 90;
+  // Meters per second per meter of range error, and degrees per second per
+  // degree of bearing.
+  float range_gain = 0.8;
+  float bearing_gain = 2;
+  // Speed and turn rate change at most this fast, per second.
+  float max_accel = 1;
+  float max_turn_accel_deg_s = 180;
+  // While searching, the robot rotates in place at this rate with the
+  // camera streaming, and stops as soon as a frame shows a person. At a
+  // pivot at cruise duty, 10 frames a second are 9 degrees apart, well
+  // inside the camera's 78 (see search_bench). 0 searches the old way
+  // instead: a search turn, a stop, a look.
+  float search_rate_deg_s = 90;
+  // Turn made while searching with search_rate_deg_s 0.
+  float search_turn_deg = 45;
+  // Where a person was last seen is searched first for this long after.
+  int64_t last_seen_ns = 10000000000LL;
+  // After a search stops, the robot coasts on for a few motor lags; it is
+  // taken to have stopped once it turns slower than this, or after
+  // settle_ns.
+  float stopped_rate_deg_s = 3;
+  int64_t settle_ns = 1000000000;
+  // A speaker heard, or a person last seen, within this of straight ahead
+  // is left to the camera (78 degrees across); one further round is turned
+  // to before searching.
+  float speaker_deadband_deg = 25;
+  TrackerConfig tracker;
+};
+
+// The "come to me" and "follow me" behaviors: search for a person, face
+// them and drive up, then keep tracking. Moves go through |motion| and
+// waits through |clock|, so the same code runs on the robot and in the
+// simulator.
+class FollowBehavior {
+ public:
+  FollowBehavior(MotionController* motion, DetectionSource* detections,
+                 Clock* clock, const FollowConfig& config);
+
+  // Turns until a person is seen, then faces them and drives to them. The
+  // search turns first toward the speaker, if set_speaker_bearing() gives
+  // one, or toward where the person was last seen.
+  // Returns false if |keep_going| turned false first.
+  bool Approach(const std::function<bool()>& keep_going);
+
+  // Finds the person, then follows them while |keep_going| returns true,
+  // searching again whenever they are lost. Once it returns false the robot
+  // stops within a poll and a control period, even in the middle of a
+  // move.
+  void Follow(const std::function<bool()>& keep_going);
+
+  // Called with true as the behavior starts turning to look for a person
+  // and with false once it has one in sight again and faces them, e.g. to
+  // show it on the LED ring. Runs on the thread running the behavior.
+  void set_on_search(std::function<void(bool searching)> on_search) {
+    on_search_ = on_search;
+  }
+  // Asked for the bearing of whoever gave the command as a search begins,
+  // right positive; the search starts by turning toward it, rather than
+  // blindly. Returns false when there is none.
+  void set_speaker_bearing(
+      std::function<bool(float* bearing_deg)> speaker_bearing) {
+    speaker_bearing_ = speaker_bearing;
+  }
+
+ private:
+  // Searches until a person is seen and turns to face them; sets
+  // |distance| to their range. Returns false if |keep_going| turned false
+  // first.
+  bool Find(const std::function<bool()>& keep_going, float* distance);
+  // Approach() without switching detection on and off.
+  bool FindAndApproach(const std::function<bool()>& keep_going);
+  // Follow() with max_speed 0: a turn or a drive at a time, each to a stop.
+  void FollowInSteps(const std::function<bool()>& keep_going);
+  // Follow() in velocity space.
+  void FollowSmoothly(const std::function<bool()>& keep_going);
+  // Searches for a person lost while following, the way they were last seen
+  // going, and faces them. Returns false if |keep_going| turned false first.
+  bool SearchLost(const std::function<bool()>& keep_going);
+  // Rotates in place, right if |direction| is positive, until a frame
+  // captured after the rotation began shows a person, then turns on to
+  // face them and stops. Sets |bearing_deg| to where they are from the
+  // heading the robot stopped at: their bearing in the frame, less the turn
+  // made since its capture. With search_rate_deg_s 0, turns and looks a
+  // step at a time. Returns false if |keep_going| turned false first.
+  bool Search(float direction, const std::function<bool()>& keep_going,
+              DetectionRecord* person, float* bearing_deg);
+  // Yaw at |time_ns|, interpolated in |yaws|, pairs of IMU time and yaw.
+  static float YawAt(const std::deque<std::pair<int64_t, float>>& yaws,
+                     int64_t time_ns);
+  // Appends |imu| to |yaws| if it is newer, dropping what is too old to
+  // need.
+  static void AddYaw(const ImuSnapshot& imu,
+                     std::deque<std::pair<int64_t, float>>* yaws);
+  // Remembers that the person is at |bearing_deg| from the current heading.
+  void SawPerson(float bearing_deg);
+  // Right turn to where the person was last seen; false if they were not
+  // seen recently.
+  bool LastSeen(float* bearing_deg);
+  // Waits for a record from a frame captured after |since_ns|, so a frame
+  // taken while the robot was still moving is never acted on.
+  bool NextDetection(int64_t since_ns, const std::function<bool()>& keep_going,
+                     DetectionRecord* record);
+  // Waits for a move to finish by polling on the clock. If |keep_going|
+  // turns false first, halts the move and waits for it to stop.
+  MotionResult Await(std::future<MotionResult> result,
+                     const std::function<bool()>& keep_going);
+  // Reports a change of searching to on_search_.
+  void SetSearching(bool searching);
+
+  MotionController* motion_;
+  DetectionSource* detections_;
+  Clock* clock_;
+  FollowConfig config_;
+  // Range at which the last approach or correction left the person.
+  float distance_;
+  std::function<void(bool)> on_search_;
+  std::function<bool(float*)> speaker_bearing_;
+  bool searching_;
+  // IMU yaw toward the person when they were last seen, and when.
+  bool seen_person_;
+  float last_seen_yaw_deg_;
+  int64_t last_seen_ns_;
+};
+
+#endif  // SRC_ASSISTANT_FOLLOW_BEHAVIOR_H_
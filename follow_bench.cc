@@ -0,0 +1,186 @@
+// How smoothly and how closely FollowBehavior::Follow() keeps up with a
+// walking person on the simulated robot (robot_sim.h): in velocity space,
+// as it does by default, against a turn or a drive at a time, each to a
+// stop (FollowConfig::max_speed 0).
+//
+// The robot's pose is sampled every 100 ms of simulated time. Smoothness is
+// the RMS of the robot's forward and angular acceleration between samples,
+// how often it comes to a stop with the person in sight, and the share of
+// the time it drives and turns at once; the follow-distance error is the
+// range to the person less FollowConfig::follow_distance.
+//
+// Usage: ./follow_bench [--runs N] [--follow-s SECONDS] [--seed N]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "assistant/follow_behavior.h"
+#include "assistant/heading_controller.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_sim.h"
+
+static const int64_t kSampleNs = 100000000;
+// Slower than these, the robot is taken to be standing or not turning.
+static const double kMovingSpeed = 0.05;
+static const double kTurningRateDegS = 5;
+
+struct FollowStats {
+  int samples = 0;
+  double range_sum = 0;
+  double error_sum = 0;
+  double error_sq_sum = 0;
+  int within_5m = 0;
+  // Between consecutive samples.
+  int accels = 0;
+  double accel_sq_sum = 0;
+  double turn_accel_sq_sum = 0;
+  int stops = 0;
+  int driving = 0;
+  int driving_and_turning = 0;
+  double simulated_s = 0;
+};
+
+// Follows the person for |follow_s| on a fresh world, adding to |stats|.
+static void Run(const FollowConfig& base, uint32_t seed, double follow_s,
+                FollowStats* stats) {
+  SimConfig config;
+  config.seed = seed;
+  SimClock clock;
+  SimRobot robot(&clock, config);
+  clock.AddThread();
+  ImuService imu(robot.imu(), &clock, ImuConfig());
+  MotionController motion(robot.motors(), &imu, &clock, MotionConfig());
+  if (!imu.Start() || !motion.Start()) {
+    clock.RemoveThread();
+    return;
+  }
+  FollowConfig follow_config = base;
+  follow_config.tracker.frame_width = config.frame_width;
+  follow_config.tracker.horizontal_fov_deg = config.horizontal_fov_deg;
+  FollowBehavior follow(&motion, robot.detections(), &clock, follow_config);
+
+  const int64_t start_ns = clock.NowNs();
+  const int64_t end_ns = start_ns + static_cast<int64_t>(follow_s * 1e9);
+  int64_t next_sample_ns = start_ns;
+  bool have_last = false, have_speed = false, was_moving = false;
+  SimPose last;
+  double last_speed = 0, last_rate = 0;
+  follow.Follow([&] {
+    int64_t now_ns = clock.NowNs();
+    if (now_ns < next_sample_ns) {
+      return now_ns < end_ns;
+    }
+    next_sample_ns = now_ns + kSampleNs;
+    SimPose pose = robot.Pose();
+    double range = std::hypot(pose.person_x - pose.x, pose.person_y - pose.y);
+    double error = range - follow_config.follow_distance;
+    stats->samples++;
+    stats->range_sum += range;
+    stats->error_sum += std::fabs(error);
+    stats->error_sq_sum += error * error;
+    stats->within_5m += range < 5;
+    if (have_last && pose.time_s > last.time_s) {
+      double dt = pose.time_s - last.time_s;
+      double heading = last.heading_deg * M_PI / 180;
+      double speed = ((pose.x - last.x) * std::cos(heading) +
+                      (pose.y - last.y) * std::sin(heading)) /
+                     dt;
+      double rate =
+          AngleDifferenceDeg(pose.heading_deg, last.heading_deg) / dt;
+      if (have_speed) {
+        double accel = (speed - last_speed) / dt;
+        double turn_accel = (rate - last_rate) / dt;
+        stats->accels++;
+        stats->accel_sq_sum += accel * accel;
+        stats->turn_accel_sq_sum += turn_accel * turn_accel;
+      }
+      bool moving = std::fabs(speed) > kMovingSpeed;
+      bool turning = std::fabs(rate) > kTurningRateDegS;
+      stats->stops += was_moving && !moving && !turning;
+      stats->driving += moving;
+      stats->driving_and_turning += moving && turning;
+      was_moving = moving || turning;
+      last_speed = speed;
+      last_rate = rate;
+      have_speed = true;
+    }
+    last = pose;
+    have_last = true;
+    return now_ns < end_ns;
+  });
+  stats->simulated_s += (clock.NowNs() - start_ns) / 1e9;
+  motion.Stop();
+  imu.Stop();
+  clock.RemoveThread();
+}
+
+static void Report(const char* name, const FollowStats& stats) {
+  int samples = std::max(stats.samples, 1);
+  int accels = std::max(stats.accels, 1);
+  printf("  %-14s %7.2f %7.2f %7.2f %7.1f | %7.2f %7.0f %7.1f %7.1f\n", name,
+         stats.range_sum / samples, stats.error_sum / samples,
+         std::sqrt(stats.error_sq_sum / samples),
+         100.0 * stats.within_5m / samples,
+         std::sqrt(stats.accel_sq_sum / accels),
+         std::sqrt(stats.turn_accel_sq_sum / accels),
+         60 * stats.stops / std::max(stats.simulated_s, 1.0),
+         100.0 * stats.driving_and_turning / std::max(stats.driving, 1));
+}
+
+int main(int argc, char** argv) {
+  int runs = 10;
+  double follow_s = 60;
+  uint32_t seed = 1;
+
+  const struct option long_options[] = {
+      {"runs", required_argument, nullptr, 'n'},
+      {"follow-s", required_argument, nullptr, 'f'},
+      {"seed", required_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:f:s:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        runs = std::atoi(optarg);
+        break;
+      case 'f':
+        follow_s = std::atof(optarg);
+        break;
+      case 's':
+        seed = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  FollowConfig smooth;
+  FollowConfig steps;
+  steps.max_speed = 0;
+  FollowStats smooth_stats, steps_stats;
+  for (int run = 0; run < runs; run++) {
+    Run(steps, seed + run, follow_s, &steps_stats);
+    Run(smooth, seed + run, follow_s, &smooth_stats);
+  }
+
+  printf("following a walking person, %d runs of %.0f simulated seconds, "
+         "%.1f m wanted\n",
+         runs, follow_s, smooth.follow_distance);
+  printf("  %-14s %7s %7s %7s %7s | %7s %7s %7s %7s\n", "", "range",
+         "|error|", "rms", "<5 m", "accel", "turn", "stops", "turning");
+  printf("  %-14s %7s %7s %7s %7s | %7s %7s %7s %7s\n", "", "m", "m",
+         "m", "%", "m/s^2", "deg/s^2", "/min", "% drive");
+  Report("turn or drive", steps_stats);
+  Report("velocity", smooth_stats);
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "assistant/heading_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+static float Clamp(float value, float limit) {
+  return std::min(std::max(value, -limit), limit);
+}
+
+float AngleDifferenceDeg(float to_deg, float from_deg) {
+  float difference = std::fmod(to_deg - from_deg + 180.0f, 360.0f);
+  if (difference < 0) {
+    difference += 360;
+  }
+  return difference - 180;
+}
+
+void DifferentialDuty(float signed_base, float correction, float* duty_a,
+                      float* duty_b) {
+  *duty_a = signed_base + correction;
+  *duty_b = signed_base - correction;
+}
+
+bool TurnReached(float turned_deg, float target_deg, float rate_deg_s,
+                 float lead_s) {
+  float projected = turned_deg + rate_deg_s * lead_s;
+  return target_deg >= 0 ? projected >= target_deg : projected <= target_deg;
+}
+
+HeadingController::HeadingController(const HeadingConfig& config)
+    : config_(config) {
+  Reset(0);
+}
+
+void HeadingController::Reset(float target_yaw_deg) {
+  target_deg_ = target_yaw_deg;
+  integral_ = 0;
+  derivative_ = 0;
+  last_yaw_deg_ = target_yaw_deg;
+  has_last_ = false;
+}
+
+float HeadingController::Update(float yaw_deg, float dt,
+                                HeadingSample* sample) {
+  float error = AngleDifferenceDeg(target_deg_, yaw_deg);
+  float active_error = 0;
+  if (error > config_.deadband_deg) {
+    active_error = error - config_.deadband_deg;
+  } else if (error < -config_.deadband_deg) {
+    active_error = error + config_.deadband_deg;
+  }
+
+  if (has_last_ && dt > 0) {
+    // Rate of the error is minus the yaw rate; filtered, since one noisy
+    // IMU reading divided by 20 ms is a large number.
+    float rate = -AngleDifferenceDeg(yaw_deg, last_yaw_deg_) / dt;
+    float alpha = dt / (config_.derivative_filter_s + dt);
+    derivative_ += alpha * (rate - derivative_);
+  }
+  last_yaw_deg_ = yaw_deg;
+  has_last_ = true;
+
+  float p = config_.kp * active_error;
+  float d = config_.kd * derivative_;
+  float unclamped = p + integral_ + d;
+  bool saturated = std::fabs(unclamped) >= config_.max_correction;
+  // Conditional integration: only wind up while there is room, or unwind.
+  if (dt > 0 && (!saturated || active_error * integral_ < 0)) {
+    integral_ = Clamp(integral_ + config_.ki * active_error * dt,
+                      config_.max_integral);
+  }
+  float correction = Clamp(p + integral_ + d, config_.max_correction);
+
+  if (sample != nullptr) {
+    sample->error_deg = error;
+    sample->p = p;
+    sample->i = integral_;
+    sample->d = d;
+    sample->correction = correction;
+  }
+  return correction;
+}
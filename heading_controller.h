@@ -0,0 +1,78 @@
+#ifndef SRC_ASSISTANT_HEADING_CONTROLLER_H_
+#define SRC_ASSISTANT_HEADING_CONTROLLER_H_
+
+struct HeadingConfig {
+  // Gains from heading error in degrees to differential duty in percent.
+  // Tuned on heading_controller_bench.
+  float kp = 0.6;
+  float ki = 1.0;
+  float kd = 0.05;
+  // Errors smaller than this are treated as zero, so IMU noise does not
+  // keep the wheels trading duty on a straight run.
+  float deadband_deg = 0.5;
+  // Largest differential duty the controller may command.
+  float max_correction = 12;
+  // Bound on the integral term, in duty percent (anti-windup).
+  float max_integral = 6;
+  // Time constant of the low-pass filter on the derivative term, seconds.
+  float derivative_filter_s = 0.05;
+};
+
+// One controller update, for telemetry.
+struct HeadingSample {
+  float error_deg;
+  float p;
+  float i;
+  float d;
+  // p + i + d after saturation.
+  float correction;
+};
+
+// PID heading hold for straight drives. The output is a differential duty
+// cycle: positive speeds wheel A up and slows wheel B down, which turns the
+// robot toward increasing yaw whichever way it is driving, so forward and
+// reverse share the controller and only the base duty changes sign (see
+// DifferentialDuty()).
+//
+// The integral only accumulates while the output is not saturated, or when
+// the error would unwind it, and is clamped to max_integral. The derivative
+// acts on the measured yaw, so retargeting does not kick the wheels.
+class HeadingController {
+ public:
+  explicit HeadingController(const HeadingConfig& config);
+
+  // Starts holding |target_yaw_deg| and clears the controller state.
+  void Reset(float target_yaw_deg);
+
+  // Returns the differential duty for a yaw reading taken |dt| seconds
+  // after the previous one. Fills |sample| when it is not null.
+  float Update(float yaw_deg, float dt, HeadingSample* sample);
+
+  float target() const { return target_deg_; }
+  const HeadingConfig& config() const { return config_; }
+
+ private:
+  HeadingConfig config_;
+  float target_deg_;
+  float integral_;
+  float derivative_;
+  float last_yaw_deg_;
+  bool has_last_;
+};
+
+// Wheel duty cycles for driving at |signed_base| percent (negative in
+// reverse) with a differential |correction|; negative duties run a wheel
+// backwards.
+void DifferentialDuty(float signed_base, float correction, float* duty_a,
+                      float* duty_b);
+
+// Whether a turn that has covered |turned_deg| of |target_deg| (same sign
+// convention) and is still turning at |rate_deg_s| should stop now: the
+// wheels keep the robot turning for roughly |lead_s| after they are cut.
+bool TurnReached(float turned_deg, float target_deg, float rate_deg_s,
+                 float lead_s);
+
+// Shortest signed angle from |from_deg| to |to_deg|, in [-180, 180).
+float AngleDifferenceDeg(float to_deg, float from_deg);
+
+#endif  // SRC_ASSISTANT_HEADING_CONTROLLER_H_
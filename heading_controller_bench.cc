@@ -0,0 +1,237 @@
+// Simulated step response of the straight-drive heading hold: the PID
+// HeadingController against the three-level bang-bang correction that
+// movementStraight used to apply (30/30, 40/25, 25/40 forward, 32/28
+// reverse, switched on exact yaw equality).
+//
+// The robot model is a differential drive with first-order motor lag, a
+// weaker wheel B, and a lagging, noisy IMU yaw. The old logic runs at its
+// own 20 Hz loop rate, the PID at --rate. Each scenario starts the robot a few
+// degrees off the heading it should hold and drives --distance meters; the
+// bench reports how long the heading takes to settle within --band degrees
+// for good, the cross-track error, and the mean forward speed lost to
+// corrections.
+//
+// Usage: ./heading_controller_bench [--distance M] [--rate HZ]
+//                                   [--band DEG] [--kp K] [--ki K] [--kd K]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "assistant/heading_controller.h"
+
+// Chassis, measured on the robot where possible.
+static const float kCruiseDuty = 30;
+static const float kCruiseSpeed = 1.25f;  // m/s at kCruiseDuty
+static const float kWheelBase = 0.15f;    // m
+static const float kMotorLagS = 0.2f;
+// The IMU's fused yaw trails the true heading and jitters.
+static const float kYawLagS = 0.06f;
+static const float kYawNoiseDeg = 0.2f;
+// movementStraight's loop period.
+static const int kBangBangRateHz = 20;
+static const double kPhysicsStepS = 0.001;
+
+enum class Logic { kBangBang, kPid };
+
+struct Scenario {
+  const char* name;
+  int direction;
+  float initial_heading_deg;
+  // Wheel B delivers this fraction of wheel A's speed at the same duty.
+  float wheel_b_gain;
+};
+
+struct Result {
+  // Seconds until the heading stays inside the band; negative if never.
+  double settling_s;
+  double rms_cross_track_m;
+  double max_cross_track_m;
+  double mean_speed;
+};
+
+// The correction movementStraight applied, as signed wheel duties.
+static void BangBang(int direction, float yaw, float start_yaw, float* a,
+                     float* b) {
+  *a = 30;
+  *b = 30;
+  if (direction > 0) {
+    if (yaw < start_yaw) {
+      *a = 40;
+      *b = 25;
+    } else if (yaw > start_yaw) {
+      *a = 25;
+      *b = 40;
+    }
+  } else {
+    if (yaw > start_yaw) {
+      *a = 32;
+      *b = 28;
+    } else if (yaw < start_yaw) {
+      *a = 28;
+      *b = 32;
+    }
+  }
+  *a *= direction;
+  *b *= direction;
+}
+
+static Result Simulate(Logic logic, const Scenario& scenario,
+                       const HeadingConfig& config, float distance,
+                       int rate_hz, float band_deg) {
+  std::mt19937 random(5);
+  std::normal_distribution<float> noise(0, kYawNoiseDeg);
+  HeadingController controller(config);
+  controller.Reset(0);
+
+  double heading = scenario.initial_heading_deg * M_PI / 180;
+  double x = 0, y = 0;
+  double speed_a = 0, speed_b = 0;
+  float duty_a = 0, duty_b = 0;
+  double control_period =
+      1.0 / (logic == Logic::kBangBang ? kBangBangRateHz : rate_hz);
+  double imu_heading = heading;
+  double next_control = 0;
+  double last_outside = 0;
+  double sum_sq = 0;
+  double max_cross = 0;
+  int samples = 0;
+  double t = 0;
+  double time_limit = 3 * distance / kCruiseSpeed + 5;
+  while (std::fabs(x) < distance && t < time_limit) {
+    if (t >= next_control) {
+      float yaw =
+          static_cast<float>(imu_heading * 180 / M_PI) + noise(random);
+      if (logic == Logic::kBangBang) {
+        BangBang(scenario.direction, yaw, 0, &duty_a, &duty_b);
+      } else {
+        float correction =
+            controller.Update(yaw, static_cast<float>(control_period),
+                              nullptr);
+        DifferentialDuty(scenario.direction * kCruiseDuty, correction,
+                         &duty_a, &duty_b);
+      }
+      next_control += control_period;
+    }
+    double target_a = duty_a / kCruiseDuty * kCruiseSpeed;
+    double target_b =
+        duty_b / kCruiseDuty * kCruiseSpeed * scenario.wheel_b_gain;
+    speed_a += (target_a - speed_a) * kPhysicsStepS / kMotorLagS;
+    speed_b += (target_b - speed_b) * kPhysicsStepS / kMotorLagS;
+    // Wheel A faster turns toward increasing yaw.
+    heading += (speed_a - speed_b) / kWheelBase * kPhysicsStepS;
+    imu_heading += (heading - imu_heading) * kPhysicsStepS / kYawLagS;
+    double speed = (speed_a + speed_b) / 2;
+    x += speed * std::cos(heading) * kPhysicsStepS;
+    y += speed * std::sin(heading) * kPhysicsStepS;
+    t += kPhysicsStepS;
+
+    if (std::fabs(heading * 180 / M_PI) > band_deg) {
+      last_outside = t;
+    }
+    sum_sq += y * y;
+    max_cross = std::max(max_cross, std::fabs(y));
+    samples++;
+  }
+
+  Result result;
+  bool reached = std::fabs(x) >= distance;
+  // Settled only if the last excursion ended well before the run did.
+  result.settling_s = reached && last_outside < t - 1.0 ? last_outside : -1;
+  result.rms_cross_track_m = std::sqrt(sum_sq / std::max(samples, 1));
+  result.max_cross_track_m = max_cross;
+  result.mean_speed = std::fabs(x) / t;
+  return result;
+}
+
+static void PrintResult(const char* logic, const Result& result) {
+  char settling[32];
+  if (result.settling_s >= 0) {
+    snprintf(settling, sizeof(settling), "%6.2fs", result.settling_s);
+  } else {
+    snprintf(settling, sizeof(settling), "%7s", "never");
+  }
+  printf("  %-10s settling %s  cross-track rms %5.3fm max %5.3fm  "
+         "speed %4.2fm/s\n",
+         logic, settling, result.rms_cross_track_m, result.max_cross_track_m,
+         result.mean_speed);
+}
+
+int main(int argc, char** argv) {
+  float distance = 6;
+  int rate_hz = 50;
+  float band_deg = 2;
+  HeadingConfig config;
+
+  const struct option long_options[] = {
+      {"distance", required_argument, nullptr, 'x'},
+      {"rate", required_argument, nullptr, 'r'},
+      {"band", required_argument, nullptr, 'b'},
+      {"kp", required_argument, nullptr, 'p'},
+      {"ki", required_argument, nullptr, 'i'},
+      {"kd", required_argument, nullptr, 'd'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "x:r:b:p:i:d:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'x':
+        distance = std::atof(optarg);
+        break;
+      case 'r':
+        rate_hz = std::atoi(optarg);
+        break;
+      case 'b':
+        band_deg = std::atof(optarg);
+        break;
+      case 'p':
+        config.kp = std::atof(optarg);
+        break;
+      case 'i':
+        config.ki = std::atof(optarg);
+        break;
+      case 'd':
+        config.kd = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  const Scenario scenarios[] = {
+      {"forward, 10 deg off", 1, 10, 1.0f},
+      {"forward, 10 deg off, weak wheel B", 1, 10, 0.92f},
+      {"reverse, 10 deg off", -1, 10, 1.0f},
+      {"reverse, 10 deg off, weak wheel B", -1, -10, 0.92f},
+  };
+  // The PID must settle everywhere, and its worst cross-track error must
+  // beat the old logic's worst.
+  bool settled = true;
+  double worst_old = 0;
+  double worst_pid = 0;
+  for (const Scenario& scenario : scenarios) {
+    Result old_logic = Simulate(Logic::kBangBang, scenario, config, distance,
+                                rate_hz, band_deg);
+    Result pid =
+        Simulate(Logic::kPid, scenario, config, distance, rate_hz, band_deg);
+    printf("%s, %.1fm:\n", scenario.name, distance);
+    PrintResult("bang-bang", old_logic);
+    PrintResult("pid", pid);
+    settled = settled && pid.settling_s >= 0;
+    worst_old = std::max(worst_old, old_logic.rms_cross_track_m);
+    worst_pid = std::max(worst_pid, pid.rms_cross_track_m);
+  }
+  printf("worst cross-track rms: bang-bang %.3fm, pid %.3fm\n", worst_old,
+         worst_pid);
+  bool ok = settled && worst_pid < worst_old;
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
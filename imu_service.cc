@@ -0,0 +1,158 @@
+#include "assistant/imu_service.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "assistant/heading_controller.h"
+#include "assistant/trace.h"
+
+YawIntegrator::YawIntegrator(const ImuConfig& config)
+    : config_(config), bias_deg_s_(0) {
+  Reset();
+}
+
+void YawIntegrator::Reset() {
+  has_last_ = false;
+  last_time_ns_ = 0;
+  yaw_deg_ = 0;
+  rate_deg_s_ = 0;
+  sensor_offset_deg_ = 0;
+}
+
+void YawIntegrator::Add(int64_t time_ns, float gyro_z_deg_s,
+                        float sensor_yaw_deg) {
+  float rate = (gyro_z_deg_s - bias_deg_s_) * config_.gyro_scale;
+  if (!has_last_) {
+    // Align the sensor's yaw with ours so the correction only removes
+    // drift, not the absolute heading.
+    sensor_offset_deg_ = sensor_yaw_deg;
+  } else if (time_ns > last_time_ns_) {
+    float dt = (time_ns - last_time_ns_) / 1e9f;
+    yaw_deg_ += (rate + rate_deg_s_) / 2 * dt;
+    if (config_.yaw_correction_s > 0) {
+      float error =
+          AngleDifferenceDeg(sensor_yaw_deg - sensor_offset_deg_, yaw_deg_);
+      yaw_deg_ += error * std::min(1.0f, dt / config_.yaw_correction_s);
+    }
+  }
+  has_last_ = true;
+  last_time_ns_ = time_ns;
+  rate_deg_s_ = rate;
+}
+
+void BiasEstimator::Add(float gyro_z_deg_s) {
+  sum_ += gyro_z_deg_s;
+  sum_sq_ += gyro_z_deg_s * gyro_z_deg_s;
+  count_++;
+}
+
+bool BiasEstimator::Estimate(float max_stddev, float* bias,
+                             float* stddev) const {
+  if (count_ < 10) {
+    *bias = 0;
+    *stddev = 0;
+    return false;
+  }
+  double mean = sum_ / count_;
+  *stddev = std::sqrt(std::max(0.0, sum_sq_ / count_ - mean * mean));
+  *bias = mean;
+  return *stddev <= max_stddev;
+}
+
+ImuService::ImuService(ImuPort* imu, Clock* clock, const ImuConfig& config)
+    : imu_(imu),
+      clock_(clock),
+      config_(config),
+      integrator_(config),
+      running_(false),
+      exited_(false),
+      samples_(0) {}
+
+ImuService::~ImuService() { Stop(); }
+
+bool ImuService::Start() {
+  if (config_.rate_hz <= 0) {
+    std::cerr << "imu_service: invalid rate " << config_.rate_hz << std::endl;
+    return false;
+  }
+  Calibrate();
+  running_ = true;
+  exited_ = false;
+  clock_->AddThread();
+  thread_ = std::thread(&ImuService::SampleLoop, this);
+  return true;
+}
+
+void ImuService::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // Sleep on the clock until the thread is out, so a simulated one keeps
+  // running.
+  while (!exited_) {
+    clock_->SleepForNs(1000000000LL / config_.rate_hz);
+  }
+  thread_.join();
+}
+
+void ImuService::Calibrate() {
+  BiasEstimator estimator;
+  int64_t end_ns =
+      clock_->NowNs() + static_cast<int64_t>(config_.calibration_s * 1e9);
+  while (clock_->NowNs() < end_ns) {
+    if (imu_->Read(&reading_)) {
+      estimator.Add(reading_.gyro_z_deg_s);
+    }
+  }
+  float bias, stddev;
+  if (estimator.Estimate(config_.max_calibration_stddev_deg_s, &bias,
+                         &stddev)) {
+    integrator_.set_bias(bias);
+    std::clog << "imu_service: gyro z bias " << bias << " deg/s (stddev "
+              << stddev << ")" << std::endl;
+  } else {
+    integrator_.set_bias(0);
+    std::cerr << "imu_service: robot moved during gyro calibration (stddev "
+              << stddev << " deg/s); running without bias correction"
+              << std::endl;
+  }
+}
+
+void ImuService::SampleLoop() {
+  TRACE_THREAD_NAME("imu");
+  const int64_t period_ns = 1000000000LL / config_.rate_hz;
+  int64_t scheduled_ns = clock_->NowNs();
+  while (running_) {
+    TRACE_SCOPE("imu.sample");
+    bool read = imu_->Read(&reading_);
+    // The read dominates the uncertainty of when the sample was taken;
+    // stamp it on return, the same way for every sample.
+    int64_t now_ns = clock_->NowNs();
+    if (!read) {
+      scheduled_ns = now_ns + period_ns;
+      clock_->SleepUntilNs(scheduled_ns);
+      continue;
+    }
+    integrator_.Add(now_ns, reading_.gyro_z_deg_s, reading_.yaw_deg);
+
+    ImuSnapshot snapshot;
+    snapshot.time_ns = now_ns;
+    snapshot.samples = ++samples_;
+    snapshot.yaw_deg = integrator_.yaw_deg();
+    snapshot.yaw_rate_deg_s = integrator_.rate_deg_s();
+    snapshot.sensor_yaw_deg = reading_.yaw_deg;
+    snapshot.gyro_bias_deg_s = integrator_.bias();
+    snapshot_.Store(snapshot);
+
+    scheduled_ns += period_ns;
+    if (scheduled_ns < now_ns) {
+      // Reads are slower than the target rate; sample back to back.
+      scheduled_ns = now_ns;
+      continue;
+    }
+    clock_->SleepUntilNs(scheduled_ns);
+  }
+  exited_ = true;
+  clock_->RemoveThread();
+}
@@ -0,0 +1,126 @@
+#ifndef SRC_ASSISTANT_IMU_SERVICE_H_
+#define SRC_ASSISTANT_IMU_SERVICE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>  // NOLINT
+
+#include "assistant/robot_hal.h"
+#include "assistant/seqlock.h"
+
+struct ImuConfig {
+  // Target sampling rate. The MATRIX bus read itself takes a few ms, so
+  // anything above what it allows just means reading back to back.
+  int rate_hz = 200;
+  // Stationary time at startup over which the gyro bias is averaged.
+  float calibration_s = 1.0;
+  // Calibration is rejected as "not stationary" above this gyro spread.
+  float max_calibration_stddev_deg_s = 2.0;
+  // Scale of the gyro. With real sample intervals no fudge is needed; the
+  // old 8/5 factor made up for a loop that ran slower than it assumed.
+  float gyro_scale = 1.0;
+  // Time constant with which the gyro yaw is pulled toward the sensor's own
+  // (magnetometer-referenced) yaw to cancel long-term drift, or 0 to use
+  // the gyro alone. The motors disturb the magnetometer, so it stays off
+  // unless the compass has been checked on the robot.
+  float yaw_correction_s = 0;
+};
+
+// Newest IMU state, as published by ImuService.
+struct ImuSnapshot {
+  // Capture time of the newest sample on the service's clock; 0 before the
+  // first one.
+  int64_t time_ns;
+  uint64_t samples;
+  // Bias-corrected, integrated gyro yaw since Start(), counter-clockwise
+  // positive and unwrapped (it keeps counting past 360).
+  float yaw_deg;
+  float yaw_rate_deg_s;
+  // The sensor's own yaw, for reference.
+  float sensor_yaw_deg;
+  float gyro_bias_deg_s;
+};
+
+// Integrates gyro z-rate over the real time between samples, trapezoidally,
+// after subtracting a bias. Kept apart from the sampling thread so the
+// simulation benchmark runs the same arithmetic.
+class YawIntegrator {
+ public:
+  explicit YawIntegrator(const ImuConfig& config);
+
+  void Reset();
+  void set_bias(float bias_deg_s) { bias_deg_s_ = bias_deg_s; }
+  float bias() const { return bias_deg_s_; }
+
+  // Adds a sample read at |time_ns|.
+  void Add(int64_t time_ns, float gyro_z_deg_s, float sensor_yaw_deg);
+
+  float yaw_deg() const { return yaw_deg_; }
+  float rate_deg_s() const { return rate_deg_s_; }
+
+ private:
+  ImuConfig config_;
+  float bias_deg_s_;
+  bool has_last_;
+  int64_t last_time_ns_;
+  float yaw_deg_;
+  float rate_deg_s_;
+  float sensor_offset_deg_;
+};
+
+// Accumulates stationary gyro samples and yields their mean as the bias.
+class BiasEstimator {
+ public:
+  void Add(float gyro_z_deg_s);
+  // False when too few samples were seen or they spread more than
+  // |max_stddev|, i.e. the robot was moving.
+  bool Estimate(float max_stddev, float* bias, float* stddev) const;
+
+ private:
+  double sum_ = 0;
+  double sum_sq_ = 0;
+  int count_ = 0;
+};
+
+// Samples the IMU on its own thread as fast as the bus allows, stamps each
+// read with |clock| and integrates the bias-corrected gyro into a
+// yaw estimate. Readers get the newest state from a lock-free snapshot, so
+// the motion control loop never waits on a bus read.
+//
+// The service is the only user of |imu| once started.
+class ImuService {
+ public:
+  ImuService(ImuPort* imu, Clock* clock, const ImuConfig& config);
+  ~ImuService();
+
+  // Estimates the gyro bias over config.calibration_s, which the robot
+  // must spend standing still, then starts sampling. If the robot moved
+  // during calibration a warning is printed and the bias left at 0.
+  // Returns false only for an invalid configuration.
+  bool Start();
+  void Stop();
+
+  ImuSnapshot Latest() const { return snapshot_.Load(); }
+
+ private:
+  void Calibrate();
+  void SampleLoop();
+
+  ImuPort* imu_;
+  Clock* clock_;
+  ImuConfig config_;
+  ImuReading reading_;
+  YawIntegrator integrator_;
+  Seqlock<ImuSnapshot> snapshot_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  // Set by the thread as it finishes, so Stop() can wait on the clock.
+  std::atomic<bool> exited_;
+  uint64_t samples_;
+
+  ImuService(const ImuService&) = delete;
+  ImuService& operator=(const ImuService&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_IMU_SERVICE_H_
@@ -0,0 +1,221 @@
+// Simulated turn accuracy: movementTurn's fixed-step gyro integration
+// against the ImuService pipeline (bias calibration, timestamped
+// trapezoidal integration, stop on yaw with a coasting lead).
+//
+// The old loop adds gyro_z * 0.02 * 8/5 per iteration, but its real period
+// is 20 ms of sleep plus the bus read, plus a stdout flush on left turns,
+// so the integrated angle runs off from the real one. The new path samples
+// as fast as the bus allows, stamps every read and is polled by a 50 Hz
+// control loop, as in MotionController.
+//
+// The robot pivots at --rate deg/s with first-order motor lag and coasts
+// after the motors are cut; the gyro has a constant bias and white noise.
+// The error reported is where the robot finally comes to rest.
+//
+// Usage: ./imu_turn_bench [--bias DEG_S] [--noise DEG_S] [--rate DEG_S]
+//                         [--lead S]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "assistant/heading_controller.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+
+static const double kStepS = 0.00025;
+static const float kMotorLagS = 0.15f;
+// A bus read of the IMU takes this long; the sample is latched at its start.
+static const float kReadMinS = 0.002f;
+static const float kReadMaxS = 0.006f;
+// movementTurn: usleep(20000) overshoots a little, and left turns print
+// (and flush) the angle every iteration.
+static const float kOversleepMaxS = 0.001f;
+static const float kFlushMinS = 0.001f;
+static const float kFlushMaxS = 0.010f;
+static const double kControlPeriodS = 0.02;
+static const double kSettleS = 2.0;
+
+struct Robot {
+  double heading_deg = 0;  // counter-clockwise positive
+  double rate_deg_s = 0;
+  double command_deg_s = 0;
+
+  void Advance(double seconds) {
+    for (double t = 0; t < seconds; t += kStepS) {
+      rate_deg_s += (command_deg_s - rate_deg_s) * kStepS / kMotorLagS;
+      heading_deg += rate_deg_s * kStepS;
+    }
+  }
+};
+
+struct Gyro {
+  Gyro(float bias, float noise) : bias(bias), noise(0, noise), random(9) {}
+  float Read(const Robot& robot) {
+    return static_cast<float>(robot.rate_deg_s) + bias + noise(random);
+  }
+  float bias;
+  std::normal_distribution<float> noise;
+  std::mt19937 random;
+};
+
+// Final turn in degrees, right positive, of movementTurn's loop.
+static double OldTurn(float target_deg, float pivot_rate, Gyro* gyro) {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> read(kReadMinS, kReadMaxS);
+  std::uniform_real_distribution<float> oversleep(0, kOversleepMaxS);
+  std::uniform_real_distribution<float> flush(kFlushMinS, kFlushMaxS);
+  bool right = target_deg > 0;
+  float set_angle = std::fabs(target_deg);
+  Robot robot;
+  robot.command_deg_s = right ? -pivot_rate : pivot_rate;
+  float angle = 0;
+  while (right ? angle > -set_angle : angle < set_angle) {
+    float gyro_z = gyro->Read(robot);
+    robot.Advance(read(random));
+    angle += gyro_z * 0.02 * 8 / 5;
+    if (!right) {
+      robot.Advance(flush(random));
+    }
+    robot.Advance(0.02 + oversleep(random));
+  }
+  robot.command_deg_s = 0;
+  robot.Advance(kSettleS);
+  return -robot.heading_deg;
+}
+
+// Final turn in degrees, right positive, of ImuService + MotionController.
+static double NewTurn(float target_deg, float pivot_rate, float lead_s,
+                      Gyro* gyro, float* bias_estimate) {
+  std::mt19937 random(2);
+  std::uniform_real_distribution<float> read(kReadMinS, kReadMaxS);
+  ImuConfig config;
+  YawIntegrator integrator(config);
+  Robot robot;
+
+  // Standing still for the startup calibration.
+  BiasEstimator estimator;
+  for (double t = 0; t < config.calibration_s;) {
+    estimator.Add(gyro->Read(robot));
+    t += read(random);
+  }
+  float bias, stddev;
+  estimator.Estimate(config.max_calibration_stddev_deg_s, &bias, &stddev);
+  integrator.set_bias(bias);
+  *bias_estimate = bias;
+
+  const int64_t kNs = 1000000000LL;
+  const double sample_period = 1.0 / config.rate_hz;
+  double t = 0;
+  double read_start = 0;
+  double read_done = read(random);
+  float latched = gyro->Read(robot);
+  bool reading = true;
+  double next_control = 0;
+  float start_yaw = 0;
+  bool started = false;
+  bool turning = true;
+  while (turning) {
+    if (t >= read_done) {
+      integrator.Add(static_cast<int64_t>(read_done * kNs), latched, 0);
+      read_start = std::max(read_done, read_start + sample_period);
+      read_done = read_start + read(random);
+      reading = false;
+    }
+    if (!reading && t >= read_start) {
+      latched = gyro->Read(robot);
+      reading = true;
+    }
+    if (t >= next_control) {
+      float yaw = integrator.yaw_deg();
+      if (!started) {
+        started = true;
+        start_yaw = yaw;
+        robot.command_deg_s = target_deg > 0 ? -pivot_rate : pivot_rate;
+      } else if (TurnReached(start_yaw - yaw, target_deg,
+                             -integrator.rate_deg_s(), lead_s)) {
+        turning = false;
+      }
+      next_control += kControlPeriodS;
+    }
+    robot.Advance(kStepS);
+    t += kStepS;
+  }
+  robot.command_deg_s = 0;
+  robot.Advance(kSettleS);
+  return -robot.heading_deg;
+}
+
+int main(int argc, char** argv) {
+  float bias = 0.8f;
+  float noise = 0.5f;
+  float pivot_rate = 80;
+  float lead_s = MotionConfig().turn_stop_lead_s;
+
+  const struct option long_options[] = {
+      {"bias", required_argument, nullptr, 'b'},
+      {"noise", required_argument, nullptr, 'n'},
+      {"rate", required_argument, nullptr, 'r'},
+      {"lead", required_argument, nullptr, 'l'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "b:n:r:l:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'b':
+        bias = std::atof(optarg);
+        break;
+      case 'n':
+        noise = std::atof(optarg);
+        break;
+      case 'r':
+        pivot_rate = std::atof(optarg);
+        break;
+      case 'l':
+        lead_s = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  const float targets[] = {45, -45, 90, -90, 180, -180};
+  double old_worst = 0, new_worst = 0;
+  double old_sum = 0, new_sum = 0;
+  float bias_estimate = 0;
+  printf("gyro bias %.2f deg/s, noise %.2f deg/s, pivot %.0f deg/s, "
+         "lead %.3fs\n",
+         bias, noise, pivot_rate, lead_s);
+  printf("  target    old turn (error)    new turn (error)\n");
+  for (float target : targets) {
+    Gyro old_gyro(bias, noise);
+    Gyro new_gyro(bias, noise);
+    double old_turn = OldTurn(target, pivot_rate, &old_gyro);
+    double new_turn =
+        NewTurn(target, pivot_rate, lead_s, &new_gyro, &bias_estimate);
+    double old_error = old_turn - target;
+    double new_error = new_turn - target;
+    printf("  %6.0f   %8.1f (%+6.1f)   %8.1f (%+6.1f)\n", target, old_turn,
+           old_error, new_turn, new_error);
+    old_worst = std::max(old_worst, std::fabs(old_error));
+    new_worst = std::max(new_worst, std::fabs(new_error));
+    old_sum += std::fabs(old_error);
+    new_sum += std::fabs(new_error);
+  }
+  int count = sizeof(targets) / sizeof(targets[0]);
+  printf("estimated bias %.2f deg/s\n", bias_estimate);
+  printf("mean |error|: old %.1f deg, new %.1f deg; worst: old %.1f deg, "
+         "new %.1f deg\n",
+         old_sum / count, new_sum / count, old_worst, new_worst);
+  bool ok = new_worst < old_worst;
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,367 @@
+// End-to-end latencies the user feels, measured on the simulated robot
+// (robot_sim.h) through the same command, motion and follow code the robot
+// runs:
+//
+//   command_to_motor   robot command accepted (stability 1) to the first
+//                      motor write that changes the output
+//   frame_to_steering  capture of the newest frame the follower had seen
+//                      the person in to the motor write that starts a turn
+//   reacquire          person stepping out of view to the follower reading
+//                      a frame that has them again
+//
+// Commands come from a transcript script, one "<seconds> <transcript>" line
+// per command, each given that long after the one before; without one, a
+// seeded mix of moves, each followed by "stop", is used. The camera is the
+// simulator's, which sees the walking person as the robot moves, so the
+// loop from frame to steering to the next frame is closed. Every result is
+// in simulated time, so it covers the pipeline's structure (tick periods,
+// polling, detection latency, coasting and search) and not CPU time.
+//
+// Prints p50/p95/p99 per path and, with --json, writes them as one JSON
+// object for comparing builds.
+//
+// Usage: ./latency_bench [--seed N] [--commands N] [--transcripts <file>]
+//                        [--follow-s SECONDS] [--lose-every-s SECONDS]
+//                        [--json <file>]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assistant/follow_behavior.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_commands.h"
+#include "assistant/robot_sim.h"
+#include "assistant/time_util.h"
+
+// A differential this large, in percent duty, is a turn rather than the
+// heading controller trimming a straight line.
+static const float kTurnDifferential = 10;
+
+// Watches the follower's detections: the newest frame it has read that
+// shows the person, and when it first sees them again after losing them.
+class DetectionProbe : public DetectionSource {
+ public:
+  DetectionProbe(DetectionSource* detections, Clock* clock)
+      : detections_(detections),
+        clock_(clock),
+        newest_capture_ns_(0),
+        lost_ns_(-1) {}
+
+  void SetActive(bool active) override { detections_->SetActive(active); }
+
+  bool ReadLatest(DetectionRecord* record) override {
+    if (!detections_->ReadLatest(record)) {
+      return false;
+    }
+    if (!record->found) {
+      return true;
+    }
+    newest_capture_ns_ = std::max<int64_t>(newest_capture_ns_,
+                                           record->capture_time_ns);
+    int64_t lost_ns = lost_ns_;
+    if (lost_ns >= 0 && record->capture_time_ns > lost_ns) {
+      reacquire_ms_.push_back((clock_->NowNs() - lost_ns) / 1e6);
+      lost_ns_ = -1;
+    }
+    return true;
+  }
+
+  // Called when the person is moved out of view.
+  void Lost() { lost_ns_ = clock_->NowNs(); }
+  bool lost() const { return lost_ns_ >= 0; }
+  int64_t newest_capture_ns() const { return newest_capture_ns_; }
+  const std::vector<double>& reacquire_ms() const { return reacquire_ms_; }
+
+ private:
+  DetectionSource* detections_;
+  Clock* clock_;
+  std::atomic<int64_t> newest_capture_ns_;
+  std::atomic<int64_t> lost_ns_;
+  // Appended on the follower's thread.
+  std::vector<double> reacquire_ms_;
+};
+
+// Times motor writes against the command that caused them and, while
+// following, turns against the newest frame the follower had seen the
+// person in. Search turns are not counted: those while the person is lost,
+// and those once the newest sighting is older than the tracker keeps a
+// track alive.
+class MotorProbe : public MotorPort {
+ public:
+  MotorProbe(MotorPort* motors, Clock* clock, const DetectionProbe* frames,
+             int64_t max_coast_ns)
+      : motors_(motors),
+        clock_(clock),
+        frames_(frames),
+        max_coast_ns_(max_coast_ns),
+        command_ns_(-1),
+        following_(false),
+        duty_a_(0),
+        duty_b_(0) {}
+
+  void Set(float duty_a, float duty_b) override {
+    motors_->Set(duty_a, duty_b);
+    int64_t now_ns = clock_->NowNs();
+    bool changed = duty_a != duty_a_ || duty_b != duty_b_;
+    int64_t command_ns = command_ns_.load();
+    if (command_ns >= 0 && changed) {
+      command_ms_.push_back((now_ns - command_ns) / 1e6);
+      command_ns_ = -1;
+    }
+    bool was_turning = std::fabs(duty_a_ - duty_b_) >= kTurnDifferential;
+    bool turning = std::fabs(duty_a - duty_b) >= kTurnDifferential;
+    int64_t capture_ns = frames_->newest_capture_ns();
+    if (following_ && turning && !was_turning && capture_ns > 0 &&
+        now_ns - capture_ns <= max_coast_ns_ && !frames_->lost()) {
+      steering_ms_.push_back((now_ns - capture_ns) / 1e6);
+    }
+    duty_a_ = duty_a;
+    duty_b_ = duty_b;
+  }
+
+  // Marks a command as accepted now. A command that changes nothing, such
+  // as "stop" once a move has finished, goes uncounted.
+  void Command() { command_ns_ = clock_->NowNs(); }
+  // Switches from timing commands to timing turns.
+  void StartFollowing() {
+    command_ns_ = -1;
+    following_ = true;
+  }
+
+  // Only read once the controller has stopped.
+  const std::vector<double>& command_ms() const { return command_ms_; }
+  const std::vector<double>& steering_ms() const { return steering_ms_; }
+
+ private:
+  MotorPort* motors_;
+  Clock* clock_;
+  const DetectionProbe* frames_;
+  int64_t max_coast_ns_;
+  std::atomic<int64_t> command_ns_;
+  std::atomic<bool> following_;
+  // Written on the motion controller's thread only.
+  float duty_a_, duty_b_;
+  std::vector<double> command_ms_;
+  std::vector<double> steering_ms_;
+};
+
+struct PathStats {
+  const char* name;
+  size_t count;
+  double p50_ms, p95_ms, p99_ms, max_ms;
+};
+
+static PathStats Summarize(const char* name, std::vector<double> samples) {
+  PathStats stats = {name, samples.size(), 0, 0, 0, 0};
+  if (samples.empty()) {
+    return stats;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&samples](double fraction) {
+    size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+    return samples[std::max<size_t>(rank, 1) - 1];
+  };
+  stats.p50_ms = percentile(0.5);
+  stats.p95_ms = percentile(0.95);
+  stats.p99_ms = percentile(0.99);
+  stats.max_ms = samples.back();
+  return stats;
+}
+
+// Reads "<seconds> <transcript>" lines; blank lines and # comments are
+// skipped.
+static bool ReadTranscripts(
+    const std::string& path,
+    std::vector<std::pair<double, std::string>>* script) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    std::cerr << "latency_bench: cannot open " << path << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    double delay_s;
+    std::string transcript;
+    if (!(fields >> delay_s) || !std::getline(fields >> std::ws, transcript)) {
+      std::cerr << "latency_bench: bad line in " << path << ": " << line
+                << std::endl;
+      return false;
+    }
+    if (!IsRobotCommand(transcript)) {
+      std::cerr << "latency_bench: not a robot command: " << transcript
+                << std::endl;
+      return false;
+    }
+    script->push_back(std::make_pair(delay_s, transcript));
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  SimConfig config;
+  int commands = 200;
+  std::string transcripts_path, json_path;
+  double follow_s = 600;
+  double lose_every_s = 20;
+
+  const struct option long_options[] = {
+      {"seed", required_argument, nullptr, 's'},
+      {"commands", required_argument, nullptr, 'c'},
+      {"transcripts", required_argument, nullptr, 't'},
+      {"follow-s", required_argument, nullptr, 'f'},
+      {"lose-every-s", required_argument, nullptr, 'l'},
+      {"json", required_argument, nullptr, 'j'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "s:c:t:f:l:j:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 's':
+        config.seed = std::atoi(optarg);
+        break;
+      case 'c':
+        commands = std::atoi(optarg);
+        break;
+      case 't':
+        transcripts_path = optarg;
+        break;
+      case 'f':
+        follow_s = std::atof(optarg);
+        break;
+      case 'l':
+        lose_every_s = std::atof(optarg);
+        break;
+      case 'j':
+        json_path = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  std::mt19937 random(config.seed);
+  std::vector<std::pair<double, std::string>> script;
+  if (!transcripts_path.empty()) {
+    if (!ReadTranscripts(transcripts_path, &script)) {
+      return -1;
+    }
+  } else {
+    const char* moves[] = {"turn left", "turn right", "turn around",
+                           "go forward", "go backward"};
+    std::uniform_int_distribution<int> move(0, 4);
+    std::uniform_real_distribution<double> pause_s(0.5, 3.0);
+    for (int i = 0; i < commands / 2; i++) {
+      script.push_back(std::make_pair(pause_s(random), moves[move(random)]));
+      script.push_back(std::make_pair(pause_s(random), "stop"));
+    }
+  }
+
+  int64_t wall_start_ns = MonotonicNowNs();
+  SimClock clock;
+  SimRobot robot(&clock, config);
+  DetectionProbe detections(robot.detections(), &clock);
+  MotorProbe motors(robot.motors(), &clock, &detections,
+                    TrackerConfig().max_coast_ns);
+  int64_t start_ns = clock.NowNs();
+  clock.AddThread();
+  {
+    ImuService imu(robot.imu(), &clock, ImuConfig());
+    MotionController motion(&motors, &imu, &clock, MotionConfig());
+    if (!imu.Start() || !motion.Start()) {
+      return -1;
+    }
+    FollowConfig follow_config;
+    follow_config.tracker.frame_width = config.frame_width;
+    follow_config.tracker.horizontal_fov_deg = config.horizontal_fov_deg;
+    FollowBehavior follow(&motion, &detections, &clock, follow_config);
+
+    // Voice commands while standing or driving.
+    for (const auto& step : script) {
+      clock.SleepForNs(static_cast<int64_t>(step.first * 1e9));
+      motors.Command();
+      RunRobotCommand(step.second, &motion, &follow, [] { return true; });
+    }
+    RunRobotCommand("stop", &motion, &follow, [] { return true; });
+    clock.SleepForNs(1000000000);
+
+    // Following, with the person stepping behind the robot now and then.
+    robot.PlacePerson(0, 2.5);
+    motors.StartFollowing();
+    const int64_t follow_end_ns =
+        clock.NowNs() + static_cast<int64_t>(follow_s * 1e9);
+    const int64_t lose_every_ns = static_cast<int64_t>(lose_every_s * 1e9);
+    int64_t next_lose_ns = clock.NowNs() + lose_every_ns;
+    std::uniform_real_distribution<double> behind_deg(120, 240);
+    std::uniform_real_distribution<double> range_m(1.5, 4);
+    RunRobotCommand("follow me", &motion, &follow, [&] {
+      int64_t now_ns = clock.NowNs();
+      if (now_ns >= next_lose_ns && !detections.lost()) {
+        robot.PlacePerson(behind_deg(random), range_m(random));
+        detections.Lost();
+        next_lose_ns = now_ns + lose_every_ns;
+      }
+      return now_ns < follow_end_ns;
+    });
+    motion.Stop();
+    imu.Stop();
+  }
+  clock.RemoveThread();
+  double simulated_s = (clock.NowNs() - start_ns) / 1e9;
+  double wall_s = (MonotonicNowNs() - wall_start_ns) / 1e9;
+
+  PathStats paths[] = {
+      Summarize("command_to_motor", motors.command_ms()),
+      Summarize("frame_to_steering", motors.steering_ms()),
+      Summarize("reacquire", detections.reacquire_ms()),
+  };
+  printf("%-18s %6s %9s %9s %9s %9s\n", "path", "count", "p50 ms", "p95 ms",
+         "p99 ms", "max ms");
+  for (const PathStats& path : paths) {
+    printf("%-18s %6zu %9.1f %9.1f %9.1f %9.1f\n", path.name, path.count,
+           path.p50_ms, path.p95_ms, path.p99_ms, path.max_ms);
+  }
+  printf("simulated %.1f s in %.2f s (%.0fx real time)\n", simulated_s, wall_s,
+         simulated_s / wall_s);
+
+  if (!json_path.empty()) {
+    FILE* json = fopen(json_path.c_str(), "w");
+    if (json == nullptr) {
+      std::cerr << "latency_bench: cannot write " << json_path << std::endl;
+      return -1;
+    }
+    fprintf(json, "{\"bench\": \"latency_bench\", \"seed\": %u, "
+            "\"simulated_s\": %.1f, \"paths\": {",
+            config.seed, simulated_s);
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+      const PathStats& path = paths[i];
+      fprintf(json, "%s\"%s\": {\"count\": %zu, \"p50_ms\": %.2f, "
+              "\"p95_ms\": %.2f, \"p99_ms\": %.2f, \"max_ms\": %.2f}",
+              i > 0 ? ", " : "", path.name, path.count, path.p50_ms,
+              path.p95_ms, path.p99_ms, path.max_ms);
+    }
+    fprintf(json, "}}\n");
+    fclose(json);
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef SRC_ASSISTANT_LATENCY_HISTOGRAM_H_
+#define SRC_ASSISTANT_LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Fixed-bucket histogram of durations that a real-time thread can record
+// into without locking or allocating, while another thread reads
+// percentiles. Buckets are kBucketNs wide; anything past the last bucket is
+// counted in it, and the exact maximum is kept separately.
+class LatencyHistogram {
+ public:
+  static const int kNumBuckets = 10000;
+  static const int64_t kBucketNs = 10000;  // 10 us, so 100 ms of range.
+
+  LatencyHistogram() { Reset(); }
+
+  void Record(int64_t ns) {
+    if (ns < 0) {
+      ns = 0;
+    }
+    int64_t bucket = ns / kBucketNs;
+    if (bucket >= kNumBuckets) {
+      bucket = kNumBuckets - 1;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    int64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Not atomic with respect to concurrent Record() calls.
+  void Reset() {
+    for (int i = 0; i < kNumBuckets; i++) {
+      buckets_[i].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_ns_.store(0, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+  double MeanMs() const {
+    uint64_t count = Count();
+    return count > 0 ? sum_ns_.load(std::memory_order_relaxed) / 1e6 / count
+                     : 0;
+  }
+
+  double MaxMs() const {
+    return max_ns_.load(std::memory_order_relaxed) / 1e6;
+  }
+
+  // Upper edge of the bucket holding the |fraction| quantile, in ms.
+  double PercentileMs(double fraction) const {
+    uint64_t count = Count();
+    if (count == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; i++) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return (i + 1) * kBucketNs / 1e6;
+      }
+    }
+    return MaxMs();
+  }
+
+ private:
+  std::atomic<uint64_t> buckets_[kNumBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<int64_t> sum_ns_;
+  std::atomic<int64_t> max_ns_;
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_LATENCY_HISTOGRAM_H_
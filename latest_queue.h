@@ -0,0 +1,98 @@
+#ifndef SRC_ASSISTANT_LATEST_QUEUE_H_
+#define SRC_ASSISTANT_LATEST_QUEUE_H_
+
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <utility>
+
+// Bounded queue between two pipeline stages. When the consumer falls behind,
+// Push() discards the oldest queued item instead of blocking the producer,
+// so the consumer always works on the freshest data available.
+template <typename T>
+class LatestQueue {
+ public:
+  explicit LatestQueue(size_t capacity)
+      : capacity_(capacity), closed_(false), pushed_(0), dropped_(0),
+        max_depth_(0) {}
+
+  // Enqueues |item|, dropping the oldest entry if the queue is full.
+  void Push(T item) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (items_.size() >= capacity_) {
+        items_.pop_front();
+        dropped_++;
+      }
+      items_.push_back(std::move(item));
+      pushed_++;
+      if (items_.size() > max_depth_) {
+        max_depth_ = items_.size();
+      }
+    }
+    ready_.notify_one();
+  }
+
+  // Blocks until an item is available and moves it into |item|. Returns
+  // false once the queue has been closed and drained.
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+    *item = std::move(items_.front());
+    items_.pop_front();
+    return true;
+  }
+
+  // Wakes all consumers; Pop() returns false once the queue is empty.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    ready_.notify_all();
+  }
+
+  // Discards everything queued, e.g. frames captured before a pause.
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropped_ += items_.size();
+    items_.clear();
+  }
+
+  size_t Depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+  }
+  size_t MaxDepth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_depth_;
+  }
+  uint64_t Pushed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pushed_;
+  }
+  uint64_t Dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+ private:
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<T> items_;
+  bool closed_;
+  uint64_t pushed_;
+  uint64_t dropped_;
+  size_t max_depth_;
+
+  LatestQueue(const LatestQueue&) = delete;
+  LatestQueue& operator=(const LatestQueue&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_LATEST_QUEUE_H_
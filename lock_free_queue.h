@@ -0,0 +1,109 @@
+#ifndef SRC_ASSISTANT_LOCK_FREE_QUEUE_H_
+#define SRC_ASSISTANT_LOCK_FREE_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Bounded multi-producer, multi-consumer queue that never blocks and never
+// takes a lock (Vyukov's sequence-numbered ring). Each slot carries a
+// sequence number that tells producers and consumers whose turn it is, so a
+// push or pop is one compare-and-swap on the shared index plus a move.
+//
+// Used where the consumer is a fixed-rate control thread that must not wait
+// on a mutex held by a lower-priority producer.
+template <typename T>
+class LockFreeQueue {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit LockFreeQueue(size_t capacity)
+      : mask_(RoundUp(capacity) - 1), slots_(mask_ + 1), head_(0),
+        tail_(0) {
+    for (size_t i = 0; i <= mask_; i++) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Moves |item| into the queue. Returns false, leaving |item| untouched,
+  // when the queue is full.
+  bool TryPush(T* item) {
+    size_t position = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[position & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t lag = static_cast<intptr_t>(sequence) -
+                     static_cast<intptr_t>(position);
+      if (lag == 0) {
+        if (tail_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = std::move(*item);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest item into |item|. Returns false when the queue is
+  // empty.
+  bool TryPop(T* item) {
+    size_t position = head_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[position & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t lag = static_cast<intptr_t>(sequence) -
+                     static_cast<intptr_t>(position + 1);
+      if (lag == 0) {
+        if (head_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+    *item = std::move(slot->item);
+    slot->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  static size_t RoundUp(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const size_t mask_;
+  std::vector<Slot> slots_;
+  // Consumers and producers hammer different indices; keep them on
+  // separate cache lines.
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+
+  LockFreeQueue(const LockFreeQueue&) = delete;
+  LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_LOCK_FREE_QUEUE_H_
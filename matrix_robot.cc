@@ -0,0 +1,58 @@
+#include "assistant/matrix_robot.h"
+
+#include <algorithm>
+
+#include "assistant/trace.h"
+
+bool MatrixImu::Read(ImuReading* reading) {
+  TRACE_SCOPE("imu.read");
+  if (!sensor_->Read(&data_)) {
+    return false;
+  }
+  reading->gyro_z_deg_s = data_.gyro_z;
+  reading->yaw_deg = data_.yaw;
+  return true;
+}
+
+MatrixLeds::MatrixLeds(matrix_hal::MatrixIOBus* bus)
+    : image_(bus->MatrixLeds()) {
+  everloop_.Setup(bus);
+}
+
+int MatrixLeds::Count() const { return image_.leds.size(); }
+
+void MatrixLeds::Write(const std::vector<LedColor>& leds) {
+  TRACE_SCOPE("everloop.write");
+  size_t count = std::min(leds.size(), image_.leds.size());
+  for (size_t i = 0; i < count; i++) {
+    image_.leds[i].red = leds[i].red;
+    image_.leds[i].green = leds[i].green;
+    image_.leds[i].blue = leds[i].blue;
+    image_.leds[i].white = leds[i].white;
+  }
+  everloop_.Write(&image_);
+}
+
+MatrixMics::MatrixMics(matrix_hal::MatrixIOBus* bus, int sample_rate)
+    : core_(mics_) {
+  mics_.Setup(bus);
+  mics_.SetSamplingRate(sample_rate);
+  // The core's FIR filter is set up for the rate.
+  core_.Setup(bus);
+  channels_ = mics_.Channels();
+  sample_rate_ = mics_.SamplingRate();
+}
+
+bool MatrixMics::Read(std::vector<int16_t>* samples) {
+  if (!mics_.Read()) {
+    return false;
+  }
+  int count = mics_.NumberOfSamples();
+  samples->resize(static_cast<size_t>(count) * channels_);
+  for (int s = 0; s < count; s++) {
+    for (int c = 0; c < channels_; c++) {
+      (*samples)[s * channels_ + c] = mics_.At(s, c);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef SRC_ASSISTANT_MATRIX_ROBOT_H_
+#define SRC_ASSISTANT_MATRIX_ROBOT_H_
+
+#include <vector>
+
+#include "assistant/robot_hal.h"
+#include "driver/everloop.h"
+#include "driver/everloop_image.h"
+#include "driver/imu_data.h"
+#include "driver/imu_sensor.h"
+#include "driver/matrixio_bus.h"
+#include "driver/microphone_array.h"
+#include "driver/microphone_core.h"
+
+// MATRIX Creator implementations of the robot_hal.h ports. The motors are
+// MotorDriver (motor_driver.h) and detections VisionDetectionSource
+// (vision_pipeline.h).
+
+class MatrixImu : public ImuPort {
+ public:
+  // |sensor| must be set up on the bus.
+  explicit MatrixImu(matrix_hal::IMUSensor* sensor) : sensor_(sensor) {}
+  bool Read(ImuReading* reading) override;
+
+ private:
+  matrix_hal::IMUSensor* sensor_;
+  matrix_hal::IMUData data_;
+};
+
+class MatrixLeds : public LedPort {
+ public:
+  explicit MatrixLeds(matrix_hal::MatrixIOBus* bus);
+  int Count() const override;
+  void Write(const std::vector<LedColor>& leds) override;
+
+ private:
+  matrix_hal::Everloop everloop_;
+  matrix_hal::EverloopImage image_;
+};
+
+// The eight microphones, read straight off the FPGA. Needs a direct bus:
+// with the MATRIX kernel modules loaded the array belongs to ALSA.
+class MatrixMics : public MicArrayPort {
+ public:
+  MatrixMics(matrix_hal::MatrixIOBus* bus, int sample_rate);
+  int Channels() const override { return channels_; }
+  int SampleRate() const override { return sample_rate_; }
+  // Blocks until the FPGA has the next block.
+  bool Read(std::vector<int16_t>* samples) override;
+
+ private:
+  matrix_hal::MicrophoneArray mics_;
+  matrix_hal::MicrophoneCore core_;
+  int channels_;
+  int sample_rate_;
+};
+
+#endif  // SRC_ASSISTANT_MATRIX_ROBOT_H_
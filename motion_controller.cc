@@ -0,0 +1,358 @@
+#include "assistant/motion_controller.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "assistant/trace.h"
+
+
+// Swing turns move one wheel, so they take about twice as long.
+static const float kSwingRateFactor = 0.5f;
+static const int64_t kMinTurnTimeoutNs = 1000000000;
+
+const char* MotionResultName(MotionResult result) {
+  switch (result) {
+    case MotionResult::kCompleted:
+      return "completed";
+    case MotionResult::kPreempted:
+      return "preempted";
+    case MotionResult::kRejected:
+      return "rejected";
+    case MotionResult::kTimedOut:
+      return "timed out";
+    case MotionResult::kShutdown:
+      return "shutdown";
+  }
+  return "unknown";
+}
+
+static float ClampDuty(float duty) {
+  return std::min(std::max(duty, -100.0f), 100.0f);
+}
+
+MotionController::MotionController(MotorPort* motors, const ImuService* imu,
+                                   Clock* clock, const MotionConfig& config)
+    : motors_(motors),
+      imu_(imu),
+      clock_(clock),
+      config_(config),
+      queue_(config.queue_capacity),
+      heading_(config.heading),
+      running_(false),
+      exited_(false),
+      ticks_(0),
+      overruns_(0),
+      commands_(0),
+      preempted_(0) {}
+
+MotionController::~MotionController() { Stop(); }
+
+bool MotionController::Start() {
+  if (config_.rate_hz <= 0) {
+    std::cerr << "motion_controller: invalid rate " << config_.rate_hz
+              << std::endl;
+    return false;
+  }
+  SetWheels(0, 0);
+  running_ = true;
+  exited_ = false;
+  clock_->AddThread();
+  thread_ = std::thread(&MotionController::ControlLoop, this);
+  return true;
+}
+
+void MotionController::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // Waiting on the clock rather than in join() lets a simulated clock move
+  // on to the thread's next wakeup.
+  while (!exited_) {
+    clock_->SleepForNs(1000000000LL / config_.rate_hz);
+  }
+  thread_.join();
+  Command command;
+  while (queue_.TryPop(&command)) {
+    command.done->set_value(MotionResult::kShutdown);
+  }
+}
+
+std::future<MotionResult> MotionController::Drive(float meters) {
+  Command command;
+  command.type = CommandType::kDrive;
+  command.value = meters;
+  return Submit(std::move(command));
+}
+
+std::future<MotionResult> MotionController::Turn(float degrees,
+                                                 TurnType type) {
+  Command command;
+  command.type = CommandType::kTurn;
+  command.value = degrees;
+  command.turn_type = type;
+  return Submit(std::move(command));
+}
+
+std::future<MotionResult> MotionController::StartTurn(float degrees,
+                                                      TurnType type) {
+  Command command;
+  command.type = CommandType::kTurnRamp;
+  command.value = degrees;
+  command.turn_type = type;
+  return Submit(std::move(command));
+}
+
+std::future<MotionResult> MotionController::SetVelocity(float linear,
+                                                        float angular_deg_s) {
+  Command command;
+  command.type = CommandType::kVelocity;
+  command.value = linear;
+  command.angular = angular_deg_s;
+  return Submit(std::move(command));
+}
+
+std::future<MotionResult> MotionController::Halt() {
+  Command command;
+  command.type = CommandType::kHalt;
+  return Submit(std::move(command));
+}
+
+std::future<MotionResult> MotionController::Submit(Command command) {
+  command.done = std::make_shared<std::promise<MotionResult>>();
+  std::future<MotionResult> result = command.done->get_future();
+  std::shared_ptr<std::promise<MotionResult>> done = command.done;
+  command.submit_time_ns = clock_->NowNs();
+  if (!running_ || !queue_.TryPush(&command)) {
+    done->set_value(running_ ? MotionResult::kRejected
+                             : MotionResult::kShutdown);
+  }
+  return result;
+}
+
+void MotionController::ControlLoop() {
+  TRACE_THREAD_NAME("motion");
+  if (config_.realtime_priority > 0) {
+    struct sched_param param;
+    param.sched_priority = config_.realtime_priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0) {
+      std::clog << "motion_controller: no real-time priority ("
+                << strerror(error) << "), running best effort" << std::endl;
+    }
+  }
+
+  const int64_t period_ns = 1000000000LL / config_.rate_hz;
+  int64_t scheduled_ns = clock_->NowNs();
+  int64_t last_ns = scheduled_ns;
+  while (running_) {
+    // Absolute deadlines, so time spent in a tick never accumulates as
+    // drift.
+    scheduled_ns += period_ns;
+    clock_->SleepUntilNs(scheduled_ns);
+    int64_t now_ns = clock_->NowNs();
+    jitter_.Record(now_ns - scheduled_ns);
+    if (now_ns - scheduled_ns > period_ns) {
+      overruns_++;
+      scheduled_ns = now_ns;
+    }
+
+    // Everything queued since the last tick preempts what is running, in
+    // order; only the newest one gets to act.
+    Command command;
+    while (queue_.TryPop(&command)) {
+      commands_++;
+      // A turn confirming a ramp the same way carries on from it.
+      bool continues_ramp =
+          command.type == CommandType::kTurn &&
+          active_.command.type == CommandType::kTurnRamp && active_.started &&
+          (command.value >= 0) == (active_.command.value >= 0);
+      float ramp_start_yaw = active_.start_yaw;
+      if (active_.command.type != CommandType::kNone) {
+        preempted_++;
+        Finish(MotionResult::kPreempted);
+      }
+      active_ = Active();
+      active_.command = std::move(command);
+      if (continues_ramp) {
+        active_.continues_ramp = true;
+        active_.start_yaw = ramp_start_yaw;
+      }
+    }
+
+    ticks_++;
+    TRACE_SCOPE("motion.tick");
+    Tick(now_ns, (now_ns - last_ns) / 1e9f);
+    last_ns = now_ns;
+  }
+
+  SetWheels(0, 0);
+  if (active_.command.type != CommandType::kNone) {
+    Finish(MotionResult::kShutdown);
+  }
+  exited_ = true;
+  clock_->RemoveThread();
+}
+
+void MotionController::Tick(int64_t now_ns, float dt) {
+  Command& command = active_.command;
+  if (command.type == CommandType::kNone) {
+    return;
+  }
+  ImuSnapshot imu = imu_->Latest();
+  bool first = !active_.started;
+  if (first) {
+    active_.started = true;
+    active_.start_ns = now_ns;
+    if (!active_.continues_ramp) {
+      active_.start_yaw = imu.yaw_deg;
+    }
+    heading_.Reset(imu.yaw_deg);
+    if (command.type == CommandType::kDrive) {
+      active_.deadline_ns =
+          now_ns + static_cast<int64_t>(std::fabs(command.value) /
+                                        config_.cruise_speed * 1e9);
+    } else if (command.type == CommandType::kTurn) {
+      float rate = config_.pivot_rate_deg_s;
+      if (command.turn_type == TurnType::kSwing) {
+        rate *= kSwingRateFactor;
+      }
+      active_.deadline_ns =
+          now_ns + std::max(kMinTurnTimeoutNs,
+                            static_cast<int64_t>(
+                                std::fabs(command.value) / rate *
+                                config_.turn_timeout_factor * 1e9));
+    } else if (command.type == CommandType::kTurnRamp) {
+      active_.deadline_ns =
+          now_ns + static_cast<int64_t>(config_.turn_ramp_hold_s * 1e9);
+    }
+  }
+
+  float duty = config_.cruise_duty;
+  bool done = false;
+  MotionResult result = MotionResult::kCompleted;
+  switch (command.type) {
+    case CommandType::kNone:
+      break;
+    case CommandType::kHalt:
+      SetWheels(0, 0);
+      done = true;
+      break;
+    case CommandType::kVelocity: {
+      float base = command.value / config_.cruise_speed * duty;
+      float differential = command.angular / config_.pivot_rate_deg_s * duty;
+      // Turning right runs wheel B faster than wheel A.
+      SetWheels(ClampDuty(base - differential),
+                ClampDuty(base + differential));
+      break;
+    }
+    case CommandType::kDrive: {
+      if (now_ns >= active_.deadline_ns) {
+        SetWheels(0, 0);
+        done = true;
+        break;
+      }
+      HeadingSample sample;
+      float correction = heading_.Update(imu.yaw_deg, first ? 0 : dt,
+                                         &sample);
+      if (config_.heading_telemetry) {
+        config_.heading_telemetry(sample);
+      }
+      float a, b;
+      DifferentialDuty(command.value >= 0 ? duty : -duty, correction, &a, &b);
+      SetWheels(ClampDuty(a), ClampDuty(b));
+      break;
+    }
+    case CommandType::kTurn: {
+      // Yaw is counter-clockwise positive; turns are right positive.
+      float turned = active_.start_yaw - imu.yaw_deg;
+      bool right = command.value >= 0;
+      if (TurnReached(turned, command.value, -imu.yaw_rate_deg_s,
+                      config_.turn_stop_lead_s)) {
+        SetWheels(0, 0);
+        done = true;
+      } else if (now_ns >= active_.deadline_ns) {
+        SetWheels(0, 0);
+        done = true;
+        result = MotionResult::kTimedOut;
+      } else if (command.turn_type == TurnType::kPivot) {
+        SetWheels(right ? -duty : duty, right ? duty : -duty);
+      } else {
+        SetWheels(right ? 0 : duty, right ? duty : 0);
+      }
+      break;
+    }
+    case CommandType::kTurnRamp: {
+      // Nobody confirmed or cancelled it.
+      if (now_ns >= active_.deadline_ns) {
+        SetWheels(0, 0);
+        done = true;
+        break;
+      }
+      float turned = active_.start_yaw - imu.yaw_deg;
+      bool right = command.value >= 0;
+      float limit =
+          std::min(std::fabs(command.value), config_.turn_ramp_max_deg);
+      if (!active_.holding &&
+          TurnReached(turned, right ? limit : -limit, -imu.yaw_rate_deg_s,
+                      config_.turn_stop_lead_s)) {
+        active_.holding = true;
+      }
+      float ramp = active_.holding ? 0 : config_.turn_ramp_duty;
+      if (command.turn_type == TurnType::kPivot) {
+        SetWheels(right ? -ramp : ramp, right ? ramp : -ramp);
+      } else {
+        SetWheels(right ? 0 : ramp, right ? ramp : 0);
+      }
+      break;
+    }
+  }
+  if (first) {
+    latency_.Record(clock_->NowNs() - command.submit_time_ns);
+  }
+  if (done) {
+    Finish(result);
+  }
+}
+
+void MotionController::Finish(MotionResult result) {
+  active_.command.done->set_value(result);
+  active_ = Active();
+}
+
+void MotionController::SetWheels(float duty_a, float duty_b) {
+  motors_->Set(duty_a, duty_b);
+}
+
+void MotionController::GetStats(MotionStats* stats) const {
+  stats->ticks = ticks_.load();
+  stats->overruns = overruns_.load();
+  stats->commands = commands_.load();
+  stats->preempted = preempted_.load();
+  stats->latency_p50_ms = latency_.PercentileMs(0.5);
+  stats->latency_p99_ms = latency_.PercentileMs(0.99);
+  stats->latency_max_ms = latency_.MaxMs();
+  stats->jitter_p50_ms = jitter_.PercentileMs(0.5);
+  stats->jitter_p99_ms = jitter_.PercentileMs(0.99);
+  stats->jitter_max_ms = jitter_.MaxMs();
+}
+
+void MotionController::PrintStats(std::ostream& out) const {
+  MotionStats stats;
+  GetStats(&stats);
+  out << std::fixed << std::setprecision(2);
+  out << "motion_controller: ticks=" << stats.ticks
+      << " overruns=" << stats.overruns << " commands=" << stats.commands
+      << " preempted=" << stats.preempted << std::endl;
+  out << "motion_controller latency: p50=" << stats.latency_p50_ms
+      << "ms p99=" << stats.latency_p99_ms << "ms max="
+      << stats.latency_max_ms << "ms" << std::endl;
+  out << "motion_controller jitter: p50=" << stats.jitter_p50_ms
+      << "ms p99=" << stats.jitter_p99_ms << "ms max=" << stats.jitter_max_ms
+      << "ms" << std::endl;
+}
@@ -0,0 +1,195 @@
+#ifndef SRC_ASSISTANT_MOTION_CONTROLLER_H_
+#define SRC_ASSISTANT_MOTION_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <future>  // NOLINT
+#include <memory>
+#include <ostream>
+#include <thread>  // NOLINT
+
+#include "assistant/heading_controller.h"
+#include "assistant/imu_service.h"
+#include "assistant/latency_histogram.h"
+#include "assistant/lock_free_queue.h"
+#include "assistant/robot_hal.h"
+
+// How a motion command ended.
+enum class MotionResult {
+  kCompleted,
+  // A newer command took over before this one finished.
+  kPreempted,
+  // The command queue was full; the command never ran.
+  kRejected,
+  // A turn did not reach its angle in the time it should have taken.
+  kTimedOut,
+  // The controller was stopped while the command was running.
+  kShutdown,
+};
+
+const char* MotionResultName(MotionResult result);
+
+enum class TurnType {
+  // Wheels turn in opposite directions; the robot rotates in place.
+  kPivot,
+  // Only the outer wheel drives.
+  kSwing,
+};
+
+struct MotionConfig {
+  // Rate of the control loop.
+  int rate_hz = 50;
+  // SCHED_FIFO priority of the control thread, or 0 to leave it in the
+  // normal scheduling class. Needs CAP_SYS_NICE; falls back with a warning.
+  int realtime_priority = 0;
+  // Commands that may be waiting for the next tick.
+  size_t queue_capacity = 16;
+  // Ground speed at cruise_duty, measured on the robot (~1.25 m/s at 30%).
+  float cruise_speed = 1.25;
+  float cruise_duty = 30;
+  // Rotation rate of a pivot turn at cruise_duty, in degrees per second.
+  float pivot_rate_deg_s = 90;
+  // Turns give up after this multiple of their expected duration.
+  float turn_timeout_factor = 3;
+  // Turns cut the motors this long before the yaw rate would carry the
+  // robot onto the target, to allow for it coasting: roughly the motor lag
+  // plus one control period (see imu_turn_bench).
+  float turn_stop_lead_s = 0.17;
+  // StartTurn(): the duty a turn not yet confirmed starts at, how far it
+  // may get before it holds still, and how long it holds waiting for the
+  // Turn() that confirms it.
+  float turn_ramp_duty = 15;
+  float turn_ramp_max_deg = 15;
+  float turn_ramp_hold_s = 3;
+  // Heading hold of Drive().
+  HeadingConfig heading;
+  // If set, called on the control thread with every heading controller
+  // update of a drive. Must not block.
+  std::function<void(const HeadingSample&)> heading_telemetry;
+};
+
+// Latency and timing of the control loop since Start().
+struct MotionStats {
+  uint64_t ticks;
+  // Ticks that started more than one period late; the loop skips ahead
+  // rather than running the missed ticks back to back.
+  uint64_t overruns;
+  uint64_t commands;
+  uint64_t preempted;
+  // From a command call to the first motor write made for it.
+  double latency_p50_ms;
+  double latency_p99_ms;
+  double latency_max_ms;
+  // How late each tick woke up relative to its schedule.
+  double jitter_p50_ms;
+  double jitter_p99_ms;
+  double jitter_max_ms;
+};
+
+// Drives the robot from its own fixed-rate control thread. Commands are
+// queued without blocking and picked up on the next tick; each returns a
+// future that resolves when the command finishes or is preempted. A newer
+// command always preempts the running one, so "stop" or a fresh target
+// takes effect within one control period, whatever was going on before.
+//
+// The control thread is the only user of |motors| once started. Heading
+// comes from |imu|, which must already be started; the loop runs on
+// |clock|.
+class MotionController {
+ public:
+  MotionController(MotorPort* motors, const ImuService* imu, Clock* clock,
+                   const MotionConfig& config);
+  ~MotionController();
+
+  // Starts the control thread.
+  bool Start();
+
+  // Stops the motors and the control thread; a running command resolves to
+  // kShutdown.
+  void Stop();
+
+  // Drives |meters| straight, backwards when negative, holding the heading
+  // the robot had when the command started.
+  std::future<MotionResult> Drive(float meters);
+
+  // Turns by |degrees|, positive to the right.
+  std::future<MotionResult> Turn(float degrees, TurnType type);
+
+  // Starts a turn by |degrees| that has not been confirmed yet: slowly, and
+  // no further than turn_ramp_max_deg, then holds. A Turn() the same way
+  // that takes over from it counts from where it began, so the ramp is
+  // part of the turn; Halt() cancels it a few degrees in.
+  std::future<MotionResult> StartTurn(float degrees, TurnType type);
+
+  // Drives at |linear| m/s while turning at |angular_deg_s| (positive to the
+  // right) until preempted.
+  std::future<MotionResult> SetVelocity(float linear, float angular_deg_s);
+
+  // Stops the motors.
+  std::future<MotionResult> Halt();
+
+  // The newest IMU state, as the control loop sees it.
+  ImuSnapshot Imu() const { return imu_->Latest(); }
+
+  void GetStats(MotionStats* stats) const;
+  void PrintStats(std::ostream& out) const;
+
+ private:
+  enum class CommandType { kNone, kDrive, kTurn, kTurnRamp, kVelocity, kHalt };
+
+  struct Command {
+    CommandType type = CommandType::kNone;
+    float value = 0;
+    float angular = 0;
+    TurnType turn_type = TurnType::kPivot;
+    int64_t submit_time_ns = 0;
+    std::shared_ptr<std::promise<MotionResult>> done;
+  };
+
+  // Progress of the running command.
+  struct Active {
+    Command command;
+    bool started = false;
+    int64_t start_ns = 0;
+    int64_t deadline_ns = 0;
+    float start_yaw = 0;
+    // A turn taking over from a ramp; |start_yaw| is the ramp's.
+    bool continues_ramp = false;
+    // A ramp that went as far as it may.
+    bool holding = false;
+  };
+
+  std::future<MotionResult> Submit(Command command);
+  void ControlLoop();
+  void Tick(int64_t now_ns, float dt);
+  void Finish(MotionResult result);
+  // Signed duty cycles in percent; negative runs a wheel backwards.
+  void SetWheels(float duty_a, float duty_b);
+
+  MotorPort* motors_;
+  const ImuService* imu_;
+  Clock* clock_;
+  MotionConfig config_;
+
+  LockFreeQueue<Command> queue_;
+  Active active_;
+  HeadingController heading_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  // Set by the thread as it finishes, so Stop() can wait on the clock.
+  std::atomic<bool> exited_;
+
+  std::atomic<uint64_t> ticks_;
+  std::atomic<uint64_t> overruns_;
+  std::atomic<uint64_t> commands_;
+  std::atomic<uint64_t> preempted_;
+  LatencyHistogram latency_;
+  LatencyHistogram jitter_;
+
+  MotionController(const MotionController&) = delete;
+  MotionController& operator=(const MotionController&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_MOTION_CONTROLLER_H_
@@ -0,0 +1,147 @@
+// Measures the MotionController on the robot: command-to-actuation latency
+// and control loop jitter, plus how quickly a running drive is preempted.
+//
+// By default only zero-velocity commands are sent, at random phases of the
+// control period, so the wheels never turn. With --move the robot also
+// starts a 6 m drive and halts it after --preempt-ms, and reports how the
+// drive ended, how long the halt took to reach the motors, and the heading
+// error the drive held.
+//
+// Usage: ./motion_controller_bench [--commands N] [--rate HZ]
+//                                  [--priority P] [--move]
+//                                  [--preempt-ms MS]
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdlib>
+#include <future>  // NOLINT
+#include <iostream>
+#include <random>
+
+#include "assistant/imu_service.h"
+#include "assistant/matrix_robot.h"
+#include "assistant/motion_controller.h"
+#include "assistant/motor_driver.h"
+#include "assistant/time_util.h"
+#include "driver/gpio_control.h"
+#include "driver/imu_sensor.h"
+#include "driver/matrixio_bus.h"
+
+int main(int argc, char** argv) {
+  int commands = 500;
+  bool move = false;
+  int preempt_ms = 500;
+  MotionConfig config;
+
+  const struct option long_options[] = {
+      {"commands", required_argument, nullptr, 'n'},
+      {"rate", required_argument, nullptr, 'r'},
+      {"priority", required_argument, nullptr, 'p'},
+      {"move", no_argument, nullptr, 'm'},
+      {"preempt-ms", required_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:r:p:mt:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        commands = std::atoi(optarg);
+        break;
+      case 'r':
+        config.rate_hz = std::atoi(optarg);
+        break;
+      case 'p':
+        config.realtime_priority = std::atoi(optarg);
+        break;
+      case 'm':
+        move = true;
+        break;
+      case 't':
+        preempt_ms = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  // Written on the control thread; read once the drive has resolved.
+  int heading_samples = 0;
+  double heading_sum_sq = 0;
+  float heading_max = 0;
+  config.heading_telemetry = [&](const HeadingSample& sample) {
+    heading_samples++;
+    heading_sum_sq += sample.error_deg * sample.error_deg;
+    heading_max = std::max(heading_max, std::fabs(sample.error_deg));
+  };
+
+  matrix_hal::MatrixIOBus bus;
+  if (!bus.Init()) {
+    std::cerr << "motion_controller_bench: unable to open the MATRIX bus"
+              << std::endl;
+    return -1;
+  }
+  matrix_hal::IMUSensor imu_sensor;
+  imu_sensor.Setup(&bus);
+  matrix_hal::GPIOControl gpio;
+  gpio.Setup(&bus);
+  gpioInit(&gpio);
+
+  MonotonicClock clock;
+  MotorDriver motors(&gpio, MotorDriverConfig());
+  MatrixImu imu_port(&imu_sensor);
+  ImuService imu(&imu_port, &clock, ImuConfig());
+  if (!imu.Start()) {
+    return -1;
+  }
+  MotionController motion(&motors, &imu, &clock, config);
+  if (!motion.Start()) {
+    return -1;
+  }
+
+  // Spread submissions over the control period so the latency reflects a
+  // command arriving at any point in the cycle.
+  std::mt19937 random(3);
+  std::uniform_int_distribution<int> gap_us(0, 2 * 1000000 / config.rate_hz);
+  int rejected = 0;
+  for (int i = 0; i < commands; i++) {
+    usleep(gap_us(random));
+    std::future<MotionResult> result = motion.SetVelocity(0, 0);
+    if (result.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready &&
+        result.get() == MotionResult::kRejected) {
+      rejected++;
+    }
+  }
+  motion.Halt().wait();
+  std::cout << "zero-velocity commands: " << commands << " (" << rejected
+            << " rejected)" << std::endl;
+
+  if (move) {
+    std::future<MotionResult> drive = motion.Drive(6);
+    usleep(preempt_ms * 1000);
+    int64_t halt_ns = MonotonicNowNs();
+    motion.Halt().wait();
+    std::cout << "6 m drive halted after " << preempt_ms << "ms: "
+              << MotionResultName(drive.get()) << ", halt took "
+              << (MonotonicNowNs() - halt_ns) / 1e6 << "ms" << std::endl;
+    if (heading_samples > 0) {
+      std::cout << "heading error: rms "
+                << std::sqrt(heading_sum_sq / heading_samples) << " deg, max "
+                << heading_max << " deg over " << heading_samples << " ticks"
+                << std::endl;
+    }
+  }
+
+  motion.Stop();
+  motion.PrintStats(std::cout);
+  motors.PrintStats(std::cout);
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include "assistant/motor_driver.h"
+
+#include <cmath>
+#include <iomanip>
+
+#include "assistant/time_util.h"
+#include "assistant/trace.h"
+
+static const uint16_t kInputPins[4] = {IN1, IN2, IN3, IN4};
+static const uint16_t kEnablePins[2] = {ENA, ENB};
+// SetGPIOValues writes the pin value register once; SetPWM writes the
+// bank's prescaler, its period and the channel's duty.
+static const int kGpioBusWrites = 1;
+static const int kPwmBusWrites = 3;
+
+void gpioInit(matrix_hal::GPIOControl* gpio) {
+  gpio->SetMode(ENA, GPIOOutputMode);
+  gpio->SetMode(IN1, GPIOOutputMode);
+  gpio->SetMode(IN2, GPIOOutputMode);
+  gpio->SetMode(IN3, GPIOOutputMode);
+  gpio->SetMode(IN4, GPIOOutputMode);
+  gpio->SetMode(ENB, GPIOOutputMode);
+  gpio->SetFunction(ENA, PWMFunction);
+  gpio->SetFunction(ENB, PWMFunction);
+}
+
+MotorDriver::MotorDriver(matrix_hal::GPIOControl* gpio,
+                         const MotorDriverConfig& config)
+    : gpio_(gpio),
+      config_(config),
+      applied_known_(false),
+      updates_(0),
+      unchanged_(0),
+      gpio_writes_(0),
+      pwm_writes_(0),
+      first_write_ns_(0) {}
+
+float MotorDriver::Quantize(float duty) const {
+  duty = std::fmin(std::fmax(duty, -100.0f), 100.0f);
+  if (config_.duty_step <= 0) {
+    return duty;
+  }
+  return std::round(duty / config_.duty_step) * config_.duty_step;
+}
+
+void MotorDriver::Set(float duty_a, float duty_b) {
+  TRACE_SCOPE("motor.set");
+  float duty[2] = {Quantize(duty_a), Quantize(duty_b)};
+  Bridge target;
+  for (int wheel = 0; wheel < 2; wheel++) {
+    target.in[2 * wheel] = duty[wheel] > 0;
+    target.in[2 * wheel + 1] = duty[wheel] < 0;
+    target.duty[wheel] = std::fabs(duty[wheel]);
+  }
+
+  uint16_t low[4], high[4];
+  int lows = 0, highs = 0;
+  for (int i = 0; i < 4; i++) {
+    if (applied_known_ && target.in[i] == applied_.in[i]) {
+      continue;
+    }
+    if (target.in[i]) {
+      high[highs++] = kInputPins[i];
+    } else {
+      low[lows++] = kInputPins[i];
+    }
+  }
+  uint64_t gpio_writes = 0, pwm_writes = 0;
+  // Lower before raising, so a reversing wheel never has both inputs high.
+  if (lows > 0) {
+    gpio_->SetGPIOValues(low, lows, 0);
+    gpio_writes++;
+  }
+  if (highs > 0) {
+    gpio_->SetGPIOValues(high, highs, 1);
+    gpio_writes++;
+  }
+  for (int wheel = 0; wheel < 2; wheel++) {
+    if (applied_known_ && target.duty[wheel] == applied_.duty[wheel]) {
+      continue;
+    }
+    gpio_->SetPWM(config_.pwm_frequency, target.duty[wheel],
+                  kEnablePins[wheel]);
+    pwm_writes++;
+  }
+  applied_ = target;
+  applied_known_ = true;
+
+  updates_.fetch_add(1, std::memory_order_relaxed);
+  if (gpio_writes + pwm_writes == 0) {
+    unchanged_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  gpio_writes_.fetch_add(gpio_writes, std::memory_order_relaxed);
+  pwm_writes_.fetch_add(pwm_writes, std::memory_order_relaxed);
+  if (first_write_ns_.load(std::memory_order_relaxed) == 0) {
+    first_write_ns_.store(MonotonicNowNs(), std::memory_order_relaxed);
+  }
+}
+
+void MotorDriver::GetStats(MotorDriverStats* stats) const {
+  stats->updates = updates_.load();
+  stats->unchanged = unchanged_.load();
+  stats->gpio_writes = gpio_writes_.load();
+  stats->pwm_writes = pwm_writes_.load();
+  stats->bus_writes = stats->gpio_writes * kGpioBusWrites +
+                      stats->pwm_writes * kPwmBusWrites;
+  // Four SetGPIOValue calls and two SetPWM calls per update.
+  stats->uncoalesced_bus_writes =
+      stats->updates * (4 * kGpioBusWrites + 2 * kPwmBusWrites);
+  // Averaged from the first write up to now.
+  stats->bus_writes_per_s = 0;
+  int64_t first_ns = first_write_ns_.load();
+  int64_t elapsed_ns = MonotonicNowNs() - first_ns;
+  if (first_ns != 0 && elapsed_ns > 0) {
+    stats->bus_writes_per_s = stats->bus_writes * 1e9 / elapsed_ns;
+  }
+}
+
+void MotorDriver::PrintStats(std::ostream& out) const {
+  MotorDriverStats stats;
+  GetStats(&stats);
+  out << std::fixed << std::setprecision(1);
+  out << "motor_driver: updates=" << stats.updates
+      << " unchanged=" << stats.unchanged
+      << " gpio_writes=" << stats.gpio_writes
+      << " pwm_writes=" << stats.pwm_writes
+      << " bus_writes=" << stats.bus_writes << " (uncoalesced "
+      << stats.uncoalesced_bus_writes << ") " << stats.bus_writes_per_s
+      << "/s" << std::endl;
+}
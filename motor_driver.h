@@ -0,0 +1,93 @@
+#ifndef SRC_ASSISTANT_MOTOR_DRIVER_H_
+#define SRC_ASSISTANT_MOTOR_DRIVER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <ostream>
+
+#include "assistant/robot_hal.h"
+#include "driver/gpio_control.h"
+
+// GPIO pin modes and functions of the MATRIX HAL.
+const uint16_t GPIOOutputMode = 1;
+const uint16_t GPIOInputMode = 0;
+const uint16_t PWMFunction = 1;
+
+// H-bridge wiring, MATRIX GPIO pins [0-15]. Wheel A is ENA/IN1/IN2, wheel B
+// ENB/IN3/IN4; IN1 (IN3) high drives the wheel forwards.
+const uint16_t ENA = 0;
+const uint16_t IN1 = 1;
+const uint16_t IN2 = 2;
+const uint16_t IN3 = 3;
+const uint16_t IN4 = 4;
+const uint16_t ENB = 5;
+
+// Puts the H-bridge pins in output mode and ENA/ENB in PWM mode.
+void gpioInit(matrix_hal::GPIOControl* gpio);
+
+struct MotorDriverConfig {
+  float pwm_frequency = 50;
+  // Duties are rounded to this many percent before they are compared, so
+  // the small changes a heading correction makes on every tick do not turn
+  // into a bus write each.
+  float duty_step = 0.5;
+};
+
+// Bus traffic of a MotorDriver since construction.
+struct MotorDriverStats {
+  // Set() calls, and those that found nothing to write.
+  uint64_t updates;
+  uint64_t unchanged;
+  uint64_t gpio_writes;
+  uint64_t pwm_writes;
+  // MATRIX bus transactions issued, and what writing every register on
+  // every update would have cost.
+  uint64_t bus_writes;
+  uint64_t uncoalesced_bus_writes;
+  double bus_writes_per_s;
+};
+
+// MotorPort on the MATRIX GPIO. Holds the H-bridge state (IN1-IN4
+// direction pins, ENA/ENB duty) last written and, on each update, writes
+// only what changed. Direction pins going to the same level share one bus
+// write, so a direction change costs at most two writes instead of four,
+// and an unchanged duty is not written at all. That leaves the shared
+// MatrixIOBus to the IMU reads.
+//
+// Not thread safe: one thread owns the driver; GetStats() may be called
+// from any thread.
+class MotorDriver : public MotorPort {
+ public:
+  MotorDriver(matrix_hal::GPIOControl* gpio, const MotorDriverConfig& config);
+
+  // The first call writes every register, since their state is unknown.
+  void Set(float duty_a, float duty_b) override;
+
+  void GetStats(MotorDriverStats* stats) const;
+  void PrintStats(std::ostream& out) const;
+
+ private:
+  struct Bridge {
+    bool in[4];
+    float duty[2];
+  };
+
+  float Quantize(float duty) const;
+
+  matrix_hal::GPIOControl* gpio_;
+  MotorDriverConfig config_;
+  Bridge applied_;
+  bool applied_known_;
+
+  std::atomic<uint64_t> updates_;
+  std::atomic<uint64_t> unchanged_;
+  std::atomic<uint64_t> gpio_writes_;
+  std::atomic<uint64_t> pwm_writes_;
+  std::atomic<int64_t> first_write_ns_;
+
+  MotorDriver(const MotorDriver&) = delete;
+  MotorDriver& operator=(const MotorDriver&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_MOTOR_DRIVER_H_
@@ -0,0 +1,249 @@
+#include "assistant/person_detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+
+#include <opencv2/imgproc.hpp>
+
+#include "assistant/time_util.h"
+
+// Index of "person" in the 21 VOC classes MobileNet-SSD was trained on.
+static const int kPersonClassId = 15;
+// Network input resolution.
+static const int kInputSize = 300;
+// blobFromImage normalization: (pixel - 127.5) * 0.007843.
+static const double kInputScale = 0.007843;
+static const double kInputMean = 127.5;
+// Each DetectionOutput row is [image_id, label, confidence, x1, y1, x2, y2].
+static const int kDetectionStride = 7;
+
+PersonDetector::PersonDetector(const PersonDetectorConfig& config)
+    : config_(config), frame_count_(0) {
+  float half_fov = config_.horizontal_fov_deg * M_PI / 360;
+  focal_px_ = (config_.frame_width / 2.0) / std::tan(half_fov);
+}
+
+bool PersonDetector::LoadModel() {
+  if (config_.native_engine) {
+    return LoadNativeNet(kInputSize, &native_net_) &&
+           (config_.roi_input_size <= 0 ||
+            LoadNativeNet(config_.roi_input_size, &native_roi_net_));
+  }
+  net_ = cv::dnn::readNetFromCaffe(config_.prototxt_path, config_.model_path);
+  if (config_.roi_input_size > 0) {
+    // A second instance, so alternating input sizes never reallocates.
+    roi_net_ =
+        cv::dnn::readNetFromCaffe(config_.prototxt_path, config_.model_path);
+  }
+  if (net_.empty() || (config_.roi_input_size > 0 && roi_net_.empty())) {
+    std::cerr << "person_detector: unable to load " << config_.prototxt_path
+              << " / " << config_.model_path << std::endl;
+    return false;
+  }
+  net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+  net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+  if (!roi_net_.empty()) {
+    roi_net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    roi_net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+  }
+  return true;
+}
+
+bool PersonDetector::LoadNativeNet(int input_size, ssd::Net* net) {
+  std::string error;
+  net->set_input_size(input_size, input_size);
+  if (!net->Load(config_.prototxt_path, config_.model_path, &error)) {
+    std::cerr << "person_detector: " << error << std::endl;
+    return false;
+  }
+  if (!config_.int8_calibration_path.empty()) {
+    std::map<std::string, float> ranges;
+    if (!ssd::ReadCalibrationTable(config_.int8_calibration_path, &ranges,
+                                   &error)) {
+      std::cerr << "person_detector: " << error << std::endl;
+      return false;
+    }
+    int converted = net->EnableInt8(ranges);
+    std::clog << "person_detector: " << converted
+              << " convolutions running in INT8" << std::endl;
+  }
+  // Postprocess() only ever looks at confident person rows.
+  if (!net->KeepOnlyClass(kPersonClassId, config_.confidence_threshold)) {
+    std::cerr << "person_detector: model has no person DetectionOutput"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool PersonDetector::Init() {
+  if (!LoadModel()) {
+    return false;
+  }
+  if (!camera_.open(config_.camera_index)) {
+    std::cerr << "person_detector: unable to open camera "
+              << config_.camera_index << std::endl;
+    return false;
+  }
+  // Keep only the newest frame queued so Detect() never sees a frame that
+  // was captured before the robot's last move.
+  camera_.set(cv::CAP_PROP_BUFFERSIZE, 1);
+
+  for (int i = 0; i < config_.warmup_frames; i++) {
+    camera_.read(frame_);
+  }
+  // Run one forward pass so lazy allocations inside the network happen
+  // before the first real detection.
+  if (!frame_.empty()) {
+    Detect(frame_);
+  }
+  return true;
+}
+
+PersonDetection PersonDetector::Detect() {
+  int64_t timestamp_ns = MonotonicNowNs();
+  if (!camera_.read(frame_) || frame_.empty()) {
+    std::cerr << "person_detector: camera read failed" << std::endl;
+    return PersonDetection();
+  }
+  PersonDetection result = Detect(frame_);
+  result.frame_id = ++frame_count_;
+  result.timestamp_ns = timestamp_ns;
+  return result;
+}
+
+PersonDetection PersonDetector::Detect(const cv::Mat& frame) {
+  cv::Size frame_size;
+  cv::Mat blob = Preprocess(frame, &frame_size);
+  return Postprocess(Infer(blob), frame_size);
+}
+
+cv::Mat PersonDetector::Preprocess(const cv::Mat& frame,
+                                   cv::Size* frame_size) const {
+  // Only the aspect ratio of the 400-wide frame matters here: box
+  // coordinates come back normalized and are scaled by |frame_size|.
+  frame_size->width = config_.frame_width;
+  frame_size->height = frame.rows * config_.frame_width / frame.cols;
+
+  cv::Mat net_input;
+  cv::resize(frame, net_input, cv::Size(kInputSize, kInputSize));
+  return cv::dnn::blobFromImage(net_input, kInputScale,
+                                cv::Size(kInputSize, kInputSize),
+                                cv::Scalar(kInputMean, kInputMean, kInputMean));
+}
+
+cv::Mat PersonDetector::PreprocessRoi(const cv::Mat& frame,
+                                      cv::Rect2f* window,
+                                      cv::Size* frame_size) const {
+  frame_size->width = config_.frame_width;
+  frame_size->height = frame.rows * config_.frame_width / frame.cols;
+  *window &= cv::Rect2f(0, 0, frame_size->width, frame_size->height);
+
+  // |window| is in resized-frame pixels; crop the same region of the
+  // full-resolution frame so the network sees it at native detail.
+  float scale = static_cast<float>(frame.cols) / config_.frame_width;
+  cv::Rect crop(cvRound(window->x * scale), cvRound(window->y * scale),
+                cvRound(window->width * scale),
+                cvRound(window->height * scale));
+  crop &= cv::Rect(0, 0, frame.cols, frame.rows);
+  int size = config_.roi_input_size;
+  cv::Mat net_input;
+  cv::resize(frame(crop), net_input, cv::Size(size, size));
+  return cv::dnn::blobFromImage(net_input, kInputScale, cv::Size(size, size),
+                                cv::Scalar(kInputMean, kInputMean, kInputMean));
+}
+
+cv::Mat PersonDetector::Infer(const cv::Mat& blob) {
+  bool roi = blob.size[2] != kInputSize;
+  if (config_.native_engine) {
+    ssd::Net& net = roi ? native_roi_net_ : native_net_;
+    ssd::Blob* input = net.input();
+    const float* pixels = blob.ptr<float>();
+    std::copy(pixels, pixels + input->count(), input->data.begin());
+    const ssd::Blob& output = net.Forward();
+    // Postprocess() only reads size[2] and the rows, so a 4-D header over a
+    // copy of the detections is all that is needed.
+    int sizes[4] = {1, 1, output.dim(2), output.dim(3)};
+    return cv::Mat(4, sizes, CV_32F, const_cast<float*>(output.data.data()))
+        .clone();
+  }
+  cv::dnn::Net& net = roi ? roi_net_ : net_;
+  net.setInput(blob);
+  return net.forward();
+}
+
+PersonDetection PersonDetector::Postprocess(const cv::Mat& output,
+                                            cv::Size frame_size) const {
+  return Postprocess(output,
+                     cv::Rect2f(0, 0, frame_size.width, frame_size.height));
+}
+
+PersonDetection PersonDetector::Postprocess(const cv::Mat& output,
+                                            const cv::Rect2f& window) const {
+  PersonDetection result;
+  float w = window.width;
+  float h = window.height;
+
+  // Output blob is 1 x 1 x N x 7.
+  int count = output.size[2];
+  const float* rows = output.ptr<float>();
+  for (int i = 0; i < count; i++) {
+    const float* row = rows + i * kDetectionStride;
+    int label = static_cast<int>(row[1]);
+    float confidence = row[2];
+    if (label != kPersonClassId || confidence < config_.confidence_threshold ||
+        confidence <= result.confidence) {
+      continue;
+    }
+    float start_x = window.x + row[3] * w;
+    float start_y = window.y + row[4] * h;
+    float end_x = window.x + row[5] * w;
+    float end_y = window.y + row[6] * h;
+    result.found = true;
+    result.confidence = confidence;
+    result.x = (start_x + end_x) / 2;
+    result.y = (start_y + end_y) / 2;
+    result.width = end_x - start_x;
+    result.height = end_y - start_y;
+    result.distance = EstimateDistance(end_y - start_y);
+  }
+  return result;
+}
+
+float PersonDetector::EstimateDistance(float box_height_px) const {
+  if (box_height_px <= 1) {
+    return 0;
+  }
+  return config_.person_height_m * focal_px_ / box_height_px;
+}
+
+DetectionRecord ToDetectionRecord(const PersonDetection& detection) {
+  DetectionRecord record;
+  record.frame_id = detection.frame_id;
+  record.capture_time_ns = detection.timestamp_ns;
+  record.publish_time_ns = MonotonicNowNs();
+  record.x = detection.x;
+  record.y = detection.y;
+  record.width = detection.width;
+  record.height = detection.height;
+  record.distance = detection.distance;
+  record.confidence = detection.confidence;
+  record.found = detection.found ? 1 : 0;
+  return record;
+}
+
+PersonDetection FromDetectionRecord(const DetectionRecord& record) {
+  PersonDetection detection;
+  detection.found = record.found != 0;
+  detection.x = record.x;
+  detection.y = record.y;
+  detection.width = record.width;
+  detection.height = record.height;
+  detection.distance = record.distance;
+  detection.confidence = record.confidence;
+  detection.frame_id = record.frame_id;
+  detection.timestamp_ns = record.capture_time_ns;
+  return detection;
+}
@@ -0,0 +1,132 @@
+#ifndef SRC_ASSISTANT_PERSON_DETECTOR_H_
+#define SRC_ASSISTANT_PERSON_DETECTOR_H_
+
+#include <string>
+
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "assistant/detection_channel.h"
+#include "assistant/ssd_net.h"
+
+// Result of one detection pass over a single camera frame.
+struct PersonDetection {
+  // False when no person above the confidence threshold was seen.
+  bool found = false;
+  // Horizontal center of the person box, in pixels of the resized frame
+  // (0 = left edge, frame_width/2 = straight ahead).
+  float x = 0;
+  // Vertical center and size of the person box, in the same pixels.
+  float y = 0;
+  float width = 0;
+  float height = 0;
+  // Estimated range to the person in meters.
+  float distance = 0;
+  // Class confidence reported by the network, [0, 1].
+  float confidence = 0;
+  // Sequence number of the camera frame this result came from.
+  uint64_t frame_id = 0;
+  // CLOCK_MONOTONIC time the frame was captured.
+  int64_t timestamp_ns = 0;
+};
+
+// Conversions to and from the shared-memory wire format.
+DetectionRecord ToDetectionRecord(const PersonDetection& detection);
+PersonDetection FromDetectionRecord(const DetectionRecord& record);
+
+struct PersonDetectorConfig {
+  std::string prototxt_path;
+  std::string model_path;
+  // V4L2 index of the camera to keep open.
+  int camera_index = 0;
+  // Minimum probability for a detection to count as a person.
+  float confidence_threshold = 0.9;
+  // Frames are resized to this width before detection, matching the
+  // `imutils.resize(frame, width=400)` of the Python script.
+  int frame_width = 400;
+  // Frames grabbed and discarded at startup so auto exposure can settle.
+  int warmup_frames = 10;
+  // Horizontal field of view of the camera, in degrees.
+  float horizontal_fov_deg = 78;
+  // Assumed standing height of the subject, used for the range estimate.
+  float person_height_m = 1.7;
+  // Run the forward pass on the built-in ssd::Net engine instead of OpenCV
+  // DNN. Pre- and postprocessing are the same either way.
+  bool native_engine = false;
+  // With native_engine, a calibration table written by ssd_calibrate runs
+  // the convolutions on the INT8 kernels. Empty keeps FP32.
+  std::string int8_calibration_path;
+  // Side of the square network input for region-of-interest frames (see
+  // PreprocessRoi()); a second instance of the net is loaded at this size.
+  // 0 disables ROI inference.
+  int roi_input_size = 0;
+};
+
+// Long-lived MobileNet-SSD person detector. The network is loaded and the
+// camera is opened once in Init(); each Detect() then only grabs a frame and
+// runs a forward pass.
+//
+// Detect() is also available as three separate stages so a pipeline can run
+// them on different threads. Preprocess() and Postprocess() are const and
+// may run concurrently with Infer(); Infer() must only be called from one
+// thread at a time.
+class PersonDetector {
+ public:
+  explicit PersonDetector(const PersonDetectorConfig& config);
+
+  // Loads the network and opens the camera. Returns false on failure.
+  bool Init();
+
+  // Loads the network only, for callers that supply their own frames.
+  bool LoadModel();
+
+  // Grabs the newest camera frame and runs detection on it.
+  PersonDetection Detect();
+
+  // Runs detection on a frame that has already been captured.
+  PersonDetection Detect(const cv::Mat& frame);
+
+  // Builds the 1x3x300x300 network input for |frame| and reports the size
+  // of the resized frame that box coordinates will be expressed in.
+  cv::Mat Preprocess(const cv::Mat& frame, cv::Size* frame_size) const;
+
+  // Builds a roi_input_size network input from only |window| of |frame|,
+  // given in resized-frame pixels and clipped to the frame. The crop is
+  // taken from the full-resolution frame, so a distant person covers more
+  // of the network input than in a full-frame pass, for less compute.
+  cv::Mat PreprocessRoi(const cv::Mat& frame, cv::Rect2f* window,
+                        cv::Size* frame_size) const;
+
+  // Runs the forward pass and returns the raw DetectionOutput blob. Blobs
+  // from PreprocessRoi() go to the ROI-sized net.
+  cv::Mat Infer(const cv::Mat& blob);
+
+  // Picks the most confident person out of the DetectionOutput blob.
+  PersonDetection Postprocess(const cv::Mat& output,
+                              cv::Size frame_size) const;
+  // Same for the output of a PreprocessRoi() blob covering |window|.
+  PersonDetection Postprocess(const cv::Mat& output,
+                              const cv::Rect2f& window) const;
+
+  const PersonDetectorConfig& config() const { return config_; }
+
+ private:
+  // Estimates range from the pixel height of the person box with a pinhole
+  // camera model.
+  float EstimateDistance(float box_height_px) const;
+  bool LoadNativeNet(int input_size, ssd::Net* net);
+
+  PersonDetectorConfig config_;
+  cv::dnn::Net net_;
+  cv::dnn::Net roi_net_;
+  ssd::Net native_net_;
+  ssd::Net native_roi_net_;
+  cv::VideoCapture camera_;
+  cv::Mat frame_;
+  uint64_t frame_count_;
+  // Focal length in pixels of the resized frame.
+  float focal_px_;
+};
+
+#endif  // SRC_ASSISTANT_PERSON_DETECTOR_H_
@@ -0,0 +1,121 @@
+// Compares the latency of the in-process PersonDetector against launching
+// the Python detection script once per detection, as the follow loop used to.
+//
+// Usage: ./person_detector_bench [--iterations N] [--script <command>]
+//                                [--prototxt <path>] [--model <path>]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "assistant/person_detector.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char kDefaultPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDefaultModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+static const char kDefaultScript[] =
+    "python /home/pi/real-time-object-detection/person_detection.py "
+    "--prototxt "
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt "
+    "--model /home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+
+static double ElapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+static void PrintStats(const std::string& name, std::vector<double> samples) {
+  if (samples.empty()) {
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double s : samples) {
+    sum += s;
+  }
+  std::cout << name << ": n=" << samples.size()
+            << " mean=" << sum / samples.size() << "ms"
+            << " p50=" << samples[samples.size() / 2] << "ms"
+            << " max=" << samples.back() << "ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  int iterations = 20;
+  std::string script = kDefaultScript;
+  PersonDetectorConfig config;
+  config.prototxt_path = kDefaultPrototxt;
+  config.model_path = kDefaultModel;
+
+  const struct option long_options[] = {
+      {"iterations", required_argument, nullptr, 'n'},
+      {"script", required_argument, nullptr, 's'},
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:s:p:m:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        iterations = std::atoi(optarg);
+        break;
+      case 's':
+        script = optarg;
+        break;
+      case 'p':
+        config.prototxt_path = optarg;
+        break;
+      case 'm':
+        config.model_path = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  // In-process detector: cold start covers model load, camera open and
+  // warm-up plus the first detection.
+  Clock::time_point start = Clock::now();
+  PersonDetector detector(config);
+  if (!detector.Init()) {
+    return -1;
+  }
+  detector.Detect();
+  double cold_start = ElapsedMs(start);
+
+  std::vector<double> steady;
+  for (int i = 0; i < iterations; i++) {
+    start = Clock::now();
+    detector.Detect();
+    steady.push_back(ElapsedMs(start));
+  }
+
+  // The script pays interpreter start, model load and camera warm-up on
+  // every call, so every call is a cold start.
+  std::vector<double> scripted;
+  for (int i = 0; i < iterations; i++) {
+    start = Clock::now();
+    if (system(script.c_str()) != 0) {
+      std::cerr << "script exited with an error" << std::endl;
+    }
+    scripted.push_back(ElapsedMs(start));
+  }
+
+  std::cout << "PersonDetector cold start: " << cold_start << "ms"
+            << std::endl;
+  PrintStats("PersonDetector steady state", steady);
+  PrintStats("python script per detection", scripted);
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include "assistant/robot_commands.h"
+
+#include "assistant/trace.h"
+
+const std::vector<std::string>& RobotCommands() {
+  static const std::vector<std::string> commands = {
+      "come to me", "follow me", "go forward",  "go backward",
+      "turn right", "turn left", "turn around", "stop"};
+  return commands;
+}
+
+bool IsRobotCommand(const std::string& transcript) {
+  for (const std::string& command : RobotCommands()) {
+    if (transcript == command) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RunRobotCommand(const std::string& transcript, MotionController* motion,
+                     FollowBehavior* follow,
+                     const std::function<bool()>& keep_going) {
+  if (transcript == "come to me") {
+    follow->Approach(keep_going);
+  } else if (transcript == "follow me") {
+    follow->Follow(keep_going);
+  } else if (transcript == "go forward") {
+    motion->Drive(6);
+  } else if (transcript == "go backward") {
+    motion->Drive(-6);
+  } else if (transcript == "turn right") {
+    motion->Turn(90, TurnType::kPivot);
+  } else if (transcript == "turn left") {
+    motion->Turn(-90, TurnType::kPivot);
+  } else if (transcript == "turn around") {
+    motion->Turn(-180, TurnType::kPivot);
+  } else if (transcript == "stop") {
+    motion->Halt();
+  }
+}
+
+// Commands waiting for the command loop; when more pile up, the oldest
+// are dropped, as each one would preempt the one before anyway.
+static const size_t kPendingCommands = 4;
+
+CommandRunner::CommandRunner(MotionController* motion, FollowBehavior* follow)
+    : motion_(motion),
+      follow_(follow),
+      executor_(nullptr),
+      commands_(kPendingCommands),
+      busy_(false) {}
+
+CommandRunner::~CommandRunner() { Stop(); }
+
+void CommandRunner::Start(TaskExecutor* executor) {
+  executor_ = executor;
+  loop_ = executor_->Post([this](const CancelToken&) { CommandLoop(); });
+}
+
+void CommandRunner::Stop() {
+  commands_.Close();
+  loop_.Wait();
+}
+
+void CommandRunner::Post(const std::string& transcript) {
+  commands_.Push(transcript);
+}
+
+void CommandRunner::CommandLoop() {
+  std::string transcript;
+  while (commands_.Pop(&transcript)) {
+    TRACE_SCOPE("command.run");
+    EndBehavior();
+    if (transcript == "come to me" || transcript == "follow me") {
+      busy_ = true;
+      behavior_ = executor_->Post([this, transcript](const CancelToken& token) {
+        RunRobotCommand(transcript, motion_, follow_,
+                        [&token] { return !token.cancelled(); });
+        busy_ = false;
+      });
+    } else {
+      RunRobotCommand(transcript, motion_, follow_, [] { return true; });
+    }
+  }
+  EndBehavior();
+}
+
+void CommandRunner::EndBehavior() {
+  // Within a poll and a control period: the behavior halts its move.
+  behavior_.Cancel();
+  behavior_.Wait();
+  behavior_ = TaskHandle();
+  busy_ = false;
+}
+
+CommandSpeculator::CommandSpeculator(MotionController* motion,
+                                     DetectionSource* detections,
+                                     const CommandRunner* commands,
+                                     const RecognizerConfig& config)
+    : motion_(motion),
+      detections_(detections),
+      commands_(commands),
+      recognizer_(RobotCommands(), config),
+      speculated_(-1),
+      activated_(false) {}
+
+bool CommandSpeculator::BehaviorRunning() const {
+  return commands_ != nullptr && commands_->busy();
+}
+
+void CommandSpeculator::OnPartial(const std::vector<SpeechResult>& results) {
+  // Only a final command takes over from a running behavior.
+  if (BehaviorRunning()) {
+    return;
+  }
+  int command = recognizer_.Match(results);
+  // An ambiguous or unmatched hypothesis keeps the current guess; the
+  // final result settles it.
+  if (command < 0 || command == speculated_) {
+    return;
+  }
+  Cancel();
+  Start(command);
+}
+
+void CommandSpeculator::OnFinal(const std::string& transcript) {
+  if (speculated_ >= 0 && recognizer_.command(speculated_) == transcript) {
+    TRACE_INSTANT("speculation.confirm");
+    stats_.confirmed++;
+    speculated_ = -1;
+    activated_ = false;
+    return;
+  }
+  Cancel();
+}
+
+void CommandSpeculator::Cancel() {
+  if (speculated_ < 0) {
+    return;
+  }
+  TRACE_INSTANT("speculation.cancel");
+  const std::string& command = recognizer_.command(speculated_);
+  if (command == "come to me" || command == "follow me") {
+    // A behavior started since has the detector on for itself.
+    if (activated_ && !BehaviorRunning()) {
+      detections_->SetActive(false);
+    }
+  } else if (command.compare(0, 5, "turn ") == 0) {
+    motion_->Halt();
+  }
+  // A halt for "stop" stays: stopping is never wrong.
+  stats_.cancelled++;
+  speculated_ = -1;
+  activated_ = false;
+}
+
+void CommandSpeculator::Start(int command) {
+  const std::string& transcript = recognizer_.command(command);
+  if (transcript == "come to me" || transcript == "follow me") {
+    detections_->SetActive(true);
+    activated_ = true;
+  } else if (transcript == "turn right") {
+    motion_->StartTurn(90, TurnType::kPivot);
+  } else if (transcript == "turn left") {
+    motion_->StartTurn(-90, TurnType::kPivot);
+  } else if (transcript == "turn around") {
+    motion_->StartTurn(-180, TurnType::kPivot);
+  } else if (transcript == "stop") {
+    motion_->Halt();
+  } else {
+    // Nothing about driving is low-risk.
+    return;
+  }
+  TRACE_INSTANT("speculation.start");
+  stats_.started++;
+  speculated_ = command;
+}
@@ -0,0 +1,127 @@
+#ifndef SRC_ASSISTANT_ROBOT_COMMANDS_H_
+#define SRC_ASSISTANT_ROBOT_COMMANDS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "assistant/command_recognizer.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/latest_queue.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_hal.h"
+#include "assistant/task_executor.h"
+
+// True for the transcripts the robot acts on: "come to me", "follow me",
+// "go forward", "go backward", "turn right", "turn left", "turn around"
+// and "stop".
+bool IsRobotCommand(const std::string& transcript);
+
+// The transcripts above.
+const std::vector<std::string>& RobotCommands();
+
+// Acts on a robot command. Moves are queued on |motion| and return at
+// once; "come to me" and "follow me" block in |follow| until done or until
+// |keep_going| returns false. Shared by run_assistant_audio and
+// flight_replay so a replayed command does exactly what the live one did.
+void RunRobotCommand(const std::string& transcript, MotionController* motion,
+                     FollowBehavior* follow,
+                     const std::function<bool()>& keep_going);
+
+// Runs robot commands as tasks on an executor, so whoever posts them never
+// waits: moves go straight to the motion controller, and "come to me" and
+// "follow me" run as cancellable tasks. A newer command cancels a running
+// behavior, which halts the robot, before it runs: "stop" ends a follow.
+class CommandRunner {
+ public:
+  CommandRunner(MotionController* motion, FollowBehavior* follow);
+  // Stop().
+  ~CommandRunner();
+
+  // Posts the command loop on |executor|, which also runs the behaviors
+  // and needs a thread for each.
+  void Start(TaskExecutor* executor);
+
+  // Cancels the running behavior and ends the command loop. Must come
+  // before the executor shuts down, which would wait for the loop.
+  void Stop();
+
+  // Queues |transcript|, one of RobotCommands(), and returns at once.
+  void Post(const std::string& transcript);
+
+  // A behavior is running or about to.
+  bool busy() const { return busy_.load(); }
+
+ private:
+  void CommandLoop();
+  void EndBehavior();
+
+  MotionController* motion_;
+  FollowBehavior* follow_;
+  TaskExecutor* executor_;
+  LatestQueue<std::string> commands_;
+  TaskHandle loop_;
+  // Only used by the command loop.
+  TaskHandle behavior_;
+  std::atomic<bool> busy_;
+};
+
+struct SpeculationStats {
+  // Speculative actions started, and how the final result settled them.
+  uint64_t started = 0;
+  uint64_t confirmed = 0;
+  uint64_t cancelled = 0;
+};
+
+// Starts the low-risk part of a robot command while it is still being
+// spoken, from the partial transcripts, instead of waiting for the end of
+// the utterance and the final result:
+//
+//   "come to me", "follow me"               switch the detector on
+//   "turn right", "turn left", "turn around"  begin the turn slowly
+//   "stop"                                  halt
+//
+// Driving is not started early. The final result confirms the guess, and
+// RunRobotCommand() then carries on from it, or cancels it: the detector
+// goes back off, a begun turn halts. Nothing is started while a behavior
+// of |commands| runs, as it owns the detector and the moves, and a
+// cancelled guess only switches the detector off if it switched it on and
+// no behavior has taken it over since. Used from the response loop only.
+class CommandSpeculator {
+ public:
+  // |commands| may be null when no behaviors run.
+  CommandSpeculator(MotionController* motion, DetectionSource* detections,
+                    const CommandRunner* commands,
+                    const RecognizerConfig& config);
+
+  // The speech results of each response that has no final result.
+  void OnPartial(const std::vector<SpeechResult>& results);
+
+  // The final transcript, before it is acted on.
+  void OnFinal(const std::string& transcript);
+
+  // Drops whatever was started, e.g. when a turn ends without a final
+  // result.
+  void Cancel();
+
+  const SpeculationStats& stats() const { return stats_; }
+
+ private:
+  void Start(int command);
+  bool BehaviorRunning() const;
+
+  MotionController* motion_;
+  DetectionSource* detections_;
+  const CommandRunner* commands_;
+  CommandRecognizer recognizer_;
+  // Index of the command acted on so far, or -1.
+  int speculated_;
+  // The guess switched the detector on.
+  bool activated_;
+  SpeculationStats stats_;
+};
+
+#endif  // SRC_ASSISTANT_ROBOT_COMMANDS_H_
@@ -0,0 +1,17 @@
+#include "assistant/robot_hal.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include "assistant/time_util.h"
+
+int64_t MonotonicClock::NowNs() { return MonotonicNowNs(); }
+
+void MonotonicClock::SleepUntilNs(int64_t deadline_ns) {
+  struct timespec wake;
+  wake.tv_sec = deadline_ns / 1000000000LL;
+  wake.tv_nsec = deadline_ns % 1000000000LL;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) ==
+         EINTR) {
+  }
+}
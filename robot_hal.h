@@ -0,0 +1,97 @@
+#ifndef SRC_ASSISTANT_ROBOT_HAL_H_
+#define SRC_ASSISTANT_ROBOT_HAL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "assistant/detection_channel.h"
+
+// Interfaces between the control code and the robot's hardware. The
+// MATRIX implementations live in matrix_robot.h (plus MotorDriver and
+// VisionDetectionSource); robot_sim.h implements the rest on a
+// simulated robot whose time runs as fast as the code allows, and
+// WavMicArray (wav_file.h) plays a recording back as the microphones.
+
+// Time source for everything that sleeps or timestamps. Threads that sleep
+// on a clock must be announced with AddThread() before they start and
+// RemoveThread() when they end, so a simulated clock knows when every
+// thread is waiting and time may jump ahead.
+class Clock {
+ public:
+  virtual ~Clock() {}
+  // Nanoseconds on a monotonic time line.
+  virtual int64_t NowNs() = 0;
+  // Returns at once if |deadline_ns| has passed.
+  virtual void SleepUntilNs(int64_t deadline_ns) = 0;
+  void SleepForNs(int64_t duration_ns) { SleepUntilNs(NowNs() + duration_ns); }
+  virtual void AddThread() {}
+  virtual void RemoveThread() {}
+};
+
+// CLOCK_MONOTONIC, slept on with clock_nanosleep.
+class MonotonicClock : public Clock {
+ public:
+  int64_t NowNs() override;
+  void SleepUntilNs(int64_t deadline_ns) override;
+};
+
+// The two drive wheels of the H-bridge.
+class MotorPort {
+ public:
+  virtual ~MotorPort() {}
+  // Signed duty cycles in percent; negative runs a wheel backwards.
+  virtual void Set(float duty_a, float duty_b) = 0;
+};
+
+struct ImuReading {
+  // Counter-clockwise positive, degrees and degrees per second.
+  float gyro_z_deg_s;
+  float yaw_deg;
+};
+
+class ImuPort {
+ public:
+  virtual ~ImuPort() {}
+  // Blocks for as long as the bus read takes.
+  virtual bool Read(ImuReading* reading) = 0;
+};
+
+struct LedColor {
+  uint8_t red = 0;
+  uint8_t green = 0;
+  uint8_t blue = 0;
+  uint8_t white = 0;
+};
+
+// The ring of LEDs around the board.
+class LedPort {
+ public:
+  virtual ~LedPort() {}
+  virtual int Count() const = 0;
+  // |leds| holds Count() colors, clockwise from LED 0.
+  virtual void Write(const std::vector<LedColor>& leds) = 0;
+};
+
+// The microphone array.
+class MicArrayPort {
+ public:
+  virtual ~MicArrayPort() {}
+  virtual int Channels() const = 0;
+  virtual int SampleRate() const = 0;
+  // Blocks for the next block of samples, interleaved by channel. False
+  // once there are no more, e.g. at the end of a recording.
+  virtual bool Read(std::vector<int16_t>* samples) = 0;
+};
+
+// Person detections, one record per processed camera frame.
+class DetectionSource {
+ public:
+  virtual ~DetectionSource() {}
+  // Detection only needs to run while a follow behavior uses it.
+  virtual void SetActive(bool active) = 0;
+  // Copies the newest record; false if there has been none yet.
+  virtual bool ReadLatest(DetectionRecord* record) = 0;
+};
+
+#endif  // SRC_ASSISTANT_ROBOT_HAL_H_
@@ -1,207 +1,122 @@
 #include "assistant/robot_movement.h"
 #include <iostream>
+#include "assistant/heading_controller.h"
+#include "assistant/trace.h"
 
-// GPIOOutputMode is 1
-const uint16_t GPIOOutputMode = 1;
-// GPIOInputMode is 0
-const uint16_t GPIOInputMode = 0;
-// PWMFunction is 1
-const uint16_t PWMFunction = 1;
-
-// Holds desired GPIO pin [0-15]
-const uint16_t ENA = 0;
-const uint16_t IN1 = 1;
-const uint16_t IN2 = 2;
-const uint16_t IN3 = 3;
-const uint16_t IN4 = 4;
-const uint16_t ENB = 5;
-
-void gpioInit(matrix_hal::GPIOControl *gpio) {
-	// Set pin mode to output
-	gpio->SetMode(ENA, GPIOOutputMode);
-	gpio->SetMode(IN1, GPIOOutputMode);
-	gpio->SetMode(IN2, GPIOOutputMode);
-	gpio->SetMode(IN3, GPIOOutputMode);
-	gpio->SetMode(IN4, GPIOOutputMode);
-	gpio->SetMode(ENB, GPIOOutputMode);
-  
-	// Set pin function to PWM
-	gpio->SetFunction(ENA, PWMFunction);
-	gpio->SetFunction(ENB, PWMFunction);
-}
-
-bool movementStraight(matrix_hal::GPIOControl *gpio, 
-					  matrix_hal::IMUData *imu_data,
-					  matrix_hal::IMUSensor *imu_sensor, 
+bool movementStraight(MotorPort *motors, 
+					  ImuPort *imu,
+					  Clock *clock, 
 					  char direction, float distance) {
-	// Set pin_out to output pin_out_state
-	if(direction == 'f') {
-		gpio->SetGPIOValue(IN1, 1);
-		gpio->SetGPIOValue(IN2, 0);
-		gpio->SetGPIOValue(IN3, 1);
-		gpio->SetGPIOValue(IN4, 0);
-	} else if (direction == 'b') {
-		gpio->SetGPIOValue(IN1, 0);
-		gpio->SetGPIOValue(IN2, 1);
-		gpio->SetGPIOValue(IN3, 0);
-		gpio->SetGPIOValue(IN4, 1);
-	}
-
+	TRACE_SCOPE("movement.straight");
 	// Velocity ~ 1.25 m/s
 	// Distance to travel => Time to travel
 	float duration = distance/1.25;
 
-	// Holds desired PWM frequency
-	float freqA = 50;
-	float freqB = 50;
 	// Holds desired PWM duty percentage
 	float percentA = 30;
 	float percentB = 30;
-	gpio->SetPWM(freqA, percentA, ENA);
-	gpio->SetPWM(freqB, percentB, ENB);
+	float sign = direction == 'b' ? -1 : 1;
+	motors->Set(sign*percentA, sign*percentB);
 	
-	// read IMU and get current yaw
-	imu_sensor->Read(imu_data);
-	float orgYaw = imu_data->yaw;
+	// read IMU and hold the current yaw
+	ImuReading imu_data;
+	imu->Read(&imu_data);
+	HeadingController heading((HeadingConfig()));
+	heading.Reset(imu_data.yaw_deg);
 
-	// each loop lasts approx. 50ms => # of loops = (1/50ms)*duration [s]
-	if (direction == 'f') {
-		for (int i = 0; i < duration*20; i++) {
-			imu_sensor->Read(imu_data);
-			float newYaw = imu_data->yaw;
-			if(newYaw == orgYaw) { // no correction needed
-				percentA = 30;
-				percentB = 30;
-				gpio->SetPWM(freqA, percentA, ENA);
-				gpio->SetPWM(freqB, percentB, ENB);
-			} else if (newYaw < orgYaw) { // correction to the right needed
-				percentA = 40;
-				percentB = 25;
-				gpio->SetPWM(freqA, percentA, ENA);
-				gpio->SetPWM(freqB, percentB, ENB);
-			} else if (newYaw > orgYaw) { // correction to the left needed
-				percentA = 25;
-				percentB = 40;
-				gpio->SetPWM(freqA, percentA, ENA);
-				gpio->SetPWM(freqB, percentB, ENB);
-			}
-			usleep(50000);
-		}
-	} else if (direction == 'b') {
-		for (int i = 0; i < duration*20; i++) {
-			imu_sensor->Read(imu_data);
-			float newYaw = imu_data->yaw;
-			if(newYaw == orgYaw) { // no correction needed
-				percentA = 30;
-				percentB = 30;
-				gpio->SetPWM(freqA, percentA, ENA);
-				gpio->SetPWM(freqB, percentB, ENB);
-			} else if (newYaw > orgYaw) { // correction to the left needed
-				percentA = 32;
-				percentB = 28;
-				gpio->SetPWM(freqA, percentA, ENA);
-				gpio->SetPWM(freqB, percentB, ENB);
-			} else if (newYaw < orgYaw) { // correction to the right needed
-				percentA = 28;
-				percentB = 32;
-				gpio->SetPWM(freqA, percentA, ENA);
-				gpio->SetPWM(freqB, percentB, ENB);
-			}
-			usleep(50000);
-		}
+	// Drive until the clock says the duration is up; each loop takes the
+	// 20 ms slept plus the blocking IMU read, so counting loops overshoots
+	const int64_t start_ns = clock->NowNs();
+	const int64_t end_ns = start_ns + static_cast<int64_t>(duration*1e9);
+	int64_t last_ns = start_ns;
+	while (clock->NowNs() < end_ns) {
+		TRACE_INSTANT("movement.straight.step");
+		imu->Read(&imu_data);
+		// PID correction, shared by both directions (see HeadingController),
+		// over the time that really passed since the last one
+		int64_t now_ns = clock->NowNs();
+		float correction = heading.Update(imu_data.yaw_deg,
+		                                  (now_ns - last_ns)/1e9f, nullptr);
+		last_ns = now_ns;
+		DifferentialDuty(sign*30, correction, &percentA, &percentB);
+		motors->Set(percentA, percentB);
+		clock->SleepForNs(20000000);
 	}
 	
-	percentA = 0;
-	percentB = 0;
-	gpio->SetPWM(freqA, percentA, ENA);
-	gpio->SetPWM(freqB, percentB, ENB);
+	motors->Set(0, 0);
 	
 	return true;
 }
 
-bool movementTurn (matrix_hal::GPIOControl *gpio, 
-				   matrix_hal::IMUData *imu_data,
-				   matrix_hal::IMUSensor *imu_sensor,
+bool movementTurn (MotorPort *motors, 
+				   ImuPort *imu,
+				   Clock *clock,
 				   char direction, char turnType, int setAngle) {
-	// Holds desired PWM frequency
-	float freqA = 50;
-	float freqB = 50;
+	TRACE_SCOPE("movement.turn");
 	// Holds desired PWM duty percentage
 	float percentA = 30;
 	float percentB = 30;
 	
 	if (direction == 'r') {
-		// Set pin_out to output pin_out_state
+		// Wheel A backwards for a pivot, stopped for a swing
 		if (turnType == 'p') {
-			gpio->SetGPIOValue(IN1, 0);
-			gpio->SetGPIOValue(IN2, 1);
-			gpio->SetGPIOValue(IN3, 1);
-			gpio->SetGPIOValue(IN4, 0);
+			motors->Set(-percentA, percentB);
 		} else if (turnType == 's') {
-			gpio->SetGPIOValue(IN1, 0);
-			gpio->SetGPIOValue(IN2, 0);
-			gpio->SetGPIOValue(IN3, 1);
-			gpio->SetGPIOValue(IN4, 0);
+			motors->Set(0, percentB);
 		}
-		
-		gpio->SetPWM(freqA, percentA, ENA);
-		gpio->SetPWM(freqB, percentB, ENB);
 
 		float angle = 0;
+		int64_t last_ns = clock->NowNs();
+		ImuReading imu_data;
 
 		// Endless loop
 		while (angle > -1*setAngle) {
+		  TRACE_INSTANT("movement.turn.step");
 		  // Overwrites imu_data with new data from IMU sensor
-		  imu_sensor->Read(imu_data);
+		  imu->Read(&imu_data);
 		  
-		  // Read Gyroscope Z axis & compute angle of rotation (yaw)
-		  float gyro_Z = imu_data->gyro_z;
-		  angle += gyro_Z*0.02*8/5;
+		  // Read Gyroscope Z axis & compute angle of rotation (yaw) over the
+		  // time that really passed, which is well over the 20 ms slept
+		  int64_t now_ns = clock->NowNs();
+		  float gyro_Z = imu_data.gyro_z_deg_s;
+		  angle += gyro_Z*(now_ns - last_ns)/1e9f;
+		  last_ns = now_ns;
 		  // Sleep for 20000 microseconds
-		  usleep(20000);
+		  clock->SleepForNs(20000000);
 		}
 		std::cout << "Angle of rotation = " << angle << std::endl;
 	} else if (direction == 'l') {
+		// Wheel B backwards for a pivot, stopped for a swing
 		if (turnType == 'p') {
-			// Set pin_out to output pin_out_state
-			gpio->SetGPIOValue(IN1, 1);
-			gpio->SetGPIOValue(IN2, 0);
-			gpio->SetGPIOValue(IN3, 0);
-			gpio->SetGPIOValue(IN4, 1);
+			motors->Set(percentA, -percentB);
 		} else if (turnType == 's') {
-			gpio->SetGPIOValue(IN1, 1);
-			gpio->SetGPIOValue(IN2, 0);
-			gpio->SetGPIOValue(IN3, 0);
-			gpio->SetGPIOValue(IN4, 0);
-			
+			motors->Set(percentA, 0);
 		}
-		
-		gpio->SetPWM(freqA, percentA, ENA);
-		gpio->SetPWM(freqB, percentB, ENB);
 
 		float angle = 0;
+		int64_t last_ns = clock->NowNs();
+		ImuReading imu_data;
 
 		// Endless loop
 		while (angle < setAngle) {
+		  TRACE_INSTANT("movement.turn.step");
 		  // Overwrites imu_data with new data from IMU sensor
-		  imu_sensor->Read(imu_data);
+		  imu->Read(&imu_data);
 		  
-		  // Read Gyroscope Z axis & compute angle of rotation (yaw)
-		  float gyro_Z = imu_data->gyro_z;
-		  angle += gyro_Z*0.02*8/5;
-		  std::cout << "Angle of rotation = " << angle << std::endl;
+		  // Read Gyroscope Z axis & compute angle of rotation (yaw) over the
+		  // time that really passed, which is well over the 20 ms slept
+		  int64_t now_ns = clock->NowNs();
+		  float gyro_Z = imu_data.gyro_z_deg_s;
+		  angle += gyro_Z*(now_ns - last_ns)/1e9f;
+		  last_ns = now_ns;
 		  // Sleep for 20000 microseconds
-		  usleep(20000);
+		  clock->SleepForNs(20000000);
 		}
 		std::cout << "Angle of rotation = " << angle << std::endl;
 	}
 	
 	// turn off motors
-	percentA = 0;
-	percentB = 0;
-	
-	gpio->SetPWM(freqA, percentA, ENA);
-	gpio->SetPWM(freqB, percentB, ENB);
+	motors->Set(0, 0);
 	
 	return true;
 }
@@ -1,20 +1,18 @@
-// System calls
-#include <unistd.h>
-// Interfaces with GPIO
-#include "driver/gpio_control.h"
-// Interfaces with IMU sensor
-#include "driver/imu_sensor.h"
-// Holds data from IMU sensor
-#include "driver/imu_data.h"
-// Communicates with MATRIX device
-#include "driver/matrixio_bus.h"
+#ifndef SRC_ASSISTANT_ROBOT_MOVEMENT_H_
+#define SRC_ASSISTANT_ROBOT_MOVEMENT_H_
 
-void gpioInit(matrix_hal::GPIOControl *gpio);
-bool movementStraight(matrix_hal::GPIOControl *gpio, 
-					  matrix_hal::IMUData *imu_data,
-					  matrix_hal::IMUSensor *imu_sensor, 
+// Motor, IMU and clock interfaces
+#include "assistant/robot_hal.h"
+
+// Blocking moves, on any robot_hal.h backend (MotorDriver and MatrixImu on
+// the robot, robot_sim.h off it)
+bool movementStraight(MotorPort *motors, 
+					  ImuPort *imu,
+					  Clock *clock, 
 					  char direction, float distance);
-bool movementTurn (matrix_hal::GPIOControl *gpio, 
-				   matrix_hal::IMUData *imu_data,
-				   matrix_hal::IMUSensor *imu_sensor,
+bool movementTurn (MotorPort *motors, 
+				   ImuPort *imu,
+				   Clock *clock,
 				   char direction, char turnType, int setAngle);
+
+#endif  // SRC_ASSISTANT_ROBOT_MOVEMENT_H_
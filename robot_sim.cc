@@ -0,0 +1,277 @@
+#include "assistant/robot_sim.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "assistant/heading_controller.h"
+
+static const int64_t kPhysicsStepNs = 1000000;
+static const int kSimLeds = 35;
+
+SimClock::SimClock(int64_t start_ns)
+    : now_ns_(start_ns), threads_(0), next_ticket_(1), released_(0) {}
+
+int64_t SimClock::NowNs() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return now_ns_;
+}
+
+void SimClock::SleepUntilNs(int64_t deadline_ns) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (deadline_ns <= now_ns_) {
+    return;
+  }
+  uint64_t ticket = next_ticket_++;
+  sleepers_.insert(std::make_pair(deadline_ns, ticket));
+  AdvanceLocked();
+  wake_.wait(lock, [this, ticket] { return released_ == ticket; });
+  released_ = 0;
+}
+
+void SimClock::AddThread() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  threads_++;
+}
+
+void SimClock::RemoveThread() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  threads_--;
+  AdvanceLocked();
+}
+
+void SimClock::AdvanceLocked() {
+  // Wait for the last released thread to run, and for everyone to sleep.
+  if (released_ != 0 || sleepers_.empty() ||
+      static_cast<int>(sleepers_.size()) < threads_) {
+    return;
+  }
+  auto first = sleepers_.begin();
+  now_ns_ = std::max(now_ns_, first->first);
+  released_ = first->second;
+  sleepers_.erase(first);
+  wake_.notify_all();
+}
+
+SimRobot::SimRobot(Clock* clock, const SimConfig& config)
+    : clock_(clock),
+      config_(config),
+      motors_(this),
+      imu_(this),
+      leds_(this),
+      detections_(this),
+      random_(config.seed),
+      person_random_(config.seed + 1),
+      time_ns_(clock->NowNs()),
+      duty_a_(0),
+      duty_b_(0),
+      speed_a_(0),
+      speed_b_(0),
+      x_(0),
+      y_(0),
+      heading_deg_(0),
+      rate_deg_s_(0),
+      person_x_(config.person_start_ahead_m),
+      person_y_(config.person_start_left_m),
+      person_heading_deg_(0),
+      person_speed_(0),
+      person_leg_end_ns_(time_ns_),
+      camera_active_(false),
+      next_capture_ns_(time_ns_),
+      frame_id_(0),
+      latest_(),
+      motor_writes_(0),
+      led_writes_(0),
+      led_frame_(kSimLeds) {
+  speed_per_duty_ = config_.speed_at_30_m_s / 30;
+  track_width_m_ = 2 * config_.speed_at_30_m_s /
+                   (config_.pivot_rate_at_30_deg_s * M_PI / 180);
+}
+
+SimPose SimRobot::Pose() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AdvanceLocked();
+  SimPose pose;
+  pose.time_s = time_ns_ / 1e9;
+  pose.x = x_;
+  pose.y = y_;
+  pose.heading_deg = heading_deg_;
+  pose.person_x = person_x_;
+  pose.person_y = person_y_;
+  return pose;
+}
+
+void SimRobot::PlacePerson(double bearing_deg, double range_m) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  AdvanceLocked();
+  double direction = (heading_deg_ - bearing_deg) * M_PI / 180;
+  person_x_ = x_ + range_m * std::cos(direction);
+  person_y_ = y_ + range_m * std::sin(direction);
+}
+
+uint64_t SimRobot::motor_writes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return motor_writes_;
+}
+
+uint64_t SimRobot::led_writes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return led_writes_;
+}
+
+bool SimRobot::motors_on() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return duty_a_ != 0 || duty_b_ != 0;
+}
+
+bool SimRobot::camera_active() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return camera_active_;
+}
+
+std::vector<LedColor> SimRobot::LedFrame() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return led_frame_;
+}
+
+void SimRobot::AdvanceLocked() {
+  int64_t now_ns = clock_->NowNs();
+  const int64_t capture_period_ns =
+      static_cast<int64_t>(1e9 / config_.camera_fps);
+  while (time_ns_ + kPhysicsStepNs <= now_ns) {
+    if (camera_active_ && time_ns_ >= next_capture_ns_) {
+      Capture();
+      next_capture_ns_ += capture_period_ns;
+    }
+    Step(kPhysicsStepNs / 1e9);
+    time_ns_ += kPhysicsStepNs;
+  }
+  while (!in_flight_.empty() &&
+         in_flight_.front().publish_time_ns <= now_ns) {
+    latest_ = in_flight_.front();
+    in_flight_.pop_front();
+  }
+}
+
+void SimRobot::Step(double dt) {
+  double alpha =
+      config_.motor_lag_s > 0 ? std::min(1.0, dt / config_.motor_lag_s) : 1;
+  speed_a_ += (duty_a_ * speed_per_duty_ - speed_a_) * alpha;
+  speed_b_ += (duty_b_ * speed_per_duty_ * config_.wheel_b_gain - speed_b_) *
+              alpha;
+  // Wheel A faster turns counter-clockwise.
+  rate_deg_s_ = (speed_a_ - speed_b_) / track_width_m_ * 180 / M_PI;
+  double speed = (speed_a_ + speed_b_) / 2;
+  double heading = heading_deg_ * M_PI / 180;
+  x_ += speed * std::cos(heading) * dt;
+  y_ += speed * std::sin(heading) * dt;
+  heading_deg_ += rate_deg_s_ * dt;
+  StepPerson(dt);
+}
+
+void SimRobot::StepPerson(double dt) {
+  if (time_ns_ >= person_leg_end_ns_) {
+    std::uniform_real_distribution<double> turn(-90, 90);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::uniform_real_distribution<double> leg_s(2, 5);
+    person_heading_deg_ += turn(person_random_);
+    // One leg in five is spent standing still.
+    person_speed_ = unit(person_random_) < 0.2
+                        ? 0
+                        : config_.person_speed_m_s *
+                              (0.5 + 0.5 * unit(person_random_));
+    person_leg_end_ns_ =
+        time_ns_ + static_cast<int64_t>(leg_s(person_random_) * 1e9);
+  }
+  double heading = person_heading_deg_ * M_PI / 180;
+  person_x_ += person_speed_ * std::cos(heading) * dt;
+  person_y_ += person_speed_ * std::sin(heading) * dt;
+}
+
+void SimRobot::Capture() {
+  DetectionRecord record = DetectionRecord();
+  record.frame_id = ++frame_id_;
+  record.capture_time_ns = time_ns_;
+  record.publish_time_ns = time_ns_ + config_.detection_latency_ns;
+
+  double heading = heading_deg_ * M_PI / 180;
+  double dx = person_x_ - x_;
+  double dy = person_y_ - y_;
+  double ahead = dx * std::cos(heading) + dy * std::sin(heading);
+  double left = -dx * std::sin(heading) + dy * std::cos(heading);
+  double range = std::sqrt(dx * dx + dy * dy);
+  // Bearing right positive, as the tracker and MotionController use it.
+  double bearing = std::atan2(-left, ahead) * 180 / M_PI;
+  double focal =
+      config_.frame_width / 2 /
+      std::tan(config_.horizontal_fov_deg / 2 * M_PI / 180);
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::normal_distribution<double> pixel_noise(0, config_.detection_noise_px);
+  std::normal_distribution<double> range_noise(0, config_.range_noise);
+  if (ahead > 0.3 && range < config_.max_range_m &&
+      std::fabs(bearing) < config_.horizontal_fov_deg / 2 &&
+      unit(random_) < config_.detection_probability) {
+    record.found = 1;
+    record.x = config_.frame_width / 2 +
+               focal * std::tan(bearing * M_PI / 180) + pixel_noise(random_);
+    record.height = std::min<double>(
+        config_.frame_height, focal * config_.person_height_m / ahead);
+    record.width = 0.4f * record.height;
+    record.y = config_.frame_height / 2;
+    record.distance = range * (1 + range_noise(random_));
+    record.confidence = 0.8f;
+  }
+  in_flight_.push_back(record);
+}
+
+void SimRobot::Motors::Set(float duty_a, float duty_b) {
+  std::lock_guard<std::mutex> lock(robot_->mutex_);
+  robot_->AdvanceLocked();
+  robot_->duty_a_ = std::min(std::max(duty_a, -100.0f), 100.0f);
+  robot_->duty_b_ = std::min(std::max(duty_b, -100.0f), 100.0f);
+  robot_->motor_writes_++;
+}
+
+bool SimRobot::Imu::Read(ImuReading* reading) {
+  {
+    std::lock_guard<std::mutex> lock(robot_->mutex_);
+    robot_->AdvanceLocked();
+    const SimConfig& config = robot_->config_;
+    std::normal_distribution<float> gyro_noise(0, config.gyro_noise_deg_s);
+    std::normal_distribution<float> yaw_noise(0, config.yaw_noise_deg);
+    reading->gyro_z_deg_s = robot_->rate_deg_s_ + config.gyro_bias_deg_s +
+                            gyro_noise(robot_->random_);
+    reading->yaw_deg = AngleDifferenceDeg(
+        robot_->heading_deg_ + yaw_noise(robot_->random_), 0);
+  }
+  // The sample is latched at the start of the read, as on the bus.
+  robot_->clock_->SleepForNs(robot_->config_.imu_read_ns);
+  return true;
+}
+
+int SimRobot::Leds::Count() const { return kSimLeds; }
+
+void SimRobot::Leds::Write(const std::vector<LedColor>& leds) {
+  std::lock_guard<std::mutex> lock(robot_->mutex_);
+  robot_->led_frame_ = leds;
+  robot_->led_frame_.resize(kSimLeds);
+  robot_->led_writes_++;
+}
+
+void SimRobot::Detections::SetActive(bool active) {
+  std::lock_guard<std::mutex> lock(robot_->mutex_);
+  robot_->AdvanceLocked();
+  if (active && !robot_->camera_active_) {
+    robot_->next_capture_ns_ = robot_->time_ns_;
+  }
+  robot_->camera_active_ = active;
+}
+
+bool SimRobot::Detections::ReadLatest(DetectionRecord* record) {
+  std::lock_guard<std::mutex> lock(robot_->mutex_);
+  robot_->AdvanceLocked();
+  if (robot_->latest_.frame_id == 0) {
+    return false;
+  }
+  *record = robot_->latest_;
+  return true;
+}
@@ -0,0 +1,195 @@
+#ifndef SRC_ASSISTANT_ROBOT_SIM_H_
+#define SRC_ASSISTANT_ROBOT_SIM_H_
+
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "assistant/detection_channel.h"
+#include "assistant/robot_hal.h"
+
+// Virtual time that jumps straight to the next wakeup once every thread
+// using it is asleep, so the code under test runs as fast as the CPU
+// allows. Only one thread runs at a time: sleepers wake one by one in
+// deadline order (ties in the order they went to sleep), which keeps a
+// run reproducible.
+//
+// Every thread that sleeps on the clock, including the one driving the
+// simulation, must be counted with AddThread() while it does. A thread
+// that blocks on anything else (a future, a join) while counted stalls
+// time; wait by polling and sleeping on the clock instead.
+class SimClock : public Clock {
+ public:
+  explicit SimClock(int64_t start_ns = 1000000000LL);
+
+  int64_t NowNs() override;
+  void SleepUntilNs(int64_t deadline_ns) override;
+  void AddThread() override;
+  void RemoveThread() override;
+
+ private:
+  void AdvanceLocked();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  int64_t now_ns_;
+  int threads_;
+  uint64_t next_ticket_;
+  // (deadline, ticket) of each sleeping thread.
+  std::set<std::pair<int64_t, uint64_t>> sleepers_;
+  // Ticket of the sleeper allowed to run, or 0.
+  uint64_t released_;
+};
+
+struct SimConfig {
+  uint32_t seed = 1;
+
+  // Ground speed and pivot rate at 30% duty, as measured on the robot and
+  // assumed by MotionConfig. The effective track width follows from them
+  // (skid steering slips, so it is wider than the axle).
+  float speed_at_30_m_s = 1.25;
+  float pivot_rate_at_30_deg_s = 90;
+  // Wheel B is this much weaker than A, so straight driving drifts.
+  float wheel_b_gain = 0.97;
+  // First-order lag of the wheel speed behind the commanded duty.
+  float motor_lag_s = 0.15;
+
+  float gyro_bias_deg_s = 0.8;
+  float gyro_noise_deg_s = 0.5;
+  float yaw_noise_deg = 0.3;
+  // Time one IMU read blocks the caller, as the MATRIX bus read does.
+  int64_t imu_read_ns = 3000000;
+
+  // Camera and detector, matching PersonDetectorConfig and the tracker.
+  float frame_width = 400;
+  float frame_height = 300;
+  float horizontal_fov_deg = 78;
+  float camera_fps = 10;
+  // From capture to the record being published.
+  int64_t detection_latency_ns = 150000000;
+  float detection_probability = 0.9;
+  float detection_noise_px = 4;
+  float range_noise = 0.08;  // Fraction of the range.
+  float max_range_m = 12;
+
+  // The walking person: starts this far ahead and to the left, walks at up
+  // to |person_speed_m_s| and picks a new direction every few seconds,
+  // pausing now and then.
+  float person_start_ahead_m = 3;
+  float person_start_left_m = 0.5;
+  float person_speed_m_s = 0.6;
+  float person_height_m = 1.7;
+};
+
+// World state, in meters and degrees; heading counter-clockwise positive.
+struct SimPose {
+  double time_s;
+  double x, y, heading_deg;
+  double person_x, person_y;
+};
+
+// A differential-drive robot driven by PWM duty, with a gyro, an LED ring
+// and a camera that sees one walking person. The physics advances lazily,
+// in fixed steps, up to the clock's time whenever a port is used, so on a
+// SimClock results depend only on the seed and on what the code under test
+// does when. On a MonotonicClock it runs in real time, for code that also
+// waits on things the SimClock cannot count, such as a gRPC stream.
+class SimRobot {
+ public:
+  SimRobot(Clock* clock, const SimConfig& config);
+
+  MotorPort* motors() { return &motors_; }
+  ImuPort* imu() { return &imu_; }
+  LedPort* leds() { return &leds_; }
+  DetectionSource* detections() { return &detections_; }
+
+  SimPose Pose();
+  // Moves the person to |range_m| at |bearing_deg| from the robot's heading,
+  // right positive, e.g. behind it to make the follower lose them.
+  void PlacePerson(double bearing_deg, double range_m);
+  // Number of motor updates and LED frames written so far.
+  uint64_t motor_writes();
+  uint64_t led_writes();
+  // The last motor update drives a wheel, and the camera is switched on.
+  bool motors_on();
+  bool camera_active();
+  // Newest frame written to the LEDs.
+  std::vector<LedColor> LedFrame();
+
+ private:
+  class Motors : public MotorPort {
+   public:
+    explicit Motors(SimRobot* robot) : robot_(robot) {}
+    void Set(float duty_a, float duty_b) override;
+
+   private:
+    SimRobot* robot_;
+  };
+  class Imu : public ImuPort {
+   public:
+    explicit Imu(SimRobot* robot) : robot_(robot) {}
+    bool Read(ImuReading* reading) override;
+
+   private:
+    SimRobot* robot_;
+  };
+  class Leds : public LedPort {
+   public:
+    explicit Leds(SimRobot* robot) : robot_(robot) {}
+    int Count() const override;
+    void Write(const std::vector<LedColor>& leds) override;
+
+   private:
+    SimRobot* robot_;
+  };
+  class Detections : public DetectionSource {
+   public:
+    explicit Detections(SimRobot* robot) : robot_(robot) {}
+    void SetActive(bool active) override;
+    bool ReadLatest(DetectionRecord* record) override;
+
+   private:
+    SimRobot* robot_;
+  };
+
+  // Steps the world up to the clock's time. Needs mutex_.
+  void AdvanceLocked();
+  void Step(double dt);
+  void StepPerson(double dt);
+  void Capture();
+
+  Clock* clock_;
+  SimConfig config_;
+  Motors motors_;
+  Imu imu_;
+  Leds leds_;
+  Detections detections_;
+
+  std::mutex mutex_;
+  std::mt19937 random_;
+  std::mt19937 person_random_;
+  int64_t time_ns_;
+  double track_width_m_;
+  double speed_per_duty_;
+  double duty_a_, duty_b_;
+  double speed_a_, speed_b_;
+  double x_, y_, heading_deg_, rate_deg_s_;
+  double person_x_, person_y_, person_heading_deg_, person_speed_;
+  int64_t person_leg_end_ns_;
+  bool camera_active_;
+  int64_t next_capture_ns_;
+  uint64_t frame_id_;
+  std::deque<DetectionRecord> in_flight_;
+  DetectionRecord latest_;
+  uint64_t motor_writes_;
+  uint64_t led_writes_;
+  std::vector<LedColor> led_frame_;
+};
+
+#endif  // SRC_ASSISTANT_ROBOT_SIM_H_
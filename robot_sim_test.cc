@@ -0,0 +1,269 @@
+// Runs the robot's control code against the simulator (robot_sim.h): the
+// blocking movementStraight/movementTurn moves, MotionController turns and
+// drives on the ImuService, and FollowBehavior after a walking person.
+// Each scenario starts from a fresh, seeded world and is checked against
+// tolerances; the run also reports how much faster than real time it went.
+// Needs neither the MATRIX board nor a camera, so it runs on any Linux box.
+//
+// With --record, the follow scenario is also written to a flight log, for
+// flight_replay. With --trace, the traced spans of the whole run are
+// written as a Chrome trace; its timestamps are wall time, not simulated
+// time.
+//
+// Usage: ./robot_sim_test [--seed N] [--follow-s SECONDS] [--record FILE]
+//                         [--trace FILE] [--verbose]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+
+#include "assistant/flight_recorder.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_commands.h"
+#include "assistant/robot_movement.h"
+#include "assistant/robot_sim.h"
+#include "assistant/time_util.h"
+#include "assistant/trace.h"
+
+static const int64_t kSettleNs = 1000000000;
+
+static double simulated_s = 0;
+static bool verbose = false;
+static std::string record_path;
+
+static bool Check(const char* what, double value, double expected,
+                  double tolerance) {
+  bool ok = std::fabs(value - expected) <= tolerance;
+  printf("  %-34s %8.2f (expected %.2f +- %.2f)%s\n", what, value, expected,
+         tolerance, ok ? "" : "  FAIL");
+  return ok;
+}
+
+// Runs on a fresh world; |scenario| runs on this thread, which is counted
+// on the clock meanwhile.
+template <typename Scenario>
+static bool Run(const char* name, const SimConfig& config,
+                Scenario scenario) {
+  printf("%s\n", name);
+  SimClock clock;
+  SimRobot robot(&clock, config);
+  int64_t start_ns = clock.NowNs();
+  clock.AddThread();
+  bool ok = scenario(&clock, &robot);
+  clock.RemoveThread();
+  simulated_s += (clock.NowNs() - start_ns) / 1e9;
+  return ok;
+}
+
+// movementStraight times the drive by counting 20 ms loops, but each IMU
+// read adds a few milliseconds to a loop, so it goes long.
+static bool LegacyStraight(Clock* clock, SimRobot* robot) {
+  movementStraight(robot->motors(), robot->imu(), clock, 'f', 2.5);
+  clock->SleepForNs(kSettleNs);
+  SimPose pose = robot->Pose();
+  bool ok = Check("distance (m)", pose.x, 2.5, 0.5);
+  ok &= Check("cross-track (m)", pose.y, 0, 0.15);
+  ok &= Check("heading (deg)", pose.heading_deg, 0, 3);
+  return ok;
+}
+
+// movementTurn stops on the integrated angle with no allowance for the
+// robot coasting, so it overshoots by roughly rate * motor lag.
+static bool LegacyTurn(Clock* clock, SimRobot* robot, char direction) {
+  movementTurn(robot->motors(), robot->imu(), clock, direction, 'p', 90);
+  clock->SleepForNs(kSettleNs);
+  SimPose pose = robot->Pose();
+  return Check("heading (deg)", pose.heading_deg,
+               direction == 'r' ? -90 : 90, 20);
+}
+
+// Heading change of |pose| from |start|, right positive like Turn().
+static double TurnedDeg(const SimPose& start, const SimPose& pose) {
+  return start.heading_deg - pose.heading_deg;
+}
+
+static bool Controller(Clock* clock, SimRobot* robot) {
+  ImuService imu(robot->imu(), clock, ImuConfig());
+  MotionController motion(robot->motors(), &imu, clock, MotionConfig());
+  if (!imu.Start() || !motion.Start()) {
+    return false;
+  }
+  bool ok = true;
+  auto await = [clock](std::future<MotionResult> result) {
+    while (result.wait_for(std::chrono::seconds(0)) !=
+           std::future_status::ready) {
+      clock->SleepForNs(5000000);
+    }
+    MotionResult value = result.get();
+    clock->SleepForNs(kSettleNs);
+    return value;
+  };
+
+  SimPose start = robot->Pose();
+  ok &= await(motion.Turn(90, TurnType::kPivot)) == MotionResult::kCompleted;
+  ok &= Check("pivot right 90 (deg)", TurnedDeg(start, robot->Pose()), 90, 3);
+
+  start = robot->Pose();
+  ok &= await(motion.Turn(-45, TurnType::kSwing)) == MotionResult::kCompleted;
+  ok &= Check("swing left 45 (deg)", TurnedDeg(start, robot->Pose()), -45, 4);
+
+  start = robot->Pose();
+  ok &= await(motion.Drive(3)) == MotionResult::kCompleted;
+  SimPose end = robot->Pose();
+  double heading = start.heading_deg * M_PI / 180;
+  double dx = end.x - start.x, dy = end.y - start.y;
+  ok &= Check("drive 3 m: along (m)",
+              dx * std::cos(heading) + dy * std::sin(heading), 3, 0.3);
+  ok &= Check("drive 3 m: cross-track (m)",
+              -dx * std::sin(heading) + dy * std::cos(heading), 0, 0.1);
+  ok &= Check("drive 3 m: heading (deg)", TurnedDeg(start, end), 0, 2);
+
+  motion.Stop();
+  imu.Stop();
+  return ok;
+}
+
+static bool Follow(Clock* clock, SimRobot* robot, const SimConfig& config,
+                   double follow_s) {
+  FlightRecorder recorder(clock);
+  if (!record_path.empty() && !recorder.Open(record_path, 64 << 20)) {
+    return false;
+  }
+  RecordingImu imu_port(robot->imu(), &recorder);
+  RecordingMotors motors(robot->motors(), &recorder);
+  RecordingDetections detections(robot->detections(), &recorder);
+  ImuService imu(&imu_port, clock, ImuConfig());
+  MotionController motion(&motors, &imu, clock, MotionConfig());
+  if (!imu.Start() || !motion.Start()) {
+    return false;
+  }
+  FollowConfig follow_config;
+  follow_config.tracker.frame_width = config.frame_width;
+  follow_config.tracker.horizontal_fov_deg = config.horizontal_fov_deg;
+  FollowBehavior follow(&motion, &detections, clock, follow_config);
+
+  // Sample the range to the person every 100 ms from the follow loop's own
+  // checks, which it makes at least that often.
+  const int64_t end_ns =
+      clock->NowNs() + static_cast<int64_t>(follow_s * 1e9);
+  int64_t next_sample_ns = 0;
+  int samples = 0, close = 0;
+  double range_sum = 0, range_max = 0;
+  bool stopped = false;
+  recorder.RecordCommand("follow me");
+  RunRobotCommand("follow me", &motion, &follow, [&] {
+    int64_t now_ns = clock->NowNs();
+    if (now_ns >= next_sample_ns) {
+      next_sample_ns = now_ns + 100000000;
+      SimPose pose = robot->Pose();
+      double range = std::hypot(pose.person_x - pose.x, pose.person_y - pose.y);
+      samples++;
+      range_sum += range;
+      range_max = std::max(range_max, range);
+      close += range < 5;
+      if (verbose) {
+        printf("    t=%6.2f robot (%6.2f, %6.2f) %7.1f deg person (%6.2f, "
+               "%6.2f) range %5.2f\n",
+               pose.time_s, pose.x, pose.y, pose.heading_deg, pose.person_x,
+               pose.person_y, range);
+      }
+    }
+    if (now_ns < end_ns) {
+      return true;
+    }
+    // Mark where the follow was told to stop, so that a replay stops it
+    // there too rather than at the last record.
+    if (!stopped) {
+      recorder.RecordStop();
+      stopped = true;
+    }
+    return false;
+  });
+  motion.Stop();
+  imu.Stop();
+  if (recorder.is_open()) {
+    printf("  recorded %llu records to %s\n",
+           static_cast<unsigned long long>(recorder.recorded()),  // NOLINT
+           record_path.c_str());
+    recorder.Close();
+  }
+
+  bool ok = Check("mean range (m)", range_sum / std::max(samples, 1), 2.5,
+                  2.0);
+  ok &= Check("time within 5 m (%)", 100.0 * close / std::max(samples, 1),
+              100, 25);
+  printf("  max range %.2f m over %d samples\n", range_max, samples);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  SimConfig config;
+  double follow_s = 60;
+  std::string trace_path;
+
+  const struct option long_options[] = {
+      {"seed", required_argument, nullptr, 's'},
+      {"follow-s", required_argument, nullptr, 'f'},
+      {"record", required_argument, nullptr, 'r'},
+      {"trace", required_argument, nullptr, 't'},
+      {"verbose", no_argument, nullptr, 'v'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "s:f:r:t:v", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 's':
+        config.seed = std::atoi(optarg);
+        break;
+      case 'f':
+        follow_s = std::atof(optarg);
+        break;
+      case 'r':
+        record_path = optarg;
+        break;
+      case 't':
+        trace_path = optarg;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  TRACE_THREAD_NAME("main");
+  if (!trace_path.empty() && !InstallTraceDump(trace_path)) {
+    return -1;
+  }
+  int64_t wall_start_ns = MonotonicNowNs();
+  bool ok = true;
+  ok &= Run("movementStraight 2.5 m", config, LegacyStraight);
+  ok &= Run("movementTurn right 90", config, [](Clock* clock, SimRobot* robot) {
+    return LegacyTurn(clock, robot, 'r');
+  });
+  ok &= Run("movementTurn left 90", config, [](Clock* clock, SimRobot* robot) {
+    return LegacyTurn(clock, robot, 'l');
+  });
+  ok &= Run("MotionController", config, Controller);
+  ok &= Run("FollowBehavior", config, [&](Clock* clock, SimRobot* robot) {
+    return Follow(clock, robot, config, follow_s);
+  });
+  double wall_s = (MonotonicNowNs() - wall_start_ns) / 1e9;
+
+  printf("simulated %.1f s in %.2f s (%.0fx real time)\n", simulated_s,
+         wall_s, simulated_s / wall_s);
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -17,12 +17,14 @@ limitations under the License.
 #include <grpc++/grpc++.h>
 
 #include <getopt.h>
+#include <unistd.h>
 
 #include <chrono>  // NOLINT
-#include <fstream>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <iterator>
-#include <sstream>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT
 
@@ -39,13 +41,32 @@ limitations under the License.
 #include "google/assistant/embedded/v1alpha2/embedded_assistant.pb.h"
 
 #include "assistant/assistant_config.h"
+#include "assistant/assistant_connection.h"
+#include "assistant/audio_buffer_pool.h"
 #include "assistant/audio_input.h"
 #include "assistant/audio_input_file.h"
 #include "assistant/base64_encode.h"
+#include "assistant/command_recognizer.h"
+#include "assistant/detection_channel.h"
+#include "assistant/doa_service.h"
+#include "assistant/flight_recorder.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/imu_service.h"
 #include "assistant/json_util.h"
+#include "assistant/motion_controller.h"
+#include "assistant/person_detector.h"
+#include "assistant/robot_commands.h"
+#include "assistant/robot_hal.h"
+#include "assistant/status_lights.h"
+#include "assistant/target_tracker.h"
+#include "assistant/task_executor.h"
+#include "assistant/trace.h"
+#include "assistant/vision_pipeline.h"
 
 // MATRIX GLOBALS //
-#include "assistant/robot_movement.h"
+// MATRIX backends of the robot interfaces
+#include "assistant/matrix_robot.h"
+#include "assistant/motor_driver.h"
 //// System calls
 //#include <unistd.h>
 // Interfaces with GPIO
@@ -62,27 +83,6 @@ limitations under the License.
 #include "driver/everloop_image.h"
 // END MATRIX GLOBALS // 
 
-// DOA GLOBALS
-//#include <fftw3.h>
-//#include <stdint.h>
-//#include <string.h>
-//#include <wiringPi.h>
-
-//#include <valarray>
-
-//#include "driver/direction_of_arrival.h"
-//#include "driver/everloop.h"
-//#include "driver/everloop_image.h"
-//#include "driver/microphone_array.h"
-//#include "driver/microphone_core.h"
-
-//DEFINE_bool(big_menu, true, "Include 'advanced' options in the menu listing");
-//DEFINE_int32(sampling_frequency, 16000, "Sampling Frequency");
-
-//int led_offset[] = {23, 27, 32, 1, 6, 10, 14, 19};
-//int lut[] = {1, 2, 10, 200, 10, 2, 1};
-// END DOA GLOBALS
-
 namespace assistant = google::assistant::embedded::v1alpha2;
 
 using assistant::AssistRequest;
@@ -93,8 +93,6 @@ using assistant::AudioOutConfig;
 using assistant::EmbeddedAssistant;
 using assistant::ScreenOutConfig;
 
-using grpc::CallCredentials;
-using grpc::Channel;
 using grpc::ClientReaderWriter;
 
 static const char kCredentialsTypeUserAccount[] = "USER_ACCOUNT";
@@ -102,55 +100,66 @@ static const char kALSAAudioInput[] = "ALSA_INPUT";
 static const char kLanguageCode[] = "en-US";
 static const char kDeviceModelId[] = "default";
 static const char kDeviceInstanceId[] = "default";
+static const char kDetectorPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDetectorModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+static const char kDetectorCalibration[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_int8.table";
+static const char kDetectionChannelName[] = "/follow_me_detections";
+// About three hours at the robot's record rates.
+static const size_t kFlightLogBytes = 256 << 20;
+// Playback buffers for audio_out: a reply of up to ~25 s queued at once
+// at 100 ms per response.
+static const int kAudioOutBuffers = 256;
+static const size_t kAudioOutBufferBytes = 3200;
+// The command loop and a behavior.
+static const int kExecutorThreads = 2;
 
 bool verbose = false;
 
-// Creates a channel to be connected to Google.
-std::shared_ptr<Channel> CreateChannel(const std::string& host) {
-  std::ifstream file("robots.pem");
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  std::string roots_pem = buffer.str();
-
-  if (verbose) {
-    std::clog << "assistant_sdk robots_pem: " << roots_pem << std::endl;
-  }
-  ::grpc::SslCredentialsOptions ssl_opts = {roots_pem, "", ""};
-  auto creds = ::grpc::SslCredentials(ssl_opts);
-  std::string server = host + ":443";
-  if (verbose) {
-    std::clog << "assistant_sdk CreateCustomChannel(" << server
-              << ", creds, arg)" << std::endl
-              << std::endl;
-  }
-  ::grpc::ChannelArguments channel_args;
-  return CreateCustomChannel(server, creds, channel_args);
-}
-
 void PrintUsage() {
   std::cerr << "Usage: ./run_assistant_audio "
             << "--credentials <credentials_file> "
             << "[--api_endpoint <API endpoint>] "
             << "[--locale <locale>]"
-            << "[--html_out <command to load HTML page>]" << std::endl;
+            << "[--html_out <command to load HTML page>] "
+            << "[--detector <opencv|native|int8>] "
+            << "[--calibration <INT8 calibration table>] "
+            << "[--roi <ROI network input size, 0 for off>] "
+            << "[--flight_log <file>] "
+            << "[--trace <file>] "
+            << "[--speculation_stability <0-1, 1 for off>]" << std::endl;
 }
 
 bool GetCommandLineFlags(int argc, char** argv,
                          std::string* credentials_file_path,
                          std::string* api_endpoint, std::string* locale,
-                         std::string* html_out_command) {
+                         std::string* html_out_command,
+                         PersonDetectorConfig* detector_config,
+                         std::string* flight_log_path,
+                         std::string* trace_path,
+                         RecognizerConfig* recognizer_config) {
   const struct option long_options[] = {
       {"credentials", required_argument, nullptr, 'c'},
       {"api_endpoint", required_argument, nullptr, 'e'},
       {"locale", required_argument, nullptr, 'l'},
       {"verbose", no_argument, nullptr, 'v'},
       {"html_out", required_argument, nullptr, 'h'},
+      {"detector", required_argument, nullptr, 'd'},
+      {"calibration", required_argument, nullptr, 'q'},
+      {"roi", required_argument, nullptr, 'r'},
+      {"flight_log", required_argument, nullptr, 'f'},
+      {"trace", required_argument, nullptr, 't'},
+      {"speculation_stability", required_argument, nullptr, 's'},
       {nullptr, 0, nullptr, 0}};
   *api_endpoint = ASSISTANT_ENDPOINT;
+  std::string detector = "opencv";
+  std::string calibration = kDetectorCalibration;
   while (true) {
     int option_index;
-    int option_char =
-        getopt_long(argc, argv, "c:e:l:v:h", long_options, &option_index);
+    int option_char = getopt_long(argc, argv, "c:e:l:v:hd:q:r:f:t:s:",
+                                  long_options, &option_index);
     if (option_char == -1) {
       break;
     }
@@ -170,16 +179,52 @@ bool GetCommandLineFlags(int argc, char** argv,
       case 'h':
         *html_out_command = optarg;
         break;
+      case 'd':
+        detector = optarg;
+        break;
+      case 'q':
+        calibration = optarg;
+        break;
+      case 'r':
+        detector_config->roi_input_size = std::atoi(optarg);
+        break;
+      case 'f':
+        *flight_log_path = optarg;
+        break;
+      case 't':
+        *trace_path = optarg;
+        break;
+      case 's':
+        recognizer_config->min_stability = std::atof(optarg);
+        break;
       default:
         PrintUsage();
         return false;
     }
   }
+  if (detector == "native" || detector == "int8") {
+    detector_config->native_engine = true;
+    if (detector == "int8") {
+      detector_config->int8_calibration_path = calibration;
+    }
+  } else if (detector != "opencv") {
+    PrintUsage();
+    return false;
+  }
+  if (credentials_file_path->empty()) {
+    PrintUsage();
+    return false;
+  }
   return true;
 }
 
 int main(int argc, char** argv) {
   std::string credentials_file_path, api_endpoint, locale, html_out_command;
+  std::string flight_log_path, trace_path;
+  PersonDetectorConfig detector_config;
+  RecognizerConfig recognizer_config;
+  detector_config.prototxt_path = kDetectorPrototxt;
+  detector_config.model_path = kDetectorModel;
 #ifndef ENABLE_ALSA
   std::cerr << "ALSA audio input is not supported on this platform."
             << std::endl;
@@ -190,7 +235,26 @@ int main(int argc, char** argv) {
   // https://github.com/grpc/grpc/issues/11366#issuecomment-328595941
   grpc_init();
   if (!GetCommandLineFlags(argc, argv, &credentials_file_path, &api_endpoint,
-                           &locale, &html_out_command)) {
+                           &locale, &html_out_command, &detector_config,
+                           &flight_log_path, &trace_path,
+                           &recognizer_config)) {
+    return -1;
+  }
+  // With --trace, the hot paths' spans go to a Chrome trace at exit and on
+  // SIGUSR2.
+  TRACE_THREAD_NAME("main");
+  if (!trace_path.empty() && !InstallTraceDump(trace_path)) {
+    return -1;
+  }
+
+  // One channel and one set of credentials for every turn. It starts
+  // connecting now, while the robot sets up and calibrates.
+  AssistantConnectionConfig connection_config;
+  connection_config.endpoint = api_endpoint;
+  connection_config.credentials_path = credentials_file_path;
+  connection_config.verbose = verbose;
+  AssistantConnection connection(connection_config);
+  if (!connection.Init()) {
     return -1;
   }
   
@@ -200,8 +264,6 @@ int main(int argc, char** argv) {
 	// Initialize bus and exit program if error occurs
 	if (!bus.Init()) return false;
 
-	// Create IMUData object
-	matrix_hal::IMUData imu_data;
 	// Create IMUSensor object
 	matrix_hal::IMUSensor imu_sensor;
 	// Set imu_sensor to use MatrixIOBus bus
@@ -212,93 +274,126 @@ int main(int argc, char** argv) {
 	// Set gpio to use MatrixIOBus bus
 	gpio.Setup(&bus);
   gpioInit(&gpio);
+  // The control code only sees the robot_hal.h interfaces; these are the
+  // MATRIX implementations of them.
+  MonotonicClock clock;
+  MotorDriver motor_driver(&gpio, MotorDriverConfig());
+  MatrixImu matrix_imu(&imu_sensor);
+  // With --flight_log, IMU readings, detections, commands and motor writes
+  // go to a binary log that flight_replay plays back.
+  FlightRecorder recorder(&clock);
+  if (!flight_log_path.empty() &&
+      !recorder.Open(flight_log_path, kFlightLogBytes)) {
+    return -1;
+  }
+  RecordingMotors motors(&motor_driver, &recorder);
+  RecordingImu imu_port(&matrix_imu, &recorder);
+  // The IMU is sampled on its own thread from here on; the robot has to
+  // stand still for the gyro calibration at startup.
+  ImuService imu(&imu_port, &clock, ImuConfig());
+  if (!imu.Start()) {
+    return -1;
+  }
+  // From here on the motors belong to the motion controller's thread.
+  // Commands return at once; a newer one preempts a running one.
+  MotionController motion(&motors, &imu, &clock, MotionConfig());
+  if (!motion.Start()) {
+    return -1;
+  }
   
-  // Holds the number of LEDs on MATRIX device
-  int ledCount = bus.MatrixLeds();
-  // Create EverloopImage object, with size of ledCount
-  matrix_hal::EverloopImage everloop_image(ledCount);
-  // Create Everloop object
-  matrix_hal::Everloop everloop;
-  // Set everloop to use MatrixIOBus bus
-  everloop.Setup(&bus);
-  // led brightness
-  int ledBright = 50;
+  // Everloop LED ring, animated on its own low-priority thread; the loop
+  // below only tells it the status.
+  MatrixLeds leds(&bus);
+  StatusLights lights(&leds, &clock, StatusLightsConfig());
+  if (!lights.Start()) {
+    return -1;
+  }
   // END MATRIX INITIALIZATIONS //
-  
-  // DOA INTIALIZATIONS
-  //if (!bus.IsDirectBus()) {
-    //std::cerr << "Kernel Modules has been loaded. Use ALSA examples "
-              //<< std::endl;
-  //}
-
-  //int sampling_rate = 16000;
-
-  //matrix_hal::Everloop everloop;
-  //everloop.Setup(&bus);
 
-  //matrix_hal::EverloopImage image1d(bus.MatrixLeds());
-
-  //matrix_hal::MicrophoneArray mics;
-  //mics.Setup(&bus);
-  //mics.SetSamplingRate(sampling_rate);
-  //mics.ShowConfiguration();
-
-  //matrix_hal::MicrophoneCore mic_core(mics);
-  //mic_core.Setup(&bus);
-
-  //matrix_hal::DirectionOfArrival doa(mics);
-  //doa.Init();
+  // Load the person detector once; the vision pipeline keeps the camera
+  // open between calls.
+  PersonDetector detector(detector_config);
+  TrackerConfig tracker_config;
+  tracker_config.frame_width = detector_config.frame_width;
+  tracker_config.horizontal_fov_deg = detector_config.horizontal_fov_deg;
+  if (!detector.LoadModel()) {
+    return -1;
+  }
 
-  //float azimutal_angle;
-  //float polar_angle;
-  //int mic;
-  // END DOA INITIALIZATIONS
+  // Capture, preprocessing, inference and postprocessing run on their own
+  // threads while a follow behavior is active and publish every result into
+  // a shared-memory channel; the loops below read the newest record from it.
+  DetectionChannel detections;
+  if (!detections.Create(kDetectionChannelName)) {
+    return -1;
+  }
+  // With --roi, a tracked person is detected in a window around them on a
+  // smaller net, with a full-frame search every few frames.
+  VisionPipelineConfig vision_config;
+  vision_config.roi = detector_config.roi_input_size > 0;
+  VisionPipeline vision(&detector, &detections, vision_config);
+  vision.SetActive(false);
+  if (!vision.Start()) {
+    return -1;
+  }
+  VisionDetectionSource vision_source(&vision, &detections);
+  RecordingDetections detection_source(&vision_source, &recorder);
+  FollowConfig follow_config;
+  follow_config.tracker = tracker_config;
+  FollowBehavior follow(&motion, &detection_source, &clock, follow_config);
+  follow.set_on_search([&lights](bool searching) {
+    lights.Show(searching ? RobotStatus::kSearching : RobotStatus::kMoving);
+  });
+  // The speaker's bearing, from the microphone array read straight off the
+  // bus while the user speaks; a search for them starts by turning toward
+  // it. With the MATRIX kernel modules loaded the array belongs to ALSA
+  // and searches go without.
+  std::unique_ptr<MatrixMics> mics;
+  std::unique_ptr<DoaService> doa;
+  if (bus.IsDirectBus()) {
+    DoaConfig doa_config;
+    mics.reset(new MatrixMics(&bus, doa_config.sample_rate));
+    doa.reset(new DoaService(mics.get(), doa_config));
+    if (!doa->Start()) {
+      return -1;
+    }
+    follow.set_speaker_bearing([&doa](float* bearing_deg) {
+      DoaEstimate estimate;
+      if (!doa->Bearing(&estimate)) {
+        return false;
+      }
+      *bearing_deg = estimate.bearing_deg;
+      return true;
+    });
+  } else {
+    std::clog << "MATRIX kernel modules loaded; searching without the "
+                 "speaker's bearing"
+              << std::endl;
+  }
+  // Everything that outlasts a response runs on the executor and takes
+  // messages from this thread, which only reads the Assistant stream: the
+  // command loop and the behavior it runs ("follow me" until another
+  // command cancels it). Perception, motion and the LED ring have their own
+  // threads already.
+  TaskExecutor executor(kExecutorThreads);
+  CommandRunner commands(&motion, &follow);
+  commands.Start(&executor);
+  // Starts the safe part of a robot command from the partial transcripts,
+  // before the final result comes back.
+  CommandSpeculator speculator(&motion, &detection_source, &commands,
+                               recognizer_config);
+  bool speculate = recognizer_config.min_stability < 1;
+
+  // Reused turn after turn: the buffers audio_out is copied into for
+  // playback.
+  AudioBufferPool audio_out_buffers(kAudioOutBuffers, kAudioOutBufferBytes);
 
   while (true) {
-    // DOA LOOP CODE
-    //mics.Read(); /* Reading 8-mics buffer from de FPGA */
-
-    //doa.Calculate();
-
-    //azimutal_angle = doa.GetAzimutalAngle() * 180 / M_PI;
-    //polar_angle = doa.GetPolarAngle() * 180 / M_PI;
-    //mic = doa.GetNearestMicrophone();
-
-    //std::cout << "azimutal angle = " << azimutal_angle
-              //<< ", polar angle = " << polar_angle << ", mic = " << mic
-              //<< std::endl;
-
-    //for (matrix_hal::LedValue &led : image1d.leds) {
-      //led.blue = 0;
-    //}
-
-    //for (int i = led_offset[mic] - 3, j = 0; i < led_offset[mic] + 3;
-         //++i, ++j) {
-      //if (i < 0) {
-        //image1d.leds[image1d.leds.size() + i].blue = lut[j];
-      //} else {
-        //image1d.leds[i % image1d.leds.size()].blue = lut[j];
-      //}
-
-      //everloop.Write(&image1d);
-    //}
-    // END DOA LOOP CODE
 /***************ADDED BY ME - NOT ORIGINAL GOOGLE ASSISTANT CODE******************/
-    for (matrix_hal::LedValue &led : everloop_image.leds) {
-      // Turn off Everloop
-      led.red = 0;
-      led.green = 0;
-      led.blue = 0;
-      led.white = 0;
+    lights.Show(RobotStatus::kListening);
+    if (doa != nullptr) {
+      doa->Begin();
     }
-    everloop_image.leds[0].blue = ledBright;
-    everloop_image.leds[5].blue = ledBright;
-    everloop_image.leds[10].blue = ledBright;
-    everloop_image.leds[15].blue = ledBright;
-    everloop_image.leds[20].blue = ledBright;
-    everloop_image.leds[25].blue = ledBright;
-    everloop_image.leds[30].blue = ledBright;
-    everloop.Write(&everloop_image);
     
     // Create an AssistRequest
     AssistRequest request;
@@ -333,48 +428,30 @@ int main(int argc, char** argv) {
         AudioInConfig::LINEAR16);
     assist_config->mutable_audio_in_config()->set_sample_rate_hertz(16000);
 
-    // Read credentials file.
-    std::ifstream credentials_file(credentials_file_path);
-    if (!credentials_file) {
-      std::cerr << "Credentials file \"" << credentials_file_path
-                << "\" does not exist." << std::endl;
-      return -1;
-    }
-    std::stringstream credentials_buffer;
-    credentials_buffer << credentials_file.rdbuf();
-    std::string credentials = credentials_buffer.str();
-    std::shared_ptr<CallCredentials> call_credentials;
-    call_credentials = grpc::GoogleRefreshTokenCredentials(credentials);
-    if (call_credentials.get() == nullptr) {
-      std::cerr << "Credentials file \"" << credentials_file_path
-                << "\" is invalid. Check step 5 in README for how to get valid "
-                << "credentials." << std::endl;
+    // Begin a stream: normally the one opened while the last reply
+    // played, with the config written.
+    grpc::Status open_status;
+    std::unique_ptr<AssistantCall> call =
+        connection.StartCall(request, &open_status);
+    if (call == nullptr) {
+      std::cerr << "assistant_sdk failed, error: "
+                << open_status.error_message() << std::endl;
       return -1;
     }
-
-    // Begin a stream.
-    auto channel = CreateChannel(api_endpoint);
-    std::unique_ptr<EmbeddedAssistant::Stub> assistant(
-        EmbeddedAssistant::NewStub(channel));
-
-    grpc::ClientContext context;
-    context.set_fail_fast(false);
-    context.set_credentials(call_credentials);
-
-    std::shared_ptr<ClientReaderWriter<AssistRequest, AssistResponse>> stream(
-        std::move(assistant->Assist(&context)));
-    // Write config in first stream.
+    std::shared_ptr<ClientReaderWriter<AssistRequest, AssistResponse>> stream =
+        call->stream;
     if (verbose) {
       std::clog << "assistant_sdk wrote first request: "
                 << request.ShortDebugString() << std::endl;
     }
-    stream->Write(request);
 
     audio_input.reset(new AudioInputALSA());
 
     audio_input->AddDataListener(
         [stream, &request](std::shared_ptr<std::vector<unsigned char>> data) {
-          request.set_audio_in(&((*data)[0]), data->size());
+          // Into the request's own string: no temporary per chunk.
+          request.mutable_audio_in()->assign(
+              reinterpret_cast<const char*>(data->data()), data->size());
           stream->Write(request);
         });
     audio_input->AddStopListener([stream]() { stream->WritesDone(); });
@@ -388,27 +465,55 @@ int main(int argc, char** argv) {
       std::clog << "assistant_sdk waiting for response ... " << std::endl;
     }
     AssistResponse response;
-    while (stream->Read(&response)) {  // Returns false when no more to read.
+    auto read_response = [&stream, &response] {
+      TRACE_SCOPE("assistant.stream_read");
+      return stream->Read(&response);
+    };
+    while (read_response()) {  // Returns false when no more to read.
+      TRACE_SCOPE("assistant.response");
       if (response.has_audio_out() ||
           response.event_type() == AssistResponse_EventType_END_OF_UTTERANCE) {
         // Synchronously stops audio input if there is one.
         if (audio_input != nullptr && audio_input->IsRunning()) {
           audio_input->Stop();
         }
+        if (doa != nullptr) {
+          doa->End();
+        }
+        // The user is done speaking; the next turn's stream opens while
+        // the reply plays.
+        connection.PrepareNextCall();
       }
       if (response.has_audio_out()) {
         // CUSTOMIZE: play back audio_out here.
 
-        std::shared_ptr<std::vector<unsigned char>> data(
-            new std::vector<unsigned char>);
-        data->resize(response.audio_out().audio_data().length());
-        memcpy(&((*data)[0]), response.audio_out().audio_data().c_str(),
-               response.audio_out().audio_data().length());
+        const std::string& audio = response.audio_out().audio_data();
+        std::shared_ptr<std::vector<unsigned char>> data =
+            audio_out_buffers.Acquire(audio.size());
+        if (data == nullptr) {
+          // More of the reply queued than the pool holds.
+          data = std::make_shared<std::vector<unsigned char>>(audio.size());
+        }
+        memcpy(data->data(), audio.data(), audio.size());
         audio_output.Send(data);
       }
+      // A final result comes alone, at stability 1.
+      bool final_result = response.speech_results_size() == 1 &&
+                          response.speech_results(0).stability() == 1;
+      if (speculate && !final_result && response.speech_results_size() > 0) {
+        std::vector<SpeechResult> results;
+        for (int i = 0; i < response.speech_results_size(); i++) {
+          results.push_back({response.speech_results(i).transcript(),
+                             response.speech_results(i).stability()});
+        }
+        speculator.OnPartial(results);
+      }
       // CUSTOMIZE: render spoken request on screen
       for (int i = 0; i < response.speech_results_size(); i++) {
         auto result = response.speech_results(i);
+        if (final_result) {
+          speculator.OnFinal(result.transcript());
+        }
         if (verbose) {
           std::clog << "assistant_sdk request: \n"
                     << result.transcript() << " ("
@@ -421,214 +526,15 @@ int main(int argc, char** argv) {
         
 /***************ADDED BY ME - NOT ORIGINAL GOOGLE ASSISTANT CODE******************/
         if (result.stability() > 0) {
-          for (matrix_hal::LedValue &led : everloop_image.leds) {
-              // Turn off Everloop
-              led.red = 0;
-              led.green = 0;
-              led.blue = 0;
-              led.white = 0;
-          }
-          everloop_image.leds[2].green = ledBright;
-          everloop_image.leds[7].green = ledBright;
-          everloop_image.leds[12].green = ledBright;
-          everloop_image.leds[17].green = ledBright;
-          everloop_image.leds[22].green = ledBright;
-          everloop_image.leds[27].green = ledBright;
-          everloop_image.leds[32].green = ledBright;
-          everloop.Write(&everloop_image);
+          lights.Show(RobotStatus::kRecognized);
         }
-        if (result.stability() == 1 && (result.transcript() == "come to me" ||
-                                        result.transcript() == "follow me" ||
-                                        result.transcript() == "go forward" ||
-                                        result.transcript() == "go backward" ||
-                                        result.transcript() == "turn right" ||
-                                        result.transcript() == "turn left" ||
-                                        result.transcript() == "turn around")) {
-          for (matrix_hal::LedValue &led : everloop_image.leds) {
-              // Turn off Everloop
-              led.red = 0;
-              led.green = 0;
-              led.blue = 0;
-              led.white = 0;
-          }
-          everloop_image.leds[4].red = ledBright;
-          everloop_image.leds[9].red = ledBright;
-          everloop_image.leds[14].red = ledBright;
-          everloop_image.leds[19].red = ledBright;
-          everloop_image.leds[24].red = ledBright;
-          everloop_image.leds[29].red = ledBright;
-          everloop_image.leds[34].red = ledBright;
-          everloop.Write(&everloop_image);
-          
-          if (result.transcript() == "come to me") {
-            audio_output.Stop();
-            std::ifstream coordFile;
-            std::string coordBuffer;
-            std::string::size_type sz;
-            float x;
-            float dx;
-            float angle;
-            float dist;
-            
-            do {
-              std::string file = "/home/pi/real-time-object-detection/person_detection.py --prototxt /home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt --model /home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
-              std::string command = "python ";
-              command += file;
-              system(command.c_str());
-              
-              coordFile.open("/home/pi/Desktop/coordinates.txt");
-              if (!coordFile) {
-                std::cout << "Unable to open coordinates.txt\n";
-              } else {
-                std::getline(coordFile, coordBuffer);
-              }
-              coordFile.close();
-                
-              if (coordBuffer == "no person") {
-                while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 'p', 45));
-              } else {
-                break;
-              }
-            } while (coordBuffer == "no person");
-            
-            if (coordBuffer != "no person") {
-              x = std::stof(coordBuffer, &sz);
-              dist = std::stof(coordBuffer.substr(sz));
-              if (x < 200) { // left of center of frame
-                angle = 30*(200 - x)/200; // camera has a 78 degree FoV
-                while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'l', 's', angle)); // turn to subject
-                while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', dist)); // go to subject
-              } else if (x > 200) { // right of center of frame
-                angle = 30*(x - 200)/200;
-                while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 's', angle)); // turn to subject
-                while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', dist)); // go to subject
-              } else { // center of frame
-                while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', dist)); // go to subject
-              }
-            }
-          } else if (result.transcript() == "follow me") {
-            audio_output.Stop();
-            std::ifstream coordFile;
-            std::string coordBuffer;
-            std::string::size_type sz;
-            float x;
-            float xNew;
-            float angle;
-            float dist;
-            float distNew;
-            
-            // Find subject
-            do {
-              std::string file = "/home/pi/real-time-object-detection/person_detection.py --prototxt /home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt --model /home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
-              std::string command = "python ";
-              command += file;
-              system(command.c_str());
-              
-              coordFile.open("/home/pi/Desktop/coordinates.txt");
-              if (!coordFile) {
-                std::cout << "Unable to open coordinates.txt\n";
-              } else {
-                std::getline(coordFile, coordBuffer);
-              }
-              coordFile.close();
-                
-              if (coordBuffer == "no person") {
-                while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 'p', 45)); // rotate if subject is not found
-              } else {
-                break; // Break out of loop if subject is found
-              }
-            } while (coordBuffer == "no person");
-            
-            if (coordBuffer != "no person") {
-              x = std::stof(coordBuffer, &sz);
-              dist = std::stof(coordBuffer.substr(sz));
-              if (x < 200) { // left of center of frame
-                angle = 30*(200 - x)/200; // camera has a 78 degree FoV
-                while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'l', 's', angle)); // turn to subject
-                while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', dist)); // go to subject
-              } else if (x > 200) { // right of center of frame
-                angle = 30*(x - 200)/200;
-                while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 's', angle)); // turn to subject
-                while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', dist)); // go to subject
-              } else { // center of frame
-                while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', dist)); // go to subject
-              }
-            }
-            
-            // Track subject
-            while (1) {
-              std::string file = "/home/pi/real-time-object-detection/person_detection.py --prototxt /home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt --model /home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
-              std::string command = "python ";
-              command += file;
-              system(command.c_str());
-              
-              coordFile.open("/home/pi/Desktop/coordinates.txt");
-              if (!coordFile) {
-                std::cout << "Unable to open coordinates.txt\n";
-              } else {
-                std::getline(coordFile, coordBuffer);
-              }
-              coordFile.close();
-              
-              if (coordBuffer == "no person") {
-                while (coordBuffer == "no person") {
-                  std::string file = "/home/pi/real-time-object-detection/person_detection.py --prototxt /home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt --model /home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
-                  std::string command = "python ";
-                  command += file;
-                  system(command.c_str());
-                  
-                  coordFile.open("/home/pi/Desktop/coordinates.txt");
-                  if (!coordFile) {
-                    std::cout << "Unable to open coordinates.txt\n";
-                  } else {
-                    std::getline(coordFile, coordBuffer);
-                  }
-                  coordFile.close();
-                    
-                  if (coordBuffer == "no person") {
-                    while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 'p', 45));
-                  } else {
-                    break;
-                  }
-                }
-              }
-              xNew = std::stof(coordBuffer, &sz);
-              distNew = std::stof(coordBuffer.substr(sz));
-              if ((xNew < x - 10) || (xNew > x + 10)) { // Track latteral movement
-                if (xNew < 200) { // left of center of frame
-                  angle = 30*(200 - xNew)/200; // camera has a 78 degree FoV
-                  while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'l', 's', angle)); // turn to subject
-                } else if (xNew > 200) { // right of center of frame
-                  angle = 30*(xNew - 200)/200;
-                  while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 's', angle)); // turn to subject
-                } 
-              }
-              if ((distNew > dist + 2) || (distNew < dist + 2)) { // Track longitudinal movement
-                if (distNew > dist) {
-                  while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', distNew)); // go to subject
-                } else if (distNew < dist) {
-                  while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'r', distNew)); // go to subject
-                }
-              }
-              x = xNew;
-              dist = distNew;
-            }
-          } else if (result.transcript() == "go forward") {
-            audio_output.Stop();
-            while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'f', 6));
-          } else if (result.transcript() == "go backward") {
-            audio_output.Stop();
-            while(!movementStraight(&gpio, &imu_data, &imu_sensor, 'b', 6));
-          } else if (result.transcript() == "turn right") {
-            audio_output.Stop();
-            while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'r', 'p', 90));
-          } else if (result.transcript() == "turn left") {
-            audio_output.Stop();
-            while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'l', 'p', 90));
-          } else if (result.transcript() == "turn around") {
-            audio_output.Stop();
-            while(!movementTurn(&gpio, &imu_data, &imu_sensor, 'l', 'p', 180));
-          } 
+        if (result.stability() == 1 && IsRobotCommand(result.transcript())) {
+          lights.Show(RobotStatus::kMoving);
+          audio_output.Stop();
+          recorder.RecordCommand(result.transcript());
+          // Returns at once; "follow me" follows on the executor until the
+          // next command cancels it, and this loop keeps listening.
+          commands.Post(result.transcript());
         }
 /***********************************************************************************/        
       }
@@ -651,13 +557,19 @@ int main(int argc, char** argv) {
     }
 
     audio_output.Stop();
+    // The turn ended without a final result.
+    speculator.Cancel();
 
     grpc::Status status = stream->Finish();
     if (!status.ok()) {
       // Report the RPC failure.
+      lights.Show(RobotStatus::kError);
       std::cerr << "assistant_sdk failed, error: " << status.error_message()
                 << std::endl;
-      return -1;
+      // The channel reconnects by itself, with backoff, if it was lost.
+      if (status.error_code() != grpc::StatusCode::UNAVAILABLE) {
+        return -1;
+      }
     }
   }
 
@@ -0,0 +1,178 @@
+// Time to find a person by rotating continuously with the camera streaming
+// (FollowConfig::search_rate_deg_s) against stopping to look every search
+// turn, on the simulated robot (robot_sim.h).
+//
+// A person stands still at each bearing round the robot and
+// FollowBehavior::Approach() looks for them from a standstill. Reports the
+// simulated time until the robot has found the person and faces them, and
+// how far off it was facing as it drove up to them: a continuous search
+// acts on a frame captured before it stopped, so it has to allow for the
+// turn made since.
+//
+// Usage: ./search_bench [--range M] [--rates DEG_S,...] [--seed N]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "assistant/follow_behavior.h"
+#include "assistant/heading_controller.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_sim.h"
+
+static const int64_t kSearchTimeoutNs = 60000000000LL;
+
+struct SearchResult {
+  bool approached = false;
+  // Until the robot had found and faced the person, and until the approach
+  // ended.
+  double found_s = 0;
+  double approach_s = 0;
+  // Bearing of the person, from where the robot started, off the heading
+  // it drove up to them on.
+  double facing_error_deg = 0;
+};
+
+// Approach() on a fresh world with the person at |person_deg|, searching at
+// |rate_deg_s|, or a search turn at a time if it is 0.
+static SearchResult Search(float person_deg, float range_m, float rate_deg_s,
+                           uint32_t seed) {
+  SimConfig config;
+  config.seed = seed;
+  config.person_speed_m_s = 0;
+  SimClock clock;
+  SimRobot robot(&clock, config);
+  clock.AddThread();
+  ImuService imu(robot.imu(), &clock, ImuConfig());
+  MotionController motion(robot.motors(), &imu, &clock, MotionConfig());
+  SearchResult result;
+  if (!imu.Start() || !motion.Start()) {
+    clock.RemoveThread();
+    return result;
+  }
+  FollowConfig follow_config;
+  follow_config.tracker.frame_width = config.frame_width;
+  follow_config.tracker.horizontal_fov_deg = config.horizontal_fov_deg;
+  follow_config.search_rate_deg_s = rate_deg_s;
+  FollowBehavior follow(&motion, robot.detections(), &clock, follow_config);
+
+  robot.PlacePerson(person_deg, range_m);
+  SimPose start = robot.Pose();
+  const int64_t start_ns = clock.NowNs();
+  int64_t found_ns = start_ns;
+  follow.set_on_search([&clock, &found_ns](bool searching) {
+    if (!searching) {
+      found_ns = clock.NowNs();
+    }
+  });
+  result.approached = follow.Approach([&clock, start_ns] {
+    return clock.NowNs() - start_ns < kSearchTimeoutNs;
+  });
+  result.found_s = (found_ns - start_ns) / 1e9;
+  result.approach_s = (clock.NowNs() - start_ns) / 1e9;
+  SimPose pose = robot.Pose();
+  double toward_deg = std::atan2(pose.person_y - start.y,
+                                 pose.person_x - start.x) * 180 / M_PI;
+  result.facing_error_deg = AngleDifferenceDeg(pose.heading_deg, toward_deg);
+  motion.Stop();
+  imu.Stop();
+  clock.RemoveThread();
+  return result;
+}
+
+int main(int argc, char** argv) {
+  float range_m = 3;
+  std::string rates = "30,45,60,90";
+  uint32_t seed = 1;
+
+  const struct option long_options[] = {
+      {"range", required_argument, nullptr, 'r'},
+      {"rates", required_argument, nullptr, 'a'},
+      {"seed", required_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "r:a:s:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'r':
+        range_m = std::atof(optarg);
+        break;
+      case 'a':
+        rates = optarg;
+        break;
+      case 's':
+        seed = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  // The stepped search first, then each continuous rate.
+  std::vector<float> modes = {0};
+  std::stringstream rate_list(rates);
+  std::string rate;
+  while (std::getline(rate_list, rate, ',')) {
+    modes.push_back(std::atof(rate.c_str()));
+  }
+
+  printf("search for a person %.1f m away at every 15 deg, simulated "
+         "seconds\n",
+         range_m);
+  printf("  %-18s %8s %8s %8s %8s %9s\n", "search", "found", "p90",
+         "max", "reached", "facing");
+  printf("  %-18s %8s %8s %8s %8s %9s\n", "", "mean", "", "", "mean",
+         "|err| deg");
+  double stepped_mean = 0;
+  for (float mode : modes) {
+    std::vector<double> found;
+    double found_sum = 0, approach_sum = 0, error_sum = 0;
+    int timeouts = 0;
+    for (int b = -165; b <= 180; b += 15) {
+      SearchResult result = Search(b, range_m, mode, seed + b + 1000);
+      if (!result.approached) {
+        timeouts++;
+        continue;
+      }
+      found.push_back(result.found_s);
+      found_sum += result.found_s;
+      approach_sum += result.approach_s;
+      error_sum += std::fabs(result.facing_error_deg);
+    }
+    char name[32];
+    if (mode == 0) {
+      snprintf(name, sizeof(name), "stop every %.0f deg",
+               FollowConfig().search_turn_deg);
+    } else {
+      snprintf(name, sizeof(name), "rotate %.0f deg/s", mode);
+    }
+    if (found.empty()) {
+      printf("  %-18s all timed out\n", name);
+      continue;
+    }
+    std::sort(found.begin(), found.end());
+    double mean = found_sum / found.size();
+    if (mode == 0) {
+      stepped_mean = mean;
+    }
+    printf("  %-18s %8.2f %8.2f %8.2f %8.2f %9.1f", name, mean,
+           found[found.size() * 9 / 10], found.back(),
+           approach_sum / found.size(), error_sum / found.size());
+    if (mode != 0 && stepped_mean > 0) {
+      printf("  (%.0f%% of stepped)", 100 * mean / stepped_mean);
+    }
+    printf("%s\n", timeouts > 0 ? "  (some timed out)" : "");
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef SRC_ASSISTANT_SEQLOCK_H_
+#define SRC_ASSISTANT_SEQLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+// Single-writer snapshot that readers copy without locking and without ever
+// blocking the writer. The writer bumps a sequence number to odd, stores
+// the value and bumps it back to even; a reader retries if the sequence was
+// odd or changed while it copied. The value is kept in atomic words so the
+// concurrent copy is not a data race.
+//
+// Suited to small, frequently updated state such as the latest IMU reading,
+// where readers only ever want the newest value.
+template <typename T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Seqlock values are copied word by word");
+
+ public:
+  Seqlock() : sequence_(0) {
+    T value = T();
+    Store(value);
+  }
+
+  // Only one thread may call Store().
+  void Store(const T& value) {
+    uint32_t words[kWords] = {};
+    memcpy(words, &value, sizeof(T));
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; i++) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T Load() const {
+    uint32_t words[kWords];
+    while (true) {
+      uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;
+      }
+      for (size_t i = 0; i < kWords; i++) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) {
+        break;
+      }
+    }
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  static const size_t kWords = (sizeof(T) + 3) / 4;
+
+  std::atomic<uint32_t> sequence_;
+  std::atomic<uint32_t> words_[kWords];
+
+  Seqlock(const Seqlock&) = delete;
+  Seqlock& operator=(const Seqlock&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_SEQLOCK_H_
@@ -0,0 +1,262 @@
+// Calibrates the INT8 mode of the native SSD engine over a folder of
+// captured frames and reports what it costs in accuracy.
+//
+// Every frame is run through the FP32 network to record the input range of
+// each convolution, and the ranges are written as a calibration table for
+// PersonDetectorConfig::int8_calibration_path. The same frames are then run
+// through the INT8 network and its person detections are scored against
+// the FP32 ones (confidence >= --reference-threshold taken as ground truth)
+// as average precision at IoU 0.5. FP32 scores 1.0 on its own reference,
+// so the reported AP is also the drop.
+//
+// Usage: ./ssd_calibrate --frames <dir> [--output <table>]
+//                        [--prototxt <path>] [--model <path>]
+//                        [--reference-threshold T]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "assistant/person_detector.h"
+#include "assistant/ssd_net.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char kDefaultPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDefaultModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+static const char kDefaultOutput[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_int8.table";
+static const int kPersonClassId = 15;
+static const float kMatchIou = 0.5f;
+
+struct Box {
+  float score;
+  float x1, y1, x2, y2;
+};
+
+static float Iou(const Box& a, const Box& b) {
+  float iw = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+  float ih = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+  if (iw <= 0 || ih <= 0) {
+    return 0;
+  }
+  float inter = iw * ih;
+  return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) +
+                  (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+// Person rows of a DetectionOutput blob with at least |threshold| score.
+static std::vector<Box> PersonBoxes(const ssd::Blob& output,
+                                    float threshold) {
+  std::vector<Box> boxes;
+  for (int i = 0; i < output.dim(2); i++) {
+    const float* row = output.data.data() + i * 7;
+    if (static_cast<int>(row[1]) == kPersonClassId && row[2] >= threshold) {
+      Box box = {row[2], row[3], row[4], row[5], row[6]};
+      boxes.push_back(box);
+    }
+  }
+  return boxes;
+}
+
+// VOC-style all-point average precision of |detections| against
+// |references|, both indexed by frame.
+static double AveragePrecision(
+    const std::vector<std::vector<Box>>& references,
+    const std::vector<std::vector<Box>>& detections) {
+  struct Scored {
+    float score;
+    size_t frame;
+    Box box;
+  };
+  std::vector<Scored> all;
+  size_t positives = 0;
+  for (size_t f = 0; f < detections.size(); f++) {
+    positives += references[f].size();
+    for (const Box& box : detections[f]) {
+      Scored scored = {box.score, f, box};
+      all.push_back(scored);
+    }
+  }
+  if (positives == 0) {
+    return 1.0;
+  }
+  std::sort(all.begin(), all.end(), [](const Scored& a, const Scored& b) {
+    return a.score > b.score;
+  });
+
+  std::vector<std::vector<bool>> matched(references.size());
+  for (size_t f = 0; f < references.size(); f++) {
+    matched[f].assign(references[f].size(), false);
+  }
+  std::vector<double> precision, recall;
+  size_t true_positives = 0;
+  for (size_t i = 0; i < all.size(); i++) {
+    const std::vector<Box>& truth = references[all[i].frame];
+    int best = -1;
+    float best_iou = kMatchIou;
+    for (size_t t = 0; t < truth.size(); t++) {
+      float iou = Iou(all[i].box, truth[t]);
+      if (iou >= best_iou && !matched[all[i].frame][t]) {
+        best = static_cast<int>(t);
+        best_iou = iou;
+      }
+    }
+    if (best >= 0) {
+      matched[all[i].frame][best] = true;
+      true_positives++;
+    }
+    precision.push_back(static_cast<double>(true_positives) / (i + 1));
+    recall.push_back(static_cast<double>(true_positives) / positives);
+  }
+
+  // Area under the precision envelope.
+  double ap = 0;
+  double previous_recall = 0;
+  for (size_t i = 0; i < precision.size(); i++) {
+    double envelope = *std::max_element(precision.begin() + i,
+                                        precision.end());
+    ap += (recall[i] - previous_recall) * envelope;
+    previous_recall = recall[i];
+  }
+  return ap;
+}
+
+static void CopyInput(const cv::Mat& blob, ssd::Net* net) {
+  ssd::Blob* input = net->input();
+  std::copy(blob.ptr<float>(), blob.ptr<float>() + input->count(),
+            input->data.begin());
+}
+
+int main(int argc, char** argv) {
+  std::string frames_dir;
+  std::string output_path = kDefaultOutput;
+  float reference_threshold = 0.5f;
+  PersonDetectorConfig config;
+  config.prototxt_path = kDefaultPrototxt;
+  config.model_path = kDefaultModel;
+
+  const struct option long_options[] = {
+      {"frames", required_argument, nullptr, 'f'},
+      {"output", required_argument, nullptr, 'o'},
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {"reference-threshold", required_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "f:o:p:m:t:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'f':
+        frames_dir = optarg;
+        break;
+      case 'o':
+        output_path = optarg;
+        break;
+      case 'p':
+        config.prototxt_path = optarg;
+        break;
+      case 'm':
+        config.model_path = optarg;
+        break;
+      case 't':
+        reference_threshold = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+  if (frames_dir.empty()) {
+    std::cerr << "Usage: ./ssd_calibrate --frames <dir> [--output <table>]"
+              << std::endl;
+    return -1;
+  }
+
+  // Preprocess exactly as the detector does at runtime.
+  PersonDetector preprocessor(config);
+  std::vector<std::string> paths;
+  cv::glob(frames_dir + "/*", paths);
+  std::vector<cv::Mat> blobs;
+  for (const std::string& path : paths) {
+    cv::Mat frame = cv::imread(path);
+    if (frame.empty()) {
+      continue;
+    }
+    cv::Size frame_size;
+    blobs.push_back(preprocessor.Preprocess(frame, &frame_size));
+  }
+  if (blobs.empty()) {
+    std::cerr << "ssd_calibrate: no readable frames in " << frames_dir
+              << std::endl;
+    return -1;
+  }
+
+  ssd::Net fp32;
+  ssd::Net int8;
+  std::string error;
+  if (!fp32.Load(config.prototxt_path, config.model_path, &error) ||
+      !int8.Load(config.prototxt_path, config.model_path, &error)) {
+    std::cerr << "ssd_calibrate: " << error << std::endl;
+    return -1;
+  }
+
+  std::map<std::string, float> ranges;
+  std::vector<std::vector<Box>> references;
+  double fp32_ms = 0;
+  for (const cv::Mat& blob : blobs) {
+    CopyInput(blob, &fp32);
+    Clock::time_point start = Clock::now();
+    const ssd::Blob& output = fp32.ForwardCalibration(&ranges);
+    fp32_ms +=
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    references.push_back(PersonBoxes(output, reference_threshold));
+  }
+  if (!ssd::WriteCalibrationTable(output_path, ranges, &error)) {
+    std::cerr << "ssd_calibrate: " << error << std::endl;
+    return -1;
+  }
+
+  int converted = int8.EnableInt8(ranges);
+  std::vector<std::vector<Box>> detections;
+  double int8_ms = 0;
+  for (const cv::Mat& blob : blobs) {
+    CopyInput(blob, &int8);
+    Clock::time_point start = Clock::now();
+    const ssd::Blob& output = int8.Forward();
+    int8_ms +=
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    detections.push_back(PersonBoxes(output, 0));
+  }
+
+  size_t people = 0;
+  for (const std::vector<Box>& boxes : references) {
+    people += boxes.size();
+  }
+  double ap = AveragePrecision(references, detections);
+  std::cout << "frames: " << blobs.size() << ", reference people: " << people
+            << std::endl;
+  std::cout << "wrote " << ranges.size() << " ranges to " << output_path
+            << " (" << converted << " convolutions run in INT8)" << std::endl;
+  std::cout << "mean forward: fp32 " << fp32_ms / blobs.size() << "ms, int8 "
+            << int8_ms / blobs.size() << "ms" << std::endl;
+  std::cout << "person AP50 vs FP32: fp32 1.000, int8 " << ap << " (drop "
+            << 1 - ap << ")" << std::endl;
+  return 0;
+}
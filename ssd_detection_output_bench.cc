@@ -0,0 +1,264 @@
+// Times the generic 21-class DetectionOutput against the person-only
+// specialization (DetectionOutputLayer::KeepOnlyClass) over the priors of
+// the model, and checks that both report the same person boxes.
+//
+// Confidences and box offsets are synthesized: a few people are placed at
+// random, priors overlapping them score high for person, a sprinkling of
+// priors score high for other classes and the rest is background.
+//
+// Usage: ./ssd_detection_output_bench [--iterations N] [--people N]
+//                                     [--prototxt <path>] [--model <path>]
+//                                     [--threshold T]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "assistant/ssd_layers.h"
+#include "assistant/ssd_net.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char kDefaultPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDefaultModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+static const int kPersonClassId = 15;
+
+static float Overlap(const float* a, const float* b) {
+  float iw = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+  float ih = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+  if (iw <= 0 || ih <= 0) {
+    return 0;
+  }
+  float inter = iw * ih;
+  return inter / ((a[2] - a[0]) * (a[3] - a[1]) +
+                  (b[2] - b[0]) * (b[3] - b[1]) - inter);
+}
+
+// Fills |loc| and |conf| for a scene with |people| people in it.
+static void Synthesize(const ssd::Blob& priors, int num_classes, int people,
+                       ssd::Blob* loc, ssd::Blob* conf) {
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::vector<float> boxes;
+  for (int i = 0; i < people; i++) {
+    float w = 0.1f + 0.3f * unit(random);
+    float h = 0.3f + 0.6f * unit(random);
+    float x = (1 - w) * unit(random);
+    float y = (1 - h) * unit(random);
+    float box[4] = {x, y, x + w, y + h};
+    boxes.insert(boxes.end(), box, box + 4);
+  }
+
+  int num_priors = priors.dim(2) / 4;
+  std::vector<float> logits(num_classes);
+  for (int p = 0; p < num_priors; p++) {
+    const float* prior = priors.data.data() + p * 4;
+    float best = 0;
+    for (size_t b = 0; b < boxes.size(); b += 4) {
+      best = std::max(best, Overlap(prior, &boxes[b]));
+    }
+    for (int c = 0; c < num_classes; c++) {
+      logits[c] = 2 * unit(random) - 1;
+    }
+    logits[0] += 4;
+    if (best > 0.3f) {
+      logits[kPersonClassId] += 3 + 8 * best;
+    } else if (unit(random) < 0.03f) {
+      logits[1 + random() % (num_classes - 1)] += 6;
+    }
+    float max_logit = *std::max_element(logits.begin(), logits.end());
+    float sum = 0;
+    for (float& logit : logits) {
+      logit = std::exp(logit - max_logit);
+      sum += logit;
+    }
+    for (int c = 0; c < num_classes; c++) {
+      conf->data[p * num_classes + c] = logits[c] / sum;
+    }
+    for (int k = 0; k < 4; k++) {
+      loc->data[p * 4 + k] = 0.6f * unit(random) - 0.3f;
+    }
+  }
+}
+
+// Median and mean wall time of |layer|.Forward() over |iterations| calls.
+static void TimeForward(const char* name, ssd::Layer* layer,
+                        const std::vector<ssd::Blob*>& bottoms,
+                        const std::vector<ssd::Blob*>& tops,
+                        int iterations) {
+  std::vector<double> samples;
+  for (int i = 0; i < iterations; i++) {
+    Clock::time_point start = Clock::now();
+    layer->Forward(bottoms, tops);
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  printf("  %-28s p50 %8.1fus  mean %8.1fus  rows %d\n", name,
+         samples[samples.size() / 2], sum / samples.size(), tops[0]->dim(2));
+}
+
+// Person rows of a DetectionOutput blob scoring above |threshold|.
+static std::vector<const float*> PersonRows(const ssd::Blob& output,
+                                            float threshold) {
+  std::vector<const float*> rows;
+  for (int i = 0; i < output.dim(2); i++) {
+    const float* row = output.data.data() + i * 7;
+    if (static_cast<int>(row[1]) == kPersonClassId && row[2] > threshold) {
+      rows.push_back(row);
+    }
+  }
+  return rows;
+}
+
+// Largest element difference between two row lists, or HUGE_VALF if their
+// lengths differ.
+static float RowsDiff(const std::vector<const float*>& a,
+                      const std::vector<const float*>& b) {
+  if (a.size() != b.size()) {
+    return HUGE_VALF;
+  }
+  float worst = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    for (int k = 0; k < 7; k++) {
+      worst = std::max(worst, std::fabs(a[i][k] - b[i][k]));
+    }
+  }
+  return worst;
+}
+
+int main(int argc, char** argv) {
+  int iterations = 2000;
+  int people = 3;
+  std::string prototxt = kDefaultPrototxt;
+  std::string model = kDefaultModel;
+  float threshold = 0.9f;
+
+  const struct option long_options[] = {
+      {"iterations", required_argument, nullptr, 'n'},
+      {"people", required_argument, nullptr, 'k'},
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {"threshold", required_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:k:p:m:t:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        iterations = std::atoi(optarg);
+        break;
+      case 'k':
+        people = std::atoi(optarg);
+        break;
+      case 'p':
+        prototxt = optarg;
+        break;
+      case 'm':
+        model = optarg;
+        break;
+      case 't':
+        threshold = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  // The net supplies the priors; the layer parameters come straight from
+  // the prototxt so each variant gets a fresh layer.
+  ssd::Net net;
+  std::string error;
+  if (!net.Load(prototxt, model, &error)) {
+    std::cerr << "ssd_detection_output_bench: " << error << std::endl;
+    return -1;
+  }
+  std::ifstream file(prototxt);
+  std::stringstream text;
+  text << file.rdbuf();
+  ssd::TextMessage definition;
+  if (!definition.Parse(text.str(), &error)) {
+    std::cerr << "ssd_detection_output_bench: " << error << std::endl;
+    return -1;
+  }
+  const ssd::TextMessage* params = nullptr;
+  for (const ssd::TextMessage* layer : definition.Children("layer")) {
+    if (layer->GetString("type") == "DetectionOutput") {
+      params = layer;
+    }
+  }
+  const ssd::Blob* priors = net.blob("mbox_priorbox");
+  if (params == nullptr || priors == nullptr) {
+    std::cerr << "ssd_detection_output_bench: no SSD DetectionOutput in "
+              << prototxt << std::endl;
+    return -1;
+  }
+  ssd::LayerSpec spec;
+  spec.name = params->GetString("name");
+  spec.type = "DetectionOutput";
+  spec.params = params;
+  int num_classes =
+      params->Child("detection_output_param").GetInt("num_classes", 0);
+  float network_threshold = params->Child("detection_output_param")
+                                .GetFloat("confidence_threshold", 0);
+
+  int num_priors = priors->dim(2) / 4;
+  ssd::Blob loc, conf, prior_blob = *priors;
+  loc.Reshape({1, num_priors * 4});
+  conf.Reshape({1, num_priors * num_classes});
+  Synthesize(*priors, num_classes, people, &loc, &conf);
+  std::vector<ssd::Blob*> bottoms = {&loc, &conf, &prior_blob};
+
+  ssd::DetectionOutputLayer generic(spec);
+  ssd::DetectionOutputLayer person(spec);
+  ssd::DetectionOutputLayer confident(spec);
+  ssd::Blob generic_out, person_out, confident_out;
+  if (!generic.Setup(bottoms, {&generic_out}, &error) ||
+      !person.Setup(bottoms, {&person_out}, &error) ||
+      !confident.Setup(bottoms, {&confident_out}, &error) ||
+      !person.KeepOnlyClass(kPersonClassId, network_threshold) ||
+      !confident.KeepOnlyClass(kPersonClassId, threshold)) {
+    std::cerr << "ssd_detection_output_bench: " << error << std::endl;
+    return -1;
+  }
+
+  std::cout << num_priors << " priors, " << num_classes << " classes, "
+            << people << " people" << std::endl;
+  TimeForward("generic", &generic, bottoms, {&generic_out}, iterations);
+  TimeForward("person", &person, bottoms, {&person_out}, iterations);
+  std::string confident_name =
+      "person > " + std::to_string(threshold).substr(0, 4);
+  TimeForward(confident_name.c_str(), &confident, bottoms, {&confident_out},
+              iterations);
+
+  float diff = std::max(
+      RowsDiff(PersonRows(generic_out, network_threshold),
+               PersonRows(person_out, network_threshold)),
+      RowsDiff(PersonRows(generic_out, threshold),
+               PersonRows(confident_out, threshold)));
+  bool ok = diff <= 1e-6f;
+  std::cout << "person rows max diff " << diff << ": "
+            << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,589 @@
+#include "assistant/ssd_kernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "assistant/ssd_simd.h"
+
+namespace ssd {
+
+// Gemm packs B a panel at a time: up to kGemmDepth rows of K by
+// kGemmPanelCols columns (128KB), which stays in the Cortex-A53's 512KB L2
+// while every row of A streams past it. Blocking K as well keeps the panel
+// that size however deep the product is, and four rows of A over one block
+// (4KB) stay in the 32KB L1 across the panel.
+static const int kGemmDepth = 256;
+static const int kGemmPanelCols = 128;
+
+// Copies |depth| rows and |cols| columns of B, whose rows are |ld| apart,
+// into 8-column strips of |depth| x 8 floats, one after the other, so the
+// kernel reads each strip sequentially. The last strip is padded with
+// zero columns.
+static void PackPanel(const float* b, int ld, int depth, int cols,
+                      float* packed) {
+  for (int j = 0; j < cols; j += 8) {
+    int width = std::min(8, cols - j);
+    const float* src = b + j;
+    for (int p = 0; p < depth; p++, src += ld, packed += 8) {
+      int x = 0;
+      for (; x < width; x++) {
+        packed[x] = src[x];
+      }
+      for (; x < 8; x++) {
+        packed[x] = 0;
+      }
+    }
+  }
+}
+
+// Stores the first |cols| of 8 columns of each of MR rows of C, |ld| apart,
+// clamping at zero with |relu|.
+template <int MR>
+static void StoreTile(const v4f* acc0, const v4f* acc1, int cols, bool relu,
+                      int ld, float* c) {
+  v4f zero = V4Set1(0);
+  for (int r = 0; r < MR; r++) {
+    v4f lo = relu ? V4Max(acc0[r], zero) : acc0[r];
+    v4f hi = relu ? V4Max(acc1[r], zero) : acc1[r];
+    float* row = c + r * ld;
+    if (cols == 8) {
+      V4Store(row, lo);
+      V4Store(row + 4, hi);
+    } else {
+      float tile[8];
+      V4Store(tile, lo);
+      V4Store(tile + 4, hi);
+      std::copy(tile, tile + cols, row);
+    }
+  }
+}
+
+// Computes MR rows x 8 columns of C over one block of K in registers: two
+// vectors per row, with the packed |strip| of B loaded once per k and
+// broadcast against each row of A, whose rows are |lda| apart. The first
+// block starts from |bias| (zero if null); later ones add to what C holds.
+// Only the first |cols| columns are stored, |ld| apart.
+template <int MR>
+static void GemmTile(int depth, const float* a, int lda, const float* strip,
+                     const float* bias, bool accumulate, bool relu, int cols,
+                     int ld, float* c) {
+  v4f acc0[MR], acc1[MR];
+  for (int r = 0; r < MR; r++) {
+    if (accumulate) {
+      float tile[8] = {0};
+      std::copy(c + r * ld, c + r * ld + cols, tile);
+      acc0[r] = V4Load(tile);
+      acc1[r] = V4Load(tile + 4);
+    } else {
+      acc0[r] = V4Set1(bias != nullptr ? bias[r] : 0.0f);
+      acc1[r] = acc0[r];
+    }
+  }
+  const float* bp = strip;
+  for (int p = 0; p < depth; p++, bp += 8) {
+    v4f b0 = V4Load(bp);
+    v4f b1 = V4Load(bp + 4);
+    for (int r = 0; r < MR; r++) {
+      v4f av = V4Set1(a[r * lda + p]);
+      acc0[r] = V4Fma(acc0[r], av, b0);
+      acc1[r] = V4Fma(acc1[r], av, b1);
+    }
+  }
+  StoreTile<MR>(acc0, acc1, cols, relu, ld, c);
+}
+
+// Rows [i, i + MR) of C over one packed panel.
+template <int MR>
+static void GemmPanelRows(int depth, int cols, int k, int n, const float* a,
+                          const float* packed, const float* bias,
+                          bool accumulate, bool relu, float* c) {
+  for (int j = 0; j < cols; j += 8) {
+    GemmTile<MR>(depth, a, k, packed + j * depth, bias, accumulate, relu,
+                 std::min(8, cols - j), n, c + j);
+  }
+}
+
+void Gemm(int m, int n, int k, const float* a, const float* b,
+          const float* bias, bool relu, float* c) {
+  // Packed once per thread and reused call after call.
+  static thread_local std::vector<float> packed;
+  packed.resize(static_cast<size_t>(kGemmDepth) * kGemmPanelCols);
+
+  for (int j = 0; j < n; j += kGemmPanelCols) {
+    int cols = std::min(kGemmPanelCols, n - j);
+    for (int p = 0; p < k; p += kGemmDepth) {
+      int depth = std::min(kGemmDepth, k - p);
+      PackPanel(b + static_cast<size_t>(p) * n + j, n, depth, cols,
+                packed.data());
+      bool accumulate = p > 0;
+      bool last = p + depth == k;
+      int i = 0;
+      for (; i + 4 <= m; i += 4) {
+        GemmPanelRows<4>(depth, cols, k, n, a + i * k + p, packed.data(),
+                         bias != nullptr ? bias + i : nullptr, accumulate,
+                         relu && last, c + i * n + j);
+      }
+      const float* tail_bias = bias != nullptr ? bias + i : nullptr;
+      float* tail_c = c + i * n + j;
+      switch (m - i) {
+        case 3:
+          GemmPanelRows<3>(depth, cols, k, n, a + i * k + p, packed.data(),
+                           tail_bias, accumulate, relu && last, tail_c);
+          break;
+        case 2:
+          GemmPanelRows<2>(depth, cols, k, n, a + i * k + p, packed.data(),
+                           tail_bias, accumulate, relu && last, tail_c);
+          break;
+        case 1:
+          GemmPanelRows<1>(depth, cols, k, n, a + i * k + p, packed.data(),
+                           tail_bias, accumulate, relu && last, tail_c);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+// One output pixel of a 3x3 depthwise convolution with bounds checks, used
+// along the padded borders.
+static float DepthwisePixel(const float* plane, int in_h, int in_w,
+                            const float* w, float bias, int iy0, int ix0) {
+  float sum = bias;
+  for (int ky = 0; ky < 3; ky++) {
+    int iy = iy0 + ky;
+    if (iy < 0 || iy >= in_h) {
+      continue;
+    }
+    for (int kx = 0; kx < 3; kx++) {
+      int ix = ix0 + kx;
+      if (ix >= 0 && ix < in_w) {
+        sum += plane[iy * in_w + ix] * w[ky * 3 + kx];
+      }
+    }
+  }
+  return sum;
+}
+
+void DepthwiseConv3x3(const float* input, int channels, int in_h, int in_w,
+                      const float* weights, const float* bias, bool relu,
+                      int pad, int stride, float* output, int out_h,
+                      int out_w) {
+  // Output columns whose 3-wide window lies fully inside the row.
+  int x_begin = std::min(out_w, (pad + stride - 1) / stride);
+  int x_end = std::max(x_begin, std::min(out_w, (in_w - 3 + pad) / stride + 1));
+
+  for (int ch = 0; ch < channels; ch++) {
+    const float* plane = input + static_cast<size_t>(ch) * in_h * in_w;
+    const float* w = weights + ch * 9;
+    float b = bias != nullptr ? bias[ch] : 0.0f;
+    float* out_plane = output + static_cast<size_t>(ch) * out_h * out_w;
+    v4f wv[9];
+    for (int i = 0; i < 9; i++) {
+      wv[i] = V4Set1(w[i]);
+    }
+    v4f bv = V4Set1(b);
+    v4f zero = V4Set1(0);
+
+    for (int oy = 0; oy < out_h; oy++) {
+      int iy0 = oy * stride - pad;
+      float* out_row = out_plane + oy * out_w;
+      int ox = 0;
+      for (; ox < x_begin; ox++) {
+        float v =
+            DepthwisePixel(plane, in_h, in_w, w, b, iy0, ox * stride - pad);
+        out_row[ox] = relu && v < 0 ? 0 : v;
+      }
+      if (stride == 1) {
+        for (; ox + 4 <= x_end; ox += 4) {
+          v4f acc = bv;
+          for (int ky = 0; ky < 3; ky++) {
+            int iy = iy0 + ky;
+            if (iy < 0 || iy >= in_h) {
+              continue;
+            }
+            const float* r = plane + iy * in_w + ox - pad;
+            acc = V4Fma(acc, wv[ky * 3], V4Load(r));
+            acc = V4Fma(acc, wv[ky * 3 + 1], V4Load(r + 1));
+            acc = V4Fma(acc, wv[ky * 3 + 2], V4Load(r + 2));
+          }
+          V4Store(out_row + ox, relu ? V4Max(acc, zero) : acc);
+        }
+      } else if (stride == 2) {
+        // V4LoadEven reads 8 floats, so stop while the last read stays
+        // inside the row.
+        for (; ox + 4 <= x_end && ox * 2 - pad + 9 < in_w; ox += 4) {
+          v4f acc = bv;
+          for (int ky = 0; ky < 3; ky++) {
+            int iy = iy0 + ky;
+            if (iy < 0 || iy >= in_h) {
+              continue;
+            }
+            const float* r = plane + iy * in_w + ox * 2 - pad;
+            acc = V4Fma(acc, wv[ky * 3], V4LoadEven(r));
+            acc = V4Fma(acc, wv[ky * 3 + 1], V4LoadEven(r + 1));
+            acc = V4Fma(acc, wv[ky * 3 + 2], V4LoadEven(r + 2));
+          }
+          V4Store(out_row + ox, relu ? V4Max(acc, zero) : acc);
+        }
+      }
+      for (; ox < out_w; ox++) {
+        float v =
+            DepthwisePixel(plane, in_h, in_w, w, b, iy0, ox * stride - pad);
+        out_row[ox] = relu && v < 0 ? 0 : v;
+      }
+    }
+  }
+}
+
+void Im2Col(const float* input, int channels, int in_h, int in_w,
+            int kernel_h, int kernel_w, int pad_h, int pad_w, int stride_h,
+            int stride_w, int dilation_h, int dilation_w, int out_h,
+            int out_w, float* col) {
+  for (int ch = 0; ch < channels; ch++) {
+    const float* plane = input + static_cast<size_t>(ch) * in_h * in_w;
+    for (int ky = 0; ky < kernel_h; ky++) {
+      for (int kx = 0; kx < kernel_w; kx++) {
+        for (int oy = 0; oy < out_h; oy++) {
+          int iy = oy * stride_h - pad_h + ky * dilation_h;
+          if (iy < 0 || iy >= in_h) {
+            memset(col, 0, out_w * sizeof(float));
+            col += out_w;
+            continue;
+          }
+          const float* row = plane + iy * in_w;
+          for (int ox = 0; ox < out_w; ox++) {
+            int ix = ox * stride_w - pad_w + kx * dilation_w;
+            *col++ = (ix >= 0 && ix < in_w) ? row[ix] : 0.0f;
+          }
+        }
+      }
+    }
+  }
+}
+
+void Relu(float* data, size_t count, float negative_slope) {
+  size_t i = 0;
+  if (negative_slope == 0) {
+    v4f zero = V4Set1(0);
+    for (; i + 4 <= count; i += 4) {
+      V4Store(data + i, V4Max(V4Load(data + i), zero));
+    }
+    for (; i < count; i++) {
+      data[i] = data[i] > 0 ? data[i] : 0;
+    }
+    return;
+  }
+  for (; i < count; i++) {
+    data[i] = data[i] > 0 ? data[i] : data[i] * negative_slope;
+  }
+}
+
+static inline int8_t QuantizeValue(float x, float inv_scale) {
+  float q = std::nearbyint(x * inv_scale);
+  return static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+}
+
+void QuantizeInt8(const float* src, size_t count, float inv_scale,
+                  int8_t* dst) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = QuantizeValue(src[i], inv_scale);
+  }
+}
+
+void QuantizePackInt8(const float* src, int k, int n, float inv_scale,
+                      int8_t* packed) {
+  int pairs = (k + 1) / 2;
+  size_t strip_bytes = static_cast<size_t>(pairs) * 16;
+  for (int q = 0; q < pairs; q++) {
+    const float* row0 = src + static_cast<size_t>(2 * q) * n;
+    const float* row1 = 2 * q + 1 < k ? row0 + n : nullptr;
+    int8_t* dst = packed + q * 16;
+    for (int j = 0; j < n; j += 8, dst += strip_bytes) {
+      int width = std::min(8, n - j);
+      int x = 0;
+      for (; x < width; x++) {
+        dst[2 * x] = QuantizeValue(row0[j + x], inv_scale);
+        dst[2 * x + 1] =
+            row1 != nullptr ? QuantizeValue(row1[j + x], inv_scale) : 0;
+      }
+      for (; x < 8; x++) {
+        dst[2 * x] = 0;
+        dst[2 * x + 1] = 0;
+      }
+    }
+  }
+}
+
+// Converts one vector of accumulators back to float and stores it.
+static inline void StoreDequantized(v4i acc, v4f scale, v4f bias, bool relu,
+                                    float* c) {
+  v4f y = V4Fma(bias, V4IToFloat(acc), scale);
+  V4Store(c, relu ? V4Max(y, V4Set1(0)) : y);
+}
+
+// GemmInt8 walks B in panels of whole strips this many bytes wide, so a
+// panel stays in L2 while every row of A streams past it. At one byte an
+// element the panel holds the whole depth of K: unlike Gemm's float sums,
+// int32 partial sums could not be parked in C between blocks of K. 128KB
+// still holds at least 8 columns up to K = 16384.
+static const int kGemmInt8PanelBytes = 128 * 1024;
+
+// INT8 counterpart of GemmTile: MR rows x 8 columns of C per register tile,
+// over a packed |strip| of B, two k values per step. Only the first |cols|
+// columns are stored, |ld| apart.
+template <int MR>
+static void GemmInt8Tile(int k, const int8_t* a, const int8_t* strip,
+                         const float* scale, const float* bias, bool relu,
+                         int cols, int ld, float* c) {
+  int pairs = k / 2;
+  v4i acc0[MR], acc1[MR];
+  for (int r = 0; r < MR; r++) {
+    acc0[r] = V4ISet1(0);
+    acc1[r] = acc0[r];
+  }
+  const int8_t* bp = strip;
+  for (int q = 0; q < pairs; q++, bp += 16) {
+    vq8 b0 = VQ8Load(bp);
+    vq8 b1 = VQ8Load(bp + 8);
+    for (int r = 0; r < MR; r++) {
+      vpair av = VPairSet(a[r * k + 2 * q], a[r * k + 2 * q + 1]);
+      acc0[r] = V4IDotPairs(acc0[r], b0, av);
+      acc1[r] = V4IDotPairs(acc1[r], b1, av);
+    }
+  }
+  for (int r = 0; r < MR; r++) {
+    v4f row_scale = V4Set1(scale[r]);
+    v4f row_bias = V4Set1(bias != nullptr ? bias[r] : 0.0f);
+    float* row = c + r * ld;
+    if (cols == 8) {
+      StoreDequantized(acc0[r], row_scale, row_bias, relu, row);
+      StoreDequantized(acc1[r], row_scale, row_bias, relu, row + 4);
+    } else {
+      float tile[8];
+      StoreDequantized(acc0[r], row_scale, row_bias, relu, tile);
+      StoreDequantized(acc1[r], row_scale, row_bias, relu, tile + 4);
+      std::copy(tile, tile + cols, row);
+    }
+  }
+}
+
+// Rows [i, i + MR) of C over the strips of one panel.
+template <int MR>
+static void GemmInt8PanelRows(int cols, int k, int n, const int8_t* a,
+                              const int8_t* b, const float* scale,
+                              const float* bias, bool relu, float* c) {
+  for (int j = 0; j < cols; j += 8) {
+    GemmInt8Tile<MR>(k, a, b + static_cast<size_t>(j) * k, scale, bias, relu,
+                     std::min(8, cols - j), n, c + j);
+  }
+}
+
+void GemmInt8(int m, int n, int k, const int8_t* a, const int8_t* b,
+              const float* scale, const float* bias, bool relu, float* c) {
+  int panel = std::max(8, kGemmInt8PanelBytes / k / 8 * 8);
+  for (int j = 0; j < n; j += panel) {
+    int cols = std::min(panel, n - j);
+    // Each 8-column strip is k bytes per column.
+    const int8_t* bj = b + static_cast<size_t>(j) * k;
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+      GemmInt8PanelRows<4>(cols, k, n, a + i * k, bj, scale + i,
+                           bias != nullptr ? bias + i : nullptr, relu,
+                           c + i * n + j);
+    }
+    const float* tail_bias = bias != nullptr ? bias + i : nullptr;
+    switch (m - i) {
+      case 3:
+        GemmInt8PanelRows<3>(cols, k, n, a + i * k, bj, scale + i, tail_bias,
+                             relu, c + i * n + j);
+        break;
+      case 2:
+        GemmInt8PanelRows<2>(cols, k, n, a + i * k, bj, scale + i, tail_bias,
+                             relu, c + i * n + j);
+        break;
+      case 1:
+        GemmInt8PanelRows<1>(cols, k, n, a + i * k, bj, scale + i, tail_bias,
+                             relu, c + i * n + j);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+static int32_t DepthwisePixelInt8(const int8_t* plane, int in_h, int in_w,
+                                  const int8_t* w, int iy0, int ix0) {
+  int32_t sum = 0;
+  for (int ky = 0; ky < 3; ky++) {
+    int iy = iy0 + ky;
+    if (iy < 0 || iy >= in_h) {
+      continue;
+    }
+    for (int kx = 0; kx < 3; kx++) {
+      int ix = ix0 + kx;
+      if (ix >= 0 && ix < in_w) {
+        sum += plane[iy * in_w + ix] * w[ky * 3 + kx];
+      }
+    }
+  }
+  return sum;
+}
+
+void DepthwiseConv3x3Int8(const int8_t* input, int channels, int in_h,
+                          int in_w, const int8_t* weights, const float* scale,
+                          const float* bias, bool relu, int pad, int stride,
+                          float* output, int out_h, int out_w) {
+  int x_begin = std::min(out_w, (pad + stride - 1) / stride);
+  int x_end = std::max(x_begin, std::min(out_w, (in_w - 3 + pad) / stride + 1));
+
+  for (int ch = 0; ch < channels; ch++) {
+    const int8_t* plane = input + static_cast<size_t>(ch) * in_h * in_w;
+    const int8_t* w = weights + ch * 9;
+    float s = scale[ch];
+    float b = bias != nullptr ? bias[ch] : 0.0f;
+    float* out_plane = output + static_cast<size_t>(ch) * out_h * out_w;
+    v8s wv[9];
+    for (int i = 0; i < 9; i++) {
+      wv[i] = V8SSet1(w[i]);
+    }
+    v4f sv = V4Set1(s);
+    v4f bv = V4Set1(b);
+
+    for (int oy = 0; oy < out_h; oy++) {
+      int iy0 = oy * stride - pad;
+      float* out_row = out_plane + oy * out_w;
+      int ox = 0;
+      for (; ox < x_begin; ox++) {
+        float y = DepthwisePixelInt8(plane, in_h, in_w, w, iy0,
+                                     ox * stride - pad) * s + b;
+        out_row[ox] = relu && y < 0 ? 0 : y;
+      }
+      // Eight outputs per step; the stride-2 loads read 16 bytes.
+      for (; ox + 8 <= x_end &&
+             (stride == 1 || ox * 2 - pad + 18 <= in_w);
+           ox += 8) {
+        v4i lo = V4ISet1(0);
+        v4i hi = V4ISet1(0);
+        for (int ky = 0; ky < 3; ky++) {
+          int iy = iy0 + ky;
+          if (iy < 0 || iy >= in_h) {
+            continue;
+          }
+          const int8_t* r = plane + iy * in_w + ox * stride - pad;
+          for (int kx = 0; kx < 3; kx++) {
+            v8s x = stride == 1 ? V8SLoadI8(r + kx) : V8SLoadEvenI8(r + kx);
+            V8SMulAcc(x, wv[ky * 3 + kx], &lo, &hi);
+          }
+        }
+        StoreDequantized(lo, sv, bv, relu, out_row + ox);
+        StoreDequantized(hi, sv, bv, relu, out_row + ox + 4);
+      }
+      for (; ox < out_w; ox++) {
+        float y = DepthwisePixelInt8(plane, in_h, in_w, w, iy0,
+                                     ox * stride - pad) * s + b;
+        out_row[ox] = relu && y < 0 ? 0 : y;
+      }
+    }
+  }
+}
+
+int SelectAboveThreshold(const float* values, int count, int stride,
+                         float threshold, int* indices) {
+  int selected = 0;
+  int i = 0;
+  if (stride == 1) {
+    v4f limit = V4Set1(threshold);
+    for (; i + 4 <= count; i += 4) {
+      int mask = V4GreaterMask(V4Load(values + i), limit);
+      for (; mask != 0; mask &= mask - 1) {
+        indices[selected++] = i + __builtin_ctz(mask);
+      }
+    }
+  }
+  // Strided scores do not vectorize; store unconditionally and only advance
+  // on a hit so the scan has no data-dependent branch.
+  for (; i < count; i++) {
+    indices[selected] = i;
+    selected += values[static_cast<size_t>(i) * stride] > threshold;
+  }
+  return selected;
+}
+
+void DecodeBoxes(const float* loc, const float* priors,
+                 const float* variances, const int* indices, int count,
+                 float* x0, float* y0, float* x1, float* y1) {
+  for (int i = 0; i < count; i++) {
+    const float* prior = priors + indices[i] * 4;
+    const float* var = variances + indices[i] * 4;
+    const float* l = loc + indices[i] * 4;
+    float prior_w = prior[2] - prior[0];
+    float prior_h = prior[3] - prior[1];
+    float cx = var[0] * l[0] * prior_w + (prior[0] + prior[2]) / 2;
+    float cy = var[1] * l[1] * prior_h + (prior[1] + prior[3]) / 2;
+    float half_w = std::exp(var[2] * l[2]) * prior_w / 2;
+    float half_h = std::exp(var[3] * l[3]) * prior_h / 2;
+    x0[i] = cx - half_w;
+    y0[i] = cy - half_h;
+    x1[i] = cx + half_w;
+    y1[i] = cy + half_h;
+  }
+}
+
+int NonMaxSuppression(const float* x0, const float* y0, const float* x1,
+                      const float* y1, float* scores, int count,
+                      float iou_threshold, int max_keep, int* keep) {
+  const float kSuppressed = -FLT_MAX;
+  int padded = (count + 3) & ~3;
+  for (int i = count; i < padded; i++) {
+    scores[i] = kSuppressed;
+  }
+  v4f zero = V4Set1(0);
+  v4f threshold = V4Set1(iou_threshold);
+  int kept = 0;
+  while (kept < max_keep) {
+    int best = -1;
+    float best_score = kSuppressed;
+    for (int i = 0; i < count; i++) {
+      if (scores[i] > best_score) {
+        best_score = scores[i];
+        best = i;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    keep[kept++] = best;
+    scores[best] = kSuppressed;
+
+    // IoU > t is tested as intersection > t * union to stay division-free.
+    v4f bx0 = V4Set1(x0[best]);
+    v4f by0 = V4Set1(y0[best]);
+    v4f bx1 = V4Set1(x1[best]);
+    v4f by1 = V4Set1(y1[best]);
+    v4f best_area = V4Mul(V4Max(V4Sub(bx1, bx0), zero),
+                          V4Max(V4Sub(by1, by0), zero));
+    for (int i = 0; i < padded; i += 4) {
+      v4f ax0 = V4Load(x0 + i);
+      v4f ay0 = V4Load(y0 + i);
+      v4f ax1 = V4Load(x1 + i);
+      v4f ay1 = V4Load(y1 + i);
+      v4f inter_w = V4Max(V4Sub(V4Min(ax1, bx1), V4Max(ax0, bx0)), zero);
+      v4f inter_h = V4Max(V4Sub(V4Min(ay1, by1), V4Max(ay0, by0)), zero);
+      v4f inter = V4Mul(inter_w, inter_h);
+      v4f area = V4Mul(V4Max(V4Sub(ax1, ax0), zero),
+                       V4Max(V4Sub(ay1, ay0), zero));
+      v4f uni = V4Sub(V4Add(area, best_area), inter);
+      int mask = V4GreaterMask(inter, V4Mul(threshold, uni));
+      for (; mask != 0; mask &= mask - 1) {
+        scores[i + __builtin_ctz(mask)] = kSuppressed;
+      }
+    }
+  }
+  return kept;
+}
+
+}  // namespace ssd
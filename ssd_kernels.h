@@ -0,0 +1,90 @@
+#ifndef SRC_ASSISTANT_SSD_KERNELS_H_
+#define SRC_ASSISTANT_SSD_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ssd {
+
+// C = A * B (+ bias per row). A is M x K, B is K x N and C is M x N, all
+// row-major and densely packed. |bias| may be null. A 1x1 convolution is
+// this product with A = weights (Cout x Cin) and B = input (Cin x H*W).
+// With |relu| the result is clamped at zero before it is stored.
+void Gemm(int m, int n, int k, const float* a, const float* b,
+          const float* bias, bool relu, float* c);
+
+// 3x3 depthwise convolution over |channels| planes of in_h x in_w. Weights
+// are channels x 9, bias is per channel and may be null. |relu| as in Gemm.
+void DepthwiseConv3x3(const float* input, int channels, int in_h, int in_w,
+                      const float* weights, const float* bias, bool relu,
+                      int pad, int stride, float* output, int out_h,
+                      int out_w);
+
+// Unfolds convolution patches of one channel group so a k x k convolution
+// becomes a Gemm: |col| is (channels * kernel_h * kernel_w) x (out_h * out_w).
+void Im2Col(const float* input, int channels, int in_h, int in_w,
+            int kernel_h, int kernel_w, int pad_h, int pad_w, int stride_h,
+            int stride_w, int dilation_h, int dilation_w, int out_h,
+            int out_w, float* col);
+
+// In-place max(x, 0), or x * negative_slope for x < 0 when the slope is
+// nonzero.
+void Relu(float* data, size_t count, float negative_slope);
+
+// INT8 kernels. Quantization is symmetric, q = round(x / scale) clamped to
+// [-127, 127]; accumulation is in int32 and results are written back as
+// float via a per-row scale, so surrounding layers stay in float.
+
+void QuantizeInt8(const float* src, size_t count, float inv_scale,
+                  int8_t* dst);
+
+// Quantizes a K x N row-major matrix into the layout GemmInt8 reads: strips
+// of 8 columns, one after the other, each holding the rows two at a time
+// interleaved per column, {b[2q][j], b[2q+1][j]} for the 8 columns j of the
+// strip. An odd last row is paired with zeros, and the columns of the last
+// strip past N are zero. |packed| holds (K + 1) / 2 * 2 bytes for each of
+// N columns rounded up to a multiple of 8.
+void QuantizePackInt8(const float* src, int k, int n, float inv_scale,
+                      int8_t* packed);
+
+// C = (A * B) * scale[row] + bias[row], optionally clamped at zero. A is
+// M x K int8 row-major with K even (pad weights with a zero column); B is
+// packed by QuantizePackInt8.
+void GemmInt8(int m, int n, int k, const int8_t* a, const int8_t* b,
+              const float* scale, const float* bias, bool relu, float* c);
+
+// DepthwiseConv3x3 on quantized planes; |scale| and |bias| are per channel.
+void DepthwiseConv3x3Int8(const int8_t* input, int channels, int in_h,
+                          int in_w, const int8_t* weights, const float* scale,
+                          const float* bias, bool relu, int pad, int stride,
+                          float* output, int out_h, int out_w);
+
+// Single-class SSD postprocessing. Boxes are kept structure-of-arrays
+// (separate x0, y0, x1, y1 arrays) so overlaps are computed four at a time.
+
+// Writes every i < count with values[i * stride] > threshold to |indices|,
+// in increasing order, and returns how many there are. |indices| holds
+// |count| entries.
+int SelectAboveThreshold(const float* values, int count, int stride,
+                         float threshold, int* indices);
+
+// Decodes the CENTER_SIZE offsets in |loc| of the priors listed in
+// |indices| to corner boxes. |priors| and |variances| are the two halves
+// of a PriorBox output.
+void DecodeBoxes(const float* loc, const float* priors,
+                 const float* variances, const int* indices, int count,
+                 float* x0, float* y0, float* x1, float* y1);
+
+// Greedy non-maximum suppression without sorting: repeatedly keeps the
+// highest remaining score (the lowest position on ties) and drops every
+// box whose IoU with it exceeds |iou_threshold|. Writes up to |max_keep|
+// kept positions to |keep| in descending score order and returns how many.
+// |scores| is overwritten. All arrays must be readable up to |count|
+// rounded up to a multiple of four.
+int NonMaxSuppression(const float* x0, const float* y0, const float* x1,
+                      const float* y1, float* scores, int count,
+                      float iou_threshold, int max_keep, int* keep);
+
+}  // namespace ssd
+
+#endif  // SRC_ASSISTANT_SSD_KERNELS_H_
@@ -0,0 +1,1049 @@
+#include "assistant/ssd_layers.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <utility>
+
+#include "assistant/ssd_kernels.h"
+#include "assistant/ssd_simd.h"
+
+namespace ssd {
+
+Layer::Layer(const LayerSpec& spec)
+    : name_(spec.name),
+      type_(spec.type),
+      bottoms_(spec.bottoms),
+      tops_(spec.tops),
+      weights_(spec.weights) {}
+
+bool Layer::Fail(const std::string& what, std::string* error) const {
+  *error = type_ + " layer " + name_ + ": " + what;
+  return false;
+}
+
+// Reads a Caffe spatial parameter that may be given either as |name| (one
+// value for both axes, possibly repeated per axis) or as |name|_h/|name|_w.
+static void SpatialParam(const TextMessage& params, const std::string& name,
+                         int fallback, int* h, int* w) {
+  std::vector<int> values = params.GetInts(name);
+  if (values.size() == 1) {
+    *h = *w = values[0];
+  } else if (values.size() >= 2) {
+    *h = values[0];
+    *w = values[1];
+  } else {
+    *h = params.GetInt(name + "_h", fallback);
+    *w = params.GetInt(name + "_w", fallback);
+  }
+}
+
+ConvolutionLayer::ConvolutionLayer(const LayerSpec& spec)
+    : Layer(spec),
+      relu_(false),
+      hwc_target_(nullptr),
+      hwc_offset_(0),
+      qweights_row_(0),
+      input_inv_scale_(0) {
+  const TextMessage& params = spec.params->Child("convolution_param");
+  num_output_ = params.GetInt("num_output", 0);
+  group_ = params.GetInt("group", 1);
+  bias_term_ = params.GetBool("bias_term", true);
+  SpatialParam(params, "kernel_size", 1, &kernel_h_, &kernel_w_);
+  SpatialParam(params, "pad", 0, &pad_h_, &pad_w_);
+  SpatialParam(params, "stride", 1, &stride_h_, &stride_w_);
+  SpatialParam(params, "dilation", 1, &dilation_h_, &dilation_w_);
+}
+
+bool ConvolutionLayer::Setup(const std::vector<Blob*>& bottoms,
+                             const std::vector<Blob*>& tops,
+                             std::string* error) {
+  const Blob& input = *bottoms[0];
+  if (input.num_axes() != 4) {
+    return Fail("expects a 4-D input", error);
+  }
+  in_channels_ = input.dim(1);
+  in_h_ = input.dim(2);
+  in_w_ = input.dim(3);
+  if (group_ <= 0 || in_channels_ % group_ != 0 || num_output_ % group_ != 0) {
+    return Fail("channels are not divisible by group", error);
+  }
+  size_t expected =
+      static_cast<size_t>(num_output_) * (in_channels_ / group_) * kernel_h_ *
+      kernel_w_;
+  if (weights_.empty() || weights_[0].data.size() != expected) {
+    return Fail("missing or mis-sized weights", error);
+  }
+  weights_data_ = weights_[0].data;
+  bias_.assign(num_output_, 0.0f);
+  if (bias_term_) {
+    if (weights_.size() < 2 ||
+        weights_[1].data.size() != static_cast<size_t>(num_output_)) {
+      return Fail("missing or mis-sized bias", error);
+    }
+    bias_ = weights_[1].data;
+  }
+  weights_.clear();
+
+  out_h_ = (in_h_ + 2 * pad_h_ - (dilation_h_ * (kernel_h_ - 1) + 1)) /
+               stride_h_ + 1;
+  out_w_ = (in_w_ + 2 * pad_w_ - (dilation_w_ * (kernel_w_ - 1) + 1)) /
+               stride_w_ + 1;
+  tops[0]->Reshape({1, num_output_, out_h_, out_w_});
+
+  bool pointwise = kernel_h_ == 1 && kernel_w_ == 1 && pad_h_ == 0 &&
+                   pad_w_ == 0 && stride_h_ == 1 && stride_w_ == 1 &&
+                   group_ == 1;
+  if (!pointwise && !IsDepthwise3x3()) {
+    col_.resize(static_cast<size_t>(in_channels_ / group_) * kernel_h_ *
+                kernel_w_ * out_h_ * out_w_);
+  }
+  return true;
+}
+
+bool ConvolutionLayer::IsDepthwise3x3() const {
+  return group_ == in_channels_ && group_ == num_output_ && kernel_h_ == 3 &&
+         kernel_w_ == 3 && dilation_h_ == 1 && dilation_w_ == 1 &&
+         pad_h_ == pad_w_ && stride_h_ == stride_w_ &&
+         (stride_h_ == 1 || stride_h_ == 2);
+}
+
+void ConvolutionLayer::FoldAffine(const std::vector<float>& scale,
+                                  const std::vector<float>& shift) {
+  size_t per_output = weights_data_.size() / num_output_;
+  for (int o = 0; o < num_output_; o++) {
+    float* w = weights_data_.data() + o * per_output;
+    for (size_t i = 0; i < per_output; i++) {
+      w[i] *= scale[o];
+    }
+    bias_[o] = bias_[o] * scale[o] + shift[o];
+  }
+}
+
+void ConvolutionLayer::SetHwcOutput(Blob* target, size_t offset) {
+  hwc_target_ = target;
+  hwc_offset_ = offset;
+  chw_.resize(static_cast<size_t>(num_output_) * out_h_ * out_w_);
+}
+
+bool ConvolutionLayer::EnableInt8(float input_range) {
+  bool depthwise = IsDepthwise3x3();
+  if (group_ != 1 && !depthwise) {
+    return false;
+  }
+  int row = static_cast<int>(weights_data_.size() / num_output_);
+  qweights_row_ = depthwise ? row : (row + 1) / 2 * 2;
+  qweights_.assign(static_cast<size_t>(num_output_) * qweights_row_, 0);
+  out_scale_.resize(num_output_);
+  float input_scale = input_range > 0 ? input_range / 127 : 1.0f;
+  input_inv_scale_ = 1 / input_scale;
+  for (int o = 0; o < num_output_; o++) {
+    const float* w = weights_data_.data() + o * row;
+    float range = 0;
+    for (int i = 0; i < row; i++) {
+      range = std::max(range, std::fabs(w[i]));
+    }
+    float weight_scale = range > 0 ? range / 127 : 1.0f;
+    QuantizeInt8(w, row, 1 / weight_scale,
+                 qweights_.data() + o * qweights_row_);
+    out_scale_[o] = input_scale * weight_scale;
+  }
+
+  if (depthwise) {
+    qinput_.resize(static_cast<size_t>(in_channels_) * in_h_ * in_w_);
+  } else {
+    int k = col_.empty() ? in_channels_ : row;
+    qinput_.resize(static_cast<size_t>((k + 1) / 2) * 2 *
+                   ((out_h_ * out_w_ + 7) / 8 * 8));
+  }
+  return true;
+}
+
+void ConvolutionLayer::Forward(const std::vector<Blob*>& bottoms,
+                               const std::vector<Blob*>& tops) {
+  const float* input = bottoms[0]->data.data();
+  float* output =
+      hwc_target_ != nullptr ? chw_.data() : tops[0]->data.data();
+  int out_size = out_h_ * out_w_;
+
+  if (int8() && IsDepthwise3x3()) {
+    QuantizeInt8(input, qinput_.size(), input_inv_scale_, qinput_.data());
+    DepthwiseConv3x3Int8(qinput_.data(), in_channels_, in_h_, in_w_,
+                         qweights_.data(), out_scale_.data(), bias_.data(),
+                         relu_, pad_h_, stride_h_, output, out_h_, out_w_);
+  } else if (int8()) {
+    int k = in_channels_;
+    if (!col_.empty()) {
+      k *= kernel_h_ * kernel_w_;
+      Im2Col(input, in_channels_, in_h_, in_w_, kernel_h_, kernel_w_, pad_h_,
+             pad_w_, stride_h_, stride_w_, dilation_h_, dilation_w_, out_h_,
+             out_w_, col_.data());
+      input = col_.data();
+    }
+    QuantizePackInt8(input, k, out_size, input_inv_scale_, qinput_.data());
+    GemmInt8(num_output_, out_size, qweights_row_, qweights_.data(),
+             qinput_.data(), out_scale_.data(), bias_.data(), relu_, output);
+  } else if (IsDepthwise3x3()) {
+    DepthwiseConv3x3(input, in_channels_, in_h_, in_w_, weights_data_.data(),
+                     bias_.data(), relu_, pad_h_, stride_h_, output, out_h_,
+                     out_w_);
+  } else if (col_.empty()) {
+    Gemm(num_output_, out_size, in_channels_, weights_data_.data(), input,
+         bias_.data(), relu_, output);
+  } else {
+    int in_group = in_channels_ / group_;
+    int out_group = num_output_ / group_;
+    int k = in_group * kernel_h_ * kernel_w_;
+    for (int g = 0; g < group_; g++) {
+      Im2Col(input + static_cast<size_t>(g) * in_group * in_h_ * in_w_,
+             in_group, in_h_, in_w_, kernel_h_, kernel_w_, pad_h_, pad_w_,
+             stride_h_, stride_w_, dilation_h_, dilation_w_, out_h_, out_w_,
+             col_.data());
+      Gemm(out_group, out_size, k,
+           weights_data_.data() + static_cast<size_t>(g) * out_group * k,
+           col_.data(), bias_.data() + g * out_group, relu_,
+           output + static_cast<size_t>(g) * out_group * out_size);
+    }
+  }
+
+  if (hwc_target_ != nullptr) {
+    float* dst = hwc_target_->data.data() + hwc_offset_;
+    for (int p = 0; p < out_size; p++) {
+      for (int o = 0; o < num_output_; o++) {
+        *dst++ = output[o * out_size + p];
+      }
+    }
+  }
+}
+
+ReluLayer::ReluLayer(const LayerSpec& spec) : Layer(spec) {
+  negative_slope_ =
+      spec.params->Child("relu_param").GetFloat("negative_slope", 0);
+}
+
+bool ReluLayer::Setup(const std::vector<Blob*>& bottoms,
+                      const std::vector<Blob*>& tops, std::string* error) {
+  tops[0]->Reshape(bottoms[0]->shape);
+  return true;
+}
+
+void ReluLayer::Forward(const std::vector<Blob*>& bottoms,
+                        const std::vector<Blob*>& tops) {
+  if (tops[0] != bottoms[0]) {
+    tops[0]->data = bottoms[0]->data;
+  }
+  Relu(tops[0]->data.data(), tops[0]->count(), negative_slope_);
+}
+
+ChannelAffineLayer::ChannelAffineLayer(const LayerSpec& spec)
+    : Layer(spec), relu_(false) {
+  eps_ = spec.params->Child("batch_norm_param").GetFloat("eps", 1e-5f);
+}
+
+bool ChannelAffineLayer::Setup(const std::vector<Blob*>& bottoms,
+                               const std::vector<Blob*>& tops,
+                               std::string* error) {
+  int channels = bottoms[0]->dim(1);
+  if (type_ == "BatchNorm") {
+    if (weights_.size() < 3 || weights_[2].data.empty()) {
+      return Fail("expects mean, variance and scale factor blobs", error);
+    }
+    const std::vector<float>& mean = weights_[0].data;
+    const std::vector<float>& variance = weights_[1].data;
+    if (mean.size() != static_cast<size_t>(channels) ||
+        variance.size() != static_cast<size_t>(channels)) {
+      return Fail("statistics do not match the channel count", error);
+    }
+    float factor = weights_[2].data[0];
+    factor = factor == 0 ? 0 : 1 / factor;
+    scale_.resize(channels);
+    shift_.resize(channels);
+    for (int c = 0; c < channels; c++) {
+      scale_[c] = 1 / std::sqrt(variance[c] * factor + eps_);
+      shift_[c] = -mean[c] * factor * scale_[c];
+    }
+  } else {
+    if (weights_.empty() ||
+        weights_[0].data.size() != static_cast<size_t>(channels)) {
+      return Fail("expects one scale per channel", error);
+    }
+    scale_ = weights_[0].data;
+    shift_.assign(channels, 0.0f);
+    if (weights_.size() > 1) {
+      if (weights_[1].data.size() != static_cast<size_t>(channels)) {
+        return Fail("expects one bias per channel", error);
+      }
+      shift_ = weights_[1].data;
+    }
+  }
+  weights_.clear();
+  tops[0]->Reshape(bottoms[0]->shape);
+  return true;
+}
+
+void ChannelAffineLayer::Forward(const std::vector<Blob*>& bottoms,
+                                 const std::vector<Blob*>& tops) {
+  const Blob& input = *bottoms[0];
+  Blob* output = tops[0];
+  int channels = input.dim(1);
+  size_t plane = input.CountRange(2, input.num_axes());
+  for (int c = 0; c < channels; c++) {
+    const float* src = input.data.data() + c * plane;
+    float* dst = output->data.data() + c * plane;
+    v4f scale = V4Set1(scale_[c]);
+    v4f shift = V4Set1(shift_[c]);
+    v4f zero = V4Set1(0);
+    size_t i = 0;
+    for (; i + 4 <= plane; i += 4) {
+      v4f y = V4Fma(shift, V4Load(src + i), scale);
+      V4Store(dst + i, relu_ ? V4Max(y, zero) : y);
+    }
+    for (; i < plane; i++) {
+      float y = src[i] * scale_[c] + shift_[c];
+      dst[i] = relu_ && y < 0 ? 0 : y;
+    }
+  }
+}
+
+void ChannelAffineLayer::Compose(const ChannelAffineLayer& next) {
+  for (size_t c = 0; c < scale_.size(); c++) {
+    scale_[c] *= next.scale_[c];
+    shift_[c] = shift_[c] * next.scale_[c] + next.shift_[c];
+  }
+}
+
+PoolingLayer::PoolingLayer(const LayerSpec& spec) : Layer(spec) {
+  const TextMessage& params = spec.params->Child("pooling_param");
+  max_ = params.GetString("pool", "MAX") == "MAX";
+  SpatialParam(params, "kernel_size", 1, &kernel_h_, &kernel_w_);
+  SpatialParam(params, "pad", 0, &pad_h_, &pad_w_);
+  SpatialParam(params, "stride", 1, &stride_h_, &stride_w_);
+  if (params.GetBool("global_pooling", false)) {
+    kernel_h_ = kernel_w_ = -1;
+  }
+}
+
+bool PoolingLayer::Setup(const std::vector<Blob*>& bottoms,
+                         const std::vector<Blob*>& tops, std::string* error) {
+  const Blob& input = *bottoms[0];
+  if (input.num_axes() != 4) {
+    return Fail("expects a 4-D input", error);
+  }
+  int h = input.dim(2);
+  int w = input.dim(3);
+  if (kernel_h_ < 0) {
+    kernel_h_ = h;
+    kernel_w_ = w;
+    pad_h_ = pad_w_ = 0;
+    stride_h_ = stride_w_ = 1;
+  }
+  // Caffe rounds pooled sizes up, then drops a last window that would start
+  // inside the padding.
+  int out_h = static_cast<int>(
+      std::ceil(static_cast<float>(h + 2 * pad_h_ - kernel_h_) / stride_h_)) +
+      1;
+  int out_w = static_cast<int>(
+      std::ceil(static_cast<float>(w + 2 * pad_w_ - kernel_w_) / stride_w_)) +
+      1;
+  if (pad_h_ > 0 && (out_h - 1) * stride_h_ >= h + pad_h_) {
+    out_h--;
+  }
+  if (pad_w_ > 0 && (out_w - 1) * stride_w_ >= w + pad_w_) {
+    out_w--;
+  }
+  tops[0]->Reshape({1, input.dim(1), out_h, out_w});
+  return true;
+}
+
+void PoolingLayer::Forward(const std::vector<Blob*>& bottoms,
+                           const std::vector<Blob*>& tops) {
+  const Blob& input = *bottoms[0];
+  Blob* output = tops[0];
+  int channels = input.dim(1);
+  int h = input.dim(2);
+  int w = input.dim(3);
+  int out_h = output->dim(2);
+  int out_w = output->dim(3);
+  for (int c = 0; c < channels; c++) {
+    const float* src = input.data.data() + static_cast<size_t>(c) * h * w;
+    float* dst = output->data.data() + static_cast<size_t>(c) * out_h * out_w;
+    for (int oy = 0; oy < out_h; oy++) {
+      for (int ox = 0; ox < out_w; ox++) {
+        int y0 = oy * stride_h_ - pad_h_;
+        int x0 = ox * stride_w_ - pad_w_;
+        int y1 = std::min(y0 + kernel_h_, h + pad_h_);
+        int x1 = std::min(x0 + kernel_w_, w + pad_w_);
+        int pool_size = (y1 - y0) * (x1 - x0);
+        y0 = std::max(y0, 0);
+        x0 = std::max(x0, 0);
+        y1 = std::min(y1, h);
+        x1 = std::min(x1, w);
+        float value = max_ ? -FLT_MAX : 0.0f;
+        for (int y = y0; y < y1; y++) {
+          for (int x = x0; x < x1; x++) {
+            float v = src[y * w + x];
+            value = max_ ? std::max(value, v) : value + v;
+          }
+        }
+        dst[oy * out_w + ox] = max_ ? value : value / pool_size;
+      }
+    }
+  }
+}
+
+EltwiseLayer::EltwiseLayer(const LayerSpec& spec) : Layer(spec) {
+  const TextMessage& params = spec.params->Child("eltwise_param");
+  std::string operation = params.GetString("operation", "SUM");
+  operation_ = operation == "PROD" ? kProd : operation == "MAX" ? kMax : kSum;
+  coeffs_ = params.GetFloats("coeff");
+}
+
+bool EltwiseLayer::Setup(const std::vector<Blob*>& bottoms,
+                         const std::vector<Blob*>& tops, std::string* error) {
+  for (const Blob* bottom : bottoms) {
+    if (bottom->shape != bottoms[0]->shape) {
+      return Fail("inputs differ in shape", error);
+    }
+  }
+  if (!coeffs_.empty() && coeffs_.size() != bottoms.size()) {
+    return Fail("needs one coefficient per input", error);
+  }
+  coeffs_.resize(bottoms.size(), 1.0f);
+  tops[0]->Reshape(bottoms[0]->shape);
+  return true;
+}
+
+void EltwiseLayer::Forward(const std::vector<Blob*>& bottoms,
+                           const std::vector<Blob*>& tops) {
+  size_t count = bottoms[0]->count();
+  float* dst = tops[0]->data.data();
+  const float* first = bottoms[0]->data.data();
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = operation_ == kSum ? first[i] * coeffs_[0] : first[i];
+  }
+  for (size_t b = 1; b < bottoms.size(); b++) {
+    const float* src = bottoms[b]->data.data();
+    float coeff = coeffs_[b];
+    for (size_t i = 0; i < count; i++) {
+      switch (operation_) {
+        case kSum:
+          dst[i] += src[i] * coeff;
+          break;
+        case kProd:
+          dst[i] *= src[i];
+          break;
+        case kMax:
+          dst[i] = std::max(dst[i], src[i]);
+          break;
+      }
+    }
+  }
+}
+
+NormalizeLayer::NormalizeLayer(const LayerSpec& spec) : Layer(spec) {
+  eps_ = spec.params->Child("norm_param").GetFloat("eps", 1e-10f);
+}
+
+bool NormalizeLayer::Setup(const std::vector<Blob*>& bottoms,
+                           const std::vector<Blob*>& tops,
+                           std::string* error) {
+  int channels = bottoms[0]->dim(1);
+  if (weights_.empty() || weights_[0].data.empty()) {
+    return Fail("missing scale blob", error);
+  }
+  scale_ = weights_[0].data;
+  if (scale_.size() == 1) {
+    scale_.assign(channels, scale_[0]);  // channel_shared
+  } else if (scale_.size() != static_cast<size_t>(channels)) {
+    return Fail("scale does not match the channel count", error);
+  }
+  weights_.clear();
+  tops[0]->Reshape(bottoms[0]->shape);
+  return true;
+}
+
+void NormalizeLayer::Forward(const std::vector<Blob*>& bottoms,
+                             const std::vector<Blob*>& tops) {
+  // across_spatial: false, as used by every SSD deploy prototxt.
+  const Blob& input = *bottoms[0];
+  int channels = input.dim(1);
+  size_t plane = input.CountRange(2, input.num_axes());
+  std::vector<float> norm(plane, eps_);
+  for (int c = 0; c < channels; c++) {
+    const float* src = input.data.data() + c * plane;
+    for (size_t i = 0; i < plane; i++) {
+      norm[i] += src[i] * src[i];
+    }
+  }
+  for (size_t i = 0; i < plane; i++) {
+    norm[i] = 1 / std::sqrt(norm[i]);
+  }
+  for (int c = 0; c < channels; c++) {
+    const float* src = input.data.data() + c * plane;
+    float* dst = tops[0]->data.data() + c * plane;
+    for (size_t i = 0; i < plane; i++) {
+      dst[i] = src[i] * norm[i] * scale_[c];
+    }
+  }
+}
+
+PermuteLayer::PermuteLayer(const LayerSpec& spec)
+    : Layer(spec), identity_(true) {
+  order_ = spec.params->Child("permute_param").GetInts("order");
+}
+
+bool PermuteLayer::Setup(const std::vector<Blob*>& bottoms,
+                         const std::vector<Blob*>& tops, std::string* error) {
+  const Blob& input = *bottoms[0];
+  int axes = input.num_axes();
+  for (int axis = 0; axis < axes; axis++) {
+    if (std::find(order_.begin(), order_.end(), axis) == order_.end()) {
+      order_.push_back(axis);
+    }
+  }
+  if (static_cast<int>(order_.size()) != axes || axes > 4) {
+    return Fail("invalid order", error);
+  }
+  std::vector<int> shape(axes);
+  for (int i = 0; i < axes; i++) {
+    shape[i] = input.shape[order_[i]];
+    identity_ = identity_ && order_[i] == i;
+  }
+  tops[0]->Reshape(shape);
+  return true;
+}
+
+void PermuteLayer::Forward(const std::vector<Blob*>& bottoms,
+                           const std::vector<Blob*>& tops) {
+  const Blob& input = *bottoms[0];
+  Blob* output = tops[0];
+  if (identity_) {
+    output->data = input.data;
+    return;
+  }
+  // Pad to four axes so one loop nest handles every order.
+  int dims[4] = {1, 1, 1, 1};
+  size_t in_strides[4] = {0, 0, 0, 0};
+  int axes = input.num_axes();
+  for (int i = 0; i < axes; i++) {
+    dims[i] = output->shape[i];
+    in_strides[i] = input.CountRange(order_[i] + 1, axes);
+  }
+  float* dst = output->data.data();
+  const float* src = input.data.data();
+  for (int a = 0; a < dims[0]; a++) {
+    for (int b = 0; b < dims[1]; b++) {
+      for (int c = 0; c < dims[2]; c++) {
+        const float* base =
+            src + a * in_strides[0] + b * in_strides[1] + c * in_strides[2];
+        for (int d = 0; d < dims[3]; d++) {
+          *dst++ = base[d * in_strides[3]];
+        }
+      }
+    }
+  }
+}
+
+ReshapeLayer::ReshapeLayer(const LayerSpec& spec) : Layer(spec) {
+  params_ = spec.params;
+}
+
+bool ReshapeLayer::Setup(const std::vector<Blob*>& bottoms,
+                         const std::vector<Blob*>& tops, std::string* error) {
+  const Blob& input = *bottoms[0];
+  std::vector<int> shape;
+  if (type_ == "Flatten") {
+    const TextMessage& params = params_->Child("flatten_param");
+    int axis = input.CanonicalAxis(params.GetInt("axis", 1));
+    int end_axis = input.CanonicalAxis(params.GetInt("end_axis", -1));
+    for (int i = 0; i < axis; i++) {
+      shape.push_back(input.shape[i]);
+    }
+    shape.push_back(static_cast<int>(input.CountRange(axis, end_axis + 1)));
+    for (int i = end_axis + 1; i < input.num_axes(); i++) {
+      shape.push_back(input.shape[i]);
+    }
+  } else {
+    std::vector<int> dims =
+        params_->Child("reshape_param").Child("shape").GetInts("dim");
+    int inferred = -1;
+    size_t known = 1;
+    for (size_t i = 0; i < dims.size(); i++) {
+      int dim = dims[i];
+      if (dim == 0) {
+        dim = input.dim(static_cast<int>(i));
+      } else if (dim == -1) {
+        inferred = static_cast<int>(i);
+        dim = 1;
+      }
+      shape.push_back(dim);
+      known *= dim;
+    }
+    if (inferred >= 0) {
+      shape[inferred] = static_cast<int>(input.count() / known);
+    }
+  }
+  tops[0]->Reshape(shape);
+  if (tops[0]->count() != input.count()) {
+    return Fail("element count changes", error);
+  }
+  return true;
+}
+
+void ReshapeLayer::Forward(const std::vector<Blob*>& bottoms,
+                           const std::vector<Blob*>& tops) {
+  if (tops[0] != bottoms[0]) {
+    memcpy(tops[0]->data.data(), bottoms[0]->data.data(),
+           bottoms[0]->count() * sizeof(float));
+  }
+}
+
+ConcatLayer::ConcatLayer(const LayerSpec& spec) : Layer(spec) {
+  const TextMessage& params = spec.params->Child("concat_param");
+  axis_ = params.GetInt("axis", params.GetInt("concat_dim", 1));
+}
+
+bool ConcatLayer::Setup(const std::vector<Blob*>& bottoms,
+                        const std::vector<Blob*>& tops, std::string* error) {
+  std::vector<int> shape = bottoms[0]->shape;
+  axis_ = bottoms[0]->CanonicalAxis(axis_);
+  for (size_t b = 1; b < bottoms.size(); b++) {
+    const Blob& bottom = *bottoms[b];
+    if (bottom.num_axes() != static_cast<int>(shape.size())) {
+      return Fail("inputs differ in rank", error);
+    }
+    for (int i = 0; i < bottom.num_axes(); i++) {
+      if (i != axis_ && bottom.shape[i] != shape[i]) {
+        return Fail("inputs differ outside the concat axis", error);
+      }
+    }
+    shape[axis_] += bottom.shape[axis_];
+  }
+  tops[0]->Reshape(shape);
+  return true;
+}
+
+void ConcatLayer::Forward(const std::vector<Blob*>& bottoms,
+                          const std::vector<Blob*>& tops) {
+  Blob* output = tops[0];
+  size_t outer = output->CountRange(0, axis_);
+  size_t out_inner = output->CountRange(axis_, output->num_axes());
+  size_t offset = 0;
+  for (const Blob* bottom : bottoms) {
+    size_t inner = bottom->CountRange(axis_, bottom->num_axes());
+    for (size_t o = 0; o < outer; o++) {
+      memcpy(output->data.data() + o * out_inner + offset,
+             bottom->data.data() + o * inner, inner * sizeof(float));
+    }
+    offset += inner;
+  }
+}
+
+SoftmaxLayer::SoftmaxLayer(const LayerSpec& spec) : Layer(spec) {
+  axis_ = spec.params->Child("softmax_param").GetInt("axis", 1);
+}
+
+bool SoftmaxLayer::Setup(const std::vector<Blob*>& bottoms,
+                         const std::vector<Blob*>& tops, std::string* error) {
+  axis_ = bottoms[0]->CanonicalAxis(axis_);
+  tops[0]->Reshape(bottoms[0]->shape);
+  return true;
+}
+
+void SoftmaxLayer::Forward(const std::vector<Blob*>& bottoms,
+                           const std::vector<Blob*>& tops) {
+  const Blob& input = *bottoms[0];
+  size_t outer = input.CountRange(0, axis_);
+  int channels = input.dim(axis_);
+  size_t inner = input.CountRange(axis_ + 1, input.num_axes());
+  for (size_t o = 0; o < outer; o++) {
+    for (size_t i = 0; i < inner; i++) {
+      const float* src = input.data.data() + o * channels * inner + i;
+      float* dst = tops[0]->data.data() + o * channels * inner + i;
+      float max_value = -FLT_MAX;
+      for (int c = 0; c < channels; c++) {
+        max_value = std::max(max_value, src[c * inner]);
+      }
+      float sum = 0;
+      for (int c = 0; c < channels; c++) {
+        dst[c * inner] = std::exp(src[c * inner] - max_value);
+        sum += dst[c * inner];
+      }
+      for (int c = 0; c < channels; c++) {
+        dst[c * inner] /= sum;
+      }
+    }
+  }
+}
+
+PriorBoxLayer::PriorBoxLayer(const LayerSpec& spec) : Layer(spec) {
+  params_ = spec.params;
+}
+
+bool PriorBoxLayer::Setup(const std::vector<Blob*>& bottoms,
+                          const std::vector<Blob*>& tops,
+                          std::string* error) {
+  const TextMessage& params = params_->Child("prior_box_param");
+  std::vector<float> min_sizes = params.GetFloats("min_size");
+  std::vector<float> max_sizes = params.GetFloats("max_size");
+  bool flip = params.GetBool("flip", true);
+  bool clip = params.GetBool("clip", false);
+  std::vector<float> variances = params.GetFloats("variance");
+  float offset = params.GetFloat("offset", 0.5f);
+  if (min_sizes.empty() ||
+      (!max_sizes.empty() && max_sizes.size() != min_sizes.size())) {
+    return Fail("needs min_size and matching max_size values", error);
+  }
+  if (variances.empty()) {
+    variances.push_back(0.1f);
+  }
+  if (variances.size() != 1 && variances.size() != 4) {
+    return Fail("needs one or four variances", error);
+  }
+
+  std::vector<float> aspect_ratios(1, 1.0f);
+  for (float ratio : params.GetFloats("aspect_ratio")) {
+    bool exists = false;
+    for (float existing : aspect_ratios) {
+      exists = exists || std::fabs(ratio - existing) < 1e-6f;
+    }
+    if (!exists) {
+      aspect_ratios.push_back(ratio);
+      if (flip) {
+        aspect_ratios.push_back(1 / ratio);
+      }
+    }
+  }
+
+  int layer_h = bottoms[0]->dim(2);
+  int layer_w = bottoms[0]->dim(3);
+  float image_h = bottoms[1]->dim(2);
+  float image_w = bottoms[1]->dim(3);
+  float step_h = params.GetFloat("step_h", params.GetFloat("step", 0));
+  float step_w = params.GetFloat("step_w", params.GetFloat("step", 0));
+  if (step_h == 0) {
+    step_h = image_h / layer_h;
+    step_w = image_w / layer_w;
+  }
+
+  // Box sizes in the order Caffe emits them for every location.
+  std::vector<std::pair<float, float>> boxes;
+  for (size_t s = 0; s < min_sizes.size(); s++) {
+    float min_size = min_sizes[s];
+    boxes.push_back(std::make_pair(min_size, min_size));
+    if (!max_sizes.empty()) {
+      float size = std::sqrt(min_size * max_sizes[s]);
+      boxes.push_back(std::make_pair(size, size));
+    }
+    for (float ratio : aspect_ratios) {
+      if (std::fabs(ratio - 1) < 1e-6f) {
+        continue;
+      }
+      boxes.push_back(std::make_pair(min_size * std::sqrt(ratio),
+                                     min_size / std::sqrt(ratio)));
+    }
+  }
+
+  int count = layer_h * layer_w * static_cast<int>(boxes.size()) * 4;
+  priors_.resize(2 * count);
+  float* coords = priors_.data();
+  for (int h = 0; h < layer_h; h++) {
+    for (int w = 0; w < layer_w; w++) {
+      float center_x = (w + offset) * step_w;
+      float center_y = (h + offset) * step_h;
+      for (const auto& box : boxes) {
+        *coords++ = (center_x - box.first / 2) / image_w;
+        *coords++ = (center_y - box.second / 2) / image_h;
+        *coords++ = (center_x + box.first / 2) / image_w;
+        *coords++ = (center_y + box.second / 2) / image_h;
+      }
+    }
+  }
+  if (clip) {
+    for (int i = 0; i < count; i++) {
+      priors_[i] = std::min(std::max(priors_[i], 0.0f), 1.0f);
+    }
+  }
+  float* variance = priors_.data() + count;
+  for (int i = 0; i < count; i++) {
+    variance[i] = variances.size() == 1 ? variances[0] : variances[i % 4];
+  }
+  tops[0]->Reshape({1, 2, count});
+  tops[0]->data = priors_;
+  return true;
+}
+
+void PriorBoxLayer::Forward(const std::vector<Blob*>& bottoms,
+                            const std::vector<Blob*>& tops) {
+  // Generated in Setup(); nothing depends on the input values.
+}
+
+DetectionOutputLayer::DetectionOutputLayer(const LayerSpec& spec)
+    : Layer(spec), num_priors_(0), single_class_(-1) {
+  const TextMessage& params = spec.params->Child("detection_output_param");
+  num_classes_ = params.GetInt("num_classes", 0);
+  background_label_ = params.GetInt("background_label_id", 0);
+  nms_threshold_ = params.Child("nms_param").GetFloat("nms_threshold", 0.3f);
+  top_k_ = params.Child("nms_param").GetInt("top_k", -1);
+  keep_top_k_ = params.GetInt("keep_top_k", -1);
+  confidence_threshold_ = params.GetFloat("confidence_threshold", -FLT_MAX);
+  share_location_ = params.GetBool("share_location", true);
+  code_type_ = params.GetString("code_type", "CORNER");
+}
+
+bool DetectionOutputLayer::Setup(const std::vector<Blob*>& bottoms,
+                                 const std::vector<Blob*>& tops,
+                                 std::string* error) {
+  if (bottoms.size() != 3) {
+    return Fail("expects loc, conf and prior inputs", error);
+  }
+  if (!share_location_ || code_type_ != "CENTER_SIZE") {
+    return Fail("only shared CENTER_SIZE locations are supported", error);
+  }
+  num_priors_ = bottoms[2]->dim(2) / 4;
+  if (bottoms[0]->count() != static_cast<size_t>(num_priors_) * 4 ||
+      bottoms[1]->count() != static_cast<size_t>(num_priors_) * num_classes_) {
+    return Fail("loc/conf sizes do not match the priors", error);
+  }
+  decoded_.resize(num_priors_ * 4);
+  tops[0]->Reshape({1, 1, 1, 7});
+  return true;
+}
+
+bool DetectionOutputLayer::KeepOnlyClass(int label, float min_confidence) {
+  if (label < 0 || label >= num_classes_ || label == background_label_) {
+    return false;
+  }
+  single_class_ = label;
+  confidence_threshold_ = std::max(confidence_threshold_, min_confidence);
+  size_t padded = (num_priors_ + 3) & ~3;
+  candidates_.resize(num_priors_);
+  box_x0_.assign(padded, 0);
+  box_y0_.assign(padded, 0);
+  box_x1_.assign(padded, 0);
+  box_y1_.assign(padded, 0);
+  scores_.assign(padded, 0);
+  keep_.resize(num_priors_);
+  return true;
+}
+
+// Intersection over union of two [xmin, ymin, xmax, ymax] boxes in
+// normalized coordinates.
+static float JaccardOverlap(const float* a, const float* b) {
+  float ix0 = std::max(a[0], b[0]);
+  float iy0 = std::max(a[1], b[1]);
+  float ix1 = std::min(a[2], b[2]);
+  float iy1 = std::min(a[3], b[3]);
+  if (ix1 < ix0 || iy1 < iy0) {
+    return 0;
+  }
+  float inter = (ix1 - ix0) * (iy1 - iy0);
+  float area_a = std::max(0.0f, a[2] - a[0]) * std::max(0.0f, a[3] - a[1]);
+  float area_b = std::max(0.0f, b[2] - b[0]) * std::max(0.0f, b[3] - b[1]);
+  return inter / (area_a + area_b - inter);
+}
+
+void DetectionOutputLayer::Forward(const std::vector<Blob*>& bottoms,
+                                   const std::vector<Blob*>& tops) {
+  const float* loc = bottoms[0]->data.data();
+  const float* conf = bottoms[1]->data.data();
+  const float* priors = bottoms[2]->data.data();
+  const float* variances = priors + num_priors_ * 4;
+  if (single_class_ >= 0) {
+    ForwardSingleClass(loc, conf, priors, tops[0]);
+    return;
+  }
+
+  for (int p = 0; p < num_priors_; p++) {
+    const float* prior = priors + p * 4;
+    const float* var = variances + p * 4;
+    const float* l = loc + p * 4;
+    float prior_w = prior[2] - prior[0];
+    float prior_h = prior[3] - prior[1];
+    float prior_cx = (prior[0] + prior[2]) / 2;
+    float prior_cy = (prior[1] + prior[3]) / 2;
+    float cx = var[0] * l[0] * prior_w + prior_cx;
+    float cy = var[1] * l[1] * prior_h + prior_cy;
+    float w = std::exp(var[2] * l[2]) * prior_w;
+    float h = std::exp(var[3] * l[3]) * prior_h;
+    float* box = decoded_.data() + p * 4;
+    box[0] = cx - w / 2;
+    box[1] = cy - h / 2;
+    box[2] = cx + w / 2;
+    box[3] = cy + h / 2;
+  }
+
+  // (score, (label, prior)) for every box that survives per-class NMS.
+  std::vector<std::pair<float, std::pair<int, int>>> kept;
+  std::vector<std::pair<float, int>> candidates;
+  std::vector<int> selected;
+  for (int c = 0; c < num_classes_; c++) {
+    if (c == background_label_) {
+      continue;
+    }
+    candidates.clear();
+    for (int p = 0; p < num_priors_; p++) {
+      float score = conf[p * num_classes_ + c];
+      if (score > confidence_threshold_) {
+        candidates.push_back(std::make_pair(score, p));
+      }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const std::pair<float, int>& a,
+                        const std::pair<float, int>& b) {
+                       return a.first > b.first;
+                     });
+    if (top_k_ > -1 && static_cast<int>(candidates.size()) > top_k_) {
+      candidates.resize(top_k_);
+    }
+    selected.clear();
+    for (const auto& candidate : candidates) {
+      const float* box = decoded_.data() + candidate.second * 4;
+      bool keep = true;
+      for (int other : selected) {
+        if (JaccardOverlap(box, decoded_.data() + other * 4) >
+            nms_threshold_) {
+          keep = false;
+          break;
+        }
+      }
+      if (keep) {
+        selected.push_back(candidate.second);
+        kept.push_back(std::make_pair(candidate.first,
+                                      std::make_pair(c, candidate.second)));
+      }
+    }
+  }
+
+  if (keep_top_k_ > -1 && static_cast<int>(kept.size()) > keep_top_k_) {
+    std::stable_sort(kept.begin(), kept.end(),
+                     [](const std::pair<float, std::pair<int, int>>& a,
+                        const std::pair<float, std::pair<int, int>>& b) {
+                       return a.first > b.first;
+                     });
+    kept.resize(keep_top_k_);
+    // Restore Caffe's output order: by label, then by score.
+    std::stable_sort(kept.begin(), kept.end(),
+                     [](const std::pair<float, std::pair<int, int>>& a,
+                        const std::pair<float, std::pair<int, int>>& b) {
+                       return a.second.first < b.second.first;
+                     });
+  }
+
+  Blob* output = tops[0];
+  if (kept.empty()) {
+    // Caffe reports "no detections" as a single row of -1.
+    output->Reshape({1, 1, 1, 7});
+    std::fill(output->data.begin(), output->data.end(), -1.0f);
+    return;
+  }
+  output->Reshape({1, 1, static_cast<int>(kept.size()), 7});
+  float* row = output->data.data();
+  for (const auto& detection : kept) {
+    const float* box = decoded_.data() + detection.second.second * 4;
+    row[0] = 0;
+    row[1] = detection.second.first;
+    row[2] = detection.first;
+    row[3] = box[0];
+    row[4] = box[1];
+    row[5] = box[2];
+    row[6] = box[3];
+    row += 7;
+  }
+}
+
+void DetectionOutputLayer::ForwardSingleClass(const float* loc,
+                                              const float* conf,
+                                              const float* priors,
+                                              Blob* output) {
+  int count = SelectAboveThreshold(conf + single_class_, num_priors_,
+                                   num_classes_, confidence_threshold_,
+                                   candidates_.data());
+  for (int i = 0; i < count; i++) {
+    scores_[i] = conf[candidates_[i] * num_classes_ + single_class_];
+  }
+
+  // Keep the top_k best, in prior order as the stable sort of the general
+  // path would: everything above the k-th score, then ties at it by index.
+  if (top_k_ > -1 && count > top_k_) {
+    std::vector<float> ranked(scores_.begin(), scores_.begin() + count);
+    std::nth_element(ranked.begin(), ranked.begin() + top_k_ - 1,
+                     ranked.end(), std::greater<float>());
+    float kth = ranked[top_k_ - 1];
+    int ties = top_k_;
+    for (int i = 0; i < count; i++) {
+      ties -= scores_[i] > kth;
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+      if (scores_[i] > kth || (scores_[i] == kth && ties-- > 0)) {
+        candidates_[kept] = candidates_[i];
+        scores_[kept++] = scores_[i];
+      }
+    }
+    count = kept;
+  }
+
+  DecodeBoxes(loc, priors, priors + num_priors_ * 4, candidates_.data(),
+              count, box_x0_.data(), box_y0_.data(), box_x1_.data(),
+              box_y1_.data());
+  int max_keep = keep_top_k_ > -1 ? keep_top_k_ : count;
+  int kept = NonMaxSuppression(box_x0_.data(), box_y0_.data(),
+                               box_x1_.data(), box_y1_.data(), scores_.data(),
+                               count, nms_threshold_, max_keep, keep_.data());
+
+  if (kept == 0) {
+    output->Reshape({1, 1, 1, 7});
+    std::fill(output->data.begin(), output->data.end(), -1.0f);
+    return;
+  }
+  output->Reshape({1, 1, kept, 7});
+  float* row = output->data.data();
+  for (int i = 0; i < kept; i++) {
+    int k = keep_[i];
+    row[0] = 0;
+    row[1] = single_class_;
+    row[2] = conf[candidates_[k] * num_classes_ + single_class_];
+    row[3] = box_x0_[k];
+    row[4] = box_y0_[k];
+    row[5] = box_x1_[k];
+    row[6] = box_y1_[k];
+    row += 7;
+  }
+}
+
+std::unique_ptr<Layer> CreateLayer(const LayerSpec& spec) {
+  const std::string& type = spec.type;
+  Layer* layer = nullptr;
+  if (type == "Convolution") {
+    layer = new ConvolutionLayer(spec);
+  } else if (type == "ReLU") {
+    layer = new ReluLayer(spec);
+  } else if (type == "BatchNorm" || type == "Scale") {
+    layer = new ChannelAffineLayer(spec);
+  } else if (type == "Pooling") {
+    layer = new PoolingLayer(spec);
+  } else if (type == "Eltwise") {
+    layer = new EltwiseLayer(spec);
+  } else if (type == "Normalize") {
+    layer = new NormalizeLayer(spec);
+  } else if (type == "Permute") {
+    layer = new PermuteLayer(spec);
+  } else if (type == "Flatten" || type == "Reshape") {
+    layer = new ReshapeLayer(spec);
+  } else if (type == "Concat") {
+    layer = new ConcatLayer(spec);
+  } else if (type == "Softmax") {
+    layer = new SoftmaxLayer(spec);
+  } else if (type == "PriorBox") {
+    layer = new PriorBoxLayer(spec);
+  } else if (type == "DetectionOutput") {
+    layer = new DetectionOutputLayer(spec);
+  }
+  return std::unique_ptr<Layer>(layer);
+}
+
+}  // namespace ssd
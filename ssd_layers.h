@@ -0,0 +1,264 @@
+#ifndef SRC_ASSISTANT_SSD_LAYERS_H_
+#define SRC_ASSISTANT_SSD_LAYERS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "assistant/ssd_net.h"
+
+namespace ssd {
+
+class ConvolutionLayer : public Layer {
+ public:
+  explicit ConvolutionLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+  // Load-time fusions used by Net's optimizer, valid after Setup().
+
+  // Folds a following per-output-channel y = x * scale + shift into the
+  // weights and bias.
+  void FoldAffine(const std::vector<float>& scale,
+                  const std::vector<float>& shift);
+  // Clamps the output at zero in the kernel epilogue.
+  void FuseRelu() { relu_ = true; }
+  bool fused_relu() const { return relu_; }
+  // Writes the output permuted to HWC order at |offset| in |target|
+  // instead of to the top blob, replacing an SSD head's
+  // Permute(0,2,3,1) + Flatten + Concat.
+  void SetHwcOutput(Blob* target, size_t offset);
+
+  // Switches to the INT8 kernels: weights are quantized per output channel
+  // and the input per tensor, with |input_range| the largest magnitude the
+  // input is expected to reach. Returns false, leaving the layer in float,
+  // for grouped convolutions other than depthwise 3x3.
+  bool EnableInt8(float input_range);
+  bool int8() const { return !qweights_.empty(); }
+
+ private:
+  int num_output_;
+  int group_;
+  int kernel_h_, kernel_w_;
+  int pad_h_, pad_w_;
+  int stride_h_, stride_w_;
+  int dilation_h_, dilation_w_;
+  bool bias_term_;
+  bool IsDepthwise3x3() const;
+
+  int in_channels_, in_h_, in_w_;
+  int out_h_, out_w_;
+  // Cout x (Cin / group) x kernel_h x kernel_w.
+  std::vector<float> weights_data_;
+  std::vector<float> bias_;
+  // im2col scratch, empty for 1x1 and depthwise convolutions.
+  std::vector<float> col_;
+  bool relu_;
+  // Set by SetHwcOutput(); the CHW result is staged in chw_ first.
+  Blob* hwc_target_;
+  size_t hwc_offset_;
+  std::vector<float> chw_;
+  // INT8 mode: weights padded to an even row length (9 per channel for
+  // depthwise), the dequantization scale per output channel and the
+  // quantized input.
+  std::vector<int8_t> qweights_;
+  int qweights_row_;
+  std::vector<float> out_scale_;
+  float input_inv_scale_;
+  std::vector<int8_t> qinput_;
+};
+
+class ReluLayer : public Layer {
+ public:
+  explicit ReluLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+  float negative_slope() const { return negative_slope_; }
+
+ private:
+  float negative_slope_;
+};
+
+// Per-channel y = x * scale + shift. BatchNorm and Scale both reduce to this
+// once their blobs are loaded.
+class ChannelAffineLayer : public Layer {
+ public:
+  explicit ChannelAffineLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+  const std::vector<float>& scale() const { return scale_; }
+  const std::vector<float>& shift() const { return shift_; }
+  // Applies |next| after this layer's own transform, so the pair runs as
+  // one pass.
+  void Compose(const ChannelAffineLayer& next);
+  void FuseRelu() { relu_ = true; }
+  bool fused_relu() const { return relu_; }
+
+ private:
+  float eps_;
+  std::vector<float> scale_;
+  std::vector<float> shift_;
+  bool relu_;
+};
+
+class PoolingLayer : public Layer {
+ public:
+  explicit PoolingLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+ private:
+  bool max_;
+  int kernel_h_, kernel_w_;
+  int pad_h_, pad_w_;
+  int stride_h_, stride_w_;
+};
+
+class EltwiseLayer : public Layer {
+ public:
+  explicit EltwiseLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+ private:
+  enum Operation { kProd, kSum, kMax };
+  Operation operation_;
+  std::vector<float> coeffs_;
+};
+
+// SSD's L2 normalization across channels at each spatial position.
+class NormalizeLayer : public Layer {
+ public:
+  explicit NormalizeLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+ private:
+  float eps_;
+  std::vector<float> scale_;
+};
+
+class PermuteLayer : public Layer {
+ public:
+  explicit PermuteLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+  const std::vector<int>& order() const { return order_; }
+
+ private:
+  std::vector<int> order_;
+  bool identity_;
+};
+
+// Flatten and Reshape only change the shape; the data is copied unchanged.
+class ReshapeLayer : public Layer {
+ public:
+  explicit ReshapeLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+ private:
+  const TextMessage* params_;
+};
+
+class ConcatLayer : public Layer {
+ public:
+  explicit ConcatLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+  int axis() const { return axis_; }
+
+ private:
+  int axis_;
+};
+
+class SoftmaxLayer : public Layer {
+ public:
+  explicit SoftmaxLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+ private:
+  int axis_;
+};
+
+// Prior boxes depend only on shapes, so they are generated once in Setup().
+class PriorBoxLayer : public Layer {
+ public:
+  explicit PriorBoxLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+ private:
+  const TextMessage* params_;
+  std::vector<float> priors_;
+};
+
+class DetectionOutputLayer : public Layer {
+ public:
+  explicit DetectionOutputLayer(const LayerSpec& spec);
+  bool Setup(const std::vector<Blob*>& bottoms, const std::vector<Blob*>& tops,
+             std::string* error) override;
+  void Forward(const std::vector<Blob*>& bottoms,
+               const std::vector<Blob*>& tops) override;
+
+  // Restricts the output to |label|: only that column of the confidences
+  // is read, candidates at or below max(|min_confidence|, the prototxt
+  // threshold) are dropped before any box is decoded and NMS runs on the
+  // survivors alone. Rows keep the usual seven-float layout. Returns false
+  // if |label| is not a foreground class.
+  bool KeepOnlyClass(int label, float min_confidence);
+
+ private:
+  void ForwardSingleClass(const float* loc, const float* conf,
+                          const float* priors, Blob* output);
+
+  int num_classes_;
+  int background_label_;
+  float nms_threshold_;
+  int top_k_;
+  int keep_top_k_;
+  float confidence_threshold_;
+  bool share_location_;
+  std::string code_type_;
+  int num_priors_;
+  std::vector<float> decoded_;
+  // KeepOnlyClass() state: the label (-1 for all classes), the selected
+  // prior indices and their boxes and scores, padded to a multiple of four.
+  int single_class_;
+  std::vector<int> candidates_;
+  std::vector<float> box_x0_, box_y0_, box_x1_, box_y1_;
+  std::vector<float> scores_;
+  std::vector<int> keep_;
+};
+
+}  // namespace ssd
+
+#endif  // SRC_ASSISTANT_SSD_LAYERS_H_
@@ -0,0 +1,450 @@
+#include "assistant/ssd_net.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "assistant/ssd_layers.h"
+
+namespace ssd {
+
+void Blob::Reshape(const std::vector<int>& new_shape) {
+  shape = new_shape;
+  size_t total = 1;
+  for (int d : shape) {
+    total *= d;
+  }
+  data.resize(total);
+}
+
+int Blob::dim(int axis) const { return shape[CanonicalAxis(axis)]; }
+
+size_t Blob::CountRange(int begin, int end) const {
+  size_t total = 1;
+  for (int i = begin; i < end; i++) {
+    total *= shape[i];
+  }
+  return total;
+}
+
+int Blob::CanonicalAxis(int axis) const {
+  return axis < 0 ? axis + num_axes() : axis;
+}
+
+Net::Net()
+    : input_(nullptr),
+      output_(nullptr),
+      profiling_(false),
+      optimize_(true),
+      input_height_(0),
+      input_width_(0) {}
+
+bool Net::Load(const std::string& prototxt_path, const std::string& model_path,
+               std::string* error) {
+  std::ifstream file(prototxt_path);
+  if (!file) {
+    *error = "cannot open " + prototxt_path;
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  if (!prototxt_.Parse(text.str(), error)) {
+    *error = prototxt_path + ": " + *error;
+    return false;
+  }
+  std::map<std::string, std::vector<WeightBlob>> weights;
+  if (!ReadCaffeModel(model_path, &weights, error)) {
+    return false;
+  }
+  return Build(&weights, error);
+}
+
+bool Net::Build(std::map<std::string, std::vector<WeightBlob>>* weights,
+                std::string* error) {
+  blobs_.clear();
+  layers_.clear();
+  layer_bottoms_.clear();
+  layer_tops_.clear();
+  timings_.clear();
+
+  // The input is declared either at the top level (input + input_shape or
+  // input_dim) or as an Input layer.
+  std::string input_name = prototxt_.GetString("input");
+  std::vector<int> input_shape =
+      prototxt_.Child("input_shape").GetInts("dim");
+  if (input_shape.empty()) {
+    input_shape = prototxt_.GetInts("input_dim");
+  }
+  std::vector<const TextMessage*> layer_params = prototxt_.Children("layer");
+  if (layer_params.empty()) {
+    layer_params = prototxt_.Children("layers");
+  }
+  if (input_name.empty()) {
+    for (const TextMessage* params : layer_params) {
+      if (params->GetString("type") == "Input") {
+        input_name = params->GetString("top");
+        input_shape =
+            params->Child("input_param").Child("shape").GetInts("dim");
+        break;
+      }
+    }
+  }
+  if (input_name.empty() || input_shape.size() != 4) {
+    *error = "prototxt does not declare a 4-D input";
+    return false;
+  }
+  input_shape[0] = 1;
+  if (input_height_ > 0) {
+    input_shape[2] = input_height_;
+    input_shape[3] = input_width_;
+  }
+  input_ = new Blob;
+  blobs_[input_name].reset(input_);
+  input_->Reshape(input_shape);
+
+  for (const TextMessage* params : layer_params) {
+    LayerSpec spec;
+    spec.name = params->GetString("name");
+    spec.type = params->GetString("type");
+    spec.bottoms = params->GetStrings("bottom");
+    spec.tops = params->GetStrings("top");
+    spec.params = params;
+    if (spec.type == "Input") {
+      continue;
+    }
+    bool train_only = false;
+    for (const TextMessage* include : params->Children("include")) {
+      train_only = train_only || include->GetString("phase") == "TRAIN";
+    }
+    if (train_only) {
+      continue;
+    }
+    auto found = weights->find(spec.name);
+    if (found != weights->end()) {
+      spec.weights = std::move(found->second);
+      weights->erase(found);
+    }
+
+    std::unique_ptr<Layer> layer = CreateLayer(spec);
+    if (!layer) {
+      *error = "unsupported layer type " + spec.type + " (" + spec.name + ")";
+      return false;
+    }
+    std::vector<Blob*> bottoms;
+    for (const std::string& name : spec.bottoms) {
+      auto blob = blobs_.find(name);
+      if (blob == blobs_.end()) {
+        *error = spec.name + ": unknown bottom " + name;
+        return false;
+      }
+      bottoms.push_back(blob->second.get());
+    }
+    std::vector<Blob*> tops;
+    for (const std::string& name : spec.tops) {
+      // A top that repeats a bottom name is computed in place.
+      std::unique_ptr<Blob>& blob = blobs_[name];
+      if (!blob) {
+        blob.reset(new Blob);
+      }
+      tops.push_back(blob.get());
+    }
+    if (tops.empty()) {
+      *error = spec.name + ": layer has no top";
+      return false;
+    }
+    if (!layer->Setup(bottoms, tops, error)) {
+      return false;
+    }
+
+    LayerTiming timing;
+    timing.name = spec.name;
+    timing.type = spec.type;
+    timing.output_count = tops[0]->count();
+    timing.calls = 0;
+    timing.total_ms = 0;
+    timings_.push_back(timing);
+    layers_.push_back(std::move(layer));
+    layer_bottoms_.push_back(bottoms);
+    layer_tops_.push_back(tops);
+  }
+  if (layers_.empty()) {
+    *error = "prototxt has no layers";
+    return false;
+  }
+  if (optimize_) {
+    Optimize();
+  }
+  output_ = layer_tops_.back()[0];
+  return true;
+}
+
+void Net::Optimize() {
+  size_t count = layers_.size();
+  std::vector<bool> removed(count, false);
+  // Layers still reading each blob, and for every bottom of every layer
+  // the index of the layer that last wrote it (-1 for the input).
+  std::map<const Blob*, int> readers;
+  std::vector<std::vector<int>> producers(count);
+  std::map<const Blob*, int> last_writer;
+  for (size_t i = 0; i < count; i++) {
+    for (const Blob* bottom : layer_bottoms_[i]) {
+      readers[bottom]++;
+      auto writer = last_writer.find(bottom);
+      producers[i].push_back(writer != last_writer.end() ? writer->second
+                                                         : -1);
+    }
+    for (const Blob* top : layer_tops_[i]) {
+      last_writer[top] = static_cast<int>(i);
+    }
+  }
+  auto remove = [&](size_t i) {
+    removed[i] = true;
+    for (const Blob* bottom : layer_bottoms_[i]) {
+      readers[bottom]--;
+    }
+  };
+
+  // SSD heads: Convolution -> Permute(0,2,3,1) -> Flatten -> Concat(axis 1).
+  // The permuted, flattened output of each head convolution is a
+  // contiguous slice of the concatenation, so the convolution can write
+  // its slice directly.
+  for (size_t c = 0; c < count; c++) {
+    ConcatLayer* concat = dynamic_cast<ConcatLayer*>(layers_[c].get());
+    if (concat == nullptr || concat->axis() != 1 ||
+        layer_tops_[c][0]->num_axes() != 2) {
+      continue;
+    }
+    std::vector<ConvolutionLayer*> heads;
+    std::vector<size_t> reshapes;
+    for (size_t b = 0; b < layer_bottoms_[c].size(); b++) {
+      int flatten = producers[c][b];
+      if (flatten < 0 || layers_[flatten]->type() != "Flatten" ||
+          readers[layer_tops_[flatten][0]] != 1) {
+        break;
+      }
+      int permute = producers[flatten][0];
+      PermuteLayer* permute_layer =
+          permute < 0 ? nullptr
+                      : dynamic_cast<PermuteLayer*>(layers_[permute].get());
+      if (permute_layer == nullptr ||
+          permute_layer->order() != std::vector<int>({0, 2, 3, 1}) ||
+          readers[layer_tops_[permute][0]] != 1) {
+        break;
+      }
+      int conv = producers[permute][0];
+      ConvolutionLayer* conv_layer =
+          conv < 0 ? nullptr
+                   : dynamic_cast<ConvolutionLayer*>(layers_[conv].get());
+      if (conv_layer == nullptr || readers[layer_tops_[conv][0]] != 1) {
+        break;
+      }
+      heads.push_back(conv_layer);
+      reshapes.push_back(flatten);
+      reshapes.push_back(permute);
+    }
+    if (heads.size() != layer_bottoms_[c].size()) {
+      continue;
+    }
+    Blob* target = layer_tops_[c][0];
+    size_t offset = 0;
+    for (size_t h = 0; h < heads.size(); h++) {
+      heads[h]->SetHwcOutput(target, offset);
+      offset += layer_bottoms_[c][h]->count();
+    }
+    for (size_t r : reshapes) {
+      remove(r);
+    }
+    remove(c);
+  }
+
+  // Elementwise chains: fold what follows a Convolution or a per-channel
+  // affine layer into it while the intermediate result has no other
+  // reader.
+  for (size_t i = 0; i < count; i++) {
+    ConvolutionLayer* conv = dynamic_cast<ConvolutionLayer*>(layers_[i].get());
+    ChannelAffineLayer* affine =
+        dynamic_cast<ChannelAffineLayer*>(layers_[i].get());
+    if (removed[i] || (conv == nullptr && affine == nullptr)) {
+      continue;
+    }
+    for (size_t j = i + 1; j < count; j++) {
+      if (removed[j]) {
+        continue;
+      }
+      Blob* top = layer_tops_[i][0];
+      if (layer_bottoms_[j].size() != 1 || layer_bottoms_[j][0] != top) {
+        break;
+      }
+      bool in_place = layer_tops_[j][0] == top;
+      bool self_reads = layer_bottoms_[i][0] == top;
+      if (!in_place && readers[top] - (self_reads ? 1 : 0) != 1) {
+        break;
+      }
+      ChannelAffineLayer* next_affine =
+          dynamic_cast<ChannelAffineLayer*>(layers_[j].get());
+      ReluLayer* relu = dynamic_cast<ReluLayer*>(layers_[j].get());
+      bool fused_relu =
+          conv != nullptr ? conv->fused_relu() : affine->fused_relu();
+      if (next_affine != nullptr && !fused_relu) {
+        if (conv != nullptr) {
+          conv->FoldAffine(next_affine->scale(), next_affine->shift());
+        } else {
+          affine->Compose(*next_affine);
+        }
+      } else if (relu != nullptr && relu->negative_slope() == 0 &&
+                 !fused_relu) {
+        if (conv != nullptr) {
+          conv->FuseRelu();
+        } else {
+          affine->FuseRelu();
+        }
+      } else {
+        break;
+      }
+      timings_[i].type += "+" + layers_[j]->type();
+      remove(j);
+      layer_tops_[i][0] = layer_tops_[j][0];
+    }
+  }
+
+  RemoveLayers(removed);
+}
+
+void Net::RemoveLayers(const std::vector<bool>& removed) {
+  size_t kept = 0;
+  for (size_t i = 0; i < layers_.size(); i++) {
+    if (removed[i]) {
+      continue;
+    }
+    layers_[kept] = std::move(layers_[i]);
+    layer_bottoms_[kept] = layer_bottoms_[i];
+    layer_tops_[kept] = layer_tops_[i];
+    timings_[kept] = timings_[i];
+    kept++;
+  }
+  layers_.resize(kept);
+  layer_bottoms_.resize(kept);
+  layer_tops_.resize(kept);
+  timings_.resize(kept);
+}
+
+const Blob& Net::Forward() {
+  for (size_t i = 0; i < layers_.size(); i++) {
+    if (!profiling_) {
+      layers_[i]->Forward(layer_bottoms_[i], layer_tops_[i]);
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    layers_[i]->Forward(layer_bottoms_[i], layer_tops_[i]);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    timings_[i].calls++;
+    timings_[i].total_ms += elapsed.count();
+  }
+  return *output_;
+}
+
+const Blob& Net::ForwardCalibration(std::map<std::string, float>* ranges) {
+  for (size_t i = 0; i < layers_.size(); i++) {
+    if (dynamic_cast<ConvolutionLayer*>(layers_[i].get()) != nullptr) {
+      const Blob& input = *layer_bottoms_[i][0];
+      float range = 0;
+      for (float value : input.data) {
+        range = std::max(range, std::fabs(value));
+      }
+      float& known = (*ranges)[layers_[i]->name()];
+      known = std::max(known, range);
+    }
+    layers_[i]->Forward(layer_bottoms_[i], layer_tops_[i]);
+  }
+  return *output_;
+}
+
+int Net::EnableInt8(const std::map<std::string, float>& ranges) {
+  int converted = 0;
+  for (size_t i = 0; i < layers_.size(); i++) {
+    ConvolutionLayer* conv = dynamic_cast<ConvolutionLayer*>(layers_[i].get());
+    auto range = ranges.find(layers_[i]->name());
+    if (conv != nullptr && range != ranges.end() &&
+        conv->EnableInt8(range->second)) {
+      timings_[i].type += "/int8";
+      converted++;
+    }
+  }
+  return converted;
+}
+
+bool Net::KeepOnlyClass(int label, float min_confidence) {
+  for (size_t i = 0; i < layers_.size(); i++) {
+    DetectionOutputLayer* detection =
+        dynamic_cast<DetectionOutputLayer*>(layers_[i].get());
+    if (detection != nullptr) {
+      if (!detection->KeepOnlyClass(label, min_confidence)) {
+        return false;
+      }
+      timings_[i].type += "/class" + std::to_string(label);
+      return true;
+    }
+  }
+  return false;
+}
+
+const Blob* Net::blob(const std::string& name) const {
+  auto found = blobs_.find(name);
+  return found != blobs_.end() ? found->second.get() : nullptr;
+}
+
+void Net::ResetTimings() {
+  for (LayerTiming& timing : timings_) {
+    timing.calls = 0;
+    timing.total_ms = 0;
+  }
+}
+
+bool ReadCalibrationTable(const std::string& path,
+                          std::map<std::string, float>* ranges,
+                          std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string layer;
+    float range;
+    if (!(fields >> layer >> range)) {
+      *error = path + ":" + std::to_string(line_number) + ": expected "
+               "\"<layer> <range>\"";
+      return false;
+    }
+    (*ranges)[layer] = range;
+  }
+  return true;
+}
+
+bool WriteCalibrationTable(const std::string& path,
+                           const std::map<std::string, float>& ranges,
+                           std::string* error) {
+  std::ofstream file(path);
+  file << "# INT8 calibration: convolution input ranges" << std::endl;
+  for (const auto& range : ranges) {
+    file << range.first << " " << range.second << std::endl;
+  }
+  if (!file) {
+    *error = "cannot write " + path;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ssd
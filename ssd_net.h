@@ -0,0 +1,175 @@
+#ifndef SRC_ASSISTANT_SSD_NET_H_
+#define SRC_ASSISTANT_SSD_NET_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "assistant/ssd_proto.h"
+
+namespace ssd {
+
+// Dense float tensor. Four-dimensional blobs are laid out NCHW.
+struct Blob {
+  std::vector<int> shape;
+  std::vector<float> data;
+
+  void Reshape(const std::vector<int>& new_shape);
+  size_t count() const { return data.size(); }
+  int num_axes() const { return static_cast<int>(shape.size()); }
+  // Size of |axis|; negative axes count from the end.
+  int dim(int axis) const;
+  // Product of the dimensions in [begin, end).
+  size_t CountRange(int begin, int end) const;
+  // Maps a possibly negative axis onto [0, num_axes()).
+  int CanonicalAxis(int axis) const;
+};
+
+// Everything a layer is built from: its prototxt entry and its weights.
+struct LayerSpec {
+  std::string name;
+  std::string type;
+  std::vector<std::string> bottoms;
+  std::vector<std::string> tops;
+  const TextMessage* params;
+  std::vector<WeightBlob> weights;
+};
+
+class Layer {
+ public:
+  explicit Layer(const LayerSpec& spec);
+  virtual ~Layer() {}
+
+  // Checks parameters and weights against the bottom shapes and shapes the
+  // tops. Called once when the net is built.
+  virtual bool Setup(const std::vector<Blob*>& bottoms,
+                     const std::vector<Blob*>& tops, std::string* error) = 0;
+
+  virtual void Forward(const std::vector<Blob*>& bottoms,
+                       const std::vector<Blob*>& tops) = 0;
+
+  const std::string& name() const { return name_; }
+  const std::string& type() const { return type_; }
+  const std::vector<std::string>& bottom_names() const { return bottoms_; }
+  const std::vector<std::string>& top_names() const { return tops_; }
+
+ protected:
+  bool Fail(const std::string& what, std::string* error) const;
+
+  std::string name_;
+  std::string type_;
+  std::vector<std::string> bottoms_;
+  std::vector<std::string> tops_;
+  std::vector<WeightBlob> weights_;
+};
+
+// Builds the layer for |spec.type|, or returns null for unsupported types.
+std::unique_ptr<Layer> CreateLayer(const LayerSpec& spec);
+
+// Accumulated forward time of one layer.
+struct LayerTiming {
+  std::string name;
+  std::string type;
+  // Product of the top shape, for relating time to work.
+  size_t output_count;
+  uint64_t calls;
+  double total_ms;
+};
+
+// Self-contained Caffe SSD inference engine. Parses a deploy prototxt and
+// the matching .caffemodel and runs the graph with the kernels in
+// ssd_kernels.h. Only batch size 1 and the input shape declared in the
+// prototxt are supported.
+class Net {
+ public:
+  Net();
+
+  bool Load(const std::string& prototxt_path, const std::string& model_path,
+            std::string* error);
+
+  // When enabled (the default), Load() rewrites the graph for inference:
+  // BatchNorm/Scale are folded into the preceding convolution, ReLU is
+  // fused into the convolution or affine layer before it, and SSD heads
+  // write straight into their concatenated outputs instead of going
+  // through Permute, Flatten and Concat. Set before Load().
+  void set_optimize(bool enabled) { optimize_ = enabled; }
+
+  // Runs the net at |height| x |width| instead of the input size declared
+  // in the prototxt. Feature maps and priors follow the new size, which
+  // suits SSD's fully convolutional body. Set before Load().
+  void set_input_size(int height, int width) {
+    input_height_ = height;
+    input_width_ = width;
+  }
+
+  // Number of layers Forward() runs.
+  size_t layer_count() const { return layers_.size(); }
+
+  // Input blob, shaped from the prototxt. Fill it before Forward().
+  Blob* input() { return input_; }
+
+  // Runs every layer and returns the top of the last one.
+  const Blob& Forward();
+
+  // INT8 calibration: runs Forward() and raises |ranges|[layer] to the
+  // largest input magnitude each convolution saw.
+  const Blob& ForwardCalibration(std::map<std::string, float>* ranges);
+
+  // Switches every convolution with an entry in |ranges| to the INT8
+  // kernels. Call after Load(); returns how many were switched.
+  int EnableInt8(const std::map<std::string, float>& ranges);
+
+  // Specializes the DetectionOutput layer to a single |label|, e.g. person
+  // when nothing else is ever looked at. See
+  // DetectionOutputLayer::KeepOnlyClass(). Call after Load(); returns false
+  // if there is no DetectionOutput layer or |label| is not a class of it.
+  bool KeepOnlyClass(int label, float min_confidence);
+
+  // Named intermediate blob, or null.
+  const Blob* blob(const std::string& name) const;
+
+  // When enabled, Forward() records per-layer wall time.
+  void set_profiling(bool enabled) { profiling_ = enabled; }
+  const std::vector<LayerTiming>& timings() const { return timings_; }
+  void ResetTimings();
+
+ private:
+  bool Build(std::map<std::string, std::vector<WeightBlob>>* weights,
+             std::string* error);
+  void Optimize();
+  // Removes the layers flagged in |removed|, keeping the per-layer vectors
+  // in step.
+  void RemoveLayers(const std::vector<bool>& removed);
+
+  TextMessage prototxt_;
+  std::map<std::string, std::unique_ptr<Blob>> blobs_;
+  std::vector<std::unique_ptr<Layer>> layers_;
+  std::vector<std::vector<Blob*>> layer_bottoms_;
+  std::vector<std::vector<Blob*>> layer_tops_;
+  std::vector<LayerTiming> timings_;
+  Blob* input_;
+  Blob* output_;
+  bool profiling_;
+  bool optimize_;
+  int input_height_;
+  int input_width_;
+
+  Net(const Net&) = delete;
+  Net& operator=(const Net&) = delete;
+};
+
+// Calibration tables map convolution names to input ranges, one
+// "<layer> <range>" pair per line.
+bool ReadCalibrationTable(const std::string& path,
+                          std::map<std::string, float>* ranges,
+                          std::string* error);
+bool WriteCalibrationTable(const std::string& path,
+                           const std::map<std::string, float>& ranges,
+                           std::string* error);
+
+}  // namespace ssd
+
+#endif  // SRC_ASSISTANT_SSD_NET_H_
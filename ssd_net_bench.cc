@@ -0,0 +1,222 @@
+// Times the native ssd::Net forward pass and breaks it down per layer, so
+// it is visible where the 300x300 MobileNet-SSD pass spends its time.
+//
+// Then times the deepest 1x1 convolutions' GEMM (conv7 to conv11: 512
+// outputs over 19x19 pixels and 512 channels) alone, in FP32 and INT8,
+// against a plain triple loop. Gemm once kept too few columns of B in cache
+// at this depth and fell behind the plain loop wherever A did not fit in
+// the last level cache; it should stay well ahead of it.
+//
+// Usage: ./ssd_net_bench [--iterations N] [--prototxt <path>]
+//                        [--model <path>] [--top N] [--no-optimize]
+//                        [--calibration <table>]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "assistant/ssd_kernels.h"
+#include "assistant/ssd_net.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const int kGemmM = 512;
+static const int kGemmN = 19 * 19;
+static const int kGemmK = 512;
+
+// Median of |iterations| runs of |run|, in milliseconds.
+template <typename Run>
+static double MedianMs(int iterations, Run run) {
+  std::vector<double> times;
+  for (int i = 0; i < iterations; i++) {
+    Clock::time_point start = Clock::now();
+    run();
+    times.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+static void TimeLargeGemm(int iterations) {
+  int m = kGemmM, n = kGemmN, k = kGemmK;
+  std::vector<float> a(m * k), b(k * n), bias(m), c(m * n);
+  for (int i = 0; i < m * k; i++) {
+    a[i] = static_cast<float>(i % 17) / 17 - 0.5f;
+  }
+  for (int i = 0; i < k * n; i++) {
+    b[i] = static_cast<float>(i % 13) / 13;
+  }
+  std::vector<int8_t> qa(m * k), qb(k * ((n + 7) / 8 * 8));
+  ssd::QuantizeInt8(a.data(), qa.size(), 127 / 0.5f, qa.data());
+  ssd::QuantizePackInt8(b.data(), k, n, 127, qb.data());
+  std::vector<float> scale(m, 1e-4f);
+
+  // Row by row, so the compiler vectorizes the inner loop.
+  double plain_ms = MedianMs(iterations, [&] {
+    for (int i = 0; i < m; i++) {
+      float* row = &c[i * n];
+      std::fill(row, row + n, bias[i]);
+      for (int p = 0; p < k; p++) {
+        float x = a[i * k + p];
+        const float* b_row = &b[p * n];
+        for (int j = 0; j < n; j++) {
+          row[j] += x * b_row[j];
+        }
+      }
+    }
+  });
+  double fp32_ms = MedianMs(iterations, [&] {
+    ssd::Gemm(m, n, k, a.data(), b.data(), bias.data(), false, c.data());
+  });
+  double int8_ms = MedianMs(iterations, [&] {
+    ssd::GemmInt8(m, n, k, qa.data(), qb.data(), scale.data(), bias.data(),
+                  false, c.data());
+  });
+  printf("  %d x %d x %d GEMM p50: plain loop %.2fms, Gemm %.2fms (%.1fx), "
+         "GemmInt8 %.2fms (%.1fx)\n",
+         m, n, k, plain_ms, fp32_ms, plain_ms / fp32_ms, int8_ms,
+         plain_ms / int8_ms);
+}
+
+static const char kDefaultPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDefaultModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+
+int main(int argc, char** argv) {
+  int iterations = 20;
+  int top = 15;
+  std::string prototxt = kDefaultPrototxt;
+  std::string model = kDefaultModel;
+  bool optimize = true;
+  std::string calibration;
+
+  const struct option long_options[] = {
+      {"iterations", required_argument, nullptr, 'n'},
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {"top", required_argument, nullptr, 't'},
+      {"no-optimize", no_argument, nullptr, 'u'},
+      {"calibration", required_argument, nullptr, 'c'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:p:m:t:uc:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        iterations = std::atoi(optarg);
+        break;
+      case 'p':
+        prototxt = optarg;
+        break;
+      case 'm':
+        model = optarg;
+        break;
+      case 't':
+        top = std::atoi(optarg);
+        break;
+      case 'u':
+        optimize = false;
+        break;
+      case 'c':
+        calibration = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  Clock::time_point start = Clock::now();
+  ssd::Net net;
+  net.set_optimize(optimize);
+  std::string error;
+  if (!net.Load(prototxt, model, &error)) {
+    std::cerr << "ssd_net_bench: " << error << std::endl;
+    return -1;
+  }
+  int int8_layers = 0;
+  if (!calibration.empty()) {
+    std::map<std::string, float> ranges;
+    if (!ssd::ReadCalibrationTable(calibration, &ranges, &error)) {
+      std::cerr << "ssd_net_bench: " << error << std::endl;
+      return -1;
+    }
+    int8_layers = net.EnableInt8(ranges);
+  }
+  double load_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  // Deterministic input in the normalized [-1, 1] range the detector feeds.
+  ssd::Blob* input = net.input();
+  for (size_t i = 0; i < input->count(); i++) {
+    input->data[i] = static_cast<float>(i % 255) / 127.5f - 1;
+  }
+  net.Forward();  // warm-up
+
+  net.set_profiling(true);
+  std::vector<double> totals;
+  for (int i = 0; i < iterations; i++) {
+    start = Clock::now();
+    net.Forward();
+    totals.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  std::sort(totals.begin(), totals.end());
+
+  std::vector<ssd::LayerTiming> layers = net.timings();
+  double layer_sum = 0;
+  std::map<std::string, double> by_type;
+  for (const ssd::LayerTiming& layer : layers) {
+    layer_sum += layer.total_ms;
+    by_type[layer.type] += layer.total_ms;
+  }
+  std::sort(layers.begin(), layers.end(),
+            [](const ssd::LayerTiming& a, const ssd::LayerTiming& b) {
+              return a.total_ms > b.total_ms;
+            });
+
+  std::cout << "load: " << load_ms << "ms, " << net.layer_count()
+            << " layers" << (optimize ? "" : " (unoptimized)");
+  if (!calibration.empty()) {
+    std::cout << ", " << int8_layers << " convolutions in INT8";
+  }
+  std::cout << std::endl;
+  std::cout << "forward: n=" << totals.size()
+            << " p50=" << totals[totals.size() / 2] << "ms"
+            << " min=" << totals.front() << "ms"
+            << " max=" << totals.back() << "ms" << std::endl;
+
+  std::cout << std::endl << "by layer type:" << std::endl;
+  for (const auto& type : by_type) {
+    printf("  %-34s %8.3fms %5.1f%%\n", type.first.c_str(),
+           type.second / iterations, 100 * type.second / layer_sum);
+  }
+
+  std::cout << std::endl << "slowest layers:" << std::endl;
+  printf("  %-28s %-34s %10s %9s %6s\n", "layer", "type", "outputs",
+         "ms", "%");
+  for (int i = 0; i < top && i < static_cast<int>(layers.size()); i++) {
+    const ssd::LayerTiming& layer = layers[i];
+    printf("  %-28s %-34s %10zu %9.3f %5.1f%%\n", layer.name.c_str(),
+           layer.type.c_str(), layer.output_count,
+           layer.total_ms / iterations, 100 * layer.total_ms / layer_sum);
+  }
+
+  std::cout << std::endl << "large-K GEMM:" << std::endl;
+  TimeLargeGemm(iterations);
+  return 0;
+}
@@ -0,0 +1,158 @@
+// Checks the native ssd::Net against OpenCV DNN on the same input: compares
+// a few intermediate blobs element-wise and matches the final detections.
+// Exits non-zero if any difference exceeds the tolerance.
+//
+// Usage: ./ssd_net_compare [--image <path>] [--prototxt <path>]
+//                          [--model <path>] [--tolerance T]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "assistant/ssd_net.h"
+
+static const char kDefaultPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDefaultModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+// Blobs compared element-wise: the first convolution, the concatenated box
+// regressions and the class probabilities after softmax.
+static const char* const kComparedBlobs[] = {"conv0", "mbox_loc",
+                                             "mbox_conf_flatten"};
+
+// Largest absolute difference between two blobs of the same size.
+static float MaxAbsDiff(const float* a, const float* b, size_t count) {
+  float worst = 0;
+  for (size_t i = 0; i < count; i++) {
+    worst = std::max(worst, std::fabs(a[i] - b[i]));
+  }
+  return worst;
+}
+
+int main(int argc, char** argv) {
+  std::string image_path;
+  std::string prototxt = kDefaultPrototxt;
+  std::string model = kDefaultModel;
+  float tolerance = 1e-3f;
+
+  const struct option long_options[] = {
+      {"image", required_argument, nullptr, 'i'},
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {"tolerance", required_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "i:p:m:t:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'i':
+        image_path = optarg;
+        break;
+      case 'p':
+        prototxt = optarg;
+        break;
+      case 'm':
+        model = optarg;
+        break;
+      case 't':
+        tolerance = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  ssd::Net native;
+  std::string error;
+  if (!native.Load(prototxt, model, &error)) {
+    std::cerr << "ssd_net_compare: " << error << std::endl;
+    return -1;
+  }
+  cv::dnn::Net reference = cv::dnn::readNetFromCaffe(prototxt, model);
+  if (reference.empty()) {
+    std::cerr << "ssd_net_compare: OpenCV could not load the model"
+              << std::endl;
+    return -1;
+  }
+  reference.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+  reference.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+
+  // Same preprocessing as PersonDetector; random pixels without --image.
+  cv::Mat image;
+  if (!image_path.empty()) {
+    image = cv::imread(image_path);
+    if (image.empty()) {
+      std::cerr << "ssd_net_compare: cannot read " << image_path << std::endl;
+      return -1;
+    }
+  } else {
+    image = cv::Mat(300, 300, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+  }
+  cv::resize(image, image, cv::Size(300, 300));
+  cv::Mat blob = cv::dnn::blobFromImage(image, 0.007843, cv::Size(300, 300),
+                                        cv::Scalar(127.5, 127.5, 127.5));
+
+  ssd::Blob* input = native.input();
+  std::copy(blob.ptr<float>(), blob.ptr<float>() + input->count(),
+            input->data.begin());
+  const ssd::Blob& detections = native.Forward();
+
+  bool ok = true;
+  reference.setInput(blob);
+  for (const char* name : kComparedBlobs) {
+    const ssd::Blob* mine = native.blob(name);
+    cv::Mat theirs = reference.forward(name);
+    if (mine == nullptr || theirs.total() != mine->count()) {
+      std::cerr << name << ": shapes differ" << std::endl;
+      ok = false;
+      continue;
+    }
+    float diff = MaxAbsDiff(mine->data.data(), theirs.ptr<float>(),
+                            mine->count());
+    std::cout << name << ": max abs diff " << diff << std::endl;
+    ok = ok && diff <= tolerance;
+  }
+
+  // Detections may come out in a different order on ties, so match every
+  // native row to the reference row with the same label and closest box.
+  reference.setInput(blob);
+  cv::Mat expected = reference.forward();
+  int expected_rows = expected.size[2];
+  const float* expected_data = expected.ptr<float>();
+  int rows = detections.dim(2);
+  float worst = 0;
+  for (int i = 0; i < rows; i++) {
+    const float* row = detections.data.data() + i * 7;
+    float best = HUGE_VALF;
+    for (int j = 0; j < expected_rows; j++) {
+      const float* other = expected_data + j * 7;
+      if (other[1] != row[1]) {
+        continue;
+      }
+      best = std::min(best, MaxAbsDiff(row + 2, other + 2, 5));
+    }
+    worst = std::max(worst, best);
+  }
+  std::cout << "detection_out: " << rows << " rows (OpenCV " << expected_rows
+            << "), max row diff " << worst << std::endl;
+  ok = ok && rows == expected_rows && worst <= tolerance;
+
+  std::cout << (ok ? "PASS" : "FAIL") << " at tolerance " << tolerance
+            << std::endl;
+  return ok ? 0 : 1;
+}
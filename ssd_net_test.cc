@@ -0,0 +1,153 @@
+// Golden test for the load-time graph optimizer: runs the same inputs
+// through an unoptimized and an optimized ssd::Net and requires the box
+// regressions, class probabilities and detections to agree; a golden blob
+// missing from either graph, e.g. renamed or fused away, fails too. Also
+// reports the layer count and forward latency of both graphs, as measured
+// on the machine it runs on, timing them in turn so that both see the same
+// load.
+//
+// Usage: ./ssd_net_test --prototxt <path> --model <path> [--runs N]
+//                       [--tolerance T]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "assistant/ssd_net.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Blobs that survive optimization and must match between the two graphs.
+static const char* const kGoldenBlobs[] = {"mbox_loc", "mbox_conf_flatten",
+                                           "mbox_priorbox"};
+
+static float MaxAbsDiff(const ssd::Blob& a, const ssd::Blob& b) {
+  if (a.shape != b.shape) {
+    return HUGE_VALF;
+  }
+  float worst = 0;
+  for (size_t i = 0; i < a.count(); i++) {
+    worst = std::max(worst, std::fabs(a.data[i] - b.data[i]));
+  }
+  return worst;
+}
+
+static double ForwardMs(ssd::Net* net) {
+  Clock::time_point start = Clock::now();
+  net->Forward();
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+int main(int argc, char** argv) {
+  std::string prototxt;
+  std::string model;
+  int runs = 5;
+  float tolerance = 1e-4f;
+
+  const struct option long_options[] = {
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {"runs", required_argument, nullptr, 'n'},
+      {"tolerance", required_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "p:m:n:t:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'p':
+        prototxt = optarg;
+        break;
+      case 'm':
+        model = optarg;
+        break;
+      case 'n':
+        runs = std::atoi(optarg);
+        break;
+      case 't':
+        tolerance = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+  if (prototxt.empty() || model.empty() || runs < 1) {
+    std::cerr << "Usage: ./ssd_net_test --prototxt <path> --model <path> "
+                 "[--runs N] [--tolerance T]"
+              << std::endl;
+    return -1;
+  }
+
+  ssd::Net reference;
+  ssd::Net optimized;
+  reference.set_optimize(false);
+  std::string error;
+  if (!reference.Load(prototxt, model, &error) ||
+      !optimized.Load(prototxt, model, &error)) {
+    std::cerr << "ssd_net_test: " << error << std::endl;
+    return -1;
+  }
+
+  bool ok = true;
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> pixel(-1, 1);
+  for (int run = 0; run < runs; run++) {
+    for (float& value : reference.input()->data) {
+      value = pixel(random);
+    }
+    optimized.input()->data = reference.input()->data;
+    const ssd::Blob& expected = reference.Forward();
+    const ssd::Blob& actual = optimized.Forward();
+
+    for (const char* name : kGoldenBlobs) {
+      const ssd::Blob* a = reference.blob(name);
+      const ssd::Blob* b = optimized.blob(name);
+      if (a == nullptr || b == nullptr) {
+        std::cerr << "run " << run << ": " << name << " missing from the "
+                  << (a == nullptr ? "reference" : "optimized") << " graph"
+                  << std::endl;
+        ok = false;
+        continue;
+      }
+      float diff = MaxAbsDiff(*a, *b);
+      if (diff > tolerance) {
+        std::cerr << "run " << run << ": " << name << " differs by " << diff
+                  << std::endl;
+        ok = false;
+      }
+    }
+    float diff = MaxAbsDiff(expected, actual);
+    if (diff > tolerance) {
+      std::cerr << "run " << run << ": detections differ by " << diff
+                << std::endl;
+      ok = false;
+    }
+  }
+
+  // Alternating, so a change in the machine's load hits both graphs alike.
+  std::vector<double> before_ms, after_ms;
+  for (int run = 0; run < runs; run++) {
+    before_ms.push_back(ForwardMs(&reference));
+    after_ms.push_back(ForwardMs(&optimized));
+  }
+  std::sort(before_ms.begin(), before_ms.end());
+  std::sort(after_ms.begin(), after_ms.end());
+  std::cout << "layers: " << reference.layer_count() << " -> "
+            << optimized.layer_count() << std::endl;
+  std::cout << "forward p50: " << before_ms[runs / 2] << "ms -> "
+            << after_ms[runs / 2] << "ms, min: " << before_ms.front()
+            << "ms -> " << after_ms.front() << "ms" << std::endl;
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,514 @@
+#include "assistant/ssd_proto.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace ssd {
+
+// Recursive-descent parser for the subset of protobuf text format used by
+// Caffe prototxt files.
+class TextParser {
+ public:
+  explicit TextParser(const std::string& text) : text_(text), pos_(0) {}
+
+  bool ParseMessage(TextMessage* message, bool nested, std::string* error) {
+    while (true) {
+      SkipSpace();
+      if (pos_ >= text_.size()) {
+        if (nested) {
+          return Fail("unexpected end of file inside a message", error);
+        }
+        return true;
+      }
+      if (text_[pos_] == '}') {
+        if (!nested) {
+          return Fail("unbalanced '}'", error);
+        }
+        pos_++;
+        return true;
+      }
+      std::string key;
+      if (!ReadIdentifier(&key)) {
+        return Fail("expected a field name", error);
+      }
+      SkipSpace();
+      bool colon = Consume(':');
+      SkipSpace();
+      if (Consume('{')) {
+        message->children_.push_back(std::make_pair(key, TextMessage()));
+        if (!ParseMessage(&message->children_.back().second, true, error)) {
+          return false;
+        }
+      } else if (!colon) {
+        return Fail("expected ':' or '{' after " + key, error);
+      } else {
+        std::string value;
+        if (!ReadValue(&value)) {
+          return Fail("expected a value for " + key, error);
+        }
+        message->values_.push_back(std::make_pair(key, value));
+      }
+    }
+  }
+
+ private:
+  void SkipSpace() {
+    while (pos_ < text_.size()) {
+      char c = text_[pos_];
+      if (c == '#') {
+        while (pos_ < text_.size() && text_[pos_] != '\n') {
+          pos_++;
+        }
+      } else if (isspace(static_cast<unsigned char>(c)) || c == ',' ||
+                 c == ';') {
+        pos_++;
+      } else {
+        break;
+      }
+    }
+  }
+
+  bool Consume(char c) {
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool ReadIdentifier(std::string* out) {
+    size_t start = pos_;
+    while (pos_ < text_.size() &&
+           (isalnum(static_cast<unsigned char>(text_[pos_])) ||
+            text_[pos_] == '_')) {
+      pos_++;
+    }
+    *out = text_.substr(start, pos_ - start);
+    return !out->empty();
+  }
+
+  bool ReadValue(std::string* out) {
+    if (pos_ >= text_.size()) {
+      return false;
+    }
+    char quote = text_[pos_];
+    if (quote == '"' || quote == '\'') {
+      pos_++;
+      size_t start = pos_;
+      while (pos_ < text_.size() && text_[pos_] != quote) {
+        pos_++;
+      }
+      if (pos_ >= text_.size()) {
+        return false;
+      }
+      *out = text_.substr(start, pos_ - start);
+      pos_++;
+      return true;
+    }
+    size_t start = pos_;
+    while (pos_ < text_.size() &&
+           (isalnum(static_cast<unsigned char>(text_[pos_])) ||
+            strchr("_.-+", text_[pos_]) != nullptr)) {
+      pos_++;
+    }
+    *out = text_.substr(start, pos_ - start);
+    return !out->empty();
+  }
+
+  bool Fail(const std::string& what, std::string* error) {
+    int line = 1;
+    for (size_t i = 0; i < pos_ && i < text_.size(); i++) {
+      line += text_[i] == '\n';
+    }
+    std::ostringstream message;
+    message << "line " << line << ": " << what;
+    *error = message.str();
+    return false;
+  }
+
+  const std::string& text_;
+  size_t pos_;
+};
+
+bool TextMessage::Parse(const std::string& text, std::string* error) {
+  values_.clear();
+  children_.clear();
+  TextParser parser(text);
+  return parser.ParseMessage(this, false, error);
+}
+
+bool TextMessage::Has(const std::string& key) const {
+  for (const auto& value : values_) {
+    if (value.first == key) {
+      return true;
+    }
+  }
+  for (const auto& child : children_) {
+    if (child.first == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string TextMessage::GetString(const std::string& key,
+                                   const std::string& fallback) const {
+  for (const auto& value : values_) {
+    if (value.first == key) {
+      return value.second;
+    }
+  }
+  return fallback;
+}
+
+float TextMessage::GetFloat(const std::string& key, float fallback) const {
+  std::string value = GetString(key);
+  return value.empty() ? fallback : std::strtof(value.c_str(), nullptr);
+}
+
+int TextMessage::GetInt(const std::string& key, int fallback) const {
+  std::string value = GetString(key);
+  return value.empty() ? fallback : std::atoi(value.c_str());
+}
+
+bool TextMessage::GetBool(const std::string& key, bool fallback) const {
+  std::string value = GetString(key);
+  if (value.empty()) {
+    return fallback;
+  }
+  return value == "true" || value == "1";
+}
+
+std::vector<std::string> TextMessage::GetStrings(
+    const std::string& key) const {
+  std::vector<std::string> result;
+  for (const auto& value : values_) {
+    if (value.first == key) {
+      result.push_back(value.second);
+    }
+  }
+  return result;
+}
+
+std::vector<float> TextMessage::GetFloats(const std::string& key) const {
+  std::vector<float> result;
+  for (const std::string& value : GetStrings(key)) {
+    result.push_back(std::strtof(value.c_str(), nullptr));
+  }
+  return result;
+}
+
+std::vector<int> TextMessage::GetInts(const std::string& key) const {
+  std::vector<int> result;
+  for (const std::string& value : GetStrings(key)) {
+    result.push_back(std::atoi(value.c_str()));
+  }
+  return result;
+}
+
+const TextMessage& TextMessage::Child(const std::string& key) const {
+  static const TextMessage kEmpty;
+  for (const auto& child : children_) {
+    if (child.first == key) {
+      return child.second;
+    }
+  }
+  return kEmpty;
+}
+
+std::vector<const TextMessage*> TextMessage::Children(
+    const std::string& key) const {
+  std::vector<const TextMessage*> result;
+  for (const auto& child : children_) {
+    if (child.first == key) {
+      result.push_back(&child.second);
+    }
+  }
+  return result;
+}
+
+// Protobuf wire types.
+enum WireType {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+// Field numbers from caffe.proto.
+static const int kNetLayerField = 100;
+static const int kNetV1LayersField = 2;
+static const int kLayerNameField = 1;
+static const int kLayerBlobsField = 7;
+static const int kV1LayerNameField = 4;
+static const int kV1LayerBlobsField = 6;
+static const int kBlobNumField = 1;
+static const int kBlobChannelsField = 2;
+static const int kBlobHeightField = 3;
+static const int kBlobWidthField = 4;
+static const int kBlobDataField = 5;
+static const int kBlobShapeField = 7;
+static const int kBlobDoubleDataField = 8;
+static const int kBlobShapeDimField = 1;
+
+// Cursor over a protobuf-encoded byte range.
+class WireReader {
+ public:
+  WireReader(const uint8_t* begin, const uint8_t* end)
+      : pos_(begin), end_(end) {}
+
+  bool Done() const { return pos_ >= end_; }
+
+  bool ReadVarint(uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && pos_ < end_; shift += 7) {
+      uint8_t byte = *pos_++;
+      result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ReadTag(int* field, int* wire_type) {
+    uint64_t tag;
+    if (!ReadVarint(&tag)) {
+      return false;
+    }
+    *field = static_cast<int>(tag >> 3);
+    *wire_type = static_cast<int>(tag & 7);
+    return true;
+  }
+
+  // Returns the payload of a length-delimited field.
+  bool ReadBytes(WireReader* payload) {
+    uint64_t length;
+    if (!ReadVarint(&length) || length > static_cast<uint64_t>(end_ - pos_)) {
+      return false;
+    }
+    *payload = WireReader(pos_, pos_ + length);
+    pos_ += length;
+    return true;
+  }
+
+  bool ReadFixed32(uint32_t* value) {
+    if (end_ - pos_ < 4) {
+      return false;
+    }
+    memcpy(value, pos_, 4);
+    pos_ += 4;
+    return true;
+  }
+
+  bool ReadFixed64(uint64_t* value) {
+    if (end_ - pos_ < 8) {
+      return false;
+    }
+    memcpy(value, pos_, 8);
+    pos_ += 8;
+    return true;
+  }
+
+  bool Skip(int wire_type) {
+    uint64_t ignored;
+    uint32_t ignored32;
+    WireReader ignored_bytes(nullptr, nullptr);
+    switch (wire_type) {
+      case kVarint:
+        return ReadVarint(&ignored);
+      case kFixed64:
+        return ReadFixed64(&ignored);
+      case kLengthDelimited:
+        return ReadBytes(&ignored_bytes);
+      case kFixed32:
+        return ReadFixed32(&ignored32);
+      default:
+        return false;  // Groups are not used by caffe.proto.
+    }
+  }
+
+  std::string AsString() const {
+    return std::string(reinterpret_cast<const char*>(pos_), end_ - pos_);
+  }
+
+ private:
+  const uint8_t* pos_;
+  const uint8_t* end_;
+};
+
+static float FloatFromBits(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static bool ReadBlobShape(WireReader reader, std::vector<int>* shape) {
+  while (!reader.Done()) {
+    int field, wire_type;
+    if (!reader.ReadTag(&field, &wire_type)) {
+      return false;
+    }
+    if (field == kBlobShapeDimField && wire_type == kLengthDelimited) {
+      WireReader packed(nullptr, nullptr);
+      if (!reader.ReadBytes(&packed)) {
+        return false;
+      }
+      while (!packed.Done()) {
+        uint64_t dim;
+        if (!packed.ReadVarint(&dim)) {
+          return false;
+        }
+        shape->push_back(static_cast<int>(dim));
+      }
+    } else if (field == kBlobShapeDimField && wire_type == kVarint) {
+      uint64_t dim;
+      if (!reader.ReadVarint(&dim)) {
+        return false;
+      }
+      shape->push_back(static_cast<int>(dim));
+    } else if (!reader.Skip(wire_type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ReadBlob(WireReader reader, WeightBlob* blob) {
+  int legacy[4] = {0, 0, 0, 0};
+  bool has_legacy = false;
+  while (!reader.Done()) {
+    int field, wire_type;
+    if (!reader.ReadTag(&field, &wire_type)) {
+      return false;
+    }
+    if (field >= kBlobNumField && field <= kBlobWidthField &&
+        wire_type == kVarint) {
+      uint64_t dim;
+      if (!reader.ReadVarint(&dim)) {
+        return false;
+      }
+      legacy[field - kBlobNumField] = static_cast<int>(dim);
+      has_legacy = true;
+    } else if (field == kBlobDataField && wire_type == kLengthDelimited) {
+      WireReader packed(nullptr, nullptr);
+      if (!reader.ReadBytes(&packed)) {
+        return false;
+      }
+      while (!packed.Done()) {
+        uint32_t bits;
+        if (!packed.ReadFixed32(&bits)) {
+          return false;
+        }
+        blob->data.push_back(FloatFromBits(bits));
+      }
+    } else if (field == kBlobDataField && wire_type == kFixed32) {
+      uint32_t bits;
+      if (!reader.ReadFixed32(&bits)) {
+        return false;
+      }
+      blob->data.push_back(FloatFromBits(bits));
+    } else if (field == kBlobDoubleDataField &&
+               wire_type == kLengthDelimited) {
+      WireReader packed(nullptr, nullptr);
+      if (!reader.ReadBytes(&packed)) {
+        return false;
+      }
+      while (!packed.Done()) {
+        uint64_t bits;
+        double value;
+        if (!packed.ReadFixed64(&bits)) {
+          return false;
+        }
+        memcpy(&value, &bits, sizeof(value));
+        blob->data.push_back(static_cast<float>(value));
+      }
+    } else if (field == kBlobShapeField && wire_type == kLengthDelimited) {
+      WireReader shape(nullptr, nullptr);
+      if (!reader.ReadBytes(&shape) || !ReadBlobShape(shape, &blob->shape)) {
+        return false;
+      }
+    } else if (!reader.Skip(wire_type)) {
+      return false;
+    }
+  }
+  if (blob->shape.empty() && has_legacy) {
+    blob->shape.assign(legacy, legacy + 4);
+  }
+  return true;
+}
+
+static bool ReadLayer(WireReader reader, int name_field, int blobs_field,
+                      std::map<std::string, std::vector<WeightBlob>>* weights) {
+  std::string name;
+  std::vector<WeightBlob> blobs;
+  while (!reader.Done()) {
+    int field, wire_type;
+    if (!reader.ReadTag(&field, &wire_type)) {
+      return false;
+    }
+    if (wire_type == kLengthDelimited &&
+        (field == name_field || field == blobs_field)) {
+      WireReader payload(nullptr, nullptr);
+      if (!reader.ReadBytes(&payload)) {
+        return false;
+      }
+      if (field == name_field) {
+        name = payload.AsString();
+      } else {
+        blobs.push_back(WeightBlob());
+        if (!ReadBlob(payload, &blobs.back())) {
+          return false;
+        }
+      }
+    } else if (!reader.Skip(wire_type)) {
+      return false;
+    }
+  }
+  if (!blobs.empty()) {
+    (*weights)[name].swap(blobs);
+  }
+  return true;
+}
+
+bool ReadCaffeModel(const std::string& path,
+                    std::map<std::string, std::vector<WeightBlob>>* weights,
+                    std::string* error) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    *error = "unable to open " + path;
+    return false;
+  }
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  WireReader reader(bytes.data(), bytes.data() + bytes.size());
+  while (!reader.Done()) {
+    int field, wire_type;
+    if (!reader.ReadTag(&field, &wire_type)) {
+      *error = "truncated NetParameter in " + path;
+      return false;
+    }
+    bool is_layer = field == kNetLayerField || field == kNetV1LayersField;
+    if (is_layer && wire_type == kLengthDelimited) {
+      WireReader layer(nullptr, nullptr);
+      bool v1 = field == kNetV1LayersField;
+      if (!reader.ReadBytes(&layer) ||
+          !ReadLayer(layer, v1 ? kV1LayerNameField : kLayerNameField,
+                     v1 ? kV1LayerBlobsField : kLayerBlobsField, weights)) {
+        *error = "malformed layer in " + path;
+        return false;
+      }
+    } else if (!reader.Skip(wire_type)) {
+      *error = "malformed NetParameter in " + path;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace ssd
@@ -0,0 +1,57 @@
+#ifndef SRC_ASSISTANT_SSD_PROTO_H_
+#define SRC_ASSISTANT_SSD_PROTO_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ssd {
+
+// One message of a protobuf text-format file such as a Caffe prototxt.
+// Scalar fields keep their textual value; nested messages are kept in file
+// order. Repeated fields simply appear more than once.
+class TextMessage {
+ public:
+  // Parses |text|. Returns false and fills |error| on a syntax error.
+  bool Parse(const std::string& text, std::string* error);
+
+  bool Has(const std::string& key) const;
+  std::string GetString(const std::string& key,
+                        const std::string& fallback = "") const;
+  float GetFloat(const std::string& key, float fallback) const;
+  int GetInt(const std::string& key, int fallback) const;
+  bool GetBool(const std::string& key, bool fallback) const;
+  std::vector<std::string> GetStrings(const std::string& key) const;
+  std::vector<float> GetFloats(const std::string& key) const;
+  std::vector<int> GetInts(const std::string& key) const;
+
+  // First nested message named |key|, or an empty message if absent.
+  const TextMessage& Child(const std::string& key) const;
+  std::vector<const TextMessage*> Children(const std::string& key) const;
+
+ private:
+  friend class TextParser;
+
+  std::vector<std::pair<std::string, std::string>> values_;
+  std::vector<std::pair<std::string, TextMessage>> children_;
+};
+
+// A learned parameter blob from a .caffemodel.
+struct WeightBlob {
+  std::vector<int> shape;
+  std::vector<float> data;
+};
+
+// Reads the blobs of every layer in a binary .caffemodel (a serialized
+// caffe.NetParameter) without depending on the Caffe protobuf definitions.
+// Only the fields needed for inference are decoded: layer name and blobs.
+bool ReadCaffeModel(const std::string& path,
+                    std::map<std::string, std::vector<WeightBlob>>* weights,
+                    std::string* error);
+
+}  // namespace ssd
+
+#endif  // SRC_ASSISTANT_SSD_PROTO_H_
@@ -0,0 +1,262 @@
+#ifndef SRC_ASSISTANT_SSD_SIMD_H_
+#define SRC_ASSISTANT_SSD_SIMD_H_
+
+// Minimal 4-lane float vector used by the SSD kernels and postprocessing,
+// plus the integer lanes the INT8 kernels need. Maps onto NEON on the
+// Pi, SSE on x86 development machines (with FMA when built with -mfma or
+// -mavx2), and plain arrays elsewhere so the kernels always compile.
+
+#include <stdint.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SSD_SIMD_NEON 1
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define SSD_SIMD_SSE 1
+#endif
+
+namespace ssd {
+
+#if defined(SSD_SIMD_NEON)
+
+typedef float32x4_t v4f;
+
+inline v4f V4Load(const float* p) { return vld1q_f32(p); }
+inline void V4Store(float* p, v4f v) { vst1q_f32(p, v); }
+inline v4f V4Set1(float x) { return vdupq_n_f32(x); }
+inline v4f V4Add(v4f a, v4f b) { return vaddq_f32(a, b); }
+inline v4f V4Mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+inline v4f V4Max(v4f a, v4f b) { return vmaxq_f32(a, b); }
+inline v4f V4Sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+inline v4f V4Min(v4f a, v4f b) { return vminq_f32(a, b); }
+// Bit i set where a[i] > b[i].
+inline int V4GreaterMask(v4f a, v4f b) {
+  static const uint32_t kBits[4] = {1, 2, 4, 8};
+  uint32x4_t bits = vandq_u32(vcgtq_f32(a, b), vld1q_u32(kBits));
+  uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+  return static_cast<int>(vget_lane_u32(vpadd_u32(sum, sum), 0));
+}
+// acc + a * b
+inline v4f V4Fma(v4f acc, v4f a, v4f b) {
+#if defined(__aarch64__)
+  return vfmaq_f32(acc, a, b);
+#else
+  return vmlaq_f32(acc, a, b);
+#endif
+}
+// Loads p[0], p[2], p[4], p[6]; reads 8 floats.
+inline v4f V4LoadEven(const float* p) { return vld2q_f32(p).val[0]; }
+
+// Integer lanes for the INT8 kernels: v4i holds four int32 accumulators,
+// v8s eight int16 values. vq8 and vpair are the operands of V4IDotPairs.
+typedef int32x4_t v4i;
+typedef int16x8_t v8s;
+typedef int8x8_t vq8;
+typedef int8x8_t vpair;
+
+inline v4i V4ISet1(int32_t x) { return vdupq_n_s32(x); }
+inline v4f V4IToFloat(v4i v) { return vcvtq_f32_s32(v); }
+inline v8s V8SSet1(int16_t x) { return vdupq_n_s16(x); }
+// Sign-extends p[0..7].
+inline v8s V8SLoadI8(const int8_t* p) { return vmovl_s8(vld1_s8(p)); }
+// Sign-extends p[0], p[2], ..., p[14]; reads 16 bytes.
+inline v8s V8SLoadEvenI8(const int8_t* p) {
+  return vmovl_s8(vld2_s8(p).val[0]);
+}
+// lo += a[0..3] * b[0..3], hi += a[4..7] * b[4..7].
+inline void V8SMulAcc(v8s a, v8s b, v4i* lo, v4i* hi) {
+  *lo = vmlal_s16(*lo, vget_low_s16(a), vget_low_s16(b));
+  *hi = vmlal_s16(*hi, vget_high_s16(a), vget_high_s16(b));
+}
+// Four columns of two consecutive k values: {c0k0, c0k1, c1k0, ...}.
+inline vq8 VQ8Load(const int8_t* p) { return vld1_s8(p); }
+inline vpair VPairSet(int8_t a0, int8_t a1) {
+  return vreinterpret_s8_s16(vdup_n_s16(static_cast<int16_t>(
+      static_cast<uint8_t>(a0) | (static_cast<uint8_t>(a1) << 8))));
+}
+// acc[j] += b[2j] * a0 + b[2j + 1] * a1. Each pair sum fits in int16 for
+// values in [-127, 127].
+inline v4i V4IDotPairs(v4i acc, vq8 b, vpair a) {
+  return vpadalq_s16(acc, vmull_s8(b, a));
+}
+
+#elif defined(SSD_SIMD_SSE)
+
+typedef __m128 v4f;
+
+inline v4f V4Load(const float* p) { return _mm_loadu_ps(p); }
+inline void V4Store(float* p, v4f v) { _mm_storeu_ps(p, v); }
+inline v4f V4Set1(float x) { return _mm_set1_ps(x); }
+inline v4f V4Add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+inline v4f V4Mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+inline v4f V4Max(v4f a, v4f b) { return _mm_max_ps(a, b); }
+inline v4f V4Sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+inline v4f V4Min(v4f a, v4f b) { return _mm_min_ps(a, b); }
+inline int V4GreaterMask(v4f a, v4f b) {
+  return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+}
+inline v4f V4Fma(v4f acc, v4f a, v4f b) {
+#if defined(__FMA__)
+  return _mm_fmadd_ps(a, b, acc);
+#else
+  return _mm_add_ps(acc, _mm_mul_ps(a, b));
+#endif
+}
+inline v4f V4LoadEven(const float* p) {
+  return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+typedef __m128i v4i;
+typedef __m128i v8s;
+typedef __m128i vq8;
+typedef __m128i vpair;
+
+inline v4i V4ISet1(int32_t x) { return _mm_set1_epi32(x); }
+inline v4f V4IToFloat(v4i v) { return _mm_cvtepi32_ps(v); }
+inline v8s V8SSet1(int16_t x) { return _mm_set1_epi16(x); }
+inline v8s V8SLoadI8(const int8_t* p) {
+  __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+  return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+}
+inline v8s V8SLoadEvenI8(const int8_t* p) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  return _mm_srai_epi16(_mm_slli_epi16(x, 8), 8);
+}
+inline void V8SMulAcc(v8s a, v8s b, v4i* lo, v4i* hi) {
+  // |a| * |b| <= 127 * 127 fits in int16, so the low half is the product.
+  __m128i product = _mm_mullo_epi16(a, b);
+  *lo = _mm_add_epi32(
+      *lo, _mm_srai_epi32(_mm_unpacklo_epi16(product, product), 16));
+  *hi = _mm_add_epi32(
+      *hi, _mm_srai_epi32(_mm_unpackhi_epi16(product, product), 16));
+}
+// Widened to int16 on load so pmaddwd can do the pair products.
+inline vq8 VQ8Load(const int8_t* p) { return V8SLoadI8(p); }
+inline vpair VPairSet(int8_t a0, int8_t a1) {
+  return _mm_set1_epi32(static_cast<uint16_t>(a0) |
+                        (static_cast<uint32_t>(static_cast<uint16_t>(a1))
+                         << 16));
+}
+inline v4i V4IDotPairs(v4i acc, vq8 b, vpair a) {
+  return _mm_add_epi32(acc, _mm_madd_epi16(b, a));
+}
+
+#else
+
+struct v4f {
+  float lane[4];
+};
+
+inline v4f V4Load(const float* p) {
+  v4f v = {{p[0], p[1], p[2], p[3]}};
+  return v;
+}
+inline void V4Store(float* p, v4f v) {
+  for (int i = 0; i < 4; i++) p[i] = v.lane[i];
+}
+inline v4f V4Set1(float x) {
+  v4f v = {{x, x, x, x}};
+  return v;
+}
+inline v4f V4Add(v4f a, v4f b) {
+  for (int i = 0; i < 4; i++) a.lane[i] += b.lane[i];
+  return a;
+}
+inline v4f V4Mul(v4f a, v4f b) {
+  for (int i = 0; i < 4; i++) a.lane[i] *= b.lane[i];
+  return a;
+}
+inline v4f V4Max(v4f a, v4f b) {
+  for (int i = 0; i < 4; i++) a.lane[i] = a.lane[i] > b.lane[i] ? a.lane[i]
+                                                                 : b.lane[i];
+  return a;
+}
+inline v4f V4Sub(v4f a, v4f b) {
+  for (int i = 0; i < 4; i++) a.lane[i] -= b.lane[i];
+  return a;
+}
+inline v4f V4Min(v4f a, v4f b) {
+  for (int i = 0; i < 4; i++) a.lane[i] = a.lane[i] < b.lane[i] ? a.lane[i]
+                                                                 : b.lane[i];
+  return a;
+}
+inline int V4GreaterMask(v4f a, v4f b) {
+  int mask = 0;
+  for (int i = 0; i < 4; i++) mask |= (a.lane[i] > b.lane[i]) << i;
+  return mask;
+}
+inline v4f V4Fma(v4f acc, v4f a, v4f b) {
+  for (int i = 0; i < 4; i++) acc.lane[i] += a.lane[i] * b.lane[i];
+  return acc;
+}
+inline v4f V4LoadEven(const float* p) {
+  v4f v = {{p[0], p[2], p[4], p[6]}};
+  return v;
+}
+
+struct v4i {
+  int32_t lane[4];
+};
+struct v8s {
+  int16_t lane[8];
+};
+struct vq8 {
+  int8_t lane[8];
+};
+struct vpair {
+  int8_t a0, a1;
+};
+
+inline v4i V4ISet1(int32_t x) {
+  v4i v = {{x, x, x, x}};
+  return v;
+}
+inline v4f V4IToFloat(v4i v) {
+  v4f f;
+  for (int i = 0; i < 4; i++) f.lane[i] = static_cast<float>(v.lane[i]);
+  return f;
+}
+inline v8s V8SSet1(int16_t x) {
+  v8s v;
+  for (int i = 0; i < 8; i++) v.lane[i] = x;
+  return v;
+}
+inline v8s V8SLoadI8(const int8_t* p) {
+  v8s v;
+  for (int i = 0; i < 8; i++) v.lane[i] = p[i];
+  return v;
+}
+inline v8s V8SLoadEvenI8(const int8_t* p) {
+  v8s v;
+  for (int i = 0; i < 8; i++) v.lane[i] = p[2 * i];
+  return v;
+}
+inline void V8SMulAcc(v8s a, v8s b, v4i* lo, v4i* hi) {
+  for (int i = 0; i < 4; i++) {
+    lo->lane[i] += a.lane[i] * b.lane[i];
+    hi->lane[i] += a.lane[i + 4] * b.lane[i + 4];
+  }
+}
+inline vq8 VQ8Load(const int8_t* p) {
+  vq8 v;
+  for (int i = 0; i < 8; i++) v.lane[i] = p[i];
+  return v;
+}
+inline vpair VPairSet(int8_t a0, int8_t a1) {
+  vpair v = {a0, a1};
+  return v;
+}
+inline v4i V4IDotPairs(v4i acc, vq8 b, vpair a) {
+  for (int j = 0; j < 4; j++) {
+    acc.lane[j] += b.lane[2 * j] * a.a0 + b.lane[2 * j + 1] * a.a1;
+  }
+  return acc;
+}
+
+#endif
+
+}  // namespace ssd
+
+#endif  // SRC_ASSISTANT_SSD_SIMD_H_
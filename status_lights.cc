@@ -0,0 +1,194 @@
+#include "assistant/status_lights.h"
+
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "assistant/trace.h"
+
+static const int kStatusCount = static_cast<int>(RobotStatus::kError) + 1;
+// Every fifth LED is lit, from a different first one per status, as the
+// loop used to do by hand.
+static const int kLitSpacing = 5;
+static const float kBreathPeriodS = 2;
+// Dimmest point of the breath, as a fraction of the brightness.
+static const float kBreathFloor = 0.3f;
+static const float kMovingLedsPerS = 10;
+static const float kSearchPeriodS = 2;
+static const int kCometTail = 5;
+static const float kErrorBlinkS = 1;
+
+static bool SameFrame(const std::vector<LedColor>& a,
+                      const std::vector<LedColor>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].red != b[i].red || a[i].green != b[i].green ||
+        a[i].blue != b[i].blue || a[i].white != b[i].white) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint8_t Scale(uint8_t brightness, float level) {
+  return static_cast<uint8_t>(std::lround(brightness * level));
+}
+
+StatusLights::StatusLights(LedPort* leds, Clock* clock,
+                           const StatusLightsConfig& config)
+    : leds_(leds),
+      clock_(clock),
+      config_(config),
+      status_(static_cast<int>(RobotStatus::kIdle)),
+      frames_(0),
+      writes_(0),
+      running_(false),
+      exited_(true) {}
+
+StatusLights::~StatusLights() { Stop(); }
+
+bool StatusLights::Start() {
+  if (config_.frame_rate_hz <= 0) {
+    std::cerr << "status_lights: invalid frame rate " << config_.frame_rate_hz
+              << std::endl;
+    return false;
+  }
+  BuildAnimations();
+  running_ = true;
+  exited_ = false;
+  clock_->AddThread();
+  thread_ = std::thread(&StatusLights::RenderLoop, this);
+  return true;
+}
+
+void StatusLights::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // Sleep on the clock until the thread is out, so a simulated one keeps
+  // running.
+  while (!exited_) {
+    clock_->SleepForNs(1000000000LL / config_.frame_rate_hz);
+  }
+  thread_.join();
+}
+
+void StatusLights::BuildAnimations() {
+  const int count = leds_->Count();
+  const float fps = config_.frame_rate_hz;
+  const uint8_t bright = config_.brightness;
+  animations_.assign(kStatusCount, std::vector<Frame>());
+
+  animations_[static_cast<int>(RobotStatus::kIdle)].push_back(Frame(count));
+
+  auto& listening = animations_[static_cast<int>(RobotStatus::kListening)];
+  int breath_frames = std::max(1, static_cast<int>(kBreathPeriodS * fps));
+  for (int k = 0; k < breath_frames; k++) {
+    float wave = (1 - std::cos(2 * M_PI * k / breath_frames)) / 2;
+    Frame frame(count);
+    for (int i = 0; i < count; i += kLitSpacing) {
+      frame[i].blue = Scale(bright, kBreathFloor + (1 - kBreathFloor) * wave);
+    }
+    listening.push_back(frame);
+  }
+
+  Frame recognized(count);
+  for (int i = 2; i < count; i += kLitSpacing) {
+    recognized[i].green = bright;
+  }
+  animations_[static_cast<int>(RobotStatus::kRecognized)].push_back(
+      recognized);
+
+  // The lit LEDs step round one at a time; the pattern repeats after
+  // kLitSpacing steps.
+  auto& moving = animations_[static_cast<int>(RobotStatus::kMoving)];
+  int step_frames = std::max(1, static_cast<int>(fps / kMovingLedsPerS));
+  for (int k = 0; k < kLitSpacing * step_frames; k++) {
+    Frame frame(count);
+    for (int i = 4 + k / step_frames; i < count + 4; i += kLitSpacing) {
+      frame[i % count].red = bright;
+    }
+    moving.push_back(frame);
+  }
+
+  auto& searching = animations_[static_cast<int>(RobotStatus::kSearching)];
+  int search_frames = std::max(1, static_cast<int>(kSearchPeriodS * fps));
+  for (int k = 0; k < search_frames; k++) {
+    Frame frame(count);
+    int head = k * count / search_frames;
+    for (int t = 0; t < kCometTail && t < count; t++) {
+      float level = 1 - static_cast<float>(t) / kCometTail;
+      LedColor& led = frame[(head - t + count) % count];
+      led.red = Scale(bright, level);
+      led.green = Scale(bright, level / 2);
+    }
+    searching.push_back(frame);
+  }
+
+  auto& error = animations_[static_cast<int>(RobotStatus::kError)];
+  int blink_frames = std::max(2, static_cast<int>(kErrorBlinkS * fps));
+  for (int k = 0; k < blink_frames; k++) {
+    Frame frame(count);
+    if (k < blink_frames / 2) {
+      for (LedColor& led : frame) {
+        led.red = bright;
+      }
+    }
+    error.push_back(frame);
+  }
+}
+
+void StatusLights::RenderLoop() {
+  TRACE_THREAD_NAME("lights");
+  if (config_.nice != 0 &&
+      setpriority(PRIO_PROCESS, syscall(SYS_gettid), config_.nice) != 0) {
+    std::clog << "status_lights: cannot set nice " << config_.nice << " ("
+              << strerror(errno) << ")" << std::endl;
+  }
+
+  const int64_t period_ns = 1000000000LL / config_.frame_rate_hz;
+  int64_t scheduled_ns = clock_->NowNs();
+  int shown = -1;
+  size_t phase = 0;
+  while (running_) {
+    int status = status_;
+    if (status != shown) {
+      shown = status;
+      phase = 0;
+    }
+    const std::vector<Frame>& animation = animations_[status];
+    back_ = animation[phase % animation.size()];
+    phase++;
+    Present();
+    frames_++;
+
+    scheduled_ns += period_ns;
+    int64_t now_ns = clock_->NowNs();
+    if (scheduled_ns < now_ns) {
+      // Fell behind; keep the rate from here rather than catch up.
+      scheduled_ns = now_ns;
+    }
+    clock_->SleepUntilNs(scheduled_ns);
+  }
+  back_.assign(leds_->Count(), LedColor());
+  Present();
+  exited_ = true;
+  clock_->RemoveThread();
+}
+
+void StatusLights::Present() {
+  if (!SameFrame(back_, front_)) {
+    TRACE_SCOPE("lights.write");
+    leds_->Write(back_);
+    writes_++;
+  }
+  front_.swap(back_);
+}
@@ -0,0 +1,90 @@
+#ifndef SRC_ASSISTANT_STATUS_LIGHTS_H_
+#define SRC_ASSISTANT_STATUS_LIGHTS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/robot_hal.h"
+
+// What the ring shows.
+enum class RobotStatus {
+  // Dark.
+  kIdle,
+  // Blue, breathing: waiting for the user to speak.
+  kListening,
+  // Green: words are coming in.
+  kRecognized,
+  // Red, turning: acting on a robot command.
+  kMoving,
+  // Amber comet going round: looking for a person.
+  kSearching,
+  // The whole ring blinking red: the Assistant call failed.
+  kError,
+};
+
+struct StatusLightsConfig {
+  uint8_t brightness = 50;
+  // Frames are rendered at this rate whatever the status; the bus is only
+  // written when a frame differs from the one shown.
+  int frame_rate_hz = 20;
+  // Nice value of the ring thread, so it gives way to the audio, IMU and
+  // motion threads.
+  int nice = 10;
+};
+
+// The LED ring on a thread of its own. Every status has its animation
+// precomputed as a loop of frames; the thread steps through the current
+// one at a fixed frame rate, double-buffered, and writes the ring only when
+// the next frame differs from the one on it, so a steady status costs no
+// bus time. Show() is a single atomic store: the voice loop never waits on
+// the ring, and may call it as often as it likes.
+class StatusLights {
+ public:
+  StatusLights(LedPort* leds, Clock* clock, const StatusLightsConfig& config);
+  // Stop().
+  ~StatusLights();
+
+  // Returns false only for an invalid configuration.
+  bool Start();
+  // Darkens the ring and ends the thread.
+  void Stop();
+
+  // Restarts the animation if |status| differs from the one shown.
+  void Show(RobotStatus status) { status_ = static_cast<int>(status); }
+
+  // Frames rendered, and how many of them went to the bus.
+  uint64_t frames() const { return frames_; }
+  uint64_t writes() const { return writes_; }
+
+ private:
+  typedef std::vector<LedColor> Frame;
+
+  void BuildAnimations();
+  void RenderLoop();
+  // Swaps |back_| in as the shown frame, writing it if it differs.
+  void Present();
+
+  LedPort* leds_;
+  Clock* clock_;
+  StatusLightsConfig config_;
+  // Frames of each status's animation, indexed by RobotStatus.
+  std::vector<std::vector<Frame>> animations_;
+  // The frame on the ring and the one being composed.
+  Frame front_;
+  Frame back_;
+  std::atomic<int> status_;
+  std::atomic<uint64_t> frames_;
+  std::atomic<uint64_t> writes_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  // Set by the thread as it finishes, so Stop() can wait on the clock.
+  std::atomic<bool> exited_;
+
+  StatusLights(const StatusLights&) = delete;
+  StatusLights& operator=(const StatusLights&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_STATUS_LIGHTS_H_
@@ -0,0 +1,189 @@
+#include "assistant/target_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Velocity uncertainty of a new track, in seconds of its acceleration
+// noise: a person seen once may already be walking.
+static const float kInitialVelocitySeconds = 1.0f;
+
+// IoU of two boxes given by center and size.
+static float BoxIou(float ax, float ay, float aw, float ah, float bx, float by,
+                    float bw, float bh) {
+  float iw = std::min(ax + aw / 2, bx + bw / 2) -
+             std::max(ax - aw / 2, bx - bw / 2);
+  float ih = std::min(ay + ah / 2, by + bh / 2) -
+             std::max(ay - ah / 2, by - bh / 2);
+  if (iw <= 0 || ih <= 0) {
+    return 0;
+  }
+  float inter = iw * ih;
+  return inter / (aw * ah + bw * bh - inter);
+}
+
+void TargetTracker::Axis::Init(float value, float noise,
+                               float velocity_sigma) {
+  position = value;
+  velocity = 0;
+  p00 = noise * noise;
+  p01 = 0;
+  p11 = velocity_sigma * velocity_sigma;
+}
+
+void TargetTracker::Axis::Advance(float dt, float accel) {
+  // F = [1 dt; 0 1], Q from white acceleration noise of |accel|.
+  float q = accel * accel;
+  float dt2 = dt * dt;
+  position += velocity * dt;
+  p00 += dt * (2 * p01 + dt * p11) + q * dt2 * dt2 / 4;
+  p01 += dt * p11 + q * dt2 * dt / 2;
+  p11 += q * dt2;
+}
+
+void TargetTracker::Axis::Correct(float measurement, float noise) {
+  float s = p00 + noise * noise;
+  float k0 = p00 / s;
+  float k1 = p01 / s;
+  float innovation = measurement - position;
+  position += k0 * innovation;
+  velocity += k1 * innovation;
+  float new_p11 = p11 - k1 * p01;
+  p01 = (1 - k0) * p01;
+  p00 = (1 - k0) * p00;
+  p11 = new_p11;
+}
+
+TargetTracker::TargetTracker(const TrackerConfig& config)
+    : config_(config), next_id_(1), primary_id_(0) {
+  float half_fov = config_.horizontal_fov_deg * M_PI / 360;
+  focal_px_ = (config_.frame_width / 2) / std::tan(half_fov);
+}
+
+void TargetTracker::Advance(Track* track, int64_t time_ns) const {
+  if (time_ns <= track->time_ns) {
+    return;
+  }
+  float dt = (time_ns - track->time_ns) / 1e9f;
+  track->x.Advance(dt, config_.position_accel_px);
+  track->y.Advance(dt, config_.position_accel_px);
+  track->width.Advance(dt, config_.size_accel_px);
+  track->height.Advance(dt, config_.size_accel_px);
+  track->range.Advance(dt, config_.range_accel_m);
+  track->time_ns = time_ns;
+}
+
+void TargetTracker::Update(const DetectionRecord& record) {
+  int64_t now_ns = record.capture_time_ns;
+  tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                               [this, now_ns](const Track& track) {
+                                 return now_ns - track.last_seen_ns >
+                                        config_.max_coast_ns;
+                               }),
+                tracks_.end());
+  for (Track& track : tracks_) {
+    Advance(&track, now_ns);
+  }
+
+  if (record.found) {
+    Track* best = nullptr;
+    float best_iou = config_.min_iou;
+    for (Track& track : tracks_) {
+      float iou = BoxIou(track.x.position, track.y.position,
+                         track.width.position, track.height.position,
+                         record.x, record.y, record.width, record.height);
+      if (iou >= best_iou) {
+        best = &track;
+        best_iou = iou;
+      }
+    }
+    if (best != nullptr) {
+      best->x.Correct(record.x, config_.position_noise_px);
+      best->y.Correct(record.y, config_.position_noise_px);
+      best->width.Correct(record.width, config_.size_noise_px);
+      best->height.Correct(record.height, config_.size_noise_px);
+      best->range.Correct(record.distance, config_.range_noise_m);
+      best->last_seen_ns = now_ns;
+      best->hits++;
+    } else {
+      Track track;
+      track.id = next_id_++;
+      track.time_ns = now_ns;
+      track.last_seen_ns = now_ns;
+      track.hits = 1;
+      float s = kInitialVelocitySeconds;
+      track.x.Init(record.x, config_.position_noise_px,
+                   config_.position_accel_px * s);
+      track.y.Init(record.y, config_.position_noise_px,
+                   config_.position_accel_px * s);
+      track.width.Init(record.width, config_.size_noise_px,
+                       config_.size_accel_px * s);
+      track.height.Init(record.height, config_.size_noise_px,
+                        config_.size_accel_px * s);
+      track.range.Init(record.distance, config_.range_noise_m,
+                       config_.range_accel_m * s);
+      tracks_.push_back(track);
+    }
+  }
+
+  // Keep following the same person for as long as their track lives;
+  // otherwise switch to the best-established confirmed track.
+  const Track* primary = nullptr;
+  for (const Track& track : tracks_) {
+    if (track.id == primary_id_) {
+      return;
+    }
+    if (track.hits >= config_.min_hits &&
+        (primary == nullptr || track.hits > primary->hits)) {
+      primary = &track;
+    }
+  }
+  primary_id_ = primary != nullptr ? primary->id : 0;
+}
+
+TrackEstimate TargetTracker::Predict(int64_t time_ns) const {
+  TrackEstimate estimate;
+  for (const Track& track : tracks_) {
+    if (track.id != primary_id_ || track.hits < config_.min_hits) {
+      continue;
+    }
+    Track state = track;
+    Advance(&state, time_ns);
+    estimate.valid = time_ns - state.last_seen_ns <= config_.max_coast_ns;
+    estimate.id = state.id;
+    estimate.x = state.x.position;
+    estimate.y = state.y.position;
+    estimate.width = std::max(state.width.position, 1.0f);
+    estimate.height = std::max(state.height.position, 1.0f);
+    estimate.bearing_deg = BearingDeg(estimate.x);
+    // d(atan(u / f)) / dt = f / (f^2 + u^2) * du / dt.
+    float u = estimate.x - config_.frame_width / 2;
+    estimate.bearing_rate_deg_s = 180 / M_PI * focal_px_ /
+                                  (focal_px_ * focal_px_ + u * u) *
+                                  state.x.velocity;
+    estimate.distance = std::max(state.range.position, 0.0f);
+    estimate.distance_rate = state.range.velocity;
+    estimate.coast_ns = time_ns - state.last_seen_ns;
+  }
+  return estimate;
+}
+
+void TargetTracker::Rotate(float degrees) {
+  for (Track& track : tracks_) {
+    track.x.position =
+        PixelAtBearing(BearingDeg(track.x.position) - degrees);
+  }
+}
+
+void TargetTracker::Reset() {
+  tracks_.clear();
+  primary_id_ = 0;
+}
+
+float TargetTracker::BearingDeg(float x) const {
+  return std::atan((x - config_.frame_width / 2) / focal_px_) * 180 / M_PI;
+}
+
+float TargetTracker::PixelAtBearing(float degrees) const {
+  return config_.frame_width / 2 +
+         focal_px_ * std::tan(degrees * static_cast<float>(M_PI) / 180);
+}
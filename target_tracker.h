@@ -0,0 +1,118 @@
+#ifndef SRC_ASSISTANT_TARGET_TRACKER_H_
+#define SRC_ASSISTANT_TARGET_TRACKER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "assistant/detection_channel.h"
+
+struct TrackerConfig {
+  // Camera model the detections are expressed in; see PersonDetectorConfig.
+  float frame_width = 400;
+  float horizontal_fov_deg = 78;
+  // A detection joins the track whose predicted box it overlaps most, if
+  // the IoU is at least this; otherwise it starts a new track.
+  float min_iou = 0.2;
+  // Detections a track needs before it is reported.
+  int min_hits = 2;
+  // A track is dropped after this long without a detection.
+  int64_t max_coast_ns = 1500000000;
+  // Standard deviation of the unmodeled acceleration (process noise) of the
+  // box center, the box size and the range, per second squared.
+  float position_accel_px = 100;
+  float size_accel_px = 50;
+  float range_accel_m = 1.5;
+  // Standard deviation of a single detection.
+  float position_noise_px = 8;
+  float size_noise_px = 12;
+  float range_noise_m = 0.4;
+};
+
+// Filtered state of the followed person at some instant.
+struct TrackEstimate {
+  // False when no confirmed track exists.
+  bool valid = false;
+  // Stays the same for as long as the same person is tracked.
+  int id = 0;
+  // Box center and size in frame pixels.
+  float x = 0;
+  float y = 0;
+  float width = 0;
+  float height = 0;
+  // Angle off the camera axis, positive to the right, in degrees, and its
+  // rate of change in degrees per second.
+  float bearing_deg = 0;
+  float bearing_rate_deg_s = 0;
+  // Range in meters and its rate of change in meters per second.
+  float distance = 0;
+  float distance_rate = 0;
+  // Time since the last detection that updated the track.
+  int64_t coast_ns = 0;
+};
+
+// SORT-style tracker for the follow loop. Every track keeps a
+// constant-velocity Kalman filter on its box center, box size and range;
+// detections are associated to tracks by IoU against the predicted boxes.
+// Between detector frames Predict() extrapolates the followed track to any
+// instant, so the controller can run much faster than the detector.
+//
+// The followed ("primary") track is the first confirmed one and is kept
+// until it expires, so a frame where the detector picks up someone else
+// starts a separate track instead of dragging the target across.
+//
+// Not thread-safe; the follow loop owns it.
+class TargetTracker {
+ public:
+  explicit TargetTracker(const TrackerConfig& config);
+
+  // Feeds one detector frame, found or not, stamped with its capture time.
+  // Frames must arrive in capture order.
+  void Update(const DetectionRecord& record);
+
+  // The primary track extrapolated to |time_ns|. Does not change state.
+  TrackEstimate Predict(int64_t time_ns) const;
+
+  // Accounts for the robot turning in place by |degrees| (positive to the
+  // right): every track's bearing shifts the other way.
+  void Rotate(float degrees);
+
+  // Forgets every track.
+  void Reset();
+
+  const TrackerConfig& config() const { return config_; }
+
+  // Bearing of pixel column |x|, positive to the right, and the column at
+  // |degrees|.
+  float BearingDeg(float x) const;
+  float PixelAtBearing(float degrees) const;
+
+ private:
+  // One constant-velocity Kalman filter: position, velocity and the
+  // symmetric 2x2 covariance.
+  struct Axis {
+    float position, velocity;
+    float p00, p01, p11;
+    void Init(float value, float noise, float velocity_sigma);
+    void Advance(float dt, float accel);
+    void Correct(float measurement, float noise);
+  };
+
+  struct Track {
+    int id;
+    int64_t time_ns;
+    int64_t last_seen_ns;
+    int hits;
+    Axis x, y, width, height, range;
+  };
+
+  void Advance(Track* track, int64_t time_ns) const;
+
+  TrackerConfig config_;
+  float focal_px_;
+  std::vector<Track> tracks_;
+  int next_id_;
+  int primary_id_;
+};
+
+#endif  // SRC_ASSISTANT_TARGET_TRACKER_H_
@@ -0,0 +1,215 @@
+// Replay test for TargetTracker: feeds a detection log through the tracker
+// and through the follow loop's old frame-to-frame rule, runs a 20 Hz
+// controller on each, and reports track continuity and how many turns each
+// one issued and how many of them were redundant (reversed within
+// --reversal-window). The tracked controller is the one Follow() runs: it
+// turns once the target's bearing is off by more than
+// FollowConfig::turn_deadband_deg. It must issue no more turns than the
+// old rule, and fewer redundant ones.
+//
+// Without --detections it replays a synthetic minute: one person walking
+// back and forth at 2-4 m, detected at ~4 Hz with pixel jitter, dropped
+// frames, and occasional frames where the detector picked someone else.
+// Logs are written by `vision_pipeline_bench --record`.
+//
+// Usage: ./target_tracker_test [--detections <log>] [--reversal-window S]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "assistant/detection_channel.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/target_tracker.h"
+
+static const int64_t kControlPeriodNs = 50000000;  // 20 Hz
+// The old follow loop's rule: turn when x moved more than this many pixels.
+static const float kTurnThresholdPx = 10;
+
+// Bearing of the synthetic person, in pixels of the 400-wide frame, at |t|.
+static float TruthX(double t) { return 200 + 90 * std::sin(t * 2 * M_PI / 20); }
+
+static std::vector<DetectionRecord> SyntheticLog() {
+  std::mt19937 random(11);
+  std::normal_distribution<float> jitter(0, 1);
+  std::uniform_real_distribution<float> unit(0, 1);
+  std::vector<DetectionRecord> log;
+  double t = 0;
+  for (uint64_t frame = 1; t < 60; frame++) {
+    t += 0.2 + 0.1 * unit(random);
+    DetectionRecord record = DetectionRecord();
+    record.frame_id = frame;
+    record.capture_time_ns = static_cast<int64_t>(t * 1e9);
+    float distance = 3 + std::sin(t * 2 * M_PI / 30);
+    record.found = unit(random) > 0.15f;
+    record.x = TruthX(t) + 6 * jitter(random);
+    record.y = 150 + 4 * jitter(random);
+    record.height = 1.7f * 247 / distance + 6 * jitter(random);
+    record.width = record.height * 0.4f + 4 * jitter(random);
+    record.distance = distance + 0.25f * jitter(random);
+    record.confidence = 0.95f;
+    if (record.found && unit(random) < 0.05f) {
+      // Someone else, off to one side.
+      record.x = record.x < 200 ? 340 : 60;
+    }
+    log.push_back(record);
+  }
+  return log;
+}
+
+// Counts turn commands and reversals among them.
+struct TurnCounter {
+  explicit TurnCounter(double reversal_window_s)
+      : window_ns(static_cast<int64_t>(reversal_window_s * 1e9)) {}
+
+  void Turn(int direction, int64_t time_ns) {
+    turns++;
+    if (last_direction != 0 && direction != last_direction &&
+        time_ns - last_time_ns < window_ns) {
+      redundant++;
+    }
+    last_direction = direction;
+    last_time_ns = time_ns;
+  }
+
+  int64_t window_ns;
+  int turns = 0;
+  int redundant = 0;
+  int last_direction = 0;
+  int64_t last_time_ns = 0;
+};
+
+int main(int argc, char** argv) {
+  std::string log_path;
+  double reversal_window_s = 2;
+
+  const struct option long_options[] = {
+      {"detections", required_argument, nullptr, 'd'},
+      {"reversal-window", required_argument, nullptr, 'w'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "d:w:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'd':
+        log_path = optarg;
+        break;
+      case 'w':
+        reversal_window_s = std::atof(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  std::vector<DetectionRecord> log;
+  bool synthetic = log_path.empty();
+  if (synthetic) {
+    log = SyntheticLog();
+  } else {
+    std::string error;
+    if (!ReadDetectionLog(log_path, &log, &error)) {
+      std::cerr << "target_tracker_test: " << error << std::endl;
+      return -1;
+    }
+  }
+  if (log.empty()) {
+    std::cerr << "target_tracker_test: empty log" << std::endl;
+    return -1;
+  }
+
+  // Replayed open loop: the recorded robot did not act on these commands,
+  // so both controllers see the same frames.
+  TrackerConfig config;
+  TargetTracker tracker(config);
+  TurnCounter raw_turns(reversal_window_s);
+  TurnCounter tracked_turns(reversal_window_s);
+  float raw_x = config.frame_width / 2;
+  // Open loop, a turn cannot zero the bearing; the tracked controller turns
+  // again once the bearing is the deadband off where it last turned to.
+  const float deadband_deg = FollowConfig().turn_deadband_deg;
+  float tracked_turn_deg = 0;
+  int id = 0;
+  int id_switches = 0;
+  int ticks_with_person = 0;
+  int ticks_tracked = 0;
+  double raw_error = 0;
+  double tracked_error = 0;
+  int64_t last_found_ns = -config.max_coast_ns - 1;
+
+  size_t next = 0;
+  int64_t end_ns = log.back().capture_time_ns;
+  for (int64_t now = log.front().capture_time_ns; now <= end_ns;
+       now += kControlPeriodNs) {
+    for (; next < log.size() && log[next].capture_time_ns <= now; next++) {
+      const DetectionRecord& record = log[next];
+      tracker.Update(record);
+      if (!record.found) {
+        continue;
+      }
+      last_found_ns = record.capture_time_ns;
+      // The old loop: compare every new detection with the previous one.
+      if (std::fabs(record.x - raw_x) > kTurnThresholdPx) {
+        raw_turns.Turn(record.x > raw_x ? 1 : -1, now);
+      }
+      raw_x = record.x;
+    }
+
+    TrackEstimate target = tracker.Predict(now);
+    bool person_present = now - last_found_ns <= config.max_coast_ns;
+    ticks_with_person += person_present;
+    if (!target.valid) {
+      continue;
+    }
+    ticks_tracked += person_present;
+    if (id != 0 && target.id != id) {
+      id_switches++;
+    }
+    id = target.id;
+    float bearing_deg = tracker.BearingDeg(target.x);
+    if (std::fabs(bearing_deg - tracked_turn_deg) > deadband_deg) {
+      tracked_turns.Turn(bearing_deg > tracked_turn_deg ? 1 : -1, now);
+      tracked_turn_deg = bearing_deg;
+    }
+    if (synthetic) {
+      float truth = TruthX(now / 1e9);
+      raw_error += (raw_x - truth) * (raw_x - truth);
+      tracked_error += (target.x - truth) * (target.x - truth);
+    }
+  }
+
+  double continuity =
+      ticks_with_person > 0 ? static_cast<double>(ticks_tracked) /
+                                  ticks_with_person
+                            : 0;
+  std::cout << "detections: " << log.size() << " over "
+            << (end_ns - log.front().capture_time_ns) / 1e9 << "s"
+            << std::endl;
+  std::cout << "track continuity: " << 100 * continuity
+            << "% of controller ticks, " << id_switches << " id switches"
+            << std::endl;
+  std::cout << "turns: raw " << raw_turns.turns << " (" << raw_turns.redundant
+            << " redundant), tracked " << tracked_turns.turns << " ("
+            << tracked_turns.redundant << " redundant)" << std::endl;
+  if (synthetic && ticks_tracked > 0) {
+    std::cout << "x rms error: raw " << std::sqrt(raw_error / ticks_tracked)
+              << "px, tracked " << std::sqrt(tracked_error / ticks_tracked)
+              << "px" << std::endl;
+  }
+
+  bool ok = tracked_turns.turns <= raw_turns.turns &&
+            tracked_turns.redundant < std::max(raw_turns.redundant, 1) &&
+            continuity >= 0.9 && id_switches <= 1;
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "assistant/task_executor.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+
+#include "assistant/trace.h"
+
+void TaskHandle::Cancel() const {
+  if (state_ != nullptr) {
+    state_->token.Cancel();
+  }
+}
+
+bool TaskHandle::done() const {
+  if (state_ == nullptr) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->done;
+}
+
+void TaskHandle::Wait() const {
+  if (state_ == nullptr) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  state_->finished.wait(lock, [this] { return state_->done; });
+}
+
+bool TaskHandle::WaitFor(int64_t timeout_ns) const {
+  if (state_ == nullptr) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  return state_->finished.wait_for(lock, std::chrono::nanoseconds(timeout_ns),
+                                   [this] { return state_->done; });
+}
+
+TaskExecutor::TaskExecutor(int threads) : stopping_(false) {
+  for (int i = 0; i < threads; i++) {
+    threads_.emplace_back(&TaskExecutor::WorkerLoop, this);
+  }
+}
+
+TaskExecutor::~TaskExecutor() { Shutdown(); }
+
+TaskHandle TaskExecutor::Post(std::function<void(const CancelToken&)> task) {
+  TaskHandle handle;
+  handle.state_ = std::make_shared<TaskHandle::State>();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      handle.state_->token.Cancel();
+      handle.state_->done = true;
+      return handle;
+    }
+    queue_.push_back({std::move(task), handle.state_});
+    live_.push_back(handle.state_);
+  }
+  ready_.notify_one();
+  return handle;
+}
+
+void TaskExecutor::Shutdown() {
+  std::deque<Pending> dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+    for (const auto& state : live_) {
+      state->token.Cancel();
+    }
+    dropped.swap(queue_);
+  }
+  ready_.notify_all();
+  for (const Pending& pending : dropped) {
+    Finish(pending.state.get());
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void TaskExecutor::WorkerLoop() {
+  TRACE_THREAD_NAME("executor");
+  while (true) {
+    Pending pending;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      pending = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    {
+      TRACE_SCOPE("executor.task");
+      pending.task(pending.state->token);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      live_.erase(std::find(live_.begin(), live_.end(), pending.state));
+    }
+    Finish(pending.state.get());
+  }
+}
+
+void TaskExecutor::Finish(TaskHandle::State* state) {
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->done = true;
+  }
+  state->finished.notify_all();
+}
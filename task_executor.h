@@ -0,0 +1,93 @@
+#ifndef SRC_ASSISTANT_TASK_EXECUTOR_H_
+#define SRC_ASSISTANT_TASK_EXECUTOR_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+// Asks a task to return. Tasks poll it, e.g. as a behavior's keep_going.
+class CancelToken {
+ public:
+  CancelToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+  bool cancelled() const { return cancelled_->load(); }
+  void Cancel() const { cancelled_->store(true); }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// A task posted to a TaskExecutor. Copies refer to the same task; a
+// default-constructed handle refers to none.
+class TaskHandle {
+ public:
+  bool valid() const { return state_ != nullptr; }
+  // Asks the task to return; it still runs if it had not started, and sees
+  // the token cancelled.
+  void Cancel() const;
+  // The task has returned.
+  bool done() const;
+  // Waits for the task to return.
+  void Wait() const;
+  // Waits up to |timeout_ns| for the task to return; true if it has.
+  bool WaitFor(int64_t timeout_ns) const;
+
+ private:
+  friend class TaskExecutor;
+
+  struct State {
+    CancelToken token;
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+// A fixed pool of threads running posted tasks in order. The robot's
+// long-running work (behaviors, the command loop, the LED ring) runs here
+// rather than on the thread reading the Assistant stream, which only posts
+// to it and so never blocks on a behavior. Size the pool for the tasks that
+// run at once: a task never gives up its thread until it returns.
+class TaskExecutor {
+ public:
+  explicit TaskExecutor(int threads);
+  // Shutdown().
+  ~TaskExecutor();
+
+  TaskHandle Post(std::function<void(const CancelToken&)> task);
+
+  // Cancels every task, queued or running, and waits for the running ones
+  // to return. Queued tasks are dropped without running.
+  void Shutdown();
+
+ private:
+  struct Pending {
+    std::function<void(const CancelToken&)> task;
+    std::shared_ptr<TaskHandle::State> state;
+  };
+
+  void WorkerLoop();
+  static void Finish(TaskHandle::State* state);
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Pending> queue_;
+  // Tasks posted and not yet returned, to cancel at shutdown.
+  std::vector<std::shared_ptr<TaskHandle::State>> live_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+
+  TaskExecutor(const TaskExecutor&) = delete;
+  TaskExecutor& operator=(const TaskExecutor&) = delete;
+};
+
+#endif  // SRC_ASSISTANT_TASK_EXECUTOR_H_
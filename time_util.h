@@ -0,0 +1,16 @@
+#ifndef SRC_ASSISTANT_TIME_UTIL_H_
+#define SRC_ASSISTANT_TIME_UTIL_H_
+
+#include <stdint.h>
+#include <time.h>
+
+// Nanoseconds on CLOCK_MONOTONIC. Comparable across processes on the same
+// host, unaffected by wall-clock adjustments. Served from the vDSO, so it
+// does not enter the kernel.
+inline int64_t MonotonicNowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+#endif  // SRC_ASSISTANT_TIME_UTIL_H_
@@ -0,0 +1,280 @@
+#include "assistant/trace.h"
+
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+static_assert((kTraceRingEvents & (kTraceRingEvents - 1)) == 0,
+              "ring size must be a power of two");
+
+namespace {
+
+struct TraceRegistry {
+  std::mutex mutex;
+  // Held for a whole dump, so the signal thread and the one exiting do not
+  // write the same temporary file at once.
+  std::mutex dump_mutex;
+  // Set by the dump at exit; a signal after it would leave a half-written
+  // temporary file behind. Guarded by dump_mutex.
+  bool dumped_at_exit = false;
+  std::vector<TraceRing*> rings;
+  std::vector<std::string> names;
+  // Counter and clock at startup, to turn ticks into nanoseconds.
+  uint64_t base_ticks = TraceTicks();
+  int64_t base_ns = MonotonicNowNs();
+};
+
+// Never destroyed: threads may still record while the process exits.
+TraceRegistry* Registry() {
+  static TraceRegistry* registry = new TraceRegistry();
+  return registry;
+}
+
+struct CopiedEvent {
+  uint32_t name_id;
+  bool instant;
+  uint64_t start_ticks, end_ticks;
+};
+
+// Copies the events of |ring| still intact after the copy, oldest first.
+void CopyRing(const TraceRing& ring, std::vector<CopiedEvent>* events) {
+  uint32_t head = __atomic_load_n(&ring.head, __ATOMIC_ACQUIRE);
+  uint32_t count =
+      __atomic_load_n(&ring.full, __ATOMIC_RELAXED) ? kTraceRingEvents : head;
+  std::vector<CopiedEvent> copy(count);
+  for (uint32_t i = 0; i < count; i++) {
+    const TraceEvent& event =
+        ring.events[(head - count + i) & (kTraceRingEvents - 1)];
+    copy[i].name_id = __atomic_load_n(&event.name_id, __ATOMIC_RELAXED);
+    copy[i].instant = __atomic_load_n(&event.instant, __ATOMIC_RELAXED) != 0;
+    copy[i].start_ticks =
+        __atomic_load_n(&event.start_low, __ATOMIC_RELAXED) |
+        static_cast<uint64_t>(
+            __atomic_load_n(&event.start_high, __ATOMIC_RELAXED))
+            << 32;
+    copy[i].end_ticks =
+        __atomic_load_n(&event.end_low, __ATOMIC_RELAXED) |
+        static_cast<uint64_t>(
+            __atomic_load_n(&event.end_high, __ATOMIC_RELAXED))
+            << 32;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  // Whatever the writer got to in the meantime overwrote the oldest ones.
+  // In a full ring the oldest slot is also the one the writer fills next,
+  // and head only moves once it is done, so that one may be torn too.
+  uint32_t overwritten = __atomic_load_n(&ring.head, __ATOMIC_RELAXED) - head;
+  if (count == kTraceRingEvents) {
+    overwritten++;
+  }
+  for (uint32_t i = std::min(overwritten, count); i < count; i++) {
+    events->push_back(copy[i]);
+  }
+}
+
+void WriteJsonString(FILE* out, const std::string& text) {
+  fputc('"', out);
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', out);
+    }
+    fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+std::string dump_path;
+sem_t dump_request;
+
+void OnDumpSignal(int) {
+  int saved_errno = errno;
+  sem_post(&dump_request);
+  errno = saved_errno;
+}
+
+}  // namespace
+
+__thread TraceRing* trace_thread_ring = nullptr;
+
+TraceRing* TraceNewThreadRing() {
+  // Rings outlive their threads so that what a thread did before it exited
+  // is still in the dump.
+  TraceRing* ring = new TraceRing();
+  ring->tid = syscall(SYS_gettid);
+  ring->head = 0;
+  ring->full = false;
+  TraceRegistry* registry = Registry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  registry->rings.push_back(ring);
+  trace_thread_ring = ring;
+  return ring;
+}
+
+uint32_t TraceNameId(const char* name) {
+  TraceRegistry* registry = Registry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  for (size_t i = 0; i < registry->names.size(); i++) {
+    if (registry->names[i] == name) {
+      return i;
+    }
+  }
+  registry->names.push_back(name);
+  return registry->names.size() - 1;
+}
+
+void TraceSetThreadName(const char* name) {
+  TraceRing* ring = trace_thread_ring != nullptr ? trace_thread_ring
+                                                : TraceNewThreadRing();
+  TraceRegistry* registry = Registry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  ring->thread_name = name;
+}
+
+namespace {
+
+// WriteChromeTrace with the dump mutex held.
+bool WriteChromeTraceLocked(const std::string& path) {
+  TraceRegistry* registry = Registry();
+  std::vector<TraceRing*> rings;
+  std::vector<std::string> names, thread_names;
+  {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    rings = registry->rings;
+    names = registry->names;
+    for (TraceRing* ring : rings) {
+      thread_names.push_back(ring->thread_name);
+    }
+  }
+
+  // Scale ticks to nanoseconds over the whole run so far; give it at
+  // least 10 ms so a dump right after startup is still accurate.
+  int64_t now_ns = MonotonicNowNs();
+  while (now_ns - registry->base_ns < 10000000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    now_ns = MonotonicNowNs();
+  }
+  uint64_t now_ticks = TraceTicks();
+  double ns_per_tick = static_cast<double>(now_ns - registry->base_ns) /
+                       (now_ticks - registry->base_ticks);
+  auto to_us = [registry, ns_per_tick](uint64_t ticks) {
+    return static_cast<int64_t>(ticks - registry->base_ticks) * ns_per_tick /
+           1000;
+  };
+
+  std::string temp_path = path + ".tmp";
+  FILE* out = fopen(temp_path.c_str(), "w");
+  if (out == nullptr) {
+    std::cerr << "trace: cannot write " << temp_path << ": "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  int pid = getpid();
+  fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  bool first = true;
+  std::vector<CopiedEvent> events;
+  for (size_t r = 0; r < rings.size(); r++) {
+    const TraceRing& ring = *rings[r];
+    if (!thread_names[r].empty()) {
+      fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+              "\"pid\": %d, \"tid\": %ld, \"args\": {\"name\": ",
+              first ? "" : ",\n", pid, ring.tid);
+      WriteJsonString(out, thread_names[r]);
+      fprintf(out, "}}");
+      first = false;
+    }
+    events.clear();
+    CopyRing(ring, &events);
+    for (const CopiedEvent& event : events) {
+      fprintf(out, "%s{\"name\": ", first ? "" : ",\n");
+      WriteJsonString(out, event.name_id < names.size()
+                               ? names[event.name_id]
+                               : std::string("?"));
+      if (event.instant) {
+        fprintf(out, ", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f",
+                to_us(event.start_ticks));
+      } else {
+        fprintf(out, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f",
+                to_us(event.start_ticks),
+                (event.end_ticks - event.start_ticks) * ns_per_tick / 1000);
+      }
+      fprintf(out, ", \"pid\": %d, \"tid\": %ld}", pid, ring.tid);
+      first = false;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  bool ok = fclose(out) == 0;
+  if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    std::cerr << "trace: cannot write " << path << ": " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void DumpOnSignal() {
+  TraceRegistry* registry = Registry();
+  std::lock_guard<std::mutex> lock(registry->dump_mutex);
+  if (!registry->dumped_at_exit && WriteChromeTraceLocked(dump_path)) {
+    std::clog << "trace: wrote " << dump_path << std::endl;
+  }
+}
+
+void DumpAtExit() {
+  TraceRegistry* registry = Registry();
+  std::lock_guard<std::mutex> lock(registry->dump_mutex);
+  WriteChromeTraceLocked(dump_path);
+  registry->dumped_at_exit = true;
+}
+
+}  // namespace
+
+bool WriteChromeTrace(const std::string& path) {
+  std::lock_guard<std::mutex> lock(Registry()->dump_mutex);
+  return WriteChromeTraceLocked(path);
+}
+
+bool InstallTraceDump(const std::string& path, int signal) {
+#ifndef ENABLE_TRACING
+  std::clog << "trace: built without ENABLE_TRACING; " << path
+            << " will hold no events" << std::endl;
+#endif
+  if (!dump_path.empty()) {
+    std::cerr << "trace: dump already installed" << std::endl;
+    return false;
+  }
+  dump_path = path;
+  if (sem_init(&dump_request, 0, 0) != 0) {
+    std::cerr << "trace: sem_init failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  // The handler only posts; the JSON is written on a thread of its own.
+  std::thread([] {
+    TraceSetThreadName("trace dump");
+    while (true) {
+      if (sem_wait(&dump_request) == 0) {
+        DumpOnSignal();
+      }
+    }
+  }).detach();
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnDumpSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  if (sigaction(signal, &action, nullptr) != 0) {
+    std::cerr << "trace: sigaction failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  atexit(DumpAtExit);
+  return true;
+}
@@ -0,0 +1,171 @@
+#ifndef SRC_ASSISTANT_TRACE_H_
+#define SRC_ASSISTANT_TRACE_H_
+
+#include <signal.h>
+#include <stdint.h>
+
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "assistant/time_util.h"
+
+// Hot-path tracing: spans and instants recorded into a lock-free ring per
+// thread and written out as Chrome trace JSON (chrome://tracing, Perfetto)
+// to see how the threads overlap. A span costs two reads of the CPU's
+// cycle counter and a handful of stores into the thread's ring; nothing is
+// allocated, locked or formatted until the dump, which converts counter
+// ticks to nanoseconds. Each ring keeps the newest kTraceRingEvents
+// events of its thread.
+//
+// The TRACE_* macros compile to nothing unless ENABLE_TRACING is defined
+// (the Makefile defines it unless built with TRACING=0). Names must be
+// string literals.
+//
+//   void MotorDriver::Set(float duty_a, float duty_b) {
+//     TRACE_SCOPE("motor.set");
+//     ...
+
+static const uint32_t kTraceRingEvents = 8192;
+
+// The Makefile builds most sources unoptimized; the parts of a span that
+// live in its caller are inlined anyway.
+#define TRACE_INLINE inline __attribute__((always_inline))
+
+// Current value of the counter trace timestamps are taken from.
+TRACE_INLINE uint64_t TraceTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#elif defined(__arm__) && __ARM_ARCH >= 7
+  // The generic timer's virtual count, which Linux lets user space read
+  // for the vDSO clock.
+  uint64_t ticks;
+  asm volatile("mrrc p15, 1, %Q0, %R0, c14" : "=r"(ticks));
+  return ticks;
+#else
+  return MonotonicNowNs();
+#endif
+}
+
+// Stored as relaxed 32-bit words (plain stores on the Pi), so a dump that
+// copies an event while it is rewritten is not a data race; the ring's
+// head tells the dump which copies to drop. Accessed through the __atomic
+// builtins rather than std::atomic, whose stores, in the unoptimized
+// callers, take the memory order at run time and become locked exchanges.
+struct TraceEvent {
+  uint32_t name_id;
+  uint32_t instant;
+  uint32_t start_low, start_high;
+  uint32_t end_low, end_high;
+};
+
+// Written by its own thread only.
+struct TraceRing {
+  long tid;  // NOLINT(runtime/int): what gettid returns
+  std::string thread_name;  // Guarded by the registry mutex.
+  // Number of events ever written, wrapping at 2^32.
+  uint32_t head;
+  // Set once the ring has wrapped, so a small head is not mistaken for a
+  // ring that has barely been used.
+  bool full;
+  TraceEvent events[kTraceRingEvents];
+};
+
+// The calling thread's ring, null until its first event. __thread rather
+// than thread_local, which would cost a call to an initialization wrapper
+// on every event.
+extern __thread TraceRing* trace_thread_ring;
+
+// Allocates and registers the calling thread's ring.
+TraceRing* TraceNewThreadRing();
+
+// Interns |name| and returns its id. Takes a lock; the macros call it once
+// per call site.
+uint32_t TraceNameId(const char* name);
+
+// Names the calling thread in the trace.
+void TraceSetThreadName(const char* name);
+
+// Appends an event to the calling thread's ring. |end_ticks| equal to
+// |start_ticks| with |instant| set marks an instant. Inlined into every
+// span, so that recording is a few stores with no call.
+TRACE_INLINE void TraceRecord(uint32_t name_id, uint64_t start_ticks,
+                              uint64_t end_ticks, bool instant) {
+  TraceRing* ring = trace_thread_ring;
+  if (__builtin_expect(ring == nullptr, 0)) {
+    ring = TraceNewThreadRing();
+  }
+  uint32_t head = ring->head;
+  TraceEvent& event = ring->events[head & (kTraceRingEvents - 1)];
+  __atomic_store_n(&event.name_id, name_id, __ATOMIC_RELAXED);
+  __atomic_store_n(&event.instant, instant, __ATOMIC_RELAXED);
+  __atomic_store_n(&event.start_low, start_ticks, __ATOMIC_RELAXED);
+  __atomic_store_n(&event.start_high, start_ticks >> 32, __ATOMIC_RELAXED);
+  __atomic_store_n(&event.end_low, end_ticks, __ATOMIC_RELAXED);
+  __atomic_store_n(&event.end_high, end_ticks >> 32, __ATOMIC_RELAXED);
+  if (head + 1 == kTraceRingEvents) {
+    __atomic_store_n(&ring->full, true, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Writes every thread's ring as Chrome trace JSON. May run while other
+// threads record; events overwritten during the copy are left out, and so
+// is the oldest event of a full ring, which its thread may be rewriting.
+// Dumps run one at a time.
+bool WriteChromeTrace(const std::string& path);
+
+// Writes the trace to |path| at exit and each time the process receives
+// |signal|, e.g. "kill -USR2 <pid>" while the robot misbehaves.
+bool InstallTraceDump(const std::string& path, int signal = SIGUSR2);
+
+// Records the span from construction to destruction.
+class TraceScope {
+ public:
+  TRACE_INLINE explicit TraceScope(uint32_t name_id)
+      : name_id_(name_id), start_ticks_(TraceTicks()) {}
+  TRACE_INLINE ~TraceScope() {
+    TraceRecord(name_id_, start_ticks_, TraceTicks(), false);
+  }
+
+ private:
+  uint32_t name_id_;
+  uint64_t start_ticks_;
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_TRACING
+#define TRACE_SCOPE(name)                                               \
+  static const uint32_t TRACE_CONCAT(trace_name_, __LINE__) =           \
+      TraceNameId(name);                                                \
+  TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(                      \
+      TRACE_CONCAT(trace_name_, __LINE__))
+#define TRACE_INSTANT(name)                                             \
+  do {                                                                  \
+    static const uint32_t trace_name = TraceNameId(name);               \
+    uint64_t trace_ticks = TraceTicks();                                \
+    TraceRecord(trace_name, trace_ticks, trace_ticks, true);            \
+  } while (0)
+#define TRACE_THREAD_NAME(name) TraceSetThreadName(name)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_INSTANT(name) \
+  do {                      \
+  } while (0)
+#define TRACE_THREAD_NAME(name) \
+  do {                          \
+  } while (0)
+#endif
+
+#endif  // SRC_ASSISTANT_TRACE_H_
@@ -0,0 +1,142 @@
+// Measures what tracing (trace.h) costs per event: a TRACE_SCOPE span, a
+// TRACE_INSTANT and the counter read itself, single-threaded and with
+// several threads recording at once while the trace is dumped, and writes
+// the resulting Chrome trace for a look at chrome://tracing. The threads
+// time themselves on their own CPU clock: with more threads than cores,
+// wall time would count the slices spent waiting for a core too.
+//
+// Usage: ./trace_bench [--events N] [--threads N] [--out <file>]
+
+#include <getopt.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/time_util.h"
+#include "assistant/trace.h"
+
+#ifndef ENABLE_TRACING
+#error "trace_bench measures the tracing macros; build with -DENABLE_TRACING"
+#endif
+
+static int64_t ThreadCpuNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static double SpanNs(int events, int64_t (*now_ns)() = MonotonicNowNs) {
+  int64_t start_ns = now_ns();
+  for (int i = 0; i < events; i++) {
+    TRACE_SCOPE("bench.span");
+  }
+  return static_cast<double>(now_ns() - start_ns) / events;
+}
+
+static double InstantNs(int events) {
+  int64_t start_ns = MonotonicNowNs();
+  for (int i = 0; i < events; i++) {
+    TRACE_INSTANT("bench.instant");
+  }
+  return static_cast<double>(MonotonicNowNs() - start_ns) / events;
+}
+
+static double TicksNs(int events) {
+  volatile uint64_t sink = 0;
+  int64_t start_ns = MonotonicNowNs();
+  for (int i = 0; i < events; i++) {
+    sink = TraceTicks();
+  }
+  (void)sink;
+  return static_cast<double>(MonotonicNowNs() - start_ns) / events;
+}
+
+int main(int argc, char** argv) {
+  int events = 10000000;
+  int threads = 4;
+  std::string out_path = "/tmp/trace_bench.json";
+
+  const struct option long_options[] = {
+      {"events", required_argument, nullptr, 'n'},
+      {"threads", required_argument, nullptr, 't'},
+      {"out", required_argument, nullptr, 'o'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:t:o:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        events = std::atoi(optarg);
+        break;
+      case 't':
+        threads = std::atoi(optarg);
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  TRACE_THREAD_NAME("main");
+  // Warm up: the ring is allocated and the names interned on first use.
+  SpanNs(1000);
+  InstantNs(1000);
+  printf("counter read   %6.1f ns\n", TicksNs(events));
+  printf("TRACE_INSTANT  %6.1f ns/event\n", InstantNs(events));
+  printf("TRACE_SCOPE    %6.1f ns/event\n", SpanNs(events));
+
+  // Several threads recording while the main thread dumps.
+  std::atomic<bool> stop(false);
+  std::vector<double> per_thread(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&stop, &per_thread, t] {
+      char name[32];
+      snprintf(name, sizeof(name), "worker %d", t);
+      TRACE_THREAD_NAME(name);
+      double sum = 0;
+      int rounds = 0;
+      while (!stop) {
+        sum += SpanNs(100000, ThreadCpuNs);
+        rounds++;
+      }
+      per_thread[t] = sum / rounds;
+    }));
+  }
+  int dumps = 0;
+  int64_t dump_ns = 0;
+  int64_t end_ns = MonotonicNowNs() + 1000000000;
+  while (MonotonicNowNs() < end_ns) {
+    int64_t start_ns = MonotonicNowNs();
+    if (!WriteChromeTrace(out_path)) {
+      return -1;
+    }
+    dump_ns += MonotonicNowNs() - start_ns;
+    dumps++;
+  }
+  stop = true;
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  double sum = 0;
+  for (double ns : per_thread) {
+    sum += ns;
+  }
+  printf("TRACE_SCOPE    %6.1f ns/event with %d threads on %u cores "
+         "recording and %d dumps (%.0f ms each)\n",
+         sum / threads, threads, std::thread::hardware_concurrency(), dumps,
+         dump_ns / 1e6 / dumps);
+  printf("wrote %s\n", out_path.c_str());
+  return 0;
+}
@@ -0,0 +1,356 @@
+#include "assistant/vision_pipeline.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "assistant/time_util.h"
+#include "assistant/trace.h"
+
+static const int kPausedPollUs = 10000;
+static const char* const kStageNames[VisionPipeline::kNumStages] = {
+    "capture", "preprocess", "inference", "postprocess"};
+static const char* const kQueueNames[VisionPipeline::kNumQueues] = {
+    "capture->preprocess", "preprocess->inference",
+    "inference->postprocess"};
+
+static bool IsCameraIndex(const std::string& source) {
+  if (source.empty()) {
+    return false;
+  }
+  for (char c : source) {
+    if (!isdigit(static_cast<unsigned char>(c))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static TrackerConfig RoiTrackerConfig(const PersonDetectorConfig& detector) {
+  TrackerConfig config;
+  config.frame_width = detector.frame_width;
+  config.horizontal_fov_deg = detector.horizontal_fov_deg;
+  return config;
+}
+
+VisionPipeline::VisionPipeline(PersonDetector* detector,
+                               DetectionChannel* channel,
+                               const VisionPipelineConfig& config)
+    : detector_(detector),
+      channel_(channel),
+      config_(config),
+      live_(IsCameraIndex(config.source)),
+      captured_(config.queue_capacity),
+      preprocessed_(config.queue_capacity),
+      inferred_(config.queue_capacity),
+      running_(false),
+      active_(true),
+      finished_(false),
+      start_time_ns_(0),
+      tracker_(RoiTrackerConfig(detector->config())),
+      roi_frames_(0),
+      full_frames_(0),
+      roi_inference_ns_(0),
+      full_inference_ns_(0),
+      target_seen_(false),
+      misses_(0),
+      losses_(0),
+      reacquisitions_(0),
+      reacquire_frames_(0) {
+  for (int i = 0; i < kNumStages; i++) {
+    counters_[i].frames = 0;
+    counters_[i].busy_ns = 0;
+  }
+}
+
+VisionPipeline::~VisionPipeline() { Stop(); }
+
+bool VisionPipeline::Start() {
+  bool opened = live_ ? capture_.open(std::atoi(config_.source.c_str()))
+                      : capture_.open(config_.source);
+  if (config_.roi && detector_->config().roi_input_size <= 0) {
+    std::cerr << "vision_pipeline: ROI mode needs a detector roi_input_size"
+              << std::endl;
+    return false;
+  }
+  if (!opened) {
+    std::cerr << "vision_pipeline: unable to open " << config_.source
+              << std::endl;
+    return false;
+  }
+  if (live_) {
+    capture_.set(cv::CAP_PROP_BUFFERSIZE, 1);
+    cv::Mat discard;
+    for (int i = 0; i < config_.warmup_frames; i++) {
+      capture_.read(discard);
+    }
+  }
+
+  start_time_ns_ = MonotonicNowNs();
+  running_ = true;
+  threads_[kCapture] = std::thread(&VisionPipeline::CaptureLoop, this);
+  threads_[kPreprocess] = std::thread(&VisionPipeline::PreprocessLoop, this);
+  threads_[kInference] = std::thread(&VisionPipeline::InferenceLoop, this);
+  threads_[kPostprocess] =
+      std::thread(&VisionPipeline::PostprocessLoop, this);
+  return true;
+}
+
+void VisionPipeline::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // Closing the first queue lets every stage drain and exit in order.
+  captured_.Close();
+  for (int i = 0; i < kNumStages; i++) {
+    if (threads_[i].joinable()) {
+      threads_[i].join();
+    }
+  }
+  capture_.release();
+}
+
+void VisionPipeline::SetActive(bool active) { active_ = active; }
+
+void VisionPipeline::Account(StageIndex stage, int64_t start_ns) {
+  counters_[stage].frames++;
+  counters_[stage].busy_ns += MonotonicNowNs() - start_ns;
+}
+
+void VisionPipeline::CaptureLoop() {
+  TRACE_THREAD_NAME("vision capture");
+  double fps = live_ ? 0 : capture_.get(cv::CAP_PROP_FPS);
+  int64_t frame_period_ns = fps > 0 ? static_cast<int64_t>(1e9 / fps) : 0;
+  int64_t next_frame_ns = MonotonicNowNs();
+  bool paused = false;
+  uint64_t frame_id = 0;
+
+  while (running_) {
+    if (!active_) {
+      paused = true;
+      usleep(kPausedPollUs);
+      continue;
+    }
+    if (paused) {
+      // The driver may still hold a frame from before the pause.
+      paused = false;
+      if (live_) {
+        capture_.grab();
+      }
+      captured_.Clear();
+      preprocessed_.Clear();
+      inferred_.Clear();
+      next_frame_ns = MonotonicNowNs();
+      // The robot may have moved; nothing is where the track thinks.
+      std::lock_guard<std::mutex> lock(tracker_mutex_);
+      tracker_.Reset();
+    }
+
+    Frame frame;
+    int64_t start_ns = MonotonicNowNs();
+    TRACE_SCOPE("vision.capture");
+    if (!capture_.read(frame.image) || frame.image.empty()) {
+      if (!live_) {
+        break;  // End of the recording.
+      }
+      std::cerr << "vision_pipeline: camera read failed" << std::endl;
+      usleep(kPausedPollUs);
+      continue;
+    }
+    frame.frame_id = ++frame_id;
+    frame.capture_time_ns = start_ns;
+    Account(kCapture, start_ns);
+    captured_.Push(std::move(frame));
+
+    if (!live_ && config_.realtime_playback && frame_period_ns > 0) {
+      next_frame_ns += frame_period_ns;
+      int64_t wait_ns = next_frame_ns - MonotonicNowNs();
+      if (wait_ns > 0) {
+        usleep(wait_ns / 1000);
+      }
+    }
+  }
+  captured_.Close();
+}
+
+void VisionPipeline::PreprocessLoop() {
+  TRACE_THREAD_NAME("vision preprocess");
+  Frame frame;
+  while (captured_.Pop(&frame)) {
+    TRACE_SCOPE("vision.preprocess");
+    int64_t start_ns = MonotonicNowNs();
+    cv::Size frame_size(detector_->config().frame_width,
+                        frame.image.rows * detector_->config().frame_width /
+                            frame.image.cols);
+    frame.roi = config_.roi &&
+                ChooseWindow(frame.frame_id, frame.capture_time_ns,
+                             frame_size, &frame.window);
+    if (frame.roi) {
+      frame.tensor = detector_->PreprocessRoi(frame.image, &frame.window,
+                                              &frame.frame_size);
+    } else {
+      frame.tensor = detector_->Preprocess(frame.image, &frame.frame_size);
+      frame.window = cv::Rect2f(0, 0, frame.frame_size.width,
+                                frame.frame_size.height);
+    }
+    frame.image.release();
+    Account(kPreprocess, start_ns);
+    preprocessed_.Push(std::move(frame));
+  }
+  preprocessed_.Close();
+}
+
+void VisionPipeline::InferenceLoop() {
+  TRACE_THREAD_NAME("vision inference");
+  Frame frame;
+  while (preprocessed_.Pop(&frame)) {
+    TRACE_SCOPE("vision.inference");
+    int64_t start_ns = MonotonicNowNs();
+    frame.tensor = detector_->Infer(frame.tensor);
+    int64_t elapsed_ns = MonotonicNowNs() - start_ns;
+    if (frame.roi) {
+      roi_frames_++;
+      roi_inference_ns_ += elapsed_ns;
+    } else {
+      full_frames_++;
+      full_inference_ns_ += elapsed_ns;
+    }
+    Account(kInference, start_ns);
+    inferred_.Push(std::move(frame));
+  }
+  inferred_.Close();
+}
+
+void VisionPipeline::PostprocessLoop() {
+  TRACE_THREAD_NAME("vision postprocess");
+  Frame frame;
+  while (inferred_.Pop(&frame)) {
+    TRACE_SCOPE("vision.postprocess");
+    int64_t start_ns = MonotonicNowNs();
+    PersonDetection detection =
+        detector_->Postprocess(frame.tensor, frame.window);
+    detection.frame_id = frame.frame_id;
+    detection.timestamp_ns = frame.capture_time_ns;
+    DetectionRecord record = ToDetectionRecord(detection);
+    channel_->Publish(record);
+    if (config_.roi) {
+      std::lock_guard<std::mutex> lock(tracker_mutex_);
+      tracker_.Update(record);
+    }
+    CountTarget(detection.found);
+    Account(kPostprocess, start_ns);
+  }
+  finished_ = true;
+}
+
+bool VisionPipeline::ChooseWindow(uint64_t frame_id, int64_t time_ns,
+                                  cv::Size frame_size, cv::Rect2f* window) {
+  if (config_.roi_full_frame_interval > 0 &&
+      frame_id % config_.roi_full_frame_interval == 0) {
+    return false;
+  }
+  TrackEstimate target;
+  {
+    std::lock_guard<std::mutex> lock(tracker_mutex_);
+    target = tracker_.Predict(time_ns);
+  }
+  if (!target.valid || target.coast_ns > config_.roi_max_coast_ns) {
+    return false;
+  }
+  // A square around the predicted box, shifted (not clipped) to stay inside
+  // the frame so the person is never cut off at an edge.
+  float side = std::max(target.width, target.height) * config_.roi_expand;
+  side = std::max(side, config_.roi_min_window);
+  side = std::min(side, static_cast<float>(
+                            std::min(frame_size.width, frame_size.height)));
+  float x = std::min(std::max(target.x - side / 2, 0.0f),
+                     frame_size.width - side);
+  float y = std::min(std::max(target.y - side / 2, 0.0f),
+                     frame_size.height - side);
+  *window = cv::Rect2f(x, y, side, side);
+  return true;
+}
+
+void VisionPipeline::CountTarget(bool found) {
+  if (found) {
+    if (misses_ > 0) {
+      reacquisitions_++;
+      reacquire_frames_ += misses_;
+    }
+    target_seen_ = true;
+    misses_ = 0;
+  } else if (target_seen_) {
+    if (misses_++ == 0) {
+      losses_++;
+    }
+  }
+}
+
+void VisionPipeline::GetStats(VisionStageStats stages[kNumStages],
+                              VisionQueueStats queues[kNumQueues]) const {
+  double elapsed_s = (MonotonicNowNs() - start_time_ns_) / 1e9;
+  for (int i = 0; i < kNumStages; i++) {
+    uint64_t frames = counters_[i].frames.load();
+    int64_t busy_ns = counters_[i].busy_ns.load();
+    stages[i].name = kStageNames[i];
+    stages[i].frames = frames;
+    stages[i].fps = elapsed_s > 0 ? frames / elapsed_s : 0;
+    stages[i].mean_ms = frames > 0 ? busy_ns / 1e6 / frames : 0;
+  }
+  const LatestQueue<Frame>* const all_queues[kNumQueues] = {
+      &captured_, &preprocessed_, &inferred_};
+  for (int i = 0; i < kNumQueues; i++) {
+    queues[i].name = kQueueNames[i];
+    queues[i].depth = all_queues[i]->Depth();
+    queues[i].max_depth = all_queues[i]->MaxDepth();
+    queues[i].dropped = all_queues[i]->Dropped();
+  }
+}
+
+void VisionPipeline::GetTargetStats(VisionTargetStats* stats) const {
+  stats->roi_frames = roi_frames_.load();
+  stats->full_frames = full_frames_.load();
+  stats->roi_mean_ms =
+      stats->roi_frames > 0 ? roi_inference_ns_ / 1e6 / stats->roi_frames : 0;
+  stats->full_mean_ms = stats->full_frames > 0
+                            ? full_inference_ns_ / 1e6 / stats->full_frames
+                            : 0;
+  stats->losses = losses_.load();
+  stats->reacquisitions = reacquisitions_.load();
+  stats->mean_frames_to_reacquire =
+      stats->reacquisitions > 0
+          ? static_cast<double>(reacquire_frames_) / stats->reacquisitions
+          : 0;
+}
+
+void VisionPipeline::PrintStats(std::ostream& out) const {
+  VisionStageStats stages[kNumStages];
+  VisionQueueStats queues[kNumQueues];
+  GetStats(stages, queues);
+  out << std::fixed << std::setprecision(2);
+  for (int i = 0; i < kNumStages; i++) {
+    out << "vision_pipeline stage " << stages[i].name
+        << ": frames=" << stages[i].frames << " fps=" << stages[i].fps
+        << " mean=" << stages[i].mean_ms << "ms" << std::endl;
+  }
+  for (int i = 0; i < kNumQueues; i++) {
+    out << "vision_pipeline queue " << queues[i].name
+        << ": depth=" << queues[i].depth
+        << " max_depth=" << queues[i].max_depth
+        << " dropped=" << queues[i].dropped << std::endl;
+  }
+  VisionTargetStats target;
+  GetTargetStats(&target);
+  out << "vision_pipeline inference: roi frames=" << target.roi_frames
+      << " mean=" << target.roi_mean_ms << "ms, full frames="
+      << target.full_frames << " mean=" << target.full_mean_ms << "ms"
+      << std::endl;
+  out << "vision_pipeline target: losses=" << target.losses
+      << " reacquired=" << target.reacquisitions
+      << " mean_frames_to_reacquire=" << target.mean_frames_to_reacquire
+      << std::endl;
+}
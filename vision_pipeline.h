@@ -0,0 +1,199 @@
+#ifndef SRC_ASSISTANT_VISION_PIPELINE_H_
+#define SRC_ASSISTANT_VISION_PIPELINE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <ostream>
+#include <string>
+#include <thread>  // NOLINT
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "assistant/detection_channel.h"
+#include "assistant/latest_queue.h"
+#include "assistant/person_detector.h"
+#include "assistant/robot_hal.h"
+#include "assistant/target_tracker.h"
+
+struct VisionPipelineConfig {
+  // Camera index ("0") or the path of a recorded video file.
+  std::string source = "0";
+  // Capacity of each queue between stages. 1 keeps only the freshest frame.
+  size_t queue_capacity = 1;
+  // Play recorded video at its native frame rate, as a live camera would
+  // deliver it. When false, frames are read as fast as the pipeline drains
+  // them and nothing is dropped for lack of time.
+  bool realtime_playback = true;
+  // Frames discarded after opening a live camera so exposure can settle.
+  int warmup_frames = 10;
+  // Region-of-interest mode: while a person is tracked, detect only in a
+  // window around their predicted box, on the detector's ROI-sized net
+  // (PersonDetectorConfig::roi_input_size must be set).
+  bool roi = false;
+  // Side of the square window as a multiple of the larger box side, and its
+  // lower bound in frame pixels.
+  float roi_expand = 1.6;
+  float roi_min_window = 120;
+  // Every this many frames the whole frame is searched anyway, so a second
+  // person or a lost one can be picked up.
+  int roi_full_frame_interval = 10;
+  // Full-frame search resumes once the track has gone this long without a
+  // detection.
+  int64_t roi_max_coast_ns = 500000000;
+};
+
+// Throughput of one pipeline stage since Start().
+struct VisionStageStats {
+  const char* name;
+  uint64_t frames;
+  // Frames per second of wall-clock time.
+  double fps;
+  // Mean time spent working on one frame.
+  double mean_ms;
+};
+
+// Occupancy of one inter-stage queue since Start().
+struct VisionQueueStats {
+  const char* name;
+  size_t depth;
+  size_t max_depth;
+  uint64_t dropped;
+};
+
+// How often a lost person is found again, and what ROI mode saves.
+struct VisionTargetStats {
+  // Frames inferred on a window and on the whole frame, with the mean
+  // inference time of each.
+  uint64_t roi_frames;
+  uint64_t full_frames;
+  double roi_mean_ms;
+  double full_mean_ms;
+  // Runs of frames without a person after one was found, how many of them
+  // ended with the person found again, and their mean length in frames.
+  uint64_t losses;
+  uint64_t reacquisitions;
+  double mean_frames_to_reacquire;
+};
+
+// Runs person detection as four concurrent stages — capture, preprocess
+// (resize + blobFromImage), SSD inference and postprocess — connected by
+// LatestQueues that drop stale frames. Every result is published to a
+// DetectionChannel, so the follow loop sees the newest detection while the
+// robot is still moving.
+class VisionPipeline {
+ public:
+  static const int kNumStages = 4;
+  static const int kNumQueues = 3;
+
+  // |detector| must have its model loaded; the pipeline only uses its
+  // stage methods and supplies frames from |config.source|.
+  VisionPipeline(PersonDetector* detector, DetectionChannel* channel,
+                 const VisionPipelineConfig& config);
+  ~VisionPipeline();
+
+  // Opens the source and starts the stage threads.
+  bool Start();
+
+  // Stops the stage threads and releases the source.
+  void Stop();
+
+  // While inactive the capture stage stops reading frames; frames queued
+  // from before a pause are discarded on resume.
+  void SetActive(bool active);
+
+  // True once a recorded video has been fully processed.
+  bool Finished() const { return finished_.load(); }
+
+  void GetStats(VisionStageStats stages[kNumStages],
+                VisionQueueStats queues[kNumQueues]) const;
+  void GetTargetStats(VisionTargetStats* stats) const;
+  void PrintStats(std::ostream& out) const;
+
+ private:
+  struct Frame {
+    uint64_t frame_id;
+    int64_t capture_time_ns;
+    cv::Mat image;
+    cv::Size frame_size;
+    // Part of the frame the tensor covers, in frame_size pixels.
+    cv::Rect2f window;
+    bool roi;
+    cv::Mat tensor;
+  };
+
+  struct StageCounters {
+    std::atomic<uint64_t> frames;
+    std::atomic<int64_t> busy_ns;
+  };
+
+  enum StageIndex { kCapture, kPreprocess, kInference, kPostprocess };
+
+  void CaptureLoop();
+  void PreprocessLoop();
+  void InferenceLoop();
+  void PostprocessLoop();
+  void Account(StageIndex stage, int64_t start_ns);
+  // Picks the ROI window for a frame captured at |time_ns|; false means
+  // search the whole frame.
+  bool ChooseWindow(uint64_t frame_id, int64_t time_ns, cv::Size frame_size,
+                    cv::Rect2f* window);
+  void CountTarget(bool found);
+
+  PersonDetector* detector_;
+  DetectionChannel* channel_;
+  VisionPipelineConfig config_;
+  bool live_;
+  cv::VideoCapture capture_;
+
+  LatestQueue<Frame> captured_;
+  LatestQueue<Frame> preprocessed_;
+  LatestQueue<Frame> inferred_;
+
+  std::thread threads_[kNumStages];
+  StageCounters counters_[kNumStages];
+  std::atomic<bool> running_;
+  std::atomic<bool> active_;
+  std::atomic<bool> finished_;
+  int64_t start_time_ns_;
+
+  // Updated by the postprocess stage, read by the preprocess stage.
+  std::mutex tracker_mutex_;
+  TargetTracker tracker_;
+
+  std::atomic<uint64_t> roi_frames_;
+  std::atomic<uint64_t> full_frames_;
+  std::atomic<int64_t> roi_inference_ns_;
+  std::atomic<int64_t> full_inference_ns_;
+  // Postprocess stage only, apart from the atomics.
+  bool target_seen_;
+  uint64_t misses_;
+  std::atomic<uint64_t> losses_;
+  std::atomic<uint64_t> reacquisitions_;
+  std::atomic<uint64_t> reacquire_frames_;
+
+  VisionPipeline(const VisionPipeline&) = delete;
+  VisionPipeline& operator=(const VisionPipeline&) = delete;
+};
+
+// DetectionSource on the camera: switches |pipeline| on and off and reads
+// the records it publishes into |channel|.
+class VisionDetectionSource : public DetectionSource {
+ public:
+  VisionDetectionSource(VisionPipeline* pipeline,
+                        const DetectionChannel* channel)
+      : pipeline_(pipeline), channel_(channel) {}
+
+  void SetActive(bool active) override { pipeline_->SetActive(active); }
+  bool ReadLatest(DetectionRecord* record) override {
+    return channel_->ReadLatest(record);
+  }
+
+ private:
+  VisionPipeline* pipeline_;
+  const DetectionChannel* channel_;
+};
+
+#endif  // SRC_ASSISTANT_VISION_PIPELINE_H_
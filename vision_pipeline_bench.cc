@@ -0,0 +1,146 @@
+// Runs the VisionPipeline over a recorded video (or a live camera) and
+// reports per-stage throughput, queue depths, and how old the newest
+// detection is whenever the follow loop would look at it. With --record,
+// every detection is also appended to a log that target_tracker_test can
+// replay. With --roi, tracked frames are detected on a window around the
+// person at the given network input size; run the same video with and
+// without it to compare inference time and re-acquisitions.
+//
+// Usage: ./vision_pipeline_bench --video <file|camera index>
+//                                [--prototxt <path>] [--model <path>]
+//                                [--fast] [--seconds N] [--record <log>]
+//                                [--roi <input size>]
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "assistant/detection_channel.h"
+#include "assistant/person_detector.h"
+#include "assistant/time_util.h"
+#include "assistant/vision_pipeline.h"
+
+static const char kDefaultPrototxt[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.prototxt.txt";
+static const char kDefaultModel[] =
+    "/home/pi/real-time-object-detection/MobileNetSSD_deploy.caffemodel";
+// Rate at which the bench samples the channel, like a control loop would.
+static const int kSamplePeriodUs = 20000;
+
+int main(int argc, char** argv) {
+  PersonDetectorConfig detector_config;
+  detector_config.prototxt_path = kDefaultPrototxt;
+  detector_config.model_path = kDefaultModel;
+  VisionPipelineConfig pipeline_config;
+  double max_seconds = 0;
+  std::string record_path;
+
+  const struct option long_options[] = {
+      {"video", required_argument, nullptr, 'v'},
+      {"prototxt", required_argument, nullptr, 'p'},
+      {"model", required_argument, nullptr, 'm'},
+      {"fast", no_argument, nullptr, 'f'},
+      {"seconds", required_argument, nullptr, 's'},
+      {"record", required_argument, nullptr, 'r'},
+      {"roi", required_argument, nullptr, 'o'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char = getopt_long(argc, argv, "v:p:m:fs:r:o:", long_options,
+                                  &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'v':
+        pipeline_config.source = optarg;
+        break;
+      case 'p':
+        detector_config.prototxt_path = optarg;
+        break;
+      case 'm':
+        detector_config.model_path = optarg;
+        break;
+      case 'f':
+        pipeline_config.realtime_playback = false;
+        // Nothing may be dropped when replaying as fast as possible.
+        pipeline_config.queue_capacity = 4;
+        break;
+      case 's':
+        max_seconds = std::atof(optarg);
+        break;
+      case 'r':
+        record_path = optarg;
+        break;
+      case 'o':
+        detector_config.roi_input_size = std::atoi(optarg);
+        pipeline_config.roi = detector_config.roi_input_size > 0;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  PersonDetector detector(detector_config);
+  if (!detector.LoadModel()) {
+    return -1;
+  }
+  DetectionChannel channel;
+  if (!channel.Create("")) {
+    return -1;
+  }
+  std::ofstream record_log;
+  if (!record_path.empty()) {
+    record_log.open(record_path);
+    if (!record_log) {
+      std::cerr << "vision_pipeline_bench: cannot write " << record_path
+                << std::endl;
+      return -1;
+    }
+  }
+  VisionPipeline pipeline(&detector, &channel, pipeline_config);
+  int64_t start_ns = MonotonicNowNs();
+  if (!pipeline.Start()) {
+    return -1;
+  }
+
+  std::vector<int64_t> age_ns;
+  uint64_t last_frame = 0;
+  uint64_t frames_with_person = 0;
+  while (!pipeline.Finished()) {
+    if (max_seconds > 0 && (MonotonicNowNs() - start_ns) / 1e9 > max_seconds) {
+      break;
+    }
+    usleep(kSamplePeriodUs);
+    DetectionRecord record;
+    if (!channel.ReadLatest(&record)) {
+      continue;
+    }
+    age_ns.push_back(MonotonicNowNs() - record.capture_time_ns);
+    if (record.frame_id != last_frame) {
+      last_frame = record.frame_id;
+      frames_with_person += record.found;
+      if (record_log.is_open()) {
+        WriteDetectionLogLine(record, &record_log);
+      }
+    }
+  }
+  pipeline.PrintStats(std::cout);
+  pipeline.Stop();
+
+  std::cout << "sampled frames with a person: " << frames_with_person
+            << std::endl;
+  if (!age_ns.empty()) {
+    std::sort(age_ns.begin(), age_ns.end());
+    std::cout << "newest detection age: p50="
+              << age_ns[age_ns.size() / 2] / 1e6 << "ms p95="
+              << age_ns[age_ns.size() * 95 / 100] / 1e6 << "ms" << std::endl;
+  }
+  return 0;
+}
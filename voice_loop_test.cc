@@ -0,0 +1,284 @@
+// Responsiveness test of the voice loop while the robot follows someone,
+// against the stand-in server (assistant_stub_server.h). The loop handles
+// responses as run_assistant_audio does: partial results go to a
+// CommandSpeculator, robot commands to a CommandRunner on a TaskExecutor
+// and the ring to StatusLights, over the real motion, IMU and follow code
+// driving the simulated robot (robot_sim.h) in real time after its walking
+// person.
+//
+// The turns are "follow me", a few questions while it follows, "come on"
+// (which starts out like "come to me"), "stop" and one more question. It
+// checks that:
+//
+//   - every turn completes: the loop used to stay inside "follow me"
+//     forever, so the stream was never finished and "stop" never heard
+//   - no response takes the loop longer than --budget-ms to handle
+//   - the follow keeps running through the questions and "come on", with
+//     the detector on
+//   - "stop" ends it, halting the robot, within --budget-ms
+//
+// Usage: ./voice_loop_test [--questions N] [--budget-ms MS]
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "assistant/assistant_stub_server.h"
+#include "assistant/follow_behavior.h"
+#include "assistant/imu_service.h"
+#include "assistant/motion_controller.h"
+#include "assistant/robot_commands.h"
+#include "assistant/robot_sim.h"
+#include "assistant/status_lights.h"
+#include "assistant/task_executor.h"
+#include "assistant/time_util.h"
+
+namespace assistant = google::assistant::embedded::v1alpha2;
+
+using assistant::AssistRequest;
+using assistant::AssistResponse;
+
+typedef grpc::ClientReaderWriter<AssistRequest, AssistResponse> AssistStream;
+
+static const int kAudioInBytes = 3200;
+static const int kAudioInChunks = 5;
+// Time between turns, as between the user's sentences.
+static const int kPauseMs = 400;
+
+struct TurnStats {
+  std::string transcript;
+  // Longest time the loop spent on one response.
+  int64_t max_handle_ns = 0;
+  // From the final result to the command's behavior having ended.
+  int64_t stop_ns = -1;
+  bool busy_after = false;
+  bool detector_after = false;
+};
+
+// One turn of the voice loop, handled as run_assistant_audio does.
+static bool RunTurn(assistant::EmbeddedAssistant::Stub* stub,
+                    CommandRunner* commands, CommandSpeculator* speculator,
+                    StatusLights* lights, SimRobot* robot,
+                    TurnStats* stats) {
+  lights->Show(RobotStatus::kListening);
+  grpc::ClientContext context;
+  std::shared_ptr<AssistStream> stream(stub->Assist(&context));
+  AssistRequest request;
+  request.mutable_config()->mutable_audio_in_config()->set_sample_rate_hertz(
+      16000);
+  if (!stream->Write(request)) {
+    std::cerr << "voice_loop_test: cannot open a stream" << std::endl;
+    return false;
+  }
+  request.set_audio_in(std::string(kAudioInBytes, '\0'));
+  for (int i = 0; i < kAudioInChunks; i++) {
+    stream->Write(request);
+  }
+  stream->WritesDone();
+
+  AssistResponse response;
+  bool stopping = false;
+  while (stream->Read(&response)) {
+    int64_t start_ns = MonotonicNowNs();
+    bool final_result = response.speech_results_size() == 1 &&
+                        response.speech_results(0).stability() == 1;
+    if (!final_result && response.speech_results_size() > 0) {
+      std::vector<SpeechResult> results;
+      for (int i = 0; i < response.speech_results_size(); i++) {
+        results.push_back({response.speech_results(i).transcript(),
+                           response.speech_results(i).stability()});
+      }
+      speculator->OnPartial(results);
+    }
+    for (int i = 0; i < response.speech_results_size(); i++) {
+      const auto& result = response.speech_results(i);
+      if (final_result) {
+        speculator->OnFinal(result.transcript());
+      }
+      if (result.stability() > 0) {
+        lights->Show(RobotStatus::kRecognized);
+      }
+      if (result.stability() == 1 && IsRobotCommand(result.transcript())) {
+        stats->transcript = result.transcript();
+        lights->Show(RobotStatus::kMoving);
+        commands->Post(result.transcript());
+        stopping = result.transcript() == "stop";
+      }
+      if (result.stability() == 1) {
+        stats->transcript = result.transcript();
+      }
+    }
+    int64_t handle_ns = MonotonicNowNs() - start_ns;
+    stats->max_handle_ns = std::max(stats->max_handle_ns, handle_ns);
+    if (stopping && stats->stop_ns < 0) {
+      // Timed apart from the loop, which has moved on already.
+      int64_t deadline_ns = start_ns + 1000000000;
+      while (commands->busy() && MonotonicNowNs() < deadline_ns) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      if (!commands->busy() && !robot->motors_on()) {
+        stats->stop_ns = MonotonicNowNs() - start_ns;
+      }
+    }
+  }
+  speculator->Cancel();
+  grpc::Status status = stream->Finish();
+  if (!status.ok()) {
+    std::cerr << "voice_loop_test: turn failed: " << status.error_message()
+              << std::endl;
+    return false;
+  }
+  stats->busy_after = commands->busy();
+  stats->detector_after = robot->camera_active();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int questions = 4;
+  int budget_ms = 100;
+
+  const struct option long_options[] = {
+      {"questions", required_argument, nullptr, 'n'},
+      {"budget-ms", required_argument, nullptr, 'b'},
+      {nullptr, 0, nullptr, 0}};
+  while (true) {
+    int option_index;
+    int option_char =
+        getopt_long(argc, argv, "n:b:", long_options, &option_index);
+    if (option_char == -1) {
+      break;
+    }
+    switch (option_char) {
+      case 'n':
+        questions = std::atoi(optarg);
+        break;
+      case 'b':
+        budget_ms = std::atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  StubAssistantConfig stub_config;
+  stub_config.transcripts.push_back("follow me");
+  for (int i = 0; i < questions; i++) {
+    stub_config.transcripts.push_back("what time is it");
+  }
+  stub_config.transcripts.push_back("come on");
+  stub_config.transcripts.push_back("stop");
+  stub_config.transcripts.push_back("what time is it");
+  stub_config.partials = true;
+  stub_config.audio_out_chunks = 2;
+  StubAssistantServer server(stub_config);
+  if (!server.Start("localhost:0")) {
+    return -1;
+  }
+  auto channel =
+      grpc::CreateChannel("localhost:" + std::to_string(server.port()),
+                          grpc::InsecureChannelCredentials());
+  auto stub = assistant::EmbeddedAssistant::NewStub(channel);
+
+  MonotonicClock clock;
+  SimConfig sim_config;
+  SimRobot robot(&clock, sim_config);
+  ImuConfig imu_config;
+  imu_config.calibration_s = 0.2;
+  ImuService imu(robot.imu(), &clock, imu_config);
+  MotionController motion(robot.motors(), &imu, &clock, MotionConfig());
+  if (!imu.Start() || !motion.Start()) {
+    return -1;
+  }
+  FollowConfig follow_config;
+  follow_config.tracker.frame_width = sim_config.frame_width;
+  follow_config.tracker.horizontal_fov_deg = sim_config.horizontal_fov_deg;
+  FollowBehavior follow(&motion, robot.detections(), &clock, follow_config);
+
+  bool pass = true;
+  int64_t max_handle_ns = 0;
+  int follow_turns = 0;
+  int detector_turns = 0;
+  uint64_t frames = 0;
+  {
+    StatusLights lights(robot.leds(), &clock, StatusLightsConfig());
+    lights.Start();
+    TaskExecutor executor(2);
+    CommandRunner commands(&motion, &follow);
+    commands.Start(&executor);
+    CommandSpeculator speculator(&motion, robot.detections(), &commands,
+                                 RecognizerConfig());
+
+    size_t turns = stub_config.transcripts.size();
+    for (size_t turn = 0; turn < turns; turn++) {
+      TurnStats stats;
+      if (!RunTurn(stub.get(), &commands, &speculator, &lights, &robot,
+                   &stats)) {
+        pass = false;
+        break;
+      }
+      printf("turn %zu %-16s handled in <= %6.2f ms, %s, detector %s", turn,
+             stats.transcript.c_str(), stats.max_handle_ns / 1e6,
+             stats.busy_after ? "following" : "idle",
+             stats.detector_after ? "on" : "off");
+      if (stats.stop_ns >= 0) {
+        printf(", stopped in %.1f ms", stats.stop_ns / 1e6);
+      }
+      printf("\n");
+      max_handle_ns = std::max(max_handle_ns, stats.max_handle_ns);
+      // The questions and "come on".
+      bool following = turn > 0 && turn <= static_cast<size_t>(questions) + 1;
+      if (following) {
+        follow_turns += stats.busy_after;
+        detector_turns += stats.detector_after;
+      }
+      if (stats.transcript == "stop" &&
+          (stats.stop_ns < 0 ||
+           stats.stop_ns > static_cast<int64_t>(budget_ms) * 1000000)) {
+        std::cerr << "voice_loop_test: \"stop\" did not end the follow in "
+                  << budget_ms << " ms" << std::endl;
+        pass = false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(kPauseMs));
+    }
+    commands.Stop();
+    lights.Stop();
+    frames = lights.frames();
+  }
+  motion.Stop();
+  imu.Stop();
+
+  if (server.turns() != static_cast<int>(stub_config.transcripts.size())) {
+    std::cerr << "voice_loop_test: " << server.turns() << " of "
+              << stub_config.transcripts.size() << " turns completed"
+              << std::endl;
+    pass = false;
+  }
+  if (max_handle_ns > static_cast<int64_t>(budget_ms) * 1000000) {
+    std::cerr << "voice_loop_test: a response held the loop for "
+              << max_handle_ns / 1e6 << " ms" << std::endl;
+    pass = false;
+  }
+  if (follow_turns != questions + 1) {
+    std::cerr << "voice_loop_test: the follow ran through " << follow_turns
+              << " of " << questions + 1 << " turns" << std::endl;
+    pass = false;
+  }
+  if (detector_turns != questions + 1) {
+    std::cerr << "voice_loop_test: the detector was on after "
+              << detector_turns << " of " << questions + 1
+              << " turns of the follow" << std::endl;
+    pass = false;
+  }
+  printf("%llu of %llu LED frames written\n",
+         static_cast<unsigned long long>(robot.led_writes()),
+         static_cast<unsigned long long>(frames));
+  printf("%s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
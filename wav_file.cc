@@ -0,0 +1,111 @@
+#include "assistant/wav_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// WAV is little-endian, as is every machine this runs on.
+static uint32_t ReadU32(const char* p) {
+  uint32_t value;
+  std::memcpy(&value, p, 4);
+  return value;
+}
+
+static uint16_t ReadU16(const char* p) {
+  uint16_t value;
+  std::memcpy(&value, p, 2);
+  return value;
+}
+
+bool ReadWav(const std::string& path, WavData* wav) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "wav_file: cannot open " << path << std::endl;
+    return false;
+  }
+  char header[12];
+  if (!file.read(header, sizeof(header)) ||
+      std::memcmp(header, "RIFF", 4) != 0 ||
+      std::memcmp(header + 8, "WAVE", 4) != 0) {
+    std::cerr << "wav_file: " << path << " is not a WAV file" << std::endl;
+    return false;
+  }
+  bool has_format = false;
+  char chunk[8];
+  while (file.read(chunk, sizeof(chunk))) {
+    uint32_t size = ReadU32(chunk + 4);
+    if (std::memcmp(chunk, "fmt ", 4) == 0) {
+      std::vector<char> format(std::max<uint32_t>(size, 16));
+      if (!file.read(format.data(), size)) {
+        break;
+      }
+      uint16_t encoding = ReadU16(&format[0]);
+      wav->channels = ReadU16(&format[2]);
+      wav->sample_rate = ReadU32(&format[4]);
+      uint16_t bits = ReadU16(&format[14]);
+      if (encoding != 1 || bits != 16 || wav->channels == 0) {
+        std::cerr << "wav_file: " << path << " is not 16-bit PCM"
+                  << std::endl;
+        return false;
+      }
+      has_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0 && has_format) {
+      wav->samples.resize(size / 2);
+      if (!file.read(reinterpret_cast<char*>(wav->samples.data()),
+                     wav->samples.size() * 2)) {
+        // A recording cut short still plays up to where it ends.
+        wav->samples.resize(file.gcount() / 2);
+      }
+      wav->samples.resize(wav->samples.size() / wav->channels *
+                          wav->channels);
+      return true;
+    } else {
+      file.seekg(size + (size & 1), std::ios::cur);
+    }
+  }
+  std::cerr << "wav_file: " << path << " has no audio" << std::endl;
+  return false;
+}
+
+static void WriteU32(std::ofstream* file, uint32_t value) {
+  file->write(reinterpret_cast<const char*>(&value), 4);
+}
+
+static void WriteU16(std::ofstream* file, uint16_t value) {
+  file->write(reinterpret_cast<const char*>(&value), 2);
+}
+
+bool WriteWav(const std::string& path, const WavData& wav) {
+  std::ofstream file(path, std::ios::binary);
+  uint32_t data_bytes = wav.samples.size() * 2;
+  file.write("RIFF", 4);
+  WriteU32(&file, 36 + data_bytes);
+  file.write("WAVEfmt ", 8);
+  WriteU32(&file, 16);
+  WriteU16(&file, 1);
+  WriteU16(&file, wav.channels);
+  WriteU32(&file, wav.sample_rate);
+  WriteU32(&file, wav.sample_rate * wav.channels * 2);
+  WriteU16(&file, wav.channels * 2);
+  WriteU16(&file, 16);
+  file.write("data", 4);
+  WriteU32(&file, data_bytes);
+  file.write(reinterpret_cast<const char*>(wav.samples.data()), data_bytes);
+  if (!file) {
+    std::cerr << "wav_file: cannot write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool WavMicArray::Read(std::vector<int16_t>* samples) {
+  size_t block = static_cast<size_t>(block_samples_) * wav_->channels;
+  if (position_ + block > wav_->samples.size()) {
+    return false;
+  }
+  samples->assign(wav_->samples.begin() + position_,
+                  wav_->samples.begin() + position_ + block);
+  position_ += block;
+  return true;
+}
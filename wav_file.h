@@ -0,0 +1,41 @@
+#ifndef SRC_ASSISTANT_WAV_FILE_H_
+#define SRC_ASSISTANT_WAV_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "assistant/robot_hal.h"
+
+// 16-bit PCM audio of any number of channels.
+struct WavData {
+  int channels = 0;
+  int sample_rate = 0;
+  // Interleaved by channel.
+  std::vector<int16_t> samples;
+};
+
+// Reads and writes 16-bit PCM WAV files. False, with the reason on
+// std::cerr, for any other format or an I/O error.
+bool ReadWav(const std::string& path, WavData* wav);
+bool WriteWav(const std::string& path, const WavData& wav);
+
+// Plays a recording back as the microphone array, |block_samples| per
+// channel at a time, as fast as it is read.
+class WavMicArray : public MicArrayPort {
+ public:
+  explicit WavMicArray(const WavData* wav, int block_samples = 128)
+      : wav_(wav), block_samples_(block_samples), position_(0) {}
+
+  int Channels() const override { return wav_->channels; }
+  int SampleRate() const override { return wav_->sample_rate; }
+  bool Read(std::vector<int16_t>* samples) override;
+
+ private:
+  const WavData* wav_;
+  int block_samples_;
+  size_t position_;
+};
+
+#endif  // SRC_ASSISTANT_WAV_FILE_H_